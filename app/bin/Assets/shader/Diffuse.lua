@@ -2,19 +2,38 @@ local vs = [[
 #ifndef SKIN_ON
 	#define SKIN_ON 0
 #endif
+#ifndef INSTANCING_ON
+	#define INSTANCING_ON 0
+#endif
 #ifndef RECIEVE_SHADOW_ON
 	#define RECIEVE_SHADOW_ON 0
 #endif
+#ifndef LIGHTS_CLUSTERED
+	#define LIGHTS_CLUSTERED 0
+#endif
+#if (LIGHTS_CLUSTERED == 1)
+	// clustered lights have no shadow
+	#undef RECIEVE_SHADOW_ON
+	#define RECIEVE_SHADOW_ON 0
+#endif
 
 VK_UNIFORM_BINDING(0) uniform PerView
 {
 	mat4 u_view_matrix;
     mat4 u_projection_matrix;
 };
-VK_UNIFORM_BINDING(1) uniform PerRenderer
-{
-	mat4 u_model_matrix;
-};
+#if (INSTANCING_ON == 1)
+	VK_UNIFORM_BINDING(1) uniform PerRenderer
+	{
+		mat4 u_model_matrices[VR_MAX_INSTANCE_COUNT];
+	};
+	#define u_model_matrix u_model_matrices[VR_INSTANCE_ID]
+#else
+	VK_UNIFORM_BINDING(1) uniform PerRenderer
+	{
+		mat4 u_model_matrix;
+	};
+#endif
 VK_UNIFORM_BINDING(3) uniform PerMaterialVertex
 {
 	vec4 u_texture_scale_offset;
@@ -51,15 +70,6 @@ VK_LAYOUT_LOCATION(2) out vec3 v_normal;
 	}
 #endif
 
-#if (RECIEVE_SHADOW_ON == 1)
-	VK_LAYOUT_LOCATION(3) out vec4 v_pos_light_proj;
-	VK_UNIFORM_BINDING(5) uniform PerLightVertex
-	{
-		mat4 u_light_view_matrix;
-		mat4 u_light_projection_matrix;
-	};
-#endif
-
 void main()
 {
 #if (SKIN_ON == 1)
@@ -74,10 +84,6 @@ void main()
 	v_uv = i_uv * u_texture_scale_offset.xy + u_texture_scale_offset.zw;
     v_normal = (vec4(i_normal, 0.0) * model_matrix).xyz;
 
-#if (RECIEVE_SHADOW_ON == 1)
-	v_pos_light_proj = i_vertex * model_matrix * u_light_view_matrix * u_light_projection_matrix;
-#endif
-
 	vk_convert();
 }
 ]]
@@ -92,6 +98,13 @@ local fs = [[
 #ifndef VR_GLES
 	#define VR_GLES 0
 #endif
+#ifndef LIGHTS_CLUSTERED
+	#define LIGHTS_CLUSTERED 0
+#endif
+#if (LIGHTS_CLUSTERED == 1)
+	#undef RECIEVE_SHADOW_ON
+	#define RECIEVE_SHADOW_ON 0
+#endif
 
 precision highp float;
 VK_SAMPLER_BINDING(0) uniform sampler2D u_texture;
@@ -99,22 +112,39 @@ VK_UNIFORM_BINDING(4) uniform PerMaterialFragment
 {
     vec4 u_color;
 };
-VK_UNIFORM_BINDING(6) uniform PerLightFragment
-{
-	vec4 u_ambient_color;
-    vec4 u_light_pos;
-    vec4 u_light_color;
-	vec4 u_light_atten;
-	vec4 u_spot_light_dir;
-	vec4 u_shadow_params;
-};
+#if (LIGHTS_CLUSTERED == 1)
+	// light index offset needs more than 16 bits
+	precision highp int;
+	VK_UNIFORM_BINDING(6) uniform PerLightFragment
+	{
+		vec4 u_ambient_color;
+		vec4 u_cluster_size;
+		vec4 u_cluster_extent;
+		vec4 u_cluster_params;
+		vec4 u_cluster_view[3];
+		vec4 u_lights[VR_MAX_CLUSTER_LIGHT_COUNT * 4];
+	};
+	VK_SAMPLER_BINDING(2) uniform highp sampler2D u_light_clusters;
+	VK_SAMPLER_BINDING(3) uniform highp sampler2D u_light_indices;
+#else
+	VK_UNIFORM_BINDING(6) uniform PerLightFragment
+	{
+		vec4 u_ambient_color;
+		vec4 u_light_pos;
+		vec4 u_light_color;
+		vec4 u_light_atten;
+		vec4 u_spot_light_dir;
+		vec4 u_shadow_params;
+		vec4 u_cascade_params;
+		mat4 u_cascade_matrices[4];
+	};
+#endif
 VK_LAYOUT_LOCATION(0) in vec3 v_pos;
 VK_LAYOUT_LOCATION(1) in vec2 v_uv;
 VK_LAYOUT_LOCATION(2) in vec3 v_normal;
 
 #if (RECIEVE_SHADOW_ON == 1)
 	VK_SAMPLER_BINDING(1) uniform highp sampler2D u_shadow_texture;
-	VK_LAYOUT_LOCATION(3) in vec4 v_pos_light_proj;
 	const vec2 Poisson25[25] = vec2[](
 		vec2(-0.978698, -0.0884121),
 		vec2(-0.841121, 0.521165),
@@ -142,9 +172,10 @@ VK_LAYOUT_LOCATION(2) in vec3 v_normal;
 		vec2(0.968871, 0.840449),
 		vec2(0.991882, -0.657338)
 	);
-	float texture_shadow(vec2 uv)
+	// tile is min and max uv of cascade in shadow texture
+	float texture_shadow(vec2 uv, vec4 tile)
 	{
-		if (uv.x < 0.0 || uv.x > 1.0 || uv.y < 0.0 || uv.y > 1.0)
+		if (uv.x < tile.x || uv.x > tile.z || uv.y < tile.y || uv.y > tile.w)
 		{
 			return 1.0;
 		}
@@ -153,13 +184,13 @@ VK_LAYOUT_LOCATION(2) in vec3 v_normal;
 			return texture(u_shadow_texture, uv).r;
 		}
 	}
-	float poisson_filter(float z, vec2 uv, float shadow_z_bias, vec2 filter_radius)
+	float poisson_filter(float z, vec2 uv, vec4 tile, float shadow_z_bias, vec2 filter_radius)
 	{
 		float shadow = 0.0;
 		for (int i = 0; i < 25; ++i)
 		{
 			vec2 offset = Poisson25[i] * filter_radius;
-			float shadow_depth = texture_shadow(uv + offset);
+			float shadow_depth = texture_shadow(uv + offset, tile);
 			if (z - shadow_z_bias > shadow_depth)
 			{
 				shadow += 1.0;
@@ -167,7 +198,7 @@ VK_LAYOUT_LOCATION(2) in vec3 v_normal;
 		}
 		return shadow / 25.0;
 	}
-	float pcf_filter(float z, vec2 uv, float shadow_z_bias, vec2 filter_radius)
+	float pcf_filter(float z, vec2 uv, vec4 tile, float shadow_z_bias, vec2 filter_radius)
 	{
 		float shadow = 0.0;
 		for (int i = -1; i <= 1; ++i)
@@ -175,7 +206,7 @@ VK_LAYOUT_LOCATION(2) in vec3 v_normal;
 			for (int j = -1; j <= 1; ++j)
 			{
 				vec2 offset = vec2(i, j) * filter_radius;
-				float shadow_depth = texture_shadow(uv + offset);
+				float shadow_depth = texture_shadow(uv + offset, tile);
 				if (z - shadow_z_bias > shadow_depth)
 				{
 					shadow += 1.0;
@@ -184,9 +215,9 @@ VK_LAYOUT_LOCATION(2) in vec3 v_normal;
 		}
 		return shadow / 9.0;
 	}
-	float linear_filter(float z, vec2 uv, float shadow_z_bias, vec2 filter_radius)
+	float linear_filter(float z, vec2 uv, vec4 tile, float shadow_z_bias, vec2 filter_radius)
 	{
-		float shadow_depth = texture_shadow(uv);
+		float shadow_depth = texture_shadow(uv, tile);
 		if (z - shadow_z_bias > shadow_depth)
 		{
 			return 1.0;
@@ -196,17 +227,108 @@ VK_LAYOUT_LOCATION(2) in vec3 v_normal;
 			return 0.0;
 		}
 	}
-	float sample_shadow(vec4 pos_light_proj, float nl)
+	float sample_shadow(vec3 pos, float nl)
 	{
-		pos_light_proj = pos_light_proj / pos_light_proj.w;
-		vec2 uv = pos_light_proj.xy * 0.5 + 0.5;
-#if (VR_GLES == 0)
-		uv.y = 1.0 - uv.y;
-#endif
-		float z = pos_light_proj.z * 0.5 + 0.5;
+		int cascade_count = int(u_cascade_params.x);
+		float tile_scale = u_cascade_params.y;
 		vec2 filter_radius = vec2(u_shadow_params.w);
 		float shadow_z_bias = u_shadow_params.y + u_shadow_params.z * tan(acos(nl));
-		return poisson_filter(z, uv, shadow_z_bias, filter_radius) * u_shadow_params.x;
+
+		// cascades go from near to far, use the first one covering pos
+		for (int i = 0; i < 4; ++i)
+		{
+			if (i >= cascade_count)
+			{
+				break;
+			}
+
+			vec4 pos_light_proj = vec4(pos, 1.0) * u_cascade_matrices[i];
+			pos_light_proj = pos_light_proj / pos_light_proj.w;
+			vec2 tile_min = vec2(float(i % 2), float(i / 2)) * tile_scale;
+			vec2 tile_max = tile_min + tile_scale;
+			vec2 uv = pos_light_proj.xy;
+			if (uv.x < tile_min.x || uv.x > tile_max.x || uv.y < tile_min.y || uv.y > tile_max.y || pos_light_proj.z > 1.0)
+			{
+				continue;
+			}
+
+			vec4 tile = vec4(tile_min, tile_max);
+#if (VR_GLES == 0)
+			uv.y = 1.0 - uv.y;
+			tile = vec4(tile_min.x, 1.0 - tile_max.y, tile_max.x, 1.0 - tile_min.y);
+#endif
+			float z = pos_light_proj.z;
+			return poisson_filter(z, uv, tile, shadow_z_bias, filter_radius) * u_shadow_params.x;
+		}
+
+		return 0.0;
+	}
+#endif
+
+#if (LIGHTS_CLUSTERED == 1)
+	vec3 light_diffuse(int index, vec3 normal)
+	{
+		vec4 light_pos = u_lights[index * 4];
+		vec4 light_color = u_lights[index * 4 + 1];
+		vec4 light_atten = u_lights[index * 4 + 2];
+		vec4 spot_light_dir = u_lights[index * 4 + 3];
+
+		vec3 to_light = light_pos.xyz - v_pos * light_pos.w;
+		vec3 light_dir = normalize(to_light);
+		float nl = max(dot(normal, light_dir), 0.0);
+
+		float sqr_len = dot(to_light, to_light);
+		float atten = max(1.0 - sqr_len * light_atten.z, 0.0);
+		int light_type = int(light_color.a);
+		if (light_type == 1)
+		{
+			float theta = dot(light_dir, spot_light_dir.xyz);
+			if (theta > light_atten.x)
+			{
+				atten *= clamp((light_atten.x - theta) * light_atten.y, 0.0, 1.0);
+			}
+			else
+			{
+				atten = 0.0;
+			}
+		}
+
+		return light_color.rgb * nl * atten;
+	}
+
+	vec3 clustered_diffuse(vec3 normal)
+	{
+		vec3 diffuse = vec3(0.0);
+
+		int directional_count = int(u_cluster_size.w);
+		for (int i = 0; i < directional_count; ++i)
+		{
+			diffuse += light_diffuse(i, normal);
+		}
+
+		vec4 pos = vec4(v_pos, 1.0);
+		vec3 view_pos = vec3(dot(u_cluster_view[0], pos), dot(u_cluster_view[1], pos), dot(u_cluster_view[2], pos));
+		float depth = -view_pos.z;
+		vec2 extent = u_cluster_extent.xy * mix(1.0, max(depth, 0.0001), u_cluster_extent.z);
+		vec2 ndc = view_pos.xy / extent;
+
+		ivec3 cluster_size = ivec3(u_cluster_size.xyz);
+		int x = clamp(int((ndc.x * 0.5 + 0.5) * u_cluster_size.x), 0, cluster_size.x - 1);
+		int y = clamp(int((ndc.y * 0.5 + 0.5) * u_cluster_size.y), 0, cluster_size.y - 1);
+		int z = clamp(int(log(max(depth, 0.0001)) * u_cluster_params.x + u_cluster_params.y), 0, cluster_size.z - 1);
+
+		// offset in rgb, count in a
+		ivec4 cluster = ivec4(texelFetch(u_light_clusters, ivec2(y * cluster_size.x + x, z), 0) * 255.0 + 0.5);
+		int offset = cluster.r + cluster.g * 256 + cluster.b * 65536;
+		int index_width = int(u_cluster_params.z);
+		for (int i = 0; i < cluster.a; ++i)
+		{
+			int index_pos = offset + i;
+			int index = int(texelFetch(u_light_indices, ivec2(index_pos % index_width, index_pos / index_width), 0).r * 255.0 + 0.5);
+			diffuse += light_diffuse(directional_count + index, normal);
+		}
+
+		return diffuse;
 	}
 #endif
 
@@ -214,10 +336,14 @@ layout(location = 0) out vec4 o_color;
 void main()
 {
     vec3 normal = normalize(v_normal);
+	vec4 c = texture(u_texture, v_uv) * u_color;
+
+#if (LIGHTS_CLUSTERED == 1)
+	vec3 diffuse = c.rgb * clustered_diffuse(normal);
+#else
 	vec3 to_light = u_light_pos.xyz - v_pos * u_light_pos.w;
 	vec3 light_dir = normalize(to_light);
     float nl = max(dot(normal, light_dir), 0.0);
-	vec4 c = texture(u_texture, v_uv) * u_color;
 
 	float sqr_len = dot(to_light, to_light);
 	float atten = 1.0 - sqr_len * u_light_atten.z;
@@ -236,9 +362,10 @@ void main()
 	}
 
 	vec3 diffuse = c.rgb * nl * u_light_color.rgb * atten;
+#endif
 
 #if (RECIEVE_SHADOW_ON == 1)
-	float shadow = sample_shadow(v_pos_light_proj, nl);
+	float shadow = sample_shadow(v_pos, nl);
     diffuse = diffuse * (1.0 - shadow);
 #endif
 
@@ -271,6 +398,10 @@ void main()
 		Background | Geometry | AlphaTest | Transparent | Overlay
 	LightMode
 		None | Forward
+	Instancing
+		On | Off
+	LightsClustered
+		On | Off
 ]]
 
 local rs = {
@@ -282,6 +413,8 @@ local rs = {
 	CWrite = On,
     Queue = Geometry,
 	LightMode = Forward,
+	Instancing = On,
+	LightsClustered = On,
 }
 
 local pass = {
@@ -342,20 +475,6 @@ local pass = {
                     size = 16,
                 },
             },
-        },
-		{
-            name = "PerLightVertex",
-            binding = 5,
-            members = {
-				{
-					name = "u_light_view_matrix",
-					size = 64,
-				},
-                {
-                    name = "u_light_projection_matrix",
-                    size = 64,
-                },
-			},
         },
         {
             name = "PerLightFragment",
@@ -384,11 +503,33 @@ local pass = {
 				{
                     name = "u_shadow_params",
                     size = 16,
+                },
+				{
+                    name = "u_cascade_params",
+                    size = 16,
+                },
+				{
+                    name = "u_cascade_matrices",
+                    size = 64 * 4,
                 },
             },
         },
 	},
 	samplers = {
+		{
+			name = "PerView",
+			binding = 0,
+			samplers = {
+				{
+					name = "u_light_clusters",
+					binding = 2,
+				},
+				{
+					name = "u_light_indices",
+					binding = 3,
+				},
+			},
+		},
 		{
 			name = "PerMaterialFragment",
 			binding = 4,
@@ -2,16 +2,27 @@ local vs = [[
 #ifndef SKIN_ON
 	#define SKIN_ON 0
 #endif
+#ifndef INSTANCING_ON
+	#define INSTANCING_ON 0
+#endif
 
 VK_UNIFORM_BINDING(0) uniform PerView
 {
 	mat4 u_view_matrix;
     mat4 u_projection_matrix;
 };
-VK_UNIFORM_BINDING(1) uniform PerRenderer
-{
-	mat4 u_model_matrix;
-};
+#if (INSTANCING_ON == 1)
+	VK_UNIFORM_BINDING(1) uniform PerRenderer
+	{
+		mat4 u_model_matrices[VR_MAX_INSTANCE_COUNT];
+	};
+	#define u_model_matrix u_model_matrices[VR_INSTANCE_ID]
+#else
+	VK_UNIFORM_BINDING(1) uniform PerRenderer
+	{
+		mat4 u_model_matrix;
+	};
+#endif
 VK_UNIFORM_BINDING(3) uniform PerMaterialVertex
 {
 	vec4 u_texture_scale_offset;
@@ -101,6 +112,7 @@ local rs = {
     DstBlendMode = Zero,
 	CWrite = On,
     Queue = Geometry,
+	Instancing = On,
 }
 
 local pass = {
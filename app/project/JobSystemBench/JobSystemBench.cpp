@@ -0,0 +1,148 @@
+/*
+* Viry3D
+* Copyright 2014-2019 by Stack - stackos@qq.com
+*
+* Licensed under the Apache License, Version 2.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at
+*
+*     http://www.apache.org/licenses/LICENSE-2.0
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+*/
+
+#include "thread/ThreadPool.h"
+#include "thread/JobSystem.h"
+#include "Object.h"
+#include "math/Mathf.h"
+#include <chrono>
+#include <atomic>
+#include <stdio.h>
+#include <stdlib.h>
+
+using namespace Viry3D;
+
+// tiny job, a few hundred cycles
+static void TinyWork(std::atomic<int>& counter, int seed)
+{
+	float x = (float) seed;
+	for (int i = 0; i < 32; ++i)
+	{
+		x = x * 0.5f + 1.0f;
+	}
+	if (x > 0)
+	{
+		counter.fetch_add(1, std::memory_order_relaxed);
+	}
+}
+
+template <typename Func>
+static double RunTime(Func func, int rounds)
+{
+	// warm up threads
+	func();
+
+	auto begin = std::chrono::high_resolution_clock::now();
+	for (int i = 0; i < rounds; ++i)
+	{
+		func();
+	}
+	auto end = std::chrono::high_resolution_clock::now();
+
+	return std::chrono::duration<double, std::milli>(end - begin).count() / rounds;
+}
+
+int main(int argc, char* argv[])
+{
+	if (argc > 1 && (argv[1][0] < '0' || argv[1][0] > '9'))
+	{
+		printf("Usage:\n");
+		printf("\tJobSystemBench [job count] [thread count] [rounds]\n");
+		return 0;
+	}
+
+	int job_count = argc > 1 ? atoi(argv[1]) : 10000;
+	int thread_count = argc > 2 ? atoi(argv[2]) : 4;
+	int rounds = argc > 3 ? atoi(argv[3]) : 20;
+	job_count = Mathf::Max(job_count, 1);
+	thread_count = Mathf::Max(thread_count, 1);
+	rounds = Mathf::Max(rounds, 1);
+
+	std::atomic<int> counter(0);
+	bool valid = true;
+
+	double serial_ms = RunTime([&]() {
+		counter = 0;
+		for (int i = 0; i < job_count; ++i)
+		{
+			TinyWork(counter, i);
+		}
+		valid = valid && counter == job_count;
+	}, rounds);
+
+	double pool_ms = 0;
+	{
+		ThreadPool pool(thread_count);
+		pool_ms = RunTime([&]() {
+			counter = 0;
+			for (int i = 0; i < job_count; ++i)
+			{
+				Thread::Task task;
+				task.job = [&counter, i]() {
+					TinyWork(counter, i);
+					return Ref<Object>();
+				};
+				pool.AddTask(task);
+			}
+			pool.WaitAll();
+			valid = valid && counter == job_count;
+		}, rounds);
+	}
+
+	double jobs_ms = 0;
+	double parallel_for_ms = 0;
+	{
+		JobSystem jobs(thread_count);
+		jobs_ms = RunTime([&]() {
+			counter = 0;
+			JobSystem::Job* root = jobs.CreateJob(nullptr);
+			for (int i = 0; i < job_count; ++i)
+			{
+				jobs.Run(jobs.CreateJob([&counter, i]() {
+					TinyWork(counter, i);
+				}, root));
+			}
+			jobs.RunAndWait(root);
+			valid = valid && counter == job_count;
+		}, rounds);
+
+		parallel_for_ms = RunTime([&]() {
+			counter = 0;
+			jobs.ParallelFor(job_count, [&counter](int begin, int end) {
+				for (int i = begin; i < end; ++i)
+				{
+					TinyWork(counter, i);
+				}
+			});
+			valid = valid && counter == job_count;
+		}, rounds);
+	}
+
+	if (!valid)
+	{
+		printf("error: some jobs did not run\n");
+		return 1;
+	}
+
+	printf("jobs: %d, threads: %d, rounds: %d\n", job_count, thread_count, rounds);
+	printf("serial: %.3f ms\n", serial_ms);
+	printf("thread pool: %.3f ms\n", pool_ms);
+	printf("job system, one job each: %.3f ms, %.2fx of thread pool\n", jobs_ms, pool_ms / jobs_ms);
+	printf("job system, parallel for: %.3f ms, %.2fx of thread pool\n", parallel_for_ms, pool_ms / parallel_for_ms);
+
+	return 0;
+}
@@ -0,0 +1,128 @@
+/*
+* Viry3D
+* Copyright 2014-2019 by Stack - stackos@qq.com
+*
+* Licensed under the Apache License, Version 2.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at
+*
+*     http://www.apache.org/licenses/LICENSE-2.0
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+*/
+
+#include "graphics/LightClusters.h"
+#include "thread/JobSystem.h"
+#include "math/Mathf.h"
+#include <chrono>
+#include <stdio.h>
+#include <stdlib.h>
+
+using namespace Viry3D;
+
+static double BuildTime(LightClusters& clusters, const Vector<LightClusters::Light>& lights, JobSystem* jobs, int frames)
+{
+	// warm up buffers
+	clusters.Build(lights, jobs);
+
+	auto begin = std::chrono::high_resolution_clock::now();
+	for (int i = 0; i < frames; ++i)
+	{
+		clusters.Build(lights, jobs);
+	}
+	auto end = std::chrono::high_resolution_clock::now();
+
+	return std::chrono::duration<double, std::milli>(end - begin).count() / frames;
+}
+
+int main(int argc, char* argv[])
+{
+	if (argc > 1 && (argv[1][0] < '0' || argv[1][0] > '9'))
+	{
+		printf("Usage:\n");
+		printf("\tLightClusterBench [light count] [thread count] [frames]\n");
+		return 0;
+	}
+
+	int light_count = argc > 1 ? atoi(argv[1]) : LightClusters::LIGHT_MAX_COUNT;
+	int thread_count = argc > 2 ? atoi(argv[2]) : 4;
+	int frames = argc > 3 ? atoi(argv[3]) : 1000;
+	light_count = Mathf::Clamp(light_count, 1, (int) LightClusters::LIGHT_MAX_COUNT);
+	frames = Mathf::Max(frames, 1);
+
+	// camera of 60 degree fov looks at -z, lights fill the view from near to 100
+	float near_clip = 0.3f;
+	float far_clip = 1000.0f;
+	float aspect = 16.0f / 9.0f;
+	float extent_y = tan(60.0f / 2 * Mathf::Deg2Rad);
+	float extent_x = extent_y * aspect;
+
+	srand(0);
+
+	Vector<LightClusters::Light> lights(light_count);
+	for (int i = 0; i < light_count; ++i)
+	{
+		auto& light = lights[i];
+		float depth = Mathf::RandomRange(near_clip, 100.0f);
+		light.position = Vector3(
+			Mathf::RandomRange(-1.0f, 1.0f) * extent_x * depth,
+			Mathf::RandomRange(-1.0f, 1.0f) * extent_y * depth,
+			-depth);
+		light.range = Mathf::RandomRange(1.0f, 10.0f);
+		light.direction = Vector3::Normalize(Vector3(
+			Mathf::RandomRange(-1.0f, 1.0f),
+			Mathf::RandomRange(-1.0f, 1.0f),
+			Mathf::RandomRange(-1.0f, 1.0f)));
+		light.spot_cos = -1.0f;
+
+		// half point, half spot
+		if (i % 2 == 1)
+		{
+			light.spot_cos = cos(Mathf::RandomRange(15.0f, 60.0f) * Mathf::Deg2Rad);
+		}
+	}
+
+	LightClusters clusters;
+	clusters.SetView(extent_x, extent_y, near_clip, far_clip, false);
+
+	double serial_ms = BuildTime(clusters, lights, nullptr, frames);
+	Vector<byte> serial_indices = clusters.GetIndices();
+	int index_count = serial_indices.Size();
+	int max_cluster_count = 0;
+	int used_cluster_count = 0;
+	for (const auto& i : clusters.GetClusters())
+	{
+		max_cluster_count = Mathf::Max(max_cluster_count, i.count);
+		if (i.count > 0)
+		{
+			++used_cluster_count;
+		}
+	}
+
+	printf("lights: %d (%d point, %d spot)\n", light_count, (light_count + 1) / 2, light_count / 2);
+	printf("clusters: %d x %d x %d, used %d, max lights per cluster %d, indices %d\n",
+		LightClusters::CLUSTER_X, LightClusters::CLUSTER_Y, LightClusters::CLUSTER_Z,
+		used_cluster_count, max_cluster_count, index_count);
+	printf("serial: %.3f ms\n", serial_ms);
+
+	if (thread_count > 0)
+	{
+		JobSystem jobs(thread_count);
+		double parallel_ms = BuildTime(clusters, lights, &jobs, frames);
+
+		const auto& indices = clusters.GetIndices();
+		if (indices.Size() != index_count || (index_count > 0 && Memory::Compare(indices.Bytes(), serial_indices.Bytes(), index_count) != 0))
+		{
+			printf("error: parallel result differs from serial\n");
+			return 1;
+		}
+
+		printf("parallel (%d threads + caller): %.3f ms, speedup %.2fx\n", thread_count, parallel_ms, serial_ms / parallel_ms);
+	}
+
+	return 0;
+}
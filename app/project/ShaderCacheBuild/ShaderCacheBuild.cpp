@@ -0,0 +1,173 @@
+/*
+* Viry3D
+* Copyright 2014-2019 by Stack - stackos@qq.com
+*
+* Licensed under the Apache License, Version 2.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at
+*
+*     http://www.apache.org/licenses/LICENSE-2.0
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+*/
+
+#include "graphics/ShaderVariant.h"
+#include "io/File.h"
+#include "io/Directory.h"
+#include "vulkan/spirv_shader_compiler.h"
+#include <chrono>
+#include <stdio.h>
+#include <string.h>
+
+using namespace Viry3D;
+
+static bool ParseBackend(const char* str, filament::backend::Backend& backend)
+{
+	if (strcmp(str, "opengl") == 0)
+	{
+		backend = filament::backend::Backend::OPENGL;
+	}
+	else if (strcmp(str, "vulkan") == 0)
+	{
+		backend = filament::backend::Backend::VULKAN;
+	}
+	else if (strcmp(str, "d3d11") == 0)
+	{
+		backend = filament::backend::Backend::D3D11;
+	}
+	else
+	{
+		return false;
+	}
+	return true;
+}
+
+int main(int argc, char* argv[])
+{
+	if (argc < 4)
+	{
+		printf("Usage:\n");
+		printf("\tShaderCacheBuild <shader dir> <cache dir> <opengl|vulkan|d3d11> [-glsl \"#version 410\"] [keywords ...]\n");
+		printf("\teach keywords argument is one comma separated set, e.g. SKIN_ON LIGHT_ADD_ON,INSTANCING_ON\n");
+		printf("\tvariant without keywords is always built, sets with LIGHT_ADD_ON build light add variants\n");
+		return 0;
+	}
+
+	String shader_dir = argv[1];
+	String cache_dir = argv[2];
+	filament::backend::Backend backend;
+	if (!ParseBackend(argv[3], backend))
+	{
+		printf("error: unknown backend %s\n", argv[3]);
+		return 1;
+	}
+
+	String glsl_version = ShaderVariant::GetDefaultGlslVersion(backend);
+	Vector<List<String>> keyword_sets;
+	keyword_sets.Add(List<String>());
+
+	for (int i = 4; i < argc; ++i)
+	{
+		if (strcmp(argv[i], "-glsl") == 0 && i + 1 < argc)
+		{
+			glsl_version = argv[++i];
+			continue;
+		}
+
+		List<String> keywords;
+		for (const auto& j : String(argv[i]).Split(",", true))
+		{
+			keywords.AddLast(j);
+		}
+		// same order as Shader::Find
+		keywords.Sort();
+		keyword_sets.Add(keywords);
+	}
+
+	if (!Directory::Exist(shader_dir))
+	{
+		printf("error: shader dir not exist %s\n", shader_dir.CString());
+		return 1;
+	}
+	if (!Directory::Exist(cache_dir))
+	{
+		Directory::Create(cache_dir);
+	}
+
+	ShaderCompiler::InitShaderCompiler();
+
+	auto begin = std::chrono::high_resolution_clock::now();
+	int built_count = 0;
+	int cached_count = 0;
+	int failed_count = 0;
+
+	for (const auto& path : Directory::GetFiles(shader_dir, true))
+	{
+		if (!path.EndsWith(".lua"))
+		{
+			continue;
+		}
+
+		String name = path.Substring(shader_dir.Size() + 1);
+		name = name.Substring(0, name.Size() - 4);
+		String src = File::ReadAllText(path);
+
+		for (const auto& keywords : keyword_sets)
+		{
+			bool light_add = keywords.Contains("LIGHT_ADD_ON");
+			ShaderVariant variant(shader_dir, name, keywords, light_add, backend);
+			variant.SetGlslVersion(glsl_version);
+
+			String cache_path = cache_dir + "/" + variant.GetCacheKey(src) + ".bin";
+			if (File::Exist(cache_path))
+			{
+				++cached_count;
+				continue;
+			}
+
+			String keyword_str;
+			for (const auto& j : keywords)
+			{
+				keyword_str += " " + j;
+			}
+			printf("%s%s\n", name.CString(), keyword_str.CString());
+			fflush(stdout);
+
+			if (!variant.Build(src))
+			{
+				printf("error: build failed %s%s\n", name.CString(), keyword_str.CString());
+				++failed_count;
+				continue;
+			}
+
+			// lua modules loaded by require return no pass
+			if (variant.GetPasses().Empty())
+			{
+				break;
+			}
+
+			if (variant.WriteCache(cache_path))
+			{
+				++built_count;
+			}
+			else
+			{
+				printf("error: write failed %s\n", cache_path.CString());
+				++failed_count;
+			}
+		}
+	}
+
+	auto end = std::chrono::high_resolution_clock::now();
+
+	ShaderCompiler::DeinitShaderCompiler();
+
+	printf("built: %d, up to date: %d, failed: %d, %.3f s\n", built_count, cached_count, failed_count,
+		std::chrono::duration<double>(end - begin).count());
+
+	return failed_count > 0 ? 1 : 0;
+}
@@ -51,6 +51,7 @@ namespace Viry3D
         Camera* m_reflection_camera = nullptr;
         Camera* m_back_screen_camera = nullptr;
         Material* m_reflection_material = nullptr;
+        int m_view_project_inverse_id = -1;
         Vector2 m_last_touch_pos;
         Vector3 m_camera_rot = Vector3(5, 180, 0);
         Label* m_fps_label = nullptr;
@@ -119,7 +120,7 @@ namespace Viry3D
             light->GetTransform()->SetRotation(Quaternion::Euler(60, 90, 0));
             light->SetType(LightType::Directional);
 
-			auto stage = Resources::LoadGameObject("Resources/res/model/CandyRockStar/Stage/Stage Objects Group.go");
+			auto stage = Resources::LoadGameObject("Resources/res/model/CandyRockStar/Stage/Stage Objects Group.go", true);
             
             auto visualizer = Resources::LoadGameObject("Resources/res/model/CandyRockStar/Visualizer/Visualizer.go");
             auto material = visualizer->GetComponent<MeshRenderer>()->GetMaterial();
@@ -127,6 +128,7 @@ namespace Viry3D
             material->SetTexture("u_reflection_depth_texture", m_reflection_camera->GetRenderTargetDepth());
             material->SetFloat("_ReflectionStrength", 0.2f);
             m_reflection_material = material.get();
+            m_view_project_inverse_id = Shader::GetPropertyId("_ViewProjectInverse");
             
             auto model = Resources::LoadGameObject("Resources/res/model/CandyRockStar/CandyRockStar.go");
             model->GetComponent<SpringManager>()->Init();
@@ -381,7 +383,7 @@ namespace Viry3D
             {
                 auto vp = m_camera->GetProjectionMatrix() * m_camera->GetViewMatrix();
                 auto vp_inverse = vp.Inverse();
-                m_reflection_material->SetMatrix("_ViewProjectInverse", vp_inverse);
+                m_reflection_material->SetMatrix(m_view_project_inverse_id, vp_inverse);
             }
             if (m_reflection_camera)
             {
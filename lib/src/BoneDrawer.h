@@ -125,5 +125,8 @@ namespace Viry3D
 			Ref<Mesh> mesh = RefMake<Mesh>(std::move(vertices), std::move(indices));
 			return mesh;
 		}
+
+	protected:
+		virtual uint32_t GetUpdatePhases() const { return 0; }
 	};
 }
@@ -20,7 +20,8 @@
 
 namespace Viry3D
 {
-    Component::Component()
+    Component::Component():
+        m_update_phases(0)
     {
         
     }
@@ -34,4 +35,25 @@ namespace Viry3D
     {
         return this->GetGameObject()->GetTransform();
     }
+
+    void Component::RunUpdatePhase(UpdatePhase phase)
+    {
+        switch (phase)
+        {
+            case UpdatePhase::Update:
+                this->Update();
+                break;
+            case UpdatePhase::Animation:
+                this->AnimationUpdate();
+                break;
+            case UpdatePhase::Physics:
+                this->PhysicsUpdate();
+                break;
+            case UpdatePhase::LateUpdate:
+                this->LateUpdate();
+                break;
+            default:
+                break;
+        }
+    }
 }
@@ -18,11 +18,65 @@
 #pragma once
 
 #include "Object.h"
+#include <assert.h>
 
 namespace Viry3D
 {
     class GameObject;
     class Transform;
+    class Component;
+
+    // address of a static per type, unique and known at compile time
+    typedef const void* ComponentTypeId;
+
+    template <class T>
+    struct ComponentType
+    {
+        static ComponentTypeId Id() { return &s_id; }
+
+    private:
+        static const char s_id;
+    };
+
+    template <class T>
+    const char ComponentType<T>::s_id = 0;
+
+    // view of components of type T in object cache, no allocation,
+    // valid until components of object are added or removed, take the span again after that,
+    // access to a stale span asserts
+    template <class T>
+    class ComponentSpan
+    {
+    public:
+        ComponentSpan(const Ref<Component>* components, int size, const uint32_t* version):
+            m_components(components),
+            m_size(size),
+            m_version(version),
+            m_span_version(*version)
+        {
+        }
+        bool IsValid() const { return *m_version == m_span_version; }
+        int Size() const { assert(this->IsValid()); return m_size; }
+        bool Empty() const { assert(this->IsValid()); return m_size == 0; }
+        Ref<T> operator [](int index) const { assert(this->IsValid()); return std::static_pointer_cast<T>(m_components[index]); }
+
+    private:
+        const Ref<Component>* m_components;
+        int m_size;
+        const uint32_t* m_version;
+        uint32_t m_span_version;
+    };
+
+    // scene runs phases in this order, each phase updates components type by type
+    enum class UpdatePhase
+    {
+        Update = 0,
+        Animation,
+        Physics,
+        LateUpdate,
+
+        Count
+    };
     
     class Component : public Object
     {
@@ -35,12 +89,26 @@ namespace Viry3D
     protected:
         virtual void Update() { }
         virtual void LateUpdate() { }
-        virtual void OnTransformDirty() { }
+        virtual void AnimationUpdate() { }
+        virtual void PhysicsUpdate() { }
+        // called once when bound to object, transform is valid from here
+        virtual void OnAttach() { }
+        // bit (1 << phase) for each phase of type, read once when component is added,
+        // components without phases cost nothing in scene update
+        virtual uint32_t GetUpdatePhases() const { return UPDATE_PHASES_DEFAULT; }
+        // components of type only touch their own data when updating, scene may update them on job threads
+        virtual bool IsParallelUpdate() const { return false; }
+
+        static const uint32_t UPDATE_PHASES_DEFAULT = (1 << (int) UpdatePhase::Update) | (1 << (int) UpdatePhase::LateUpdate);
         
 	private:
         friend class GameObject;
+        friend class Scene;
+        void RunUpdatePhase(UpdatePhase phase);
         
     private:
         WeakRef<GameObject> m_object;
+        // phases registered in scene
+        uint32_t m_update_phases;
     };
 }
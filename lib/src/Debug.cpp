@@ -51,7 +51,7 @@ namespace Viry3D
     {
         __android_log_print(ANDROID_LOG_ERROR, "Viry3D", "%s", str.CString());
     }
-#elif VR_WASM
+#elif VR_WASM || VR_LINUX
     void Debug::LogString(const String& str, bool end_line)
     {
         printf("%s\n", str.CString());
@@ -25,6 +25,7 @@
 #include "Input.h"
 #include "Scene.h"
 #include "Resources.h"
+#include "TransformSystem.h"
 #include "graphics/Shader.h"
 #include "graphics/Texture.h"
 #include "graphics/RenderTarget.h"
@@ -34,7 +35,13 @@
 #include "ui/Font.h"
 #include "audio/AudioManager.h"
 #include "time/Time.h"
+#include "math/Mathf.h"
+#include "thread/ActionQueue.h"
+#include "time/FrameScheduler.h"
 #include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <chrono>
 
 #if VR_WINDOWS
 #include <Windows.h>
@@ -54,12 +61,39 @@ namespace Viry3D
     {
 		Memory::Free(buffer, (int) size);
     }
+
+	// stream of the command pass recorded on this thread
+	static thread_local backend::DriverApi* g_pass_command_stream = nullptr;
     
 	class EnginePrivate
 	{
 	public:
 		static constexpr size_t CONFIG_MIN_COMMAND_BUFFERS_SIZE			= 1 * 1024 * 1024;
 		static constexpr size_t CONFIG_COMMAND_BUFFERS_SIZE				= 3 * CONFIG_MIN_COMMAND_BUFFERS_SIZE;
+		// posted actions run per frame, the rest wait for next frames
+		static constexpr float ACTION_TIME_BUDGET_MS					= 4.0f;
+		// frames main thread may run ahead of driver thread
+		static constexpr int FRAME_LATENCY_DEFAULT						= 2;
+		static constexpr int FRAME_LATENCY_MAX							= 3;
+
+		struct RetiredAction
+		{
+			uint32_t frame_id;
+			Action action;
+		};
+
+		// own buffer and stream of a command pass, executed from main stream
+		struct PassRecorder
+		{
+			backend::CommandBufferQueue queue;
+			backend::DriverApi stream;
+
+			PassRecorder(backend::Driver& driver):
+				queue(CONFIG_MIN_COMMAND_BUFFERS_SIZE, 2 * CONFIG_MIN_COMMAND_BUFFERS_SIZE),
+				stream(driver, queue.getCircularBuffer())
+			{
+			}
+		};
 
 		Engine* m_engine;
 		backend::Backend m_backend;
@@ -67,7 +101,6 @@ namespace Viry3D
 		void* m_shared_gl_context = nullptr;
 		std::thread m_driver_thread;
 		utils::CountDownLatch m_driver_barrier;
-		utils::CountDownLatch m_frame_barrier;
 		backend::Driver* m_driver = nullptr;
 		backend::CommandBufferQueue m_command_buffer_queue;
 		backend::DriverApi m_command_stream;
@@ -82,15 +115,32 @@ namespace Viry3D
         String m_save_path;
         bool m_quit = false;
         Ref<Scene> m_scene;
-        Ref<ThreadPool> m_thread_pool;
-        List<Action> m_actions;
-        Mutex m_mutex;
+        Ref<JobSystem> m_job_system;
+        ActionQueue m_actions;
+        FrameScheduler m_scheduler;
+        float m_action_time_budget = ACTION_TIME_BUDGET_MS;
+        int m_frame_latency = FRAME_LATENCY_DEFAULT;
+        // frame id of last end frame, main thread only
+        uint32_t m_submitted_frame_id = 0;
+        Vector<RetiredAction> m_retired_actions;
+        std::chrono::steady_clock::time_point m_main_begin_time;
+        // driver thread only
+        std::chrono::steady_clock::time_point m_driver_begin_time;
+        float m_driver_busy_ms = 0;
+        // written by driver thread when it finished a frame
+        mutable std::mutex m_frame_mutex;
+        std::condition_variable m_frame_condition;
+        uint32_t m_retired_frame_id = 0;
+        Engine::FrameStats m_frame_stats = { };
+        Vector<Ref<PassRecorder>> m_pass_recorders;
         
 		backend::DriverApi& GetDriverApi() { return m_command_stream; }
 
 		EnginePrivate(Engine* engine, void* native_window, int width, int height, uint64_t flags, void* shared_gl_context):
 			m_engine(engine),
-#if VR_WINDOWS
+#if VR_USE_NOOP
+			m_backend(backend::Backend::NOOP),
+#elif VR_WINDOWS
 			m_backend(backend::Backend::D3D11),
 #elif VR_UWP
 			m_backend(backend::Backend::D3D11),
@@ -103,7 +153,6 @@ namespace Viry3D
 #endif
 			m_shared_gl_context(shared_gl_context),
 			m_driver_barrier(1),
-			m_frame_barrier(1),
 			m_command_buffer_queue(CONFIG_MIN_COMMAND_BUFFERS_SIZE, CONFIG_COMMAND_BUFFERS_SIZE),
 			m_native_window(native_window),
 			m_width(width),
@@ -133,12 +182,13 @@ namespace Viry3D
             this->GetSavePath();
             
 #if !VR_WASM
-            m_thread_pool = RefMake<ThreadPool>(4);
+            m_job_system = RefMake<JobSystem>();
 #endif
             
             Shader::Init();
             Texture::Init();
 			RenderTarget::Init();
+			Renderer::Init();
 			Camera::Init();
 			Mesh::Init();
 			Font::Init();
@@ -148,17 +198,21 @@ namespace Viry3D
 
 		void Shutdown()
 		{
+            // release per frame resources before their owners are done
+            this->RetireAllFrames();
             AudioManager::Done();
             m_scene.reset();
 			Resources::Done();
 			Font::Done();
 			Mesh::Done();
 			Camera::Done();
+			Light::Done();
+			Renderer::Done();
 			RenderTarget::Done();
             Texture::Done();
             Shader::Done();
             
-            m_thread_pool.reset();
+            m_job_system.reset();
             
 			this->GetDriverApi().destroyRenderTarget(m_render_target);
 
@@ -218,7 +272,9 @@ namespace Viry3D
 				auto& item = buffers[i];
 				if (item.begin)
 				{
+					m_driver_begin_time = std::chrono::steady_clock::now();
 					m_command_stream.execute(item.begin);
+					m_driver_busy_ms += std::chrono::duration<float, std::milli>(std::chrono::steady_clock::now() - m_driver_begin_time).count();
 					m_command_buffer_queue.releaseBuffer(item);
 				}
 			}
@@ -235,7 +291,9 @@ namespace Viry3D
 		void BeginFrame()
 		{
             Time::Update();
+            this->ProcessRetiredActions();
             this->ProcessActions();
+            m_scheduler.Run();
             
 			++m_frame_id;
 
@@ -248,9 +306,20 @@ namespace Viry3D
 
 		void Render()
 		{
-			Renderer::PrepareAll();
-			Light::RenderShadowMaps();
-			Camera::RenderAll();
+			// resolve world matrices moved since last frame in one pass and notify subscribers,
+			// cull first, then prepare only renderers drawn by some camera or light,
+			// shadow and camera passes record in parallel and run in this order
+			Renderer::PrepareAlways();
+			TransformSystem::UpdateAll();
+			Renderer::UpdateSpatialTree();
+			Camera::CullAll();
+			Light::CullAll();
+			Renderer::PrepareVisible();
+
+			Vector<CommandPass> passes;
+			Light::AddShadowPasses(passes);
+			Camera::AddRenderPasses(passes);
+			this->RecordCommandPasses(passes);
 			this->Flush();
 		}
 
@@ -258,18 +327,30 @@ namespace Viry3D
 		{
 			this->GetDriverApi().commit(m_swap_chain);
 			this->GetDriverApi().endFrame(m_frame_id);
-			if (UTILS_HAS_THREADING)
-			{
-				this->GetDriverApi().queueCommand([this]() {
-					m_frame_barrier.latch();
-				});
-			}
+
+			// fence of the frame, runs on driver thread after all commands of the frame
+			uint32_t frame_id = m_frame_id;
+			float main_ms = std::chrono::duration<float, std::milli>(std::chrono::steady_clock::now() - m_main_begin_time).count();
+			this->GetDriverApi().queueCommand([this, frame_id, main_ms]() {
+				auto now = std::chrono::steady_clock::now();
+				float driver_ms = m_driver_busy_ms + std::chrono::duration<float, std::milli>(now - m_driver_begin_time).count();
+				m_driver_busy_ms = 0;
+				m_driver_begin_time = now;
+
+				std::lock_guard<std::mutex> lock(m_frame_mutex);
+				m_retired_frame_id = frame_id;
+				m_frame_stats.frame_id = frame_id;
+				m_frame_stats.main_thread_ms = main_ms;
+				m_frame_stats.driver_thread_ms = driver_ms;
+				m_frame_condition.notify_all();
+			});
+			m_submitted_frame_id = frame_id;
 			this->Flush();
 
-			if (UTILS_HAS_THREADING)
+			// block only when driver is more than latency frames behind
+			if (frame_id >= (uint32_t) m_frame_latency)
 			{
-				m_frame_barrier.await();
-				m_frame_barrier.reset(1);
+				this->WaitFrame(frame_id - m_frame_latency + 1);
 			}
             
 #if VR_ANDROID
@@ -295,23 +376,167 @@ namespace Viry3D
 
         void PostAction(Action action)
         {
-            m_mutex.lock();
-            m_actions.AddLast(action);
-            m_mutex.unlock();
+            m_actions.Post(action);
         }
         
         void ProcessActions()
         {
-            m_mutex.lock();
-            for (const auto& action : m_actions)
+            m_actions.Process(m_action_time_budget);
+        }
+
+        void RecordCommandPasses(const Vector<CommandPass>& passes)
+        {
+            // without job threads, passes record straight into main stream
+            if (!m_job_system || m_job_system->GetThreadCount() == 0)
+            {
+                for (int i = 0; i < passes.Size(); ++i)
+                {
+                    if (passes[i].prepare)
+                    {
+                        passes[i].prepare();
+                    }
+                    if (passes[i].record)
+                    {
+                        passes[i].record();
+                    }
+                }
+                return;
+            }
+
+            while (m_pass_recorders.Size() < passes.Size())
+            {
+                m_pass_recorders.Add(RefMake<PassRecorder>(*m_driver));
+            }
+
+            auto run = [this](int index, const Action& action) {
+                // a thread waiting in a pass may run other passes, so restore the outer one
+                auto& stream = m_pass_recorders[index]->stream;
+                backend::DriverApi* outer = g_pass_command_stream;
+                g_pass_command_stream = &stream;
+                stream.debugThreading();
+                action();
+                g_pass_command_stream = outer;
+            };
+
+            for (int i = 0; i < passes.Size(); ++i)
+            {
+                if (passes[i].prepare)
+                {
+                    run(i, passes[i].prepare);
+                }
+            }
+
+            m_job_system->ParallelFor(passes.Size(), [&](int begin, int end) {
+                for (int i = begin; i < end; ++i)
+                {
+                    if (passes[i].record)
+                    {
+                        run(i, passes[i].record);
+                    }
+                }
+            }, 1);
+
+            // splice in pass order, driver releases each buffer after executing it
+            for (int i = 0; i < passes.Size(); ++i)
+            {
+                PassRecorder* recorder = m_pass_recorders[i].get();
+                if (recorder->queue.getCircularBuffer().empty())
+                {
+                    continue;
+                }
+
+                recorder->queue.flush();
+                auto buffers = recorder->queue.waitForCommands();
+                m_command_stream.queueCommand([recorder, buffers]() {
+                    for (const auto& item : buffers)
+                    {
+                        recorder->stream.execute(item.begin);
+                        recorder->queue.releaseBuffer(item);
+                    }
+                });
+            }
+        }
+
+        void WaitFrame(uint32_t frame_id)
+        {
+            // without driver thread, commands run at end of each execute
+            if (!UTILS_HAS_THREADING)
+            {
+                return;
+            }
+
+            std::unique_lock<std::mutex> lock(m_frame_mutex);
+            m_frame_condition.wait(lock, [this, frame_id]() {
+                return m_retired_frame_id >= frame_id;
+            });
+        }
+
+        void PostFrameRetiredAction(Action action)
+        {
+            // commands recorded outside of a frame go with next frame
+            RetiredAction retired;
+            retired.frame_id = m_submitted_frame_id + 1;
+            retired.action = action;
+            m_retired_actions.Add(retired);
+        }
+
+        void ProcessRetiredActions()
+        {
+            if (m_retired_actions.Empty())
+            {
+                return;
+            }
+
+            uint32_t retired_frame_id;
+            {
+                std::lock_guard<std::mutex> lock(m_frame_mutex);
+                retired_frame_id = m_retired_frame_id;
+            }
+
+            // posted in frame order, so retired ones are at front
+            int count = 0;
+            while (count < m_retired_actions.Size() && m_retired_actions[count].frame_id <= retired_frame_id)
+            {
+                ++count;
+            }
+            if (count == 0)
+            {
+                return;
+            }
+
+            Vector<RetiredAction> actions(count);
+            for (int i = 0; i < count; ++i)
+            {
+                actions[i] = m_retired_actions[i];
+            }
+            m_retired_actions.RemoveRange(0, count);
+
+            for (int i = 0; i < actions.Size(); ++i)
+            {
+                if (actions[i].action)
+                {
+                    actions[i].action();
+                }
+            }
+        }
+
+        void RetireAllFrames()
+        {
+            this->WaitFrame(m_submitted_frame_id);
+
+            while (!m_retired_actions.Empty())
             {
-                if (action)
+                Vector<RetiredAction> actions = m_retired_actions;
+                m_retired_actions.Clear();
+
+                for (int i = 0; i < actions.Size(); ++i)
                 {
-                    action();
+                    if (actions[i].action)
+                    {
+                        actions[i].action();
+                    }
                 }
             }
-            m_actions.Clear();
-            m_mutex.unlock();
         }
         
 #if VR_WINDOWS
@@ -533,6 +758,7 @@ namespace Viry3D
         {
             m_private->m_scene = RefMake<Scene>();
         }
+        m_private->m_main_begin_time = std::chrono::steady_clock::now();
         m_private->m_scene->Update();
         
 		m_private->BeginFrame();
@@ -548,6 +774,10 @@ namespace Viry3D
 
 	backend::DriverApi& Engine::GetDriverApi()
 	{
+		if (g_pass_command_stream)
+		{
+			return *g_pass_command_stream;
+		}
 		return m_private->GetDriverApi();
 	}
 
@@ -603,13 +833,49 @@ namespace Viry3D
         return m_private->m_quit;
     }
 
-    ThreadPool* Engine::GetThreadPool() const
+    JobSystem* Engine::GetJobSystem() const
     {
-        return m_private->m_thread_pool.get();
+        return m_private->m_job_system.get();
     }
     
     void Engine::PostAction(Action action)
     {
         m_private->PostAction(action);
     }
+
+    void Engine::SetActionTimeBudget(float ms)
+    {
+        m_private->m_action_time_budget = ms;
+    }
+
+    void Engine::SetFrameLatency(int frames)
+    {
+        m_private->m_frame_latency = Mathf::Clamp(frames, 1, (int) EnginePrivate::FRAME_LATENCY_MAX);
+    }
+
+    int Engine::GetFrameLatency() const
+    {
+        return m_private->m_frame_latency;
+    }
+
+    void Engine::PostFrameRetiredAction(Action action)
+    {
+        m_private->PostFrameRetiredAction(action);
+    }
+
+    Engine::FrameStats Engine::GetFrameStats() const
+    {
+        std::lock_guard<std::mutex> lock(m_private->m_frame_mutex);
+        return m_private->m_frame_stats;
+    }
+
+    void Engine::RecordCommandPasses(const Vector<CommandPass>& passes)
+    {
+        m_private->RecordCommandPasses(passes);
+    }
+
+    FrameScheduler* Engine::GetFrameScheduler() const
+    {
+        return &m_private->m_scheduler;
+    }
 }
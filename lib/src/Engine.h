@@ -21,7 +21,10 @@
 #include <assert.h>
 #include "string/String.h"
 #include "thread/ThreadPool.h"
+#include "thread/JobSystem.h"
 #include "memory/Memory.h"
+#include "container/Vector.h"
+#include "graphics/CommandPass.h"
 
 #define VR_VERSION_NAME "1.0.0"
 
@@ -38,14 +41,25 @@ namespace filament
 namespace Viry3D
 {
 	class EnginePrivate;
+	class FrameScheduler;
 
     class Engine
     {
 	public:
+        struct FrameStats
+        {
+            uint32_t frame_id;
+            // main thread from scene update to submit, not counting wait for frames in flight
+            float main_thread_ms;
+            // driver thread executing commands of the frame
+            float driver_thread_ms;
+        };
+
 		static Engine* Create(void* native_window, int width, int height, uint64_t flags = 0, void* shared_gl_context = nullptr);
 		static void Destroy(Engine** engine);
 		static Engine* Instance();
 		void Execute();
+		// on a thread recording a command pass, stream of the pass
 		filament::backend::DriverApi& GetDriverApi();
 		const filament::backend::Backend& GetBackend() const;
 		void* GetDefaultRenderTarget();
@@ -59,8 +73,25 @@ namespace Viry3D
 		int GetWidth() const;
 		int GetHeight() const;
         bool HasQuit() const;
-        ThreadPool* GetThreadPool() const;
+        // null on platforms without threads
+        JobSystem* GetJobSystem() const;
+        // any thread, action runs on main thread at begin of a frame
         void PostAction(Action action);
+        // ms per frame for posted actions, at least one runs each frame, 0 runs all
+        void SetActionTimeBudget(float ms);
+        // frames main thread may run ahead of driver thread, 1 to 3, 1 waits for driver each frame
+        void SetFrameLatency(int frames);
+        int GetFrameLatency() const;
+        // main thread only, action runs on main thread after driver finished all commands recorded so far,
+        // keeps per frame resources alive while frames are in flight
+        void PostFrameRetiredAction(Action action);
+        // stats of last frame finished by driver
+        FrameStats GetFrameStats() const;
+        // main thread only, records passes in parallel on job threads, each into own command stream,
+        // streams are executed by driver in pass order
+        void RecordCommandPasses(const Vector<CommandPass>& passes);
+        // time sliced main thread tasks, run at begin of each frame after posted actions
+        FrameScheduler* GetFrameScheduler() const;
         
 	private:
 		Engine(void* native_window, int width, int height, uint64_t flags, void* shared_gl_context);
@@ -20,10 +20,12 @@
 
 namespace Viry3D
 {
+	Map<std::pair<std::type_index, ComponentTypeId>, bool> GameObject::m_kind_table;
+
 	Ref<GameObject> GameObject::Create(const String& name)
 	{
 		Ref<GameObject> obj = Ref<GameObject>(new GameObject(name));
-		Scene::Instance()->AddGameObject(obj);
+		obj->m_handle = Scene::Instance()->AddGameObject(obj);
         obj->m_transform = obj->AddComponent<Transform>();
 		return obj;
 	}
@@ -35,9 +37,12 @@ namespace Viry3D
 	}
 
 	GameObject::GameObject(const String& name):
+        m_component_version(0),
+        m_handle(Scene::INVALID_HANDLE),
         m_layer(0),
 		m_is_active_self(true),
-		m_is_active_in_tree(true)
+		m_is_active_in_tree(true),
+		m_is_static(false)
 	{
 		this->SetName(name);
 	}
@@ -45,7 +50,6 @@ namespace Viry3D
 	GameObject::~GameObject()
     {
         m_added_components.Clear();
-        m_removed_components.Clear();
         m_components.Clear();
         m_transform.reset();
     }
@@ -57,10 +61,9 @@ namespace Viry3D
             return;
         }
         
-        if (!m_added_components.Remove(com))
-        {
-            m_removed_components.Add(com);
-        }
+        m_added_components.Remove(com);
+        this->ClearComponentCaches();
+        Scene::Instance()->RemoveComponent(com);
     }
     
     void GameObject::BindComponent(const Ref<Component>& com) const
@@ -68,28 +71,75 @@ namespace Viry3D
         auto obj = Scene::Instance()->GetGameObject(this);
         com->m_object = obj;
 		com->SetName(this->GetName());
+        com->OnAttach();
+
+        Scene::Instance()->AddComponent(com);
     }
 
-	void GameObject::OnTransformDirty()
+	void GameObject::ClearComponentCaches() const
 	{
-		for (int i = 0; i < m_added_components.Size(); ++i)
+		m_component_caches.Clear();
+		++m_component_version;
+	}
+
+	const Vector<Ref<Component>>& GameObject::FindComponents(ComponentTypeId type, IsKindFunc is_kind) const
+	{
+		for (const auto& i : m_component_caches)
 		{
-			auto& com = m_added_components[i];
-			com->OnTransformDirty();
+			if (i.type == type)
+			{
+				return i.components;
+			}
 		}
 
+		ComponentCache cache;
+		cache.type = type;
+
+		// added components first, same order as before caching
+		for (int i = 0; i < m_added_components.Size(); ++i)
+		{
+			if (IsKindOf(m_added_components[i].get(), type, is_kind))
+			{
+				cache.components.Add(m_added_components[i]);
+			}
+		}
 		for (int i = 0; i < m_components.Size(); ++i)
 		{
-			auto& com = m_components[i];
-			com->OnTransformDirty();
+			if (IsKindOf(m_components[i].get(), type, is_kind))
+			{
+				cache.components.Add(m_components[i]);
+			}
 		}
+
+		m_component_caches.AddLast(cache);
+		return m_component_caches.Last().components;
 	}
-    
+
+	bool GameObject::IsKindOf(const Component* com, ComponentTypeId type, IsKindFunc is_kind)
+	{
+		auto key = std::make_pair(std::type_index(typeid(*com)), type);
+
+		const bool* is_kind_of;
+		if (m_kind_table.TryGet(key, &is_kind_of))
+		{
+			return *is_kind_of;
+		}
+
+		bool result = is_kind(com);
+		m_kind_table.Add(key, result);
+		return result;
+	}
+
 	void GameObject::SetLayer(int layer)
 	{
 		m_layer = layer;
 	}
 
+	void GameObject::SetStatic(bool is_static)
+	{
+		m_is_static = is_static;
+	}
+
 	void GameObject::SetActive(bool active)
 	{
 		m_is_active_self = active;
@@ -111,43 +161,4 @@ namespace Viry3D
 			child->GetGameObject()->SetActive(child->GetGameObject()->IsActiveSelf());
 		}
 	}
-
-	void GameObject::Update()
-	{
-        for (int i = 0; i < m_components.Size(); ++i)
-        {
-            auto& com = m_components[i];
-            com->Update();
-        }
-        
-        do
-        {
-            Vector<Ref<Component>> added = m_added_components;
-            m_added_components.Clear();
-            
-            for (int i = 0; i < added.Size(); ++i)
-            {
-                auto& com = added[i];
-                com->Update();
-                m_components.Add(com);
-            }
-            added.Clear();
-        } while (m_added_components.Size() > 0);
-        
-        for (int i = 0; i < m_removed_components.Size(); ++i)
-        {
-            auto& com = m_removed_components[i];
-            m_components.Remove(com);
-        }
-        m_removed_components.Clear();
-	}
-    
-    void GameObject::LateUpdate()
-    {
-        for (int i = 0; i < m_components.Size(); ++i)
-        {
-            auto& com = m_components[i];
-            com->LateUpdate();
-        }
-    }
 }
@@ -19,8 +19,11 @@
 
 #include "Object.h"
 #include "container/Vector.h"
+#include "container/List.h"
+#include "container/Map.h"
 #include "Component.h"
 #include "Transform.h"
+#include <typeindex>
 
 namespace Viry3D
 {
@@ -31,8 +34,9 @@ namespace Viry3D
 		static void Destroy(Ref<GameObject>& obj);
         virtual ~GameObject();
         template <class T, typename ...ARGS> Ref<T> AddComponent(ARGS... args);
+        // lookups of a type are cached until components change, only call on main thread
         template <class T> Ref<T> GetComponent() const;
-		template <class T> Vector<Ref<T>> GetComponents() const;
+		template <class T> ComponentSpan<T> GetComponents() const;
 		template <class T> Vector<Ref<T>> GetComponentsInChildren() const;
         void RemoveComponent(const Ref<Component>& com);
         const Ref<Transform>& GetTransform() const { return m_transform; }
@@ -41,25 +45,48 @@ namespace Viry3D
 		bool IsActiveSelf() const { return m_is_active_self; }
 		void SetActive(bool active);
 		bool IsActiveInTree() const { return m_is_active_in_tree; }
-		void Update();
-		void LateUpdate();
+		// static objects never move, their renderers can be merged by StaticBatcher
+		bool IsStatic() const { return m_is_static; }
+		void SetStatic(bool is_static);
+		// generational handle in scene, Scene::GetGameObject fails once object is destroyed
+		uint32_t GetHandle() const { return m_handle; }
         
 	private:
 		GameObject(const String& name);
         void BindComponent(const Ref<Component>& com) const;
-		void OnTransformDirty();
+		template <class T> void AddComponentsInChildren(Vector<Ref<T>>& coms) const;
+		typedef bool (*IsKindFunc)(const Component* com);
+		const Vector<Ref<Component>>& FindComponents(ComponentTypeId type, IsKindFunc is_kind) const;
+		static bool IsKindOf(const Component* com, ComponentTypeId type, IsKindFunc is_kind);
+		// spans taken before become stale
+		void ClearComponentCaches() const;
 	
 	private:
-		friend class Transform;
+		friend class Scene;
 
 	private:
+		struct ComponentCache
+		{
+			ComponentTypeId type;
+			Vector<Ref<Component>> components;
+		};
+
+	private:
+		// is kind of results for concrete type and looked up type, each pair is cast once
+		static Map<std::pair<std::type_index, ComponentTypeId>, bool> m_kind_table;
         Vector<Ref<Component>> m_components;
+        // added and removed components are committed by scene at end of update phase
         Vector<Ref<Component>> m_added_components;
-        Vector<Ref<Component>> m_removed_components;
+        // components of each looked up type, list keeps spans valid while other types are added
+        mutable List<ComponentCache> m_component_caches;
+        // changes when caches are cleared
+        mutable uint32_t m_component_version;
         Ref<Transform> m_transform;
+        uint32_t m_handle;
         int m_layer;
         bool m_is_active_self;
         bool m_is_active_in_tree;
+        bool m_is_static;
     };
     
     template <class T, typename ...ARGS>
@@ -74,6 +101,7 @@ namespace Viry3D
         }
         
         m_added_components.Add(com);
+        this->ClearComponentCaches();
         
         this->BindComponent(com);
         
@@ -83,73 +111,46 @@ namespace Viry3D
     template <class T>
     Ref<T> GameObject::GetComponent() const
     {
-        for (int i = 0; i < m_added_components.Size(); ++i)
-        {
-            auto& com = m_added_components[i];
-            auto t = RefCast<T>(com);
-            if (t)
-            {
-                return t;
-            }
-        }
-        
-        for (int i = 0; i < m_components.Size(); ++i)
+        ComponentSpan<T> coms = this->GetComponents<T>();
+        if (coms.Size() > 0)
         {
-            auto& com = m_components[i];
-            auto t = RefCast<T>(com);
-            if (t)
-            {
-                return t;
-            }
+            return coms[0];
         }
         
         return Ref<T>();
     }
 
 	template <class T>
-	Vector<Ref<T>> GameObject::GetComponents() const
+	ComponentSpan<T> GameObject::GetComponents() const
 	{
-		Vector<Ref<T>> coms;
+		const Vector<Ref<Component>>& coms = this->FindComponents(ComponentType<T>::Id(), [](const Component* com) {
+			return dynamic_cast<const T*>(com) != nullptr;
+		});
 
-		for (int i = 0; i < m_added_components.Size(); ++i)
-		{
-			auto& com = m_added_components[i];
-			auto t = RefCast<T>(com);
-			if (t)
-			{
-				coms.Add(t);
-			}
-		}
-
-		for (int i = 0; i < m_components.Size(); ++i)
-		{
-			auto& com = m_components[i];
-			auto t = RefCast<T>(com);
-			if (t)
-			{
-				coms.Add(t);
-			}
-		}
+		return ComponentSpan<T>(coms.Size() > 0 ? &coms[0] : nullptr, coms.Size(), &m_component_version);
+	}
 
+	template <class T>
+	Vector<Ref<T>> GameObject::GetComponentsInChildren() const
+	{
+		Vector<Ref<T>> coms;
+		this->AddComponentsInChildren<T>(coms);
 		return coms;
 	}
 
 	template <class T>
-	Vector<Ref<T>> GameObject::GetComponentsInChildren() const
+	void GameObject::AddComponentsInChildren(Vector<Ref<T>>& coms) const
 	{
-		Vector<Ref<T>> coms = this->GetComponents<T>();
+		ComponentSpan<T> self_coms = this->GetComponents<T>();
+		for (int i = 0; i < self_coms.Size(); ++i)
+		{
+			coms.Add(self_coms[i]);
+		}
 
 		int child_count = this->GetTransform()->GetChildCount();
 		for (int i = 0; i < child_count; ++i)
 		{
-			auto child = this->GetTransform()->GetChild(i);
-			Vector<Ref<T>> child_coms = child->GetGameObject()->GetComponentsInChildren<T>();
-			for (int j = 0; j < child_coms.Size(); ++j)
-			{
-				coms.Add(child_coms[j]);
-			}
+			this->GetTransform()->GetChild(i)->GetGameObject()->AddComponentsInChildren<T>(coms);
 		}
-
-		return coms;
 	}
 }
@@ -18,13 +18,15 @@
 #pragma once
 
 #include "string/String.h"
+#include <atomic>
 
 namespace Viry3D
 {
     class Object
     {
     public:
-        Object() { static int s_id = 0; m_id = ++s_id; }
+        // objects may be created on loading threads
+        Object() { static std::atomic<int> s_id(0); m_id = ++s_id; }
         virtual ~Object() { }
         const String& GetName() const { return m_name; }
         void SetName(const String& name) { m_name = name; }
@@ -21,6 +21,7 @@
 #include "io/MemoryStream.h"
 #include "graphics/MeshRenderer.h"
 #include "graphics/SkinnedMeshRenderer.h"
+#include "graphics/StaticBatcher.h"
 #include "graphics/Mesh.h"
 #include "graphics/Material.h"
 #include "graphics/Shader.h"
@@ -428,7 +429,7 @@ namespace Viry3D
         }
     }
 
-    static Ref<GameObject> ReadGameObject(MemoryStream& ms, const Ref<GameObject>& parent)
+    static Ref<GameObject> ReadGameObject(MemoryStream& ms, const Ref<GameObject>& parent, bool is_static)
     {
         String name = ReadString(ms);
         int layer = ms.Read<int>();
@@ -440,6 +441,7 @@ namespace Viry3D
 		Ref<GameObject> obj = GameObject::Create(name);
 		obj->SetLayer(layer);
 		obj->SetActive(active);
+		obj->SetStatic(is_static);
 
 		if (parent)
 		{
@@ -498,13 +500,13 @@ namespace Viry3D
 		int child_count = ms.Read<int>();
 		for (int i = 0; i < child_count; ++i)
 		{
-			ReadGameObject(ms, obj);
+			ReadGameObject(ms, obj, is_static);
 		}
 
         return obj;
     }
 
-    Ref<GameObject> Resources::LoadGameObject(const String& path)
+    Ref<GameObject> Resources::LoadGameObject(const String& path, bool is_static)
     {
 		Ref<GameObject> obj;
 
@@ -513,7 +515,12 @@ namespace Viry3D
         {
             MemoryStream ms(File::ReadAllBytes(full_path));
 
-			obj = ReadGameObject(ms, Ref<GameObject>());
+			obj = ReadGameObject(ms, Ref<GameObject>(), is_static);
+
+			if (is_static)
+			{
+				StaticBatcher::Combine(obj);
+			}
         }
 
         return obj;
@@ -30,7 +30,8 @@ namespace Viry3D
     public:
 		static void Init();
 		static void Done();
-        static Ref<GameObject> LoadGameObject(const String& path);
+        // mark loaded objects static and merge their mesh renderers by StaticBatcher if is_static is true
+        static Ref<GameObject> LoadGameObject(const String& path, bool is_static = false);
 		static Ref<Mesh> LoadMesh(const String& path);
         static Ref<Texture> LoadTexture(const String& path);
         static Ref<Texture> LoadLightmap(const String& path);
@@ -18,9 +18,13 @@
 #include "Scene.h"
 #include "GameObject.h"
 #include "App.h"
+#include "Engine.h"
 
 namespace Viry3D
 {
+	// fewer components per job cost more in scheduling than they save
+	static const int UPDATE_MIN_COMPONENTS_PER_JOB = 64;
+
 	Scene* Scene::m_instance = nullptr;
 
 	Scene* Scene::Instance()
@@ -37,88 +41,296 @@ namespace Viry3D
     
     Scene::~Scene()
     {
-		m_added_objects.Clear();
+		for (int i = 0; i < (int) UpdatePhase::Count; ++i)
+		{
+			m_phase_lists[i].Clear();
+		}
+		m_added_components.Clear();
+		m_removed_components.Clear();
 		m_removed_objects.Clear();
 		m_objects.Clear();
+		m_object_slots.Clear();
+		m_slots.Clear();
+		m_free_slots.Clear();
 
 		m_instance = nullptr;
     }
 
-	void Scene::AddGameObject(const Ref<GameObject>& obj)
+	uint32_t Scene::AddGameObject(const Ref<GameObject>& obj)
 	{
-		m_added_objects.Add(obj);
+		int slot;
+		if (m_free_slots.Size() > 0)
+		{
+			slot = m_free_slots[m_free_slots.Size() - 1];
+			m_free_slots.Resize(m_free_slots.Size() - 1);
+		}
+		else
+		{
+			slot = m_slots.Size();
+			assert(slot < (int) HANDLE_INDEX_MASK);
+			m_slots.Add({ 0, -1 });
+		}
+
+		m_slots[slot].index = m_objects.Size();
+		m_objects.Add(obj);
+		m_object_slots.Add(slot);
+
+		return (m_slots[slot].generation << HANDLE_INDEX_BITS) | (uint32_t) slot;
 	}
 
 	void Scene::RemoveGameObject(const Ref<GameObject>& obj)
 	{
-        if (!m_added_objects.Remove(obj))
-        {
-            m_removed_objects.Add(obj);
-        }
+		m_removed_objects.Add(obj);
+	}
+
+	void Scene::FreeSlot(uint32_t handle)
+	{
+		int slot = (int) (handle & HANDLE_INDEX_MASK);
+		auto& object_slot = m_slots[slot];
+
+		// destroyed twice
+		if (object_slot.index < 0 || object_slot.generation != (handle >> HANDLE_INDEX_BITS))
+		{
+			return;
+		}
+
+		int index = object_slot.index;
+		int last = m_objects.Size() - 1;
+
+		// keep object alive until slots are consistent, its destructor may destroy other objects
+		Ref<GameObject> obj = m_objects[index];
+
+		if (index != last)
+		{
+			m_objects[index] = m_objects[last];
+			m_object_slots[index] = m_object_slots[last];
+			m_slots[m_object_slots[index]].index = index;
+		}
+		m_objects.Resize(last);
+		m_object_slots.Resize(last);
+
+		object_slot.index = -1;
+		object_slot.generation += 1;
+
+		// a wrapped generation would validate stale handles again, so a saturated slot is never reused,
+		// no handle carries the last generation, which also keeps INVALID_HANDLE invalid
+		if (object_slot.generation < HANDLE_GENERATION_MASK)
+		{
+			m_free_slots.Add(slot);
+		}
+	}
+
+	void Scene::AddComponent(const Ref<Component>& com)
+	{
+		m_added_components.Add(com);
+	}
+
+	void Scene::RemoveComponent(const Ref<Component>& com)
+	{
+		if (!m_added_components.Remove(com))
+		{
+			m_removed_components.Add(com);
+		}
 	}
     
     void Scene::Update()
     {
-		for (auto& i : m_objects)
+		for (int i = 0; i < (int) UpdatePhase::Count; ++i)
+		{
+			this->RunPhase((UpdatePhase) i);
+		}
+    }
+
+	void Scene::RunPhase(UpdatePhase phase)
+	{
+		const auto& lists = m_phase_lists[(int) phase];
+		for (int i = 0; i < lists.Size(); ++i)
+		{
+			this->UpdateComponents(lists[i], phase);
+		}
+
+		this->CommitChanges(phase);
+	}
+
+	void Scene::UpdateComponent(Component* com, UpdatePhase phase)
+	{
+		auto obj = com->GetGameObject();
+		if (obj && obj->IsActiveInTree())
 		{
-			auto& obj = i.second;
-			if (obj->IsActiveInTree())
+			com->RunUpdatePhase(phase);
+		}
+	}
+
+	void Scene::UpdateComponents(const ComponentList& list, UpdatePhase phase)
+	{
+		// adds and removes are deferred to phase end, so list does not change while updating
+		const auto& components = list.components;
+
+		JobSystem* jobs = list.parallel ? Engine::Instance()->GetJobSystem() : nullptr;
+		if (jobs)
+		{
+			jobs->ParallelFor(components.Size(), [&components, phase](int begin, int end) {
+				for (int i = begin; i < end; ++i)
+				{
+					UpdateComponent(components[i].get(), phase);
+				}
+			}, UPDATE_MIN_COMPONENTS_PER_JOB);
+		}
+		else
+		{
+			for (int i = 0; i < components.Size(); ++i)
 			{
-				obj->Update();
+				UpdateComponent(components[i].get(), phase);
 			}
 		}
+	}
 
+	void Scene::CommitChanges(UpdatePhase phase)
+	{
 		do
 		{
-			Vector<Ref<GameObject>> added = m_added_objects;
-			m_added_objects.Clear();
+			// removed first, so components added to destroyed objects never run
+			this->CommitRemovedObjects();
+
+			Vector<Ref<Component>> added = m_added_components;
+			m_added_components.Clear();
 
 			for (int i = 0; i < added.Size(); ++i)
 			{
-				auto& obj = added[i];
-				if (obj->IsActiveInTree())
+				const auto& com = added[i];
+
+				auto obj = com->GetGameObject();
+				if (!obj)
 				{
-					obj->Update();
+					continue;
+				}
+
+				obj->m_added_components.Remove(com);
+				obj->m_components.Add(com);
+				obj->ClearComponentCaches();
+				this->RegisterComponent(com);
+
+				if (com->m_update_phases & (1 << (int) phase))
+				{
+					UpdateComponent(com.get(), phase);
 				}
-				m_objects.Add(obj->GetId(), obj);
 			}
 			added.Clear();
-		} while (m_added_objects.Size() > 0);
+		} while (m_removed_objects.Size() > 0 || m_added_components.Size() > 0);
 
-		for (int i = 0; i < m_removed_objects.Size(); ++i)
+		for (int i = 0; i < m_removed_components.Size(); ++i)
 		{
-			const auto& obj = m_removed_objects[i];
-			m_objects.Remove(obj->GetId());
+			const auto& com = m_removed_components[i];
+			auto obj = com->GetGameObject();
+			if (obj)
+			{
+				obj->m_components.Remove(com);
+				obj->ClearComponentCaches();
+			}
+			this->UnregisterComponent(com);
 		}
+		m_removed_components.Clear();
+	}
+
+	void Scene::CommitRemovedObjects()
+	{
+		Vector<Ref<GameObject>> removed = m_removed_objects;
 		m_removed_objects.Clear();
-        
-        for (auto& i : m_objects)
-        {
-            auto& obj = i.second;
-            if (obj->IsActiveInTree())
-            {
-                obj->LateUpdate();
-            }
-        }
-    }
+
+		for (int i = 0; i < removed.Size(); ++i)
+		{
+			const auto& obj = removed[i];
+			for (int j = 0; j < obj->m_components.Size(); ++j)
+			{
+				this->UnregisterComponent(obj->m_components[j]);
+			}
+			for (int j = 0; j < obj->m_added_components.Size(); ++j)
+			{
+				m_added_components.Remove(obj->m_added_components[j]);
+			}
+			this->FreeSlot(obj->m_handle);
+		}
+	}
+
+	void Scene::RegisterComponent(const Ref<Component>& com)
+	{
+		uint32_t phases = com->GetUpdatePhases();
+		com->m_update_phases = phases;
+
+		for (int i = 0; i < (int) UpdatePhase::Count; ++i)
+		{
+			if ((phases & (1 << i)) == 0)
+			{
+				continue;
+			}
+
+			auto& lists = m_phase_lists[i];
+			const std::type_info* type = &typeid(*com);
+
+			ComponentList* list = nullptr;
+			for (int j = 0; j < lists.Size(); ++j)
+			{
+				if (*lists[j].type == *type)
+				{
+					list = &lists[j];
+					break;
+				}
+			}
+
+			if (list == nullptr)
+			{
+				ComponentList new_list;
+				new_list.type = type;
+				new_list.parallel = com->IsParallelUpdate();
+				lists.Add(new_list);
+				list = &lists[lists.Size() - 1];
+			}
+
+			list->components.Add(com);
+		}
+	}
+
+	void Scene::UnregisterComponent(const Ref<Component>& com)
+	{
+		uint32_t phases = com->m_update_phases;
+		com->m_update_phases = 0;
+
+		for (int i = 0; i < (int) UpdatePhase::Count && phases != 0; ++i)
+		{
+			if ((phases & (1 << i)) == 0)
+			{
+				continue;
+			}
+
+			auto& lists = m_phase_lists[i];
+			for (int j = 0; j < lists.Size(); ++j)
+			{
+				if (*lists[j].type == typeid(*com))
+				{
+					lists[j].components.Remove(com);
+					break;
+				}
+			}
+		}
+	}
     
-    Ref<GameObject> Scene::GetGameObject(const GameObject* obj)
+    Ref<GameObject> Scene::GetGameObject(const GameObject* obj) const
     {
-        for (int i = 0; i < m_added_objects.Size(); ++i)
-        {
-            const auto& obj_ref = m_added_objects[i];
-            if (obj_ref.get() == obj)
-            {
-                return obj_ref;
-            }
-        }
-        
-        Ref<GameObject>* find;
-        if (m_objects.TryGet(obj->GetId(), &find))
-        {
-            return *find;
-        }
-        
-        return Ref<GameObject>();
+        return this->GetGameObject(obj->GetHandle());
     }
+
+	Ref<GameObject> Scene::GetGameObject(uint32_t handle) const
+	{
+		int slot = (int) (handle & HANDLE_INDEX_MASK);
+		if (slot < m_slots.Size())
+		{
+			const auto& object_slot = m_slots[slot];
+			if (object_slot.index >= 0 && object_slot.generation == (handle >> HANDLE_INDEX_BITS))
+			{
+				return m_objects[object_slot.index];
+			}
+		}
+
+		return Ref<GameObject>();
+	}
 }
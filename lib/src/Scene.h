@@ -18,8 +18,9 @@
 #pragma once
 
 #include "Object.h"
-#include "container/Map.h"
 #include "container/Vector.h"
+#include "Component.h"
+#include <typeinfo>
 
 namespace Viry3D
 {
@@ -32,17 +33,63 @@ namespace Viry3D
         Scene();
         virtual ~Scene();
         void Update();
-        Ref<GameObject> GetGameObject(const GameObject* obj);
+        Ref<GameObject> GetGameObject(const GameObject* obj) const;
+		// null if handle is invalid or object was destroyed
+		Ref<GameObject> GetGameObject(uint32_t handle) const;
+		int GetGameObjectCount() const { return m_objects.Size(); }
+
+		// handle is slot index in low bits and slot generation in high bits,
+		// generation changes when slot is freed, so stale handles fail lookup,
+		// slots are retired instead of reused once generation reaches the mask
+		static const uint32_t HANDLE_INDEX_BITS = 20;
+		static const uint32_t HANDLE_INDEX_MASK = (1 << HANDLE_INDEX_BITS) - 1;
+		static const uint32_t HANDLE_GENERATION_MASK = (1 << (32 - HANDLE_INDEX_BITS)) - 1;
+		static const uint32_t INVALID_HANDLE = 0xffffffff;
 
 	private:
 		friend class GameObject;
-		void AddGameObject(const Ref<GameObject>& obj);
+		uint32_t AddGameObject(const Ref<GameObject>& obj);
+		// object stays alive until end of update phase
 		void RemoveGameObject(const Ref<GameObject>& obj);
+		void AddComponent(const Ref<Component>& com);
+		void RemoveComponent(const Ref<Component>& com);
 
 	private:
+		// components of one type in one phase
+		struct ComponentList
+		{
+			const std::type_info* type;
+			bool parallel;
+			Vector<Ref<Component>> components;
+		};
+
+		static void UpdateComponent(Component* com, UpdatePhase phase);
+		void RunPhase(UpdatePhase phase);
+		void UpdateComponents(const ComponentList& list, UpdatePhase phase);
+		// apply adds and removes deferred during phase, added components run the phase at once
+		void CommitChanges(UpdatePhase phase);
+		void CommitRemovedObjects();
+		void FreeSlot(uint32_t handle);
+		void RegisterComponent(const Ref<Component>& com);
+		void UnregisterComponent(const Ref<Component>& com);
+
+	private:
+		struct ObjectSlot
+		{
+			uint32_t generation;
+			// index in dense object array, -1 for free slot
+			int index;
+		};
+
 		static Scene* m_instance;
-		Map<int, Ref<GameObject>> m_objects;
-		Vector<Ref<GameObject>> m_added_objects;
+		// dense, removed objects are swapped with last
+		Vector<Ref<GameObject>> m_objects;
+		Vector<int> m_object_slots;
+		Vector<ObjectSlot> m_slots;
+		Vector<int> m_free_slots;
 		Vector<Ref<GameObject>> m_removed_objects;
+		Vector<ComponentList> m_phase_lists[(int) UpdatePhase::Count];
+		Vector<Ref<Component>> m_added_components;
+		Vector<Ref<Component>> m_removed_components;
     };
 }
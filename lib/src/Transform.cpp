@@ -21,22 +21,20 @@
 namespace Viry3D
 {
 	Transform::Transform():
-		m_local_position(0, 0, 0),
-		m_local_rotation(Quaternion::Identity()),
-		m_local_scale(1, 1, 1),
-		m_position(m_local_position),
-		m_rotation(m_local_rotation),
-		m_scale(m_local_scale),
-		m_local_to_world(Matrix4x4::Identity()),
-		m_world_to_local(Matrix4x4::Identity()),
-		m_dirty(false)
+		m_handle(TransformSystem::Alloc())
 	{
 
 	}
     
     Transform::~Transform()
     {
-        
+		// children left alive become roots
+		for (int i = 0; i < m_children.Size(); ++i)
+		{
+			TransformSystem::SetParent(m_children[i]->m_handle, -1);
+		}
+
+		TransformSystem::Free(m_handle);
     }
 
 	void Transform::SetParent(const Ref<Transform>& parent)
@@ -64,6 +62,8 @@ namespace Viry3D
             parent->m_children.Add(this->GetGameObject()->GetTransform());
 			m_parent = parent;
         }
+
+		TransformSystem::SetParent(m_handle, parent ? parent->m_handle : -1);
         
         this->SetPosition(position);
         this->SetRotation(rotation);
@@ -131,40 +131,34 @@ namespace Viry3D
 
 	void Transform::SetLocalPosition(const Vector3& pos)
 	{
-        m_local_position = pos;
-        
-        this->MarkDirty();
+        TransformSystem::SetLocalPosition(m_handle, pos);
 	}
 
 	void Transform::SetLocalRotation(const Quaternion& rot)
 	{
-        m_local_rotation = rot;
-        
-        this->MarkDirty();
+        TransformSystem::SetLocalRotation(m_handle, rot);
 	}
 
 	void Transform::SetLocalScale(const Vector3& scale)
 	{
-        m_local_scale = scale;
-        
-        this->MarkDirty();
+        TransformSystem::SetLocalScale(m_handle, scale);
 	}
 
-	const Vector3& Transform::GetPosition()
+	Vector3 Transform::GetPosition()
 	{
-        this->UpdateMatrix();
+        const Matrix4x4& local_to_world = TransformSystem::GetLocalToWorldMatrix(m_handle);
         
-        return m_position;
+        return Vector3(local_to_world.m03, local_to_world.m13, local_to_world.m23);
 	}
     
     void Transform::SetPosition(const Vector3& pos)
     {
 		Vector3 local_position;
 
-		auto parent = m_parent.lock();
-		if (parent)
+		int parent = TransformSystem::GetParent(m_handle);
+		if (parent >= 0)
 		{
-			local_position = parent->GetWorldToLocalMatrix().MultiplyPoint3x4(pos);
+			local_position = TransformSystem::GetWorldToLocalMatrix(parent).MultiplyPoint3x4(pos);
 		}
 		else
 		{
@@ -174,21 +168,19 @@ namespace Viry3D
 		this->SetLocalPosition(local_position);
     }
 
-	const Quaternion& Transform::GetRotation()
+	Quaternion Transform::GetRotation()
 	{
-        this->UpdateMatrix();
-        
-        return m_rotation;
+        return TransformSystem::GetRotation(m_handle);
 	}
     
     void Transform::SetRotation(const Quaternion& rot)
     {
         Quaternion local_rotation;
         
-        auto parent = m_parent.lock();
-        if (parent)
+        int parent = TransformSystem::GetParent(m_handle);
+        if (parent >= 0)
         {
-            local_rotation = Quaternion::Inverse(parent->GetRotation()) * rot;
+            local_rotation = Quaternion::Inverse(TransformSystem::GetRotation(parent)) * rot;
         }
         else
         {
@@ -198,21 +190,19 @@ namespace Viry3D
         this->SetLocalRotation(local_rotation);
     }
 
-	const Vector3& Transform::GetScale()
+	Vector3 Transform::GetScale()
 	{
-        this->UpdateMatrix();
-        
-        return m_scale;
+        return TransformSystem::GetScale(m_handle);
 	}
 
     void Transform::SetScale(const Vector3& scale)
     {
         Vector3 local_scale;
         
-        auto parent = m_parent.lock();
-        if (parent)
+        int parent = TransformSystem::GetParent(m_handle);
+        if (parent >= 0)
         {
-            const auto& parent_scale = parent->GetScale();
+            const Vector3& parent_scale = TransformSystem::GetScale(parent);
             local_scale = Vector3(scale.x / parent_scale.x, scale.y / parent_scale.y, scale.z / parent_scale.z);
         }
         else
@@ -223,76 +213,28 @@ namespace Viry3D
         this->SetLocalScale(local_scale);
     }
     
-	const Matrix4x4& Transform::GetLocalToWorldMatrix()
+	Matrix4x4 Transform::GetLocalToWorldMatrix()
 	{
-		this->UpdateMatrix();
-        
-        return m_local_to_world;
+        return TransformSystem::GetLocalToWorldMatrix(m_handle);
 	}
 
-	const Matrix4x4& Transform::GetWorldToLocalMatrix()
+	Matrix4x4 Transform::GetWorldToLocalMatrix()
 	{
-        this->UpdateMatrix();
-        
-        return m_world_to_local;
+        return TransformSystem::GetWorldToLocalMatrix(m_handle);
 	}
 
 	Vector3 Transform::GetRight()
 	{
-        this->UpdateMatrix();
-        
-        return m_local_to_world.MultiplyDirection(Vector3(1, 0, 0));
+        return TransformSystem::GetLocalToWorldMatrix(m_handle).MultiplyDirection(Vector3(1, 0, 0));
 	}
 
 	Vector3 Transform::GetUp()
 	{
-        this->UpdateMatrix();
-        
-        return m_local_to_world.MultiplyDirection(Vector3(0, 1, 0));
+        return TransformSystem::GetLocalToWorldMatrix(m_handle).MultiplyDirection(Vector3(0, 1, 0));
 	}
 
 	Vector3 Transform::GetForward()
 	{
-        this->UpdateMatrix();
-        
-        return m_local_to_world.MultiplyDirection(Vector3(0, 0, 1));
-	}
-
-	void Transform::MarkDirty()
-	{
-		m_dirty = true;
-		this->GetGameObject()->OnTransformDirty();
-
-		for (auto& i : m_children)
-		{
-			i->MarkDirty();
-		}
-	}
-
-	void Transform::UpdateMatrix()
-	{
-		if (m_dirty)
-		{
-			m_dirty = false;
-
-			auto parent = m_parent.lock();
-			if (parent)
-			{
-				m_local_to_world = parent->GetLocalToWorldMatrix() * Matrix4x4::TRS(m_local_position, m_local_rotation, m_local_scale);
-				m_position = parent->GetLocalToWorldMatrix().MultiplyPoint3x4(m_local_position);
-				m_rotation = parent->GetRotation() * m_local_rotation;
-				const auto& parent_scale = parent->GetScale();
-				m_scale = Vector3(parent_scale.x * m_local_scale.x, parent_scale.y * m_local_scale.y, parent_scale.z * m_local_scale.z);
-			}
-			else
-			{
-				m_local_to_world = Matrix4x4::TRS(m_local_position, m_local_rotation, m_local_scale);
-				m_position = m_local_position;
-				m_rotation = m_local_rotation;
-				m_scale = m_local_scale;
-			}
-
-			m_world_to_local = m_local_to_world.Inverse();
-		}
+        return TransformSystem::GetLocalToWorldMatrix(m_handle).MultiplyDirection(Vector3(0, 0, 1));
 	}
 }
@@ -21,6 +21,7 @@
 #include "math/Vector3.h"
 #include "math/Quaternion.h"
 #include "math/Matrix4x4.h"
+#include "TransformSystem.h"
 
 namespace Viry3D
 {
@@ -35,39 +36,35 @@ namespace Viry3D
 		const Ref<Transform>& GetChild(int index) const { return m_children[index]; }
 		Ref<Transform> Find(const String& path) const;
 		Ref<Transform> GetRoot() const;
-		const Vector3& GetLocalPosition() const { return m_local_position; }
+		Vector3 GetLocalPosition() const { return TransformSystem::GetLocalPosition(m_handle); }
 		void SetLocalPosition(const Vector3& pos);
-		const Quaternion& GetLocalRotation() const { return m_local_rotation; }
+		Quaternion GetLocalRotation() const { return TransformSystem::GetLocalRotation(m_handle); }
 		void SetLocalRotation(const Quaternion& rot);
-		const Vector3& GetLocalScale() const { return m_local_scale; }
+		Vector3 GetLocalScale() const { return TransformSystem::GetLocalScale(m_handle); }
 		void SetLocalScale(const Vector3& scale);
-		const Vector3& GetPosition();
+		// world values are returned by copy, transform data moves when hierarchy changes
+		Vector3 GetPosition();
         void SetPosition(const Vector3& pos);
-		const Quaternion& GetRotation();
+		Quaternion GetRotation();
         void SetRotation(const Quaternion& rot);
-		const Vector3& GetScale();
+		Vector3 GetScale();
         void SetScale(const Vector3& scale);
-		const Matrix4x4& GetLocalToWorldMatrix();
-		const Matrix4x4& GetWorldToLocalMatrix();
+		Matrix4x4 GetLocalToWorldMatrix();
+		Matrix4x4 GetWorldToLocalMatrix();
 		Vector3 GetRight();
 		Vector3 GetUp();
 		Vector3 GetForward();
+		// callback runs once per frame after world matrix of this transform or a parent changed,
+		// returns id for TransformSystem::Unsubscribe
+		int Subscribe(const Action& callback) { return TransformSystem::Subscribe(m_handle, callback); }
 
-	private:
-		void MarkDirty();
-		void UpdateMatrix();
+	protected:
+		virtual uint32_t GetUpdatePhases() const { return 0; }
 
 	private:
 		WeakRef<Transform> m_parent;
 		Vector<Ref<Transform>> m_children;
-		Vector3 m_local_position;
-		Quaternion m_local_rotation;
-		Vector3 m_local_scale;
-		Vector3 m_position;
-		Quaternion m_rotation;
-		Vector3 m_scale;
-		Matrix4x4 m_local_to_world;
-		Matrix4x4 m_world_to_local;
-		bool m_dirty;
+		// local and world data live in TransformSystem
+		int m_handle;
     };
 }
@@ -0,0 +1,498 @@
+/*
+* Viry3D
+* Copyright 2014-2019 by Stack - stackos@qq.com
+*
+* Licensed under the Apache License, Version 2.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at
+*
+*     http://www.apache.org/licenses/LICENSE-2.0
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+*/
+
+#include "TransformSystem.h"
+#include "Engine.h"
+#include "math/Mathf.h"
+
+namespace Viry3D
+{
+	// fewer transforms per job cost more in scheduling than they save
+	static const int UPDATE_MIN_TRANSFORMS_PER_JOB = 256;
+
+	Vector<int> TransformSystem::m_indices;
+	Vector<int> TransformSystem::m_free_handles;
+	Vector<int> TransformSystem::m_handles;
+	Vector<int> TransformSystem::m_parents;
+	Vector<Vector3> TransformSystem::m_local_positions;
+	Vector<Quaternion> TransformSystem::m_local_rotations;
+	Vector<Vector3> TransformSystem::m_local_scales;
+	Vector<Matrix4x4> TransformSystem::m_local_to_worlds;
+	Vector<Matrix4x4> TransformSystem::m_world_to_locals;
+	Vector<Quaternion> TransformSystem::m_rotations;
+	Vector<Vector3> TransformSystem::m_scales;
+	Vector<byte> TransformSystem::m_flags;
+	Vector<uint32_t> TransformSystem::m_generations;
+	Vector<uint32_t> TransformSystem::m_parent_generations;
+	Vector<int> TransformSystem::m_level_begins;
+	bool TransformSystem::m_order_dirty = false;
+	int TransformSystem::m_first_dirty = 0;
+	Vector<TransformSystem::Subscription> TransformSystem::m_subscriptions;
+	Vector<int> TransformSystem::m_free_subscriptions;
+
+	// same as Matrix4x4::TRS without the two full matrix multiplies
+	static void ComposeTRS(Matrix4x4& m, const Vector3& t, const Quaternion& r, const Vector3& s)
+	{
+		float xx = r.x * r.x;
+		float yy = r.y * r.y;
+		float zz = r.z * r.z;
+		float xy = r.x * r.y;
+		float xz = r.x * r.z;
+		float yz = r.y * r.z;
+		float wx = r.w * r.x;
+		float wy = r.w * r.y;
+		float wz = r.w * r.z;
+
+		m.m00 = (1 - 2 * (yy + zz)) * s.x;
+		m.m01 = 2 * (xy - wz) * s.y;
+		m.m02 = 2 * (xz + wy) * s.z;
+		m.m03 = t.x;
+		m.m10 = 2 * (xy + wz) * s.x;
+		m.m11 = (1 - 2 * (xx + zz)) * s.y;
+		m.m12 = 2 * (yz - wx) * s.z;
+		m.m13 = t.y;
+		m.m20 = 2 * (xz - wy) * s.x;
+		m.m21 = 2 * (yz + wx) * s.y;
+		m.m22 = (1 - 2 * (xx + yy)) * s.z;
+		m.m23 = t.z;
+		m.m30 = 0;
+		m.m31 = 0;
+		m.m32 = 0;
+		m.m33 = 1;
+	}
+
+	// both matrices affine, last row is always 0 0 0 1
+	static void MultiplyAffine(Matrix4x4& m, const Matrix4x4& a, const Matrix4x4& b)
+	{
+		m.m00 = a.m00 * b.m00 + a.m01 * b.m10 + a.m02 * b.m20;
+		m.m01 = a.m00 * b.m01 + a.m01 * b.m11 + a.m02 * b.m21;
+		m.m02 = a.m00 * b.m02 + a.m01 * b.m12 + a.m02 * b.m22;
+		m.m03 = a.m00 * b.m03 + a.m01 * b.m13 + a.m02 * b.m23 + a.m03;
+		m.m10 = a.m10 * b.m00 + a.m11 * b.m10 + a.m12 * b.m20;
+		m.m11 = a.m10 * b.m01 + a.m11 * b.m11 + a.m12 * b.m21;
+		m.m12 = a.m10 * b.m02 + a.m11 * b.m12 + a.m12 * b.m22;
+		m.m13 = a.m10 * b.m03 + a.m11 * b.m13 + a.m12 * b.m23 + a.m13;
+		m.m20 = a.m20 * b.m00 + a.m21 * b.m10 + a.m22 * b.m20;
+		m.m21 = a.m20 * b.m01 + a.m21 * b.m11 + a.m22 * b.m21;
+		m.m22 = a.m20 * b.m02 + a.m21 * b.m12 + a.m22 * b.m22;
+		m.m23 = a.m20 * b.m03 + a.m21 * b.m13 + a.m22 * b.m23 + a.m23;
+		m.m30 = 0;
+		m.m31 = 0;
+		m.m32 = 0;
+		m.m33 = 1;
+	}
+
+	template <class V>
+	static void Permute(Vector<V>& values, const Vector<int>& new_indices, int new_count)
+	{
+		Vector<V> sorted(new_count);
+		for (int i = 0; i < values.Size(); ++i)
+		{
+			if (new_indices[i] >= 0)
+			{
+				sorted[new_indices[i]] = values[i];
+			}
+		}
+		values = std::move(sorted);
+	}
+
+	int TransformSystem::Alloc()
+	{
+		int handle;
+		if (m_free_handles.Size() > 0)
+		{
+			handle = m_free_handles[m_free_handles.Size() - 1];
+			m_free_handles.Resize(m_free_handles.Size() - 1);
+		}
+		else
+		{
+			handle = m_indices.Size();
+			m_indices.Add(-1);
+		}
+
+		// new root at end keeps parents before children, no sort needed,
+		// it joins the last level, roots read no parent so any level works
+		if (m_level_begins.Empty())
+		{
+			m_level_begins.Add(0);
+		}
+
+		int index = m_handles.Size();
+		m_indices[handle] = index;
+		m_handles.Add(handle);
+		m_parents.Add(-1);
+		m_local_positions.Add(Vector3(0, 0, 0));
+		m_local_rotations.Add(Quaternion::Identity());
+		m_local_scales.Add(Vector3(1, 1, 1));
+		m_local_to_worlds.Add(Matrix4x4::Identity());
+		m_world_to_locals.Add(Matrix4x4::Identity());
+		m_rotations.Add(Quaternion::Identity());
+		m_scales.Add(Vector3(1, 1, 1));
+		m_flags.Add(0);
+		m_generations.Add(0);
+		m_parent_generations.Add(0);
+
+		return handle;
+	}
+
+	void TransformSystem::Free(int handle)
+	{
+		int index = m_indices[handle];
+		m_handles[index] = -1;
+		m_indices[handle] = -1;
+		m_free_handles.Add(handle);
+
+		// freed entry is dropped by next sort
+		m_order_dirty = true;
+	}
+
+	void TransformSystem::SetParent(int handle, int parent)
+	{
+		int index = m_indices[handle];
+		m_parents[index] = parent >= 0 ? m_indices[parent] : -1;
+		m_order_dirty = true;
+
+		MarkDirty(index);
+	}
+
+	int TransformSystem::GetParent(int handle)
+	{
+		int parent = m_parents[m_indices[handle]];
+		if (parent >= 0)
+		{
+			return m_handles[parent];
+		}
+		return -1;
+	}
+
+	void TransformSystem::SetLocalPosition(int handle, const Vector3& pos)
+	{
+		int index = m_indices[handle];
+		m_local_positions[index] = pos;
+		MarkDirty(index);
+	}
+
+	void TransformSystem::SetLocalRotation(int handle, const Quaternion& rot)
+	{
+		int index = m_indices[handle];
+		m_local_rotations[index] = rot;
+		MarkDirty(index);
+	}
+
+	void TransformSystem::SetLocalScale(int handle, const Vector3& scale)
+	{
+		int index = m_indices[handle];
+		m_local_scales[index] = scale;
+		MarkDirty(index);
+	}
+
+	const Matrix4x4& TransformSystem::GetLocalToWorldMatrix(int handle)
+	{
+		int index = m_indices[handle];
+		Resolve(index);
+		return m_local_to_worlds[index];
+	}
+
+	const Matrix4x4& TransformSystem::GetWorldToLocalMatrix(int handle)
+	{
+		int index = m_indices[handle];
+		Resolve(index);
+
+		if (m_flags[index] & FLAG_INVERSE_DIRTY)
+		{
+			m_flags[index] &= ~FLAG_INVERSE_DIRTY;
+			m_world_to_locals[index] = m_local_to_worlds[index].Inverse();
+		}
+
+		return m_world_to_locals[index];
+	}
+
+	const Quaternion& TransformSystem::GetRotation(int handle)
+	{
+		int index = m_indices[handle];
+		Resolve(index);
+		return m_rotations[index];
+	}
+
+	const Vector3& TransformSystem::GetScale(int handle)
+	{
+		int index = m_indices[handle];
+		Resolve(index);
+		return m_scales[index];
+	}
+
+	int TransformSystem::Subscribe(int handle, const Action& callback)
+	{
+		int id;
+		if (m_free_subscriptions.Size() > 0)
+		{
+			id = m_free_subscriptions[m_free_subscriptions.Size() - 1];
+			m_free_subscriptions.Resize(m_free_subscriptions.Size() - 1);
+		}
+		else
+		{
+			id = m_subscriptions.Size();
+			m_subscriptions.Add(Subscription());
+		}
+
+		auto& subscription = m_subscriptions[id];
+		subscription.handle = handle;
+		// never matches, so first UpdateAll notifies
+		subscription.generation = m_generations[m_indices[handle]] - 1;
+		subscription.callback = callback;
+
+		return id;
+	}
+
+	void TransformSystem::Unsubscribe(int id)
+	{
+		auto& subscription = m_subscriptions[id];
+		subscription.handle = -1;
+		subscription.callback = nullptr;
+		m_free_subscriptions.Add(id);
+	}
+
+	void TransformSystem::UpdateAll()
+	{
+		if (m_order_dirty)
+		{
+			Sort();
+		}
+
+		int count = m_handles.Size();
+		if (m_first_dirty < count)
+		{
+			UpdateLevels();
+		}
+
+		for (int i = 0; i < m_subscriptions.Size(); ++i)
+		{
+			auto& subscription = m_subscriptions[i];
+			if (subscription.handle < 0)
+			{
+				continue;
+			}
+
+			// handle freed before its subscriber
+			int index = m_indices[subscription.handle];
+			if (index < 0)
+			{
+				continue;
+			}
+
+			if (subscription.generation != m_generations[index])
+			{
+				subscription.generation = m_generations[index];
+				subscription.callback();
+			}
+		}
+	}
+
+	void TransformSystem::UpdateLevels()
+	{
+		int count = m_handles.Size();
+		JobSystem* jobs = Engine::Instance()->GetJobSystem();
+
+		// entries of one level only read parents of levels before, so a level updates in parallel
+		for (int i = 0; i < m_level_begins.Size(); ++i)
+		{
+			int begin = Mathf::Max(m_level_begins[i], m_first_dirty);
+			int end = i + 1 < m_level_begins.Size() ? m_level_begins[i + 1] : count;
+			if (begin >= end)
+			{
+				continue;
+			}
+
+			if (jobs)
+			{
+				jobs->ParallelFor(end - begin, [begin](int range_begin, int range_end) {
+					UpdateRange(begin + range_begin, begin + range_end);
+				}, UPDATE_MIN_TRANSFORMS_PER_JOB);
+			}
+			else
+			{
+				UpdateRange(begin, end);
+			}
+		}
+
+		m_first_dirty = count;
+	}
+
+	void TransformSystem::MarkDirty(int index)
+	{
+		m_flags[index] |= FLAG_DIRTY;
+		m_first_dirty = Mathf::Min(m_first_dirty, index);
+	}
+
+	bool TransformSystem::IsStale(int index)
+	{
+		if (m_flags[index] & FLAG_DIRTY)
+		{
+			return true;
+		}
+
+		int parent = m_parents[index];
+		return parent >= 0 && m_generations[parent] != m_parent_generations[index];
+	}
+
+	void TransformSystem::Resolve(int index)
+	{
+		// nothing set since last pass, all entries are up to date
+		if (m_first_dirty >= m_handles.Size())
+		{
+			return;
+		}
+
+		int parent = m_parents[index];
+		if (parent >= 0)
+		{
+			Resolve(parent);
+		}
+
+		if (IsStale(index))
+		{
+			UpdateWorld(index);
+		}
+	}
+
+	void TransformSystem::UpdateWorld(int index)
+	{
+		const Vector3& local_scale = m_local_scales[index];
+		int parent = m_parents[index];
+
+		if (parent >= 0)
+		{
+			Matrix4x4 local;
+			ComposeTRS(local, m_local_positions[index], m_local_rotations[index], local_scale);
+			MultiplyAffine(m_local_to_worlds[index], m_local_to_worlds[parent], local);
+
+			const Vector3& parent_scale = m_scales[parent];
+			m_rotations[index] = m_rotations[parent] * m_local_rotations[index];
+			m_scales[index] = Vector3(parent_scale.x * local_scale.x, parent_scale.y * local_scale.y, parent_scale.z * local_scale.z);
+		}
+		else
+		{
+			ComposeTRS(m_local_to_worlds[index], m_local_positions[index], m_local_rotations[index], local_scale);
+			m_rotations[index] = m_local_rotations[index];
+			m_scales[index] = local_scale;
+		}
+
+		m_flags[index] = FLAG_INVERSE_DIRTY;
+		m_generations[index] += 1;
+		m_parent_generations[index] = parent >= 0 ? m_generations[parent] : 0;
+	}
+
+	void TransformSystem::UpdateRange(int begin, int end)
+	{
+		for (int i = begin; i < end; ++i)
+		{
+			if (IsStale(i))
+			{
+				UpdateWorld(i);
+			}
+		}
+	}
+
+	void TransformSystem::Sort()
+	{
+		m_order_dirty = false;
+
+		int count = m_handles.Size();
+
+		// depth of each entry, walking up to first entry of known depth
+		Vector<int> depths(count, -1);
+		Vector<int> chain;
+		int level_count = 0;
+		for (int i = 0; i < count; ++i)
+		{
+			if (m_handles[i] < 0 || depths[i] >= 0)
+			{
+				continue;
+			}
+
+			int p = i;
+			while (p >= 0 && depths[p] < 0)
+			{
+				chain.Add(p);
+				p = m_parents[p];
+			}
+
+			int depth = p >= 0 ? depths[p] : -1;
+			for (int j = chain.Size() - 1; j >= 0; --j)
+			{
+				depths[chain[j]] = ++depth;
+			}
+			chain.Clear();
+
+			level_count = Mathf::Max(level_count, depth + 1);
+		}
+
+		// counting sort by depth, keeps order inside a level
+		m_level_begins.Resize(level_count);
+		Vector<int> cursors(level_count, 0);
+		for (int i = 0; i < count; ++i)
+		{
+			if (m_handles[i] >= 0)
+			{
+				cursors[depths[i]] += 1;
+			}
+		}
+
+		int new_count = 0;
+		for (int i = 0; i < level_count; ++i)
+		{
+			int level_size = cursors[i];
+			m_level_begins[i] = new_count;
+			cursors[i] = new_count;
+			new_count += level_size;
+		}
+
+		Vector<int> new_indices(count, -1);
+		for (int i = 0; i < count; ++i)
+		{
+			if (m_handles[i] >= 0)
+			{
+				new_indices[i] = cursors[depths[i]]++;
+			}
+		}
+
+		Permute(m_handles, new_indices, new_count);
+		Permute(m_parents, new_indices, new_count);
+		Permute(m_local_positions, new_indices, new_count);
+		Permute(m_local_rotations, new_indices, new_count);
+		Permute(m_local_scales, new_indices, new_count);
+		Permute(m_local_to_worlds, new_indices, new_count);
+		Permute(m_world_to_locals, new_indices, new_count);
+		Permute(m_rotations, new_indices, new_count);
+		Permute(m_scales, new_indices, new_count);
+		Permute(m_flags, new_indices, new_count);
+		Permute(m_generations, new_indices, new_count);
+		Permute(m_parent_generations, new_indices, new_count);
+
+		for (int i = 0; i < new_count; ++i)
+		{
+			if (m_parents[i] >= 0)
+			{
+				m_parents[i] = new_indices[m_parents[i]];
+			}
+			m_indices[m_handles[i]] = i;
+		}
+
+		// stale children of lazily resolved parents carry no flag, so scan all
+		m_first_dirty = m_first_dirty < count ? 0 : new_count;
+	}
+}
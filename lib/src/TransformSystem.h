@@ -0,0 +1,108 @@
+/*
+* Viry3D
+* Copyright 2014-2019 by Stack - stackos@qq.com
+*
+* Licensed under the Apache License, Version 2.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at
+*
+*     http://www.apache.org/licenses/LICENSE-2.0
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+*/
+
+#pragma once
+
+#include "container/Vector.h"
+#include "math/Matrix4x4.h"
+#include "Action.h"
+
+namespace Viry3D
+{
+	// transform data of all objects in flat arrays, one array per attribute,
+	// entries are sorted by hierarchy depth so parents always come before children,
+	// Transform only keeps a handle, entries may move when hierarchy changes.
+	// each entry counts world matrix changes in a generation, a child is stale if parent generation differs from
+	// the one it was computed with, so setting local values only flags the entry itself.
+	class TransformSystem
+	{
+	public:
+		static int Alloc();
+		// children must be detached before free
+		static void Free(int handle);
+		// parent -1 for root, world matrix is computed again
+		static void SetParent(int handle, int parent);
+		static int GetParent(int handle);
+		static const Vector3& GetLocalPosition(int handle) { return m_local_positions[m_indices[handle]]; }
+		static void SetLocalPosition(int handle, const Vector3& pos);
+		static const Quaternion& GetLocalRotation(int handle) { return m_local_rotations[m_indices[handle]]; }
+		static void SetLocalRotation(int handle, const Quaternion& rot);
+		static const Vector3& GetLocalScale(int handle) { return m_local_scales[m_indices[handle]]; }
+		static void SetLocalScale(int handle, const Vector3& scale);
+		// world getters resolve dirty chain first, only safe on main thread unless resolved already
+		static const Matrix4x4& GetLocalToWorldMatrix(int handle);
+		// inverse is computed on first request after world matrix changes
+		static const Matrix4x4& GetWorldToLocalMatrix(int handle);
+		static const Quaternion& GetRotation(int handle);
+		static const Vector3& GetScale(int handle);
+		// callback runs on main thread in UpdateAll after world matrix of transform changed, once per frame,
+		// also once after subscribe, callback must not subscribe or unsubscribe
+		static int Subscribe(int handle, const Action& callback);
+		static void Unsubscribe(int id);
+		// resolve all stale world matrices in one pass, depth by depth, large levels split across job threads,
+		// then notify subscribers
+		static void UpdateAll();
+
+	private:
+		enum : byte
+		{
+			FLAG_DIRTY = 1,
+			FLAG_INVERSE_DIRTY = 2,
+		};
+
+		struct Subscription
+		{
+			int handle;
+			uint32_t generation;
+			Action callback;
+		};
+
+		static void MarkDirty(int index);
+		static bool IsStale(int index);
+		static void Resolve(int index);
+		static void UpdateWorld(int index);
+		static void UpdateLevels();
+		static void UpdateRange(int begin, int end);
+		static void Sort();
+
+	private:
+		// handle to index, -1 for free handle
+		static Vector<int> m_indices;
+		static Vector<int> m_free_handles;
+		// index to handle, -1 for freed entry waiting for sort
+		static Vector<int> m_handles;
+		static Vector<int> m_parents;
+		static Vector<Vector3> m_local_positions;
+		static Vector<Quaternion> m_local_rotations;
+		static Vector<Vector3> m_local_scales;
+		static Vector<Matrix4x4> m_local_to_worlds;
+		static Vector<Matrix4x4> m_world_to_locals;
+		static Vector<Quaternion> m_rotations;
+		static Vector<Vector3> m_scales;
+		static Vector<byte> m_flags;
+		static Vector<uint32_t> m_generations;
+		// parent generation when world matrix was computed
+		static Vector<uint32_t> m_parent_generations;
+		// first index of each depth, valid after sort
+		static Vector<int> m_level_begins;
+		static bool m_order_dirty;
+		// no stale entry before this index
+		static int m_first_dirty;
+		static Vector<Subscription> m_subscriptions;
+		static Vector<int> m_free_subscriptions;
+	};
+}
@@ -93,7 +93,7 @@ namespace Viry3D
         m_states.Clear();
     }
 
-    void Animation::Update()
+    void Animation::AnimationUpdate()
     {
         bool first_state = true;
 
@@ -107,7 +107,8 @@ namespace Viry3D
         void Stop();
 
     protected:
-        virtual void Update();
+        virtual void AnimationUpdate();
+        virtual uint32_t GetUpdatePhases() const { return 1 << (int) UpdatePhase::Animation; }
         
     private:
         void Sample(AnimationState& state, float time, float weight, bool first_state, bool last_state);
@@ -66,6 +66,11 @@ namespace Viry3D
         ALuint m_buffer;
         Mutex m_mutex;
         bool m_stream_loop;
+#if !VR_WASM
+        // decoder blocks until stopped, so it keeps its own thread out of job system,
+        // destroyed first to join before other members go
+        Ref<Thread> m_decoder_thread;
+#endif
 
         AudioClipPrivate():
 #if !VR_WASM
@@ -193,7 +198,11 @@ namespace Viry3D
 
                     return Ref<Object>();
                 };
-                Engine::Instance()->GetThreadPool()->AddTask(task);
+                if (!m_decoder_thread)
+                {
+                    m_decoder_thread = RefMake<Thread>(nullptr, nullptr);
+                }
+                m_decoder_thread->AddTask(task);
             }
         }
 
@@ -63,16 +63,29 @@ namespace Viry3D
     };
 
     AudioListener::AudioListener():
-        m_private(Memory::New<AudioListenerPrivate>())
+        m_private(Memory::New<AudioListenerPrivate>()),
+        m_transform_subscription(-1)
     {
     
     }
 
     AudioListener::~AudioListener()
     {
+        if (m_transform_subscription >= 0)
+        {
+            TransformSystem::Unsubscribe(m_transform_subscription);
+        }
+
         Memory::SafeDelete(m_private);
     }
 
+    void AudioListener::OnAttach()
+    {
+        m_transform_subscription = this->GetTransform()->Subscribe([this]() {
+            this->OnTransformDirty();
+        });
+    }
+
     void AudioListener::OnTransformDirty()
     {
         Vector3 pos = this->GetTransform()->GetPosition();
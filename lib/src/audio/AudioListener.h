@@ -30,9 +30,14 @@ namespace Viry3D
         virtual ~AudioListener();
 
     protected:
-        virtual void OnTransformDirty();
+        virtual void OnAttach();
+        virtual uint32_t GetUpdatePhases() const { return 0; }
+
+    private:
+        void OnTransformDirty();
 
     private:
         AudioListenerPrivate* m_private;
+        int m_transform_subscription;
     };
 }
@@ -178,16 +178,29 @@ namespace Viry3D
     };
 
     AudioSource::AudioSource():
-        m_private(Memory::New<AudioSourcePrivate>())
+        m_private(Memory::New<AudioSourcePrivate>()),
+        m_transform_subscription(-1)
     {
     
     }
 
     AudioSource::~AudioSource()
     {
+        if (m_transform_subscription >= 0)
+        {
+            TransformSystem::Unsubscribe(m_transform_subscription);
+        }
+
         Memory::SafeDelete(m_private);
     }
 
+    void AudioSource::OnAttach()
+    {
+        m_transform_subscription = this->GetTransform()->Subscribe([this]() {
+            this->OnTransformDirty();
+        });
+    }
+
     void AudioSource::SetClip(const Ref<AudioClip>& clip)
     {
         this->Stop();
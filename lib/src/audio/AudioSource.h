@@ -49,10 +49,15 @@ namespace Viry3D
 
     protected:
 		virtual void Update();
-        virtual void OnTransformDirty();
+        virtual void OnAttach();
+        virtual uint32_t GetUpdatePhases() const { return 1 << (int) UpdatePhase::Update; }
+
+    private:
+        void OnTransformDirty();
 
     private:
         AudioSourcePrivate* m_private;
         Ref<AudioClip> m_clip;
+        int m_transform_subscription;
     };
 }
@@ -21,6 +21,7 @@
 #include <utils/Log.h>
 
 #include <assert.h>
+#include <limits>
 
 namespace filament {
 namespace backend {
@@ -31,6 +31,15 @@ namespace filament
 			return D3D11Driver::create(platform);
 		}
 
+		// range is counted in 16 byte constants, and must start and span in steps of 16 constants
+		static void GetConstantRange(const D3D11Context::UniformBufferBinding& binding, UINT& first_constant, UINT& constant_count)
+		{
+			assert(binding.offset % 256 == 0);
+
+			first_constant = (UINT) (binding.offset / 16);
+			constant_count = (UINT) ((binding.size + 255) / 256 * 16);
+		}
+
 		Driver* D3D11Driver::create(backend::D3D11Platform* platform)
 		{
 			assert(platform);
@@ -831,6 +840,11 @@ namespace filament
 		}
 
 		void D3D11Driver::draw(backend::PipelineState ps, Handle<HwRenderPrimitive> rph)
+		{
+			this->drawInstanced(ps, rph, 1);
+		}
+
+		void D3D11Driver::drawInstanced(backend::PipelineState ps, Handle<HwRenderPrimitive> rph, uint32_t instanceCount)
 		{
 			auto program = handle_cast<D3D11Program>(m_handle_map, ps.program);
 			auto primitive = handle_cast<D3D11RenderPrimitive>(m_handle_map, rph);
@@ -843,9 +857,17 @@ namespace filament
 
 				for (size_t i = 0; i < m_context->uniform_buffer_bindings.size(); ++i)
 				{
-					if (m_context->uniform_buffer_bindings[i].buffer)
+					const auto& binding = m_context->uniform_buffer_bindings[i];
+					if (binding.buffer && binding.offset > 0)
+					{
+						UINT first_constant;
+						UINT constant_count;
+						GetConstantRange(binding, first_constant, constant_count);
+						m_context->context->VSSetConstantBuffers1((UINT) i, 1, &binding.buffer, &first_constant, &constant_count);
+					}
+					else if (binding.buffer)
 					{
-						m_context->context->VSSetConstantBuffers1((UINT) i, 1, &m_context->uniform_buffer_bindings[i].buffer, nullptr, nullptr);
+						m_context->context->VSSetConstantBuffers1((UINT) i, 1, &binding.buffer, nullptr, nullptr);
 					}
 					else
 					{
@@ -860,9 +882,17 @@ namespace filament
 
 				for (size_t i = 0; i < m_context->uniform_buffer_bindings.size(); ++i)
 				{
-					if (m_context->uniform_buffer_bindings[i].buffer)
+					const auto& binding = m_context->uniform_buffer_bindings[i];
+					if (binding.buffer && binding.offset > 0)
+					{
+						UINT first_constant;
+						UINT constant_count;
+						GetConstantRange(binding, first_constant, constant_count);
+						m_context->context->PSSetConstantBuffers1((UINT) i, 1, &binding.buffer, &first_constant, &constant_count);
+					}
+					else if (binding.buffer)
 					{
-						m_context->context->PSSetConstantBuffers1((UINT) i, 1, &m_context->uniform_buffer_bindings[i].buffer, nullptr, nullptr);
+						m_context->context->PSSetConstantBuffers1((UINT) i, 1, &binding.buffer, nullptr, nullptr);
 					}
 					else
 					{
@@ -989,7 +1019,14 @@ namespace filament
 			}
 			m_context->context->IASetInputLayout(program->input_layout);
 
-			m_context->context->DrawIndexed(primitive->count, primitive->offset, 0);
+			if (instanceCount > 1)
+			{
+				m_context->context->DrawIndexedInstanced(primitive->count, instanceCount, primitive->offset, 0, 0);
+			}
+			else
+			{
+				m_context->context->DrawIndexed(primitive->count, primitive->offset, 0);
+			}
 		}
 	}
 }
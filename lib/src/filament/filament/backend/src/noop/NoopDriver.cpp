@@ -17,6 +17,8 @@
 #include "noop/NoopDriver.h"
 #include "CommandStreamDispatcher.h"
 
+#include <utils/Log.h>
+
 namespace filament {
 
 using namespace backend;
@@ -38,6 +40,24 @@ backend::ShaderModel NoopDriver::getShaderModel() const noexcept {
 #endif
 }
 
+// draw calls are reported as averages every 60 frames, instanced draws count once
+// but submit instanceCount objects, so both numbers show the effect of batching.
+void NoopDriver::onCommand(uint32_t&) {
+    mTotalDrawCount += mDrawCount;
+    mTotalInstanceCount += mInstanceCount;
+    mDrawCount = 0;
+    mInstanceCount = 0;
+
+    if (++mFrameCount == 60) {
+        utils::slog.i << "noop driver: " << uint32_t(mTotalDrawCount / mFrameCount)
+                << " draw calls, " << uint32_t(mTotalInstanceCount / mFrameCount)
+                << " objects per frame" << utils::io::endl;
+        mFrameCount = 0;
+        mTotalDrawCount = 0;
+        mTotalInstanceCount = 0;
+    }
+}
+
 // explicit instantiation of the Dispatcher
 template class backend::ConcreteDispatcher<NoopDriver>;
 
@@ -41,8 +41,32 @@ private:
     template<typename T>
     friend class backend::ConcreteDispatcher;
 
+    // every command goes through onCommand(), only draws and endFrame are counted
+    template<typename... ARGS>
+    UTILS_ALWAYS_INLINE void onCommand(ARGS&&...) { }
+
+    void onCommand(backend::PipelineState&, backend::RenderPrimitiveHandle&) {
+        mDrawCount++;
+        mInstanceCount++;
+    }
+
+    void onCommand(backend::PipelineState&, backend::RenderPrimitiveHandle&,
+            uint32_t& instanceCount) {
+        mDrawCount++;
+        mInstanceCount += instanceCount;
+    }
+
+    // endFrame(frameId)
+    void onCommand(uint32_t& frameId);
+
+    uint32_t mDrawCount = 0;
+    uint32_t mInstanceCount = 0;
+    uint32_t mFrameCount = 0;
+    uint64_t mTotalDrawCount = 0;
+    uint64_t mTotalInstanceCount = 0;
+
 #define DECL_DRIVER_API(methodName, paramsDecl, params) \
-    UTILS_ALWAYS_INLINE void methodName(paramsDecl) { }
+    UTILS_ALWAYS_INLINE void methodName(paramsDecl) { onCommand(params); }
 
     // The only reason we return a non-zero value is so that "isTextureFormatSupported"
     // returns true, which is necessary because Engine creates an internal 1x1 texture
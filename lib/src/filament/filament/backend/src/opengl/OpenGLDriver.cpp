@@ -3084,6 +3084,11 @@ void OpenGLDriver::updateTextureLodRange(GLTexture* texture, int8_t targetLevel)
 }
 
 void OpenGLDriver::draw(PipelineState state, Handle<HwRenderPrimitive> rph) {
+    drawInstanced(state, rph, 1);
+}
+
+void OpenGLDriver::drawInstanced(PipelineState state, Handle<HwRenderPrimitive> rph,
+        uint32_t instanceCount) {
     DEBUG_MARKER()
 
     OpenGLProgram* p = handle_cast<OpenGLProgram*>(state.program);
@@ -3098,8 +3103,14 @@ void OpenGLDriver::draw(PipelineState state, Handle<HwRenderPrimitive> rph) {
 
     enable(GL_SCISSOR_TEST);
 
-    glDrawRangeElements(GLenum(rp->type), rp->minIndex, rp->maxIndex, rp->count,
-            rp->gl.indicesType, reinterpret_cast<const void*>(rp->offset));
+    if (instanceCount == 1) {
+        // single instance keeps the index range hint
+        glDrawRangeElements(GLenum(rp->type), rp->minIndex, rp->maxIndex, rp->count,
+                rp->gl.indicesType, reinterpret_cast<const void*>(rp->offset));
+    } else {
+        glDrawElementsInstanced(GLenum(rp->type), rp->count,
+                rp->gl.indicesType, reinterpret_cast<const void*>(rp->offset), GLsizei(instanceCount));
+    }
 
     CHECK_GL_ERROR(utils::slog.e)
 }
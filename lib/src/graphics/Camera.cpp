@@ -22,9 +22,12 @@
 #include "Engine.h"
 #include "Renderer.h"
 #include "Material.h"
+#include "MaterialPropertyBlock.h"
+#include "MeshRenderer.h"
 #include "SkinnedMeshRenderer.h"
 #include "Light.h"
 #include "time/Time.h"
+#include "math/Frustum.h"
 #include "postprocessing/PostProcessing.h"
 
 namespace Viry3D
@@ -34,19 +37,44 @@ namespace Viry3D
 	bool Camera::m_cameras_order_dirty = false;
 	Ref<Mesh> Camera::m_quad_mesh;
 	Ref<Material> Camera::m_blit_material;
+	Ref<UniformArena> Camera::m_view_arena;
+
+	// light index list texture, holds 256k indices
+	static const int LIGHT_INDEX_TEXTURE_WIDTH = 1024;
+	static const int LIGHT_INDEX_TEXTURE_HEIGHT = 256;
+
+	static bool LightRangeIntersects(const Bounds& bounds, const Vector3& position, float range)
+	{
+		Vector3 closest = Vector3::Max(bounds.Min(), Vector3::Min(position, bounds.Max()));
+		return (closest - position).SqrMagnitude() <= range * range;
+	}
 
 	void Camera::Init()
 	{
-	
+		m_view_arena = RefMake<UniformArena>((int) sizeof(ViewUniforms));
 	}
 
 	void Camera::Done()
 	{
 		m_quad_mesh.reset();
 		m_blit_material.reset();
+		m_view_arena.reset();
 	}
 
-	void Camera::RenderAll()
+	void Camera::CullAll()
+	{
+		for (auto i : m_cameras)
+		{
+			i->m_visible_renderers.Clear();
+
+			if (i->GetGameObject()->IsActiveInTree())
+			{
+				i->CullRenderers(i->m_visible_renderers);
+			}
+		}
+	}
+
+	void Camera::AddRenderPasses(Vector<CommandPass>& passes)
 	{
 		const auto& lights = Light::GetLights();
 		for (auto i : lights)
@@ -62,19 +90,49 @@ namespace Viry3D
 			});
 		}
 
+		// view uniforms of all cameras go in one upload
 		for (auto i : m_cameras)
 		{
 			if (i->GetGameObject()->IsActiveInTree())
 			{
-				m_current_camera = i;
-
-				List<Renderer*> renderers;
-				i->CullRenderers(Renderer::GetRenderers(), renderers);
 				i->UpdateViewUniforms();
-				i->Draw(renderers);
-				i->PostProcessing();
+			}
+		}
+		m_view_arena->Upload();
 
-				m_current_camera = nullptr;
+		for (auto i : m_cameras)
+		{
+			if (i->GetGameObject()->IsActiveInTree())
+			{
+				// parts and targets are shared, so they are set up in prepare, draws record in parallel
+				CommandPass pass;
+				pass.prepare = [i]() {
+					m_current_camera = i;
+
+					i->CullParts();
+					i->UpdateLightClusters();
+					i->BuildRenderQueue(i->m_visible_renderers);
+					i->PrepareDraw();
+
+					i->m_visible_renderers.Clear();
+
+					m_current_camera = nullptr;
+				};
+				pass.record = [i]() {
+					i->Draw(i->m_render_queue.GetItems());
+				};
+				passes.Add(pass);
+
+				if (i->HasPostProcessing())
+				{
+					CommandPass post;
+					post.prepare = [i]() {
+						m_current_camera = i;
+						i->PostProcessing();
+						m_current_camera = nullptr;
+					};
+					passes.Add(post);
+				}
 			}
 		}
 	}
@@ -98,53 +156,141 @@ namespace Viry3D
         m_projection_matrix_dirty = true;
     }
 
-    void Camera::CullRenderers(const List<Renderer*>& renderers, List<Renderer*>& result)
+    void Camera::CullRenderers(Vector<Renderer*>& result)
     {
-        for (auto i : renderers)
+        Frustum frustum(this->GetProjectionMatrix() * this->GetViewMatrix());
+
+        Vector<Renderer*> candidates;
+        Renderer::QueryFrustum(frustum, candidates);
+
+        // tree culled whole subtrees by fat bounds, count them as culled
+        m_visible_renderer_count = 0;
+        m_culled_renderer_count = Renderer::GetSpatialTree().GetProxyCount();
+
+        for (int j = 0; j < candidates.Size(); ++j)
         {
+            Renderer* i = candidates[j];
+            if (i->m_proxy != AABBTree::NullProxy)
+            {
+                --m_culled_renderer_count;
+            }
+
             int layer = i->GetGameObject()->GetLayer();
             if (i->GetGameObject()->IsActiveInTree() && ((1 << layer) & m_culling_mask) != 0)
             {
-                result.AddLast(i);
+                // renderers without bounds are never culled
+                const Bounds* bounds = i->GetBounds();
+                if (bounds && frustum.ContainsBounds(*bounds) == ContainsResult::Out)
+                {
+                    ++m_culled_renderer_count;
+                    continue;
+                }
+
+                result.Add(i);
+                Renderer::MarkVisible(i);
+                ++m_visible_renderer_count;
             }
         }
-        result.Sort([](Renderer* a, Renderer* b) {
-            const auto& materials_a = a->GetMaterials();
-            int queue_a = 0;
-            for (int i = 0; i < materials_a.Size(); ++i)
+    }
+
+	void Camera::CullParts()
+	{
+		// other cameras and lights cull same renderers, so parts are culled right before drawing
+		Frustum frustum(this->GetProjectionMatrix() * this->GetViewMatrix());
+
+		for (int i = 0; i < m_visible_renderers.Size(); ++i)
+		{
+			m_visible_renderers[i]->CullParts(frustum);
+		}
+	}
+
+    void Camera::BuildRenderQueue(const Vector<Renderer*>& renderers)
+    {
+        const Matrix4x4& view = this->GetViewMatrix();
+        float depth_scale = 1.0f / (m_far_clip - m_near_clip);
+
+        m_render_queue.Clear();
+
+        for (int i = 0; i < renderers.Size(); ++i)
+        {
+            Renderer* renderer = renderers[i];
+            const auto& materials = renderer->GetMaterials();
+            auto primitives = renderer->GetPrimitives();
+            if (materials.Size() == 0 || primitives.Size() == 0)
             {
-				if (materials_a[i])
-				{
-					int queue = materials_a[i]->GetQueue();
-					if (queue_a < queue)
-					{
-						queue_a = queue;
-					}
-				}
+                continue;
             }
-            const auto& materials_b = b->GetMaterials();
-            int queue_b = 0;
-            for (int i = 0; i < materials_b.Size(); ++i)
+
+            // view space looks at -z
+            const Bounds* bounds = renderer->GetBounds();
+            Vector3 center = bounds ? bounds->GetCenter() : renderer->GetTransform()->GetPosition();
+            float depth = -view.MultiplyPoint3x4(center).z;
+            float depth01 = (depth - m_near_clip) * depth_scale;
+
+            // lightmapped and skinned renderers have per renderer data besides model matrix
+            bool can_instance = renderer->GetLightmapIndex() < 0 &&
+                dynamic_cast<MeshRenderer*>(renderer) != nullptr &&
+                dynamic_cast<SkinnedMeshRenderer*>(renderer) == nullptr;
+            const auto& block = renderer->GetPropertyBlock();
+            uint32_t block_id = block ? block->GetId() : 0;
+
+            for (int j = 0; j < materials.Size(); ++j)
             {
-				if (materials_b[i])
-				{
-					int queue = materials_b[i]->GetQueue();
-					if (queue_b < queue)
-					{
-						queue_b = queue;
-					}
-				}
+                auto& material = materials[j];
+                if (!material)
+                {
+                    continue;
+                }
+
+                filament::backend::RenderPrimitiveHandle primitive;
+                if (j < primitives.Size())
+                {
+                    primitive = primitives[j];
+                }
+                else
+                {
+                    primitive = primitives[0];
+                }
+
+                if (!primitive)
+                {
+                    continue;
+                }
+
+                if (renderer->IsRecieveShadow())
+                {
+                    static const Shader::KeywordMask recieve_shadow = Shader::GetKeywordMask("RECIEVE_SHADOW_ON");
+                    material->EnableKeywords(recieve_shadow);
+                }
+
+                const auto& shader = material->GetShader();
+                int queue = material->GetQueue();
+
+                for (int k = 0; k < shader->GetPassCount(); ++k)
+                {
+                    bool instancing = can_instance && queue <= RenderQueue::TransparentQueueStart && shader->GetPass(k).instancing;
+
+                    RenderItem item;
+                    item.key = RenderQueue::MakeKey(queue, instancing ? 0.0f : depth01, shader->GetId(), material->GetId(), primitive.getId(), block_id, k);
+                    item.renderer = renderer;
+                    item.material = material.get();
+                    item.primitive = primitive;
+                    item.submesh = j;
+                    item.pass = k;
+                    item.instancing = instancing;
+                    m_render_queue.Add(item);
+                }
             }
-            return queue_a < queue_b;
-        });
+        }
+
+        m_render_queue.Sort();
     }
 
 	void Camera::UpdateViewUniforms()
 	{
-		auto& driver = Engine::Instance()->GetDriverApi();
-		if (!m_view_uniform_buffer)
+		if (m_view_slot < 0)
 		{
-			m_view_uniform_buffer = driver.createUniformBuffer(sizeof(ViewUniforms), filament::backend::BufferUsage::DYNAMIC);
+			m_view_slot = m_view_arena->Alloc();
 		}
 
 		ViewUniforms view_uniforms;
@@ -166,12 +312,153 @@ namespace Viry3D
 			view_uniforms.projection_matrix = depth_map_01 * this->GetProjectionMatrix();
 		}
 
-		void* buffer = driver.allocate(sizeof(ViewUniforms));
-		Memory::Copy(buffer, &view_uniforms, sizeof(ViewUniforms));
-		driver.loadUniformBuffer(m_view_uniform_buffer, filament::backend::BufferDescriptor(buffer, sizeof(ViewUniforms)));
+		m_view_arena->Write(m_view_slot, &view_uniforms, sizeof(ViewUniforms));
 	}
 
-	void Camera::Draw(const List<Renderer*>& renderers)
+	void Camera::UpdateLightClusters()
+	{
+		const auto& lights = Light::GetLights();
+
+		m_unclustered_lights.Clear();
+		if (!m_clustered_lighting)
+		{
+			for (auto i : lights)
+			{
+				m_unclustered_lights.AddLast(i);
+			}
+			return;
+		}
+
+		auto& driver = Engine::Instance()->GetDriverApi();
+		if (!m_cluster_light_uniform_buffer)
+		{
+			m_cluster_light_uniform_buffer = driver.createUniformBuffer(sizeof(ClusteredLightUniforms), filament::backend::BufferUsage::DYNAMIC);
+
+			m_light_cluster_texture = Texture::CreateTexture2D(
+				LightClusters::CLUSTER_X * LightClusters::CLUSTER_Y,
+				LightClusters::CLUSTER_Z,
+				TextureFormat::R8G8B8A8,
+				FilterMode::Nearest,
+				SamplerAddressMode::ClampToEdge,
+				false);
+			m_light_index_texture = Texture::CreateTexture2D(
+				LIGHT_INDEX_TEXTURE_WIDTH,
+				LIGHT_INDEX_TEXTURE_HEIGHT,
+				TextureFormat::R8,
+				FilterMode::Nearest,
+				SamplerAddressMode::ClampToEdge,
+				false);
+
+			m_light_cluster_sampler_group = driver.createSamplerGroup(2);
+			filament::backend::SamplerGroup samplers(2);
+			samplers.setSampler(0, m_light_cluster_texture->GetTexture(), m_light_cluster_texture->GetSampler());
+			samplers.setSampler(1, m_light_index_texture->GetTexture(), m_light_index_texture->GetSampler());
+			driver.updateSamplerGroup(m_light_cluster_sampler_group, std::move(samplers));
+		}
+
+		const Matrix4x4& view = this->GetViewMatrix();
+		const Matrix4x4& projection = this->GetProjectionMatrix();
+		Frustum frustum(projection * view);
+
+		// shadowed and layer masked lights keep their own passes,
+		// directional lights are applied everywhere and go first in light list
+		Vector<Light*> directional_lights;
+		Vector<Light*> local_lights;
+		for (auto i : lights)
+		{
+			if (i->IsShadowEnable() || i->GetCullingMask() != 0xffffffff)
+			{
+				m_unclustered_lights.AddLast(i);
+			}
+			else if (i->GetType() == LightType::Directional)
+			{
+				directional_lights.Add(i);
+			}
+			else if (frustum.ContainsSphere(i->GetTransform()->GetPosition(), i->GetRange()) != ContainsResult::Out)
+			{
+				local_lights.Add(i);
+			}
+		}
+
+		int max_count = ClusteredLightUniforms::LIGHT_MAX_COUNT;
+		while (directional_lights.Size() + local_lights.Size() > max_count)
+		{
+			Vector<Light*>& overflow = local_lights.Size() > 0 ? local_lights : directional_lights;
+			m_unclustered_lights.AddLast(overflow[overflow.Size() - 1]);
+			overflow.Resize(overflow.Size() - 1);
+		}
+
+		ClusteredLightUniforms light_uniforms;
+		light_uniforms.ambient_color = Light::GetAmbientColor();
+
+		int light_count = 0;
+		for (int i = 0; i < directional_lights.Size(); ++i)
+		{
+			auto& uniforms = light_uniforms.lights[light_count++];
+			directional_lights[i]->GetLightUniforms(uniforms.light_pos, uniforms.light_color, uniforms.light_atten, uniforms.spot_light_dir);
+		}
+
+		Vector<LightClusters::Light> cluster_lights(local_lights.Size());
+		for (int i = 0; i < local_lights.Size(); ++i)
+		{
+			Light* light = local_lights[i];
+			auto& uniforms = light_uniforms.lights[light_count++];
+			light->GetLightUniforms(uniforms.light_pos, uniforms.light_color, uniforms.light_atten, uniforms.spot_light_dir);
+
+			auto& cluster_light = cluster_lights[i];
+			cluster_light.position = view.MultiplyPoint3x4(light->GetTransform()->GetPosition());
+			cluster_light.range = light->GetRange();
+			cluster_light.direction = view.MultiplyDirection(light->GetTransform()->GetForward());
+			cluster_light.spot_cos = -1.0f;
+			if (light->GetType() == LightType::Spot)
+			{
+				cluster_light.spot_cos = cos(light->GetSpotAngle() / 2 * Mathf::Deg2Rad);
+			}
+		}
+
+		m_light_clusters.SetView(1.0f / projection.m00, 1.0f / projection.m11, m_near_clip, m_far_clip, m_orthographic);
+		m_light_clusters.Build(cluster_lights, Engine::Instance()->GetJobSystem(), LIGHT_INDEX_TEXTURE_WIDTH * LIGHT_INDEX_TEXTURE_HEIGHT);
+
+		light_uniforms.cluster_size = Vector4(
+			(float) LightClusters::CLUSTER_X,
+			(float) LightClusters::CLUSTER_Y,
+			(float) LightClusters::CLUSTER_Z,
+			(float) directional_lights.Size());
+		light_uniforms.cluster_extent = Vector4(1.0f / projection.m00, 1.0f / projection.m11, m_orthographic ? 0.0f : 1.0f, 0.0f);
+		light_uniforms.cluster_params = Vector4(m_light_clusters.GetSliceScale(), m_light_clusters.GetSliceBias(), (float) LIGHT_INDEX_TEXTURE_WIDTH, 0.0f);
+		light_uniforms.cluster_view[0] = Vector4(view.m00, view.m01, view.m02, view.m03);
+		light_uniforms.cluster_view[1] = Vector4(view.m10, view.m11, view.m12, view.m13);
+		light_uniforms.cluster_view[2] = Vector4(view.m20, view.m21, view.m22, view.m23);
+
+		void* buffer = driver.allocate(sizeof(ClusteredLightUniforms));
+		Memory::Copy(buffer, &light_uniforms, sizeof(ClusteredLightUniforms));
+		driver.loadUniformBuffer(m_cluster_light_uniform_buffer, filament::backend::BufferDescriptor(buffer, sizeof(ClusteredLightUniforms)));
+
+		// offset in rgb, count in a
+		const auto& clusters = m_light_clusters.GetClusters();
+		ByteBuffer cluster_pixels(clusters.Size() * 4);
+		for (int i = 0; i < clusters.Size(); ++i)
+		{
+			cluster_pixels[i * 4 + 0] = (byte) (clusters[i].offset & 0xff);
+			cluster_pixels[i * 4 + 1] = (byte) ((clusters[i].offset >> 8) & 0xff);
+			cluster_pixels[i * 4 + 2] = (byte) ((clusters[i].offset >> 16) & 0xff);
+			cluster_pixels[i * 4 + 3] = (byte) clusters[i].count;
+		}
+		m_light_cluster_texture->UpdateTexture(cluster_pixels, 0, 0, 0, 0, m_light_cluster_texture->GetWidth(), m_light_cluster_texture->GetHeight());
+
+		// upload used rows only
+		const auto& indices = m_light_clusters.GetIndices();
+		int index_rows = (indices.Size() + LIGHT_INDEX_TEXTURE_WIDTH - 1) / LIGHT_INDEX_TEXTURE_WIDTH;
+		if (index_rows > 0)
+		{
+			ByteBuffer index_pixels(index_rows * LIGHT_INDEX_TEXTURE_WIDTH);
+			Memory::Zero(index_pixels.Bytes(), index_pixels.Size());
+			Memory::Copy(index_pixels.Bytes(), indices.Bytes(), indices.Size());
+			m_light_index_texture->UpdateTexture(index_pixels, 0, 0, 0, 0, LIGHT_INDEX_TEXTURE_WIDTH, index_rows);
+		}
+	}
+
+	void Camera::PrepareDraw()
 	{
 		auto& driver = Engine::Instance()->GetDriverApi();
 
@@ -179,8 +466,10 @@ namespace Viry3D
 		int target_height = this->GetTargetHeight();
 		bool has_post_processing = this->HasPostProcessing();
 
-		filament::backend::RenderTargetHandle target;
-		filament::backend::RenderPassParams params;
+		filament::backend::RenderTargetHandle& target = m_draw_target;
+		filament::backend::RenderPassParams& params = m_draw_params;
+		target.clear();
+		params = filament::backend::RenderPassParams();
 		params.flags.clear = filament::backend::TargetBufferFlags::NONE;
 		params.flags.discardStart = filament::backend::TargetBufferFlags::NONE;
 		params.flags.discardEnd = filament::backend::TargetBufferFlags::NONE;
@@ -336,87 +625,247 @@ namespace Viry3D
 		params.viewport.height = (uint32_t) (m_viewport_rect.h * target_height);
 		params.clearColor = filament::math::float4(m_clear_color.r, m_clear_color.g, m_clear_color.b, m_clear_color.a);
 
-		driver.beginRenderPass(target, params);
+		// variants are found on first use, which changes shared shader cache
+		const auto& items = m_render_queue.GetItems();
+		for (int i = 0; i < items.Size(); ++i)
+		{
+			this->PrepareVariants(items[i]);
+		}
+	}
 
-		driver.bindUniformBuffer((size_t) Shader::BindingPoint::PerView, m_view_uniform_buffer);
+	void Camera::PrepareVariants(const RenderItem& item)
+	{
+		Material* material = item.material;
+		const auto& base_pass = material->GetShader()->GetPass(item.pass);
+		bool clustered = m_clustered_lighting && m_cluster_light_uniform_buffer && base_pass.light_mode == Shader::LightMode::Forward && base_pass.lights_clustered;
+
+		int light_count = 0;
+		const auto& lights = clustered ? m_unclustered_lights : Light::GetLights();
+		for (auto i : lights)
+		{
+			if ((1 << item.renderer->GetGameObject()->GetLayer()) & i->GetCullingMask())
+			{
+				++light_count;
+			}
+		}
+		bool light_add = clustered ? light_count > 0 : light_count > 1;
+
+		// instancing items drawn alone use plain variants
+		if (clustered)
+		{
+			material->GetClusteredShader();
+		}
+		if (light_add)
+		{
+			material->GetLightAddShader();
+		}
+		if (item.instancing)
+		{
+			if (clustered)
+			{
+				material->GetClusteredInstancingShader();
+			}
+			else
+			{
+				material->GetInstancingShader();
+			}
+			if (light_add)
+			{
+				material->GetLightAddInstancingShader();
+			}
+		}
+	}
+
+	void Camera::Draw(const Vector<RenderItem>& items)
+	{
+		auto& driver = Engine::Instance()->GetDriverApi();
+
+		driver.beginRenderPass(m_draw_target, m_draw_params);
+
+		m_view_arena->Bind((size_t) Shader::BindingPoint::PerView, m_view_slot);
+
+		if (m_clustered_lighting && m_light_cluster_sampler_group)
+		{
+			driver.bindSamplers((size_t) Shader::BindingPoint::PerView, m_light_cluster_sampler_group);
+		}
+
+		m_draw_call_count = 0;
+		m_draw_call_count_without_instancing = 0;
+		m_instance_uniform_buffer_used = 0;
+
+		Renderer* bound_renderer = nullptr;
+		int i = 0;
+		while (i < items.Size())
+		{
+			const RenderItem& item = items[i];
+
+			// merge following items of same state into one instanced draw
+			int count = 1;
+			if (item.instancing)
+			{
+				int layer = item.renderer->GetGameObject()->GetLayer();
+				while (i + count < items.Size() && count < InstancedRendererUniforms::INSTANCE_MAX_COUNT)
+				{
+					const RenderItem& next = items[i + count];
+					if (!next.instancing ||
+						next.material != item.material ||
+						next.primitive != item.primitive ||
+						next.pass != item.pass ||
+						next.renderer->GetGameObject()->GetLayer() != layer ||
+						next.renderer->GetPropertyBlock() != item.renderer->GetPropertyBlock())
+					{
+						break;
+					}
+					++count;
+				}
+			}
+
+			if (count > 1)
+			{
+				this->BindInstances(&items[i], count);
+				bound_renderer = nullptr;
+			}
+			else if (item.renderer != bound_renderer)
+			{
+				bound_renderer = item.renderer;
+				this->BindRenderer(bound_renderer);
+			}
+
+			this->DrawItems(&items[i], count);
+
+			i += count;
+		}
 
-        for (auto i : renderers)
-        {
-            this->DrawRenderer(i);
-        }
-        
 		driver.endRenderPass();
 
 		driver.flush();
 	}
 
-    void Camera::DrawRenderer(Renderer* renderer)
+    void Camera::BindRenderer(Renderer* renderer)
+    {
+		renderer->BindUniforms();
+    }
+
+	void Camera::BindInstances(const RenderItem* items, int count)
+	{
+		auto& driver = Engine::Instance()->GetDriverApi();
+
+		// each run in a frame has its own buffer, so uploads do not overwrite data of pending draws
+		if (m_instance_uniform_buffer_used == m_instance_uniform_buffers.Size())
+		{
+			m_instance_uniform_buffers.Add(driver.createUniformBuffer(sizeof(InstancedRendererUniforms), filament::backend::BufferUsage::DYNAMIC));
+		}
+		const auto& uniform_buffer = m_instance_uniform_buffers[m_instance_uniform_buffer_used++];
+
+		int size = sizeof(Matrix4x4) * count;
+		Matrix4x4* matrices = (Matrix4x4*) driver.allocate(size);
+		for (int i = 0; i < count; ++i)
+		{
+			matrices[i] = items[i].renderer->GetTransform()->GetLocalToWorldMatrix();
+		}
+		driver.loadUniformBuffer(uniform_buffer, filament::backend::BufferDescriptor(matrices, size));
+
+		driver.bindUniformBuffer((size_t) Shader::BindingPoint::PerRenderer, uniform_buffer);
+	}
+
+    void Camera::DrawItems(const RenderItem* items, int count)
     {
         auto& driver = Engine::Instance()->GetDriverApi();
-		
-		driver.bindUniformBuffer((size_t) Shader::BindingPoint::PerRenderer, renderer->GetTransformUniformBuffer());
+		const RenderItem& item = items[0];
+		Renderer* renderer = item.renderer;
+		Material* material = item.material;
+		bool instanced = count > 1;
 
-        SkinnedMeshRenderer* skin = dynamic_cast<SkinnedMeshRenderer*>(renderer);
-        if (skin && skin->GetBonesUniformBuffer())
-        {
-            driver.bindUniformBuffer((size_t) Shader::BindingPoint::PerRendererBones, skin->GetBonesUniformBuffer());
-        }
+		material->SetScissor(this->GetTargetWidth(), this->GetTargetHeight());
+
+		// all lights without shadow shade in one pass if shader supports it
+		const auto& base_pass = material->GetShader()->GetPass(item.pass);
+		bool clustered = m_clustered_lighting && m_cluster_light_uniform_buffer && base_pass.light_mode == Shader::LightMode::Forward && base_pass.lights_clustered;
 
 		auto draw = [&](bool light_add = false) {
-			const auto& materials = renderer->GetMaterials();
-			for (int i = 0; i < materials.Size(); ++i)
+			const Ref<Shader>* shader_ptr;
+			if (clustered && !light_add)
 			{
-				auto& material = materials[i];
-				if (material)
-				{
-					filament::backend::RenderPrimitiveHandle primitive;
+				shader_ptr = instanced ? &material->GetClusteredInstancingShader() : &material->GetClusteredShader();
+			}
+			else if (instanced)
+			{
+				shader_ptr = light_add ? &material->GetLightAddInstancingShader() : &material->GetInstancingShader();
+			}
+			else
+			{
+				shader_ptr = light_add ? &material->GetLightAddShader() : &material->GetShader();
+			}
+			const auto& shader = *shader_ptr;
+			if (item.pass >= shader->GetPassCount())
+			{
+				return;
+			}
 
-					auto primitives = renderer->GetPrimitives();
-					if (i < primitives.Size())
-					{
-						primitive = primitives[i];
-					}
-					else if (primitives.Size() > 0)
-					{
-						primitive = primitives[0];
-					}
+			bool has_light = shader->GetPass(item.pass).light_mode == Shader::LightMode::Forward;
+			if (!has_light && light_add)
+			{
+				return;
+			}
 
-					if (primitive)
-					{
-						if (renderer->IsRecieveShadow())
-						{
-							material->EnableKeyword("RECIEVE_SHADOW_ON");
-						}
-
-						const auto& shader = light_add ? material->GetLightAddShader() : material->GetShader();
-						
-						material->SetScissor(this->GetTargetWidth(), this->GetTargetHeight());
-
-						for (int j = 0; j < shader->GetPassCount(); ++j)
-						{
-							bool has_light = shader->GetPass(j).light_mode == Shader::LightMode::Forward;
-							if (!has_light && light_add)
-							{
-								continue;
-							}
-
-							material->Bind(j);
-
-							const auto& pipeline = shader->GetPass(j).pipeline;
-							driver.draw(pipeline, primitive);
-						}
-					}
+			material->Bind(item.pass);
+			renderer->BindMaterialOverride(item.submesh, item.pass);
+
+			const auto& pipeline = shader->GetPass(item.pass).pipeline;
+			if (instanced)
+			{
+				driver.drawInstanced(pipeline, item.primitive, (uint32_t) count);
+			}
+			else
+			{
+				driver.draw(pipeline, item.primitive);
+			}
+
+			m_draw_call_count += 1;
+			m_draw_call_count_without_instancing += count;
+		};
+
+		// skip local lights out of range of all instances
+		auto in_light_range = [&](Light* light) {
+			if (light->GetType() == LightType::Directional)
+			{
+				return true;
+			}
+
+			for (int j = 0; j < count; ++j)
+			{
+				const Bounds* bounds = items[j].renderer->GetBounds();
+				if (!bounds || LightRangeIntersects(*bounds, light->GetTransform()->GetPosition(), light->GetRange()))
+				{
+					return true;
 				}
 			}
+
+			return false;
 		};
 
 		bool lighted = false;
 		bool light_add = false;
-		const auto& lights = Light::GetLights();
+		if (clustered)
+		{
+			driver.bindUniformBuffer((size_t) Shader::BindingPoint::PerLightFragment, m_cluster_light_uniform_buffer);
+
+			draw();
+
+			lighted = true;
+			light_add = true;
+		}
+
+		const auto& lights = clustered ? m_unclustered_lights : Light::GetLights();
 		for (auto i : lights)
 		{
 			if ((1 << renderer->GetGameObject()->GetLayer()) & i->GetCullingMask())
 			{
+				if (!in_light_range(i))
+				{
+					continue;
+				}
+
 				if (i->IsShadowEnable())
 				{
 					if (i->GetViewUniformBuffer())
@@ -446,13 +895,19 @@ namespace Viry3D
 
 	bool Camera::HasPostProcessing()
 	{
-		Vector<Ref<Viry3D::PostProcessing>> coms = this->GetGameObject()->GetComponents<Viry3D::PostProcessing>();
-		return coms.Size() > 0;
+		return !this->GetGameObject()->GetComponents<Viry3D::PostProcessing>().Empty();
 	}
 
 	void Camera::PostProcessing()
 	{
-		Vector<Ref<Viry3D::PostProcessing>> coms = this->GetGameObject()->GetComponents<Viry3D::PostProcessing>();
+		// effects may add or remove components while rendering, which makes a span stale,
+		// so effects of this frame are copied, the vector keeps its capacity across frames
+		auto& coms = m_post_processing_effects;
+		ComponentSpan<Viry3D::PostProcessing> span = this->GetGameObject()->GetComponents<Viry3D::PostProcessing>();
+		for (int i = 0; i < span.Size(); ++i)
+		{
+			coms.Add(span[i]);
+		}
 		if (coms.Size() == 0)
 		{
 			return;
@@ -563,29 +1018,11 @@ namespace Viry3D
 
 		RenderTarget::ReleaseTemporaryRenderTarget(m_post_processing_target);
 		m_post_processing_target.reset();
+		coms.Clear();
 	}
 
-	void Camera::Blit(const Ref<RenderTarget>& src, const Ref<RenderTarget>& dst, const Ref<Material>& mat, int pass)
+	const Ref<Mesh>& Camera::GetQuadMesh()
 	{
-		int target_width = dst->key.width;
-		int target_height = dst->key.height;
-
-		filament::backend::RenderPassParams params;
-		params.flags.clear = filament::backend::TargetBufferFlags::COLOR;
-		if (dst->target == m_current_camera->m_render_target ||
-			dst->target == *(filament::backend::RenderTargetHandle*) Engine::Instance()->GetDefaultRenderTarget())
-		{
-			params.flags.clear = dst->key.flags;
-		}
-
-		params.viewport.left = 0;
-		params.viewport.bottom = 0;
-		params.viewport.width = (uint32_t) target_width;
-		params.viewport.height = (uint32_t) target_height;
-		params.clearColor = filament::math::float4(0, 0, 0, 0);
-
-		// draw quad
-		filament::backend::RenderPrimitiveHandle primitive;
 		if (!m_quad_mesh)
 		{
 			Vector<Mesh::Vertex> vertices(4);
@@ -615,7 +1052,31 @@ namespace Viry3D
 
 			m_quad_mesh = RefMake<Mesh>(std::move(vertices), std::move(indices));
 		}
-		primitive = m_quad_mesh->GetPrimitives()[0];
+
+		return m_quad_mesh;
+	}
+
+	void Camera::Blit(const Ref<RenderTarget>& src, const Ref<RenderTarget>& dst, const Ref<Material>& mat, int pass)
+	{
+		int target_width = dst->key.width;
+		int target_height = dst->key.height;
+
+		filament::backend::RenderPassParams params;
+		params.flags.clear = filament::backend::TargetBufferFlags::COLOR;
+		if (dst->target == m_current_camera->m_render_target ||
+			dst->target == *(filament::backend::RenderTargetHandle*) Engine::Instance()->GetDefaultRenderTarget())
+		{
+			params.flags.clear = dst->key.flags;
+		}
+
+		params.viewport.left = 0;
+		params.viewport.bottom = 0;
+		params.viewport.width = (uint32_t) target_width;
+		params.viewport.height = (uint32_t) target_height;
+		params.clearColor = filament::math::float4(0, 0, 0, 0);
+
+		// draw quad
+		filament::backend::RenderPrimitiveHandle primitive = GetQuadMesh()->GetPrimitives()[0];
 
 		Ref<Material> material = mat;
 		if (!material)
@@ -673,9 +1134,17 @@ namespace Viry3D
 		m_orthographic(false),
 		m_orthographic_size(1),
 		m_view_matrix_dirty(true),
+		m_transform_subscription(-1),
 		m_projection_matrix_dirty(true),
 		m_view_matrix_external(false),
-		m_projection_matrix_external(false)
+		m_projection_matrix_external(false),
+		m_view_slot(-1),
+		m_visible_renderer_count(0),
+		m_culled_renderer_count(0),
+		m_draw_call_count(0),
+		m_draw_call_count_without_instancing(0),
+		m_instance_uniform_buffer_used(0),
+		m_clustered_lighting(true)
     {
 		m_cameras.AddLast(this);
 		m_cameras_order_dirty = true;
@@ -683,12 +1152,35 @@ namespace Viry3D
     
 	Camera::~Camera()
     {
+		if (m_transform_subscription >= 0)
+		{
+			TransformSystem::Unsubscribe(m_transform_subscription);
+		}
+
 		auto& driver = Engine::Instance()->GetDriverApi();
 
-		if (m_view_uniform_buffer)
+		if (m_view_slot >= 0 && m_view_arena)
+		{
+			m_view_arena->Free(m_view_slot);
+			m_view_slot = -1;
+		}
+
+		for (int i = 0; i < m_instance_uniform_buffers.Size(); ++i)
+		{
+			driver.destroyUniformBuffer(m_instance_uniform_buffers[i]);
+		}
+		m_instance_uniform_buffers.Clear();
+
+		if (m_cluster_light_uniform_buffer)
 		{
-			driver.destroyUniformBuffer(m_view_uniform_buffer);
-			m_view_uniform_buffer.clear();
+			driver.destroyUniformBuffer(m_cluster_light_uniform_buffer);
+			m_cluster_light_uniform_buffer.clear();
+		}
+
+		if (m_light_cluster_sampler_group)
+		{
+			driver.destroySamplerGroup(m_light_cluster_sampler_group);
+			m_light_cluster_sampler_group.clear();
 		}
 
 		if (m_render_target)
@@ -700,6 +1192,13 @@ namespace Viry3D
 		m_cameras.Remove(this);
     }
 
+	void Camera::OnAttach()
+	{
+		m_transform_subscription = this->GetTransform()->Subscribe([this]() {
+			this->OnTransformDirty();
+		});
+	}
+
 	void Camera::OnTransformDirty()
 	{
 		m_view_matrix_dirty = true;
@@ -710,6 +1209,11 @@ namespace Viry3D
 		m_depth = depth;
 	}
 
+	void Camera::EnableClusteredLighting(bool enable)
+	{
+		m_clustered_lighting = enable;
+	}
+
     void Camera::SetCullingMask(uint32_t mask)
     {
         m_culling_mask = mask;
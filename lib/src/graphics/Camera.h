@@ -23,6 +23,10 @@
 #include "math/Rect.h"
 #include "math/Matrix4x4.h"
 #include "container/List.h"
+#include "RenderQueue.h"
+#include "LightClusters.h"
+#include "UniformArena.h"
+#include "CommandPass.h"
 #include "private/backend/DriverApi.h"
 
 namespace Viry3D
@@ -32,14 +36,22 @@ namespace Viry3D
 	class RenderTarget;
 	class Material;
 	class Mesh;
+	class Light;
+	class PostProcessing;
 
     class Camera : public Component
     {
     public:
 		static void Init();
 		static void Done();
-		static void RenderAll();
+		static const List<Camera*>& GetCameras() { return m_cameras; }
+		// cull renderers of all cameras and mark them visible, call before Renderer::PrepareVisible
+		static void CullAll();
+		// passes of all cameras, each camera draws in one pass, post processing in the next
+		static void AddRenderPasses(Vector<CommandPass>& passes);
         static void OnResizeAll(int width, int height);
+		// quad covering viewport, uv origin at top left of target
+		static const Ref<Mesh>& GetQuadMesh();
 		static void Blit(const Ref<RenderTarget>& src, const Ref<RenderTarget>& dst, const Ref<Material>& mat = Ref<Material>(), int pass = -1);
 		Camera();
         virtual ~Camera();
@@ -74,16 +86,33 @@ namespace Viry3D
 		void SetRenderTarget(const Ref<Texture>& color, const Ref<Texture>& depth);
 		int GetTargetWidth() const;
 		int GetTargetHeight() const;
+		int GetVisibleRendererCount() const { return m_visible_renderer_count; }
+		int GetCulledRendererCount() const { return m_culled_renderer_count; }
+		int GetDrawCallCount() const { return m_draw_call_count; }
+		int GetDrawCallCountWithoutInstancing() const { return m_draw_call_count_without_instancing; }
+		bool IsClusteredLightingEnable() const { return m_clustered_lighting; }
+		// shade lights without shadow in one pass for shaders supporting it, other lights still draw additive passes
+		void EnableClusteredLighting(bool enable);
+		const LightClusters& GetLightClusters() const { return m_light_clusters; }
 
 	protected:
-		virtual void OnTransformDirty();
+		virtual void OnAttach();
+		virtual uint32_t GetUpdatePhases() const { return 0; }
 
 	private:
+		void OnTransformDirty();
         void OnResize(int width, int height);
-        void CullRenderers(const List<Renderer*>& renderers, List<Renderer*>& result);
+        void CullRenderers(Vector<Renderer*>& result);
+		void CullParts();
 		void UpdateViewUniforms();
-		void Draw(const List<Renderer*>& renderers);
-        void DrawRenderer(Renderer* renderer);
+		void UpdateLightClusters();
+		void BuildRenderQueue(const Vector<Renderer*>& renderers);
+		void PrepareDraw();
+		void PrepareVariants(const RenderItem& item);
+		void Draw(const Vector<RenderItem>& items);
+        void BindRenderer(Renderer* renderer);
+        void DrawItems(const RenderItem* items, int count);
+		void BindInstances(const RenderItem* items, int count);
 		bool HasPostProcessing();
 		void PostProcessing();
 
@@ -93,6 +122,8 @@ namespace Viry3D
 		static bool m_cameras_order_dirty;
 		static Ref<Mesh> m_quad_mesh;
 		static Ref<Material> m_blit_material;
+		// view uniforms of all cameras
+		static Ref<UniformArena> m_view_arena;
 		int m_depth;
         uint32_t m_culling_mask;
 		CameraClearFlags m_clear_flags;
@@ -106,6 +137,7 @@ namespace Viry3D
 		float m_orthographic_size;
 		Matrix4x4 m_view_matrix;
 		bool m_view_matrix_dirty;
+		int m_transform_subscription;
 		Matrix4x4 m_projection_matrix;
 		bool m_projection_matrix_dirty;
 		bool m_view_matrix_external;
@@ -113,7 +145,28 @@ namespace Viry3D
 		Ref<Texture> m_render_target_color;
 		Ref<Texture> m_render_target_depth;
 		Ref<RenderTarget> m_post_processing_target;
-		filament::backend::UniformBufferHandle m_view_uniform_buffer;
+		Vector<Ref<Viry3D::PostProcessing>> m_post_processing_effects;
+		int m_view_slot;
 		filament::backend::RenderTargetHandle m_render_target;
+		// target and params of draw pass set by prepare
+		filament::backend::RenderTargetHandle m_draw_target;
+		filament::backend::RenderPassParams m_draw_params;
+		int m_visible_renderer_count;
+		int m_culled_renderer_count;
+		int m_draw_call_count;
+		int m_draw_call_count_without_instancing;
+		// culled by CullAll, drawn by render pass in same frame
+		Vector<Renderer*> m_visible_renderers;
+		RenderQueue m_render_queue;
+		Vector<filament::backend::UniformBufferHandle> m_instance_uniform_buffers;
+		int m_instance_uniform_buffer_used;
+		bool m_clustered_lighting;
+		LightClusters m_light_clusters;
+		// lights not in clusters, drawn by additive passes
+		List<Light*> m_unclustered_lights;
+		filament::backend::UniformBufferHandle m_cluster_light_uniform_buffer;
+		filament::backend::SamplerGroupHandle m_light_cluster_sampler_group;
+		Ref<Texture> m_light_cluster_texture;
+		Ref<Texture> m_light_index_texture;
     };
 }
@@ -0,0 +1,33 @@
+/*
+* Viry3D
+* Copyright 2014-2019 by Stack - stackos@qq.com
+*
+* Licensed under the Apache License, Version 2.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at
+*
+*     http://www.apache.org/licenses/LICENSE-2.0
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+*/
+
+#pragma once
+
+#include "Action.h"
+
+namespace Viry3D
+{
+	// one pass of commands recorded by Engine::RecordCommandPasses,
+	// prepare runs on main thread in pass order and may touch shared state,
+	// record may run on a job thread and only reads state set up by prepares.
+	// commands of both go to the pass's own stream.
+	struct CommandPass
+	{
+		Action prepare;
+		Action record;
+	};
+}
@@ -20,6 +20,7 @@
 #include "Material.h"
 #include "GameObject.h"
 #include "Renderer.h"
+#include "Camera.h"
 #include "SkinnedMeshRenderer.h"
 #include "Texture.h"
 
@@ -27,6 +28,16 @@ namespace Viry3D
 {
 	List<Light*> Light::m_lights;
 	Color Light::m_ambient_color(0, 0, 0, 0);
+	int Light::m_shadow_pass_count = 0;
+	int Light::m_skipped_shadow_pass_count = 0;
+	Ref<Shader> Light::m_shadow_shader;
+	Ref<Shader> Light::m_shadow_skin_shader;
+
+	void Light::Done()
+	{
+		m_shadow_shader.reset();
+		m_shadow_skin_shader.reset();
+	}
 
 	void Light::SetAmbientColor(const Color& color)
 	{
@@ -37,33 +48,25 @@ namespace Viry3D
 		}
 	}
 
-	void Light::RenderShadowMaps()
+	// blend of logarithmic and uniform split
+	static const float CASCADE_SPLIT_LAMBDA = 0.75f;
+	// casters covering fewer texels add nothing but aliasing in far cascades
+	static const float CASCADE_CASTER_MIN_TEXELS = 2.0f;
+
+	static float CascadeSplit(float near_clip, float far_clip, int index, int count)
 	{
-		for (auto i : m_lights)
-		{
-			if (i->GetGameObject()->IsActiveInTree() &&
-				(i->GetType() == LightType::Directional || i->GetType() == LightType::Spot) &&
-				i->IsShadowEnable())
-			{
-				List<Renderer*> renderers;
-				i->CullRenderers(Renderer::GetRenderers(), renderers);
-				i->UpdateViewUniforms();
-				i->Draw(renderers);
-			}
-		}
+		float t = index / (float) count;
+		float log_split = near_clip * pow(far_clip / near_clip, t);
+		float uniform_split = near_clip + (far_clip - near_clip) * t;
+		return Mathf::Lerp(uniform_split, log_split, CASCADE_SPLIT_LAMBDA);
 	}
 
-	void Light::CullRenderers(const List<Renderer*>& renderers, List<Renderer*>& result)
+	// casters move near plane in steps of this fraction of cascade depth
+	static const float CASCADE_NEAR_STEPS = 8.0f;
+
+	static void SortByQueue(List<Renderer*>& renderers)
 	{
-		for (auto i : renderers)
-		{
-			int layer = i->GetGameObject()->GetLayer();
-			if (i->GetGameObject()->IsActiveInTree() && ((1 << layer) & m_culling_mask) != 0 && i->IsCastShadow())
-			{
-				result.AddLast(i);
-			}
-		}
-		result.Sort([](Renderer* a, Renderer* b) {
+		renderers.Sort([](Renderer* a, Renderer* b) {
 			const auto& materials_a = a->GetMaterials();
 			int queue_a = 0;
 			for (int i = 0; i < materials_a.Size(); ++i)
@@ -88,142 +91,586 @@ namespace Viry3D
 		});
 	}
 
-	void Light::UpdateViewUniforms()
+	// first camera to render in tree
+	static Camera* FindShadowCamera()
+	{
+		Camera* camera = nullptr;
+		for (auto i : Camera::GetCameras())
+		{
+			if (i->GetGameObject()->IsActiveInTree() && (camera == nullptr || i->GetDepth() < camera->GetDepth()))
+			{
+				camera = i;
+			}
+		}
+		return camera;
+	}
+
+	static bool IsShadowCaster(Light* light)
+	{
+		return light->GetGameObject()->IsActiveInTree() &&
+			(light->GetType() == LightType::Directional || light->GetType() == LightType::Spot) &&
+			light->IsShadowEnable();
+	}
+
+	void Light::CullAll()
+	{
+		for (auto i : m_lights)
+		{
+			if (IsShadowCaster(i))
+			{
+				i->CullShadowCasters();
+			}
+		}
+	}
+
+	void Light::AddShadowPasses(Vector<CommandPass>& passes)
+	{
+		m_shadow_pass_count = 0;
+		m_skipped_shadow_pass_count = 0;
+
+		for (auto i : m_lights)
+		{
+			if (IsShadowCaster(i))
+			{
+				i->AddShadowMapPasses(passes);
+			}
+		}
+	}
+
+	void Light::CullShadowCasters()
+	{
+		this->UpdateCascades();
+
+		bool static_dirty = m_shadow_dirty || m_static_version != Renderer::GetStaticVersion();
+		bool has_dynamic = false;
+
+		for (int i = 0; i < m_cascade_count; ++i)
+		{
+			auto& cascade = m_cascades[i];
+			cascade.static_casters.Clear();
+			cascade.dynamic_casters.Clear();
+
+			this->CullRenderers(i, cascade.static_casters, cascade.dynamic_casters);
+
+			if (this->UpdateStaticCache(i, cascade.static_casters))
+			{
+				static_dirty = true;
+			}
+			if (cascade.dynamic_casters.Size() > 0)
+			{
+				has_dynamic = true;
+			}
+		}
+
+		m_shadow_dirty = false;
+		m_static_version = Renderer::GetStaticVersion();
+		m_has_dynamic_casters = has_dynamic;
+
+		if (static_dirty)
+		{
+			m_shadow_static_only = false;
+			m_static_layer_valid = false;
+
+			// shadow matrices go to light uniforms
+			m_dirty = true;
+		}
+
+		// cached static casters are not drawn, so they need no prepare
+		bool draw_static = has_dynamic ? !m_static_layer_valid : !m_shadow_static_only;
+
+		for (int i = 0; i < m_cascade_count; ++i)
+		{
+			const auto& cascade = m_cascades[i];
+			if (draw_static)
+			{
+				for (auto j : cascade.static_casters)
+				{
+					Renderer::MarkVisible(j);
+				}
+			}
+			for (auto j : cascade.dynamic_casters)
+			{
+				Renderer::MarkVisible(j);
+			}
+		}
+	}
+
+	void Light::AddShadowMapPasses(Vector<CommandPass>& passes)
+	{
+		m_shadow_passes.Clear();
+
+		if (!m_has_dynamic_casters)
+		{
+			// nothing moved, shadow texture already has all casters
+			if (m_shadow_static_only)
+			{
+				m_skipped_shadow_pass_count += m_cascade_count;
+				return;
+			}
+
+			for (int i = 0; i < m_cascade_count; ++i)
+			{
+				this->AddShadowPass(i, false, false, m_cascades[i].static_casters, true);
+			}
+			m_shadow_static_only = true;
+		}
+		else
+		{
+			if (!m_static_layer_texture)
+			{
+				m_static_layer_texture = Texture::CreateRenderTexture(
+					m_shadow_texture_size,
+					m_shadow_texture_size,
+					Texture::SelectDepthFormat(),
+					FilterMode::Nearest,
+					SamplerAddressMode::ClampToEdge);
+				m_static_layer_material = RefMake<Material>(Shader::Find("ShadowCopy"));
+				m_static_layer_material->SetTexture(MaterialProperty::TEXTURE, m_static_layer_texture);
+			}
+
+			for (int i = 0; i < m_cascade_count; ++i)
+			{
+				bool update_view = true;
+
+				if (m_static_layer_valid)
+				{
+					++m_skipped_shadow_pass_count;
+				}
+				else
+				{
+					this->AddShadowPass(i, true, false, m_cascades[i].static_casters, update_view);
+					update_view = false;
+				}
+
+				// static layer first, then dynamic casters on top
+				this->AddShadowPass(i, false, true, m_cascades[i].dynamic_casters, update_view);
+			}
+			m_static_layer_valid = true;
+			m_shadow_static_only = false;
+		}
+
+		for (int i = 0; i < m_shadow_passes.Size(); ++i)
+		{
+			CommandPass pass;
+			pass.prepare = [this, i]() {
+				this->PrepareShadowPass(i);
+			};
+			pass.record = [this, i]() {
+				this->DrawShadowPass(i);
+			};
+			passes.Add(pass);
+		}
+		m_shadow_pass_count += m_shadow_passes.Size();
+	}
+
+	void Light::AddShadowPass(int cascade_index, bool static_layer, bool copy_static_layer, const List<Renderer*>& casters, bool update_view)
+	{
+		ShadowPass pass;
+		pass.cascade_index = cascade_index;
+		pass.static_layer = static_layer;
+		pass.copy_static_layer = copy_static_layer;
+		pass.update_view = update_view;
+		pass.casters = &casters;
+		m_shadow_passes.Add(pass);
+	}
+
+	bool Light::UpdateStaticCache(int cascade_index, const List<Renderer*>& static_casters)
+	{
+		auto& cascade = m_cascades[cascade_index];
+		bool dirty = false;
+
+		if (Memory::Compare(&cascade.cached_view_matrix, &cascade.view_matrix, sizeof(Matrix4x4)) != 0 ||
+			Memory::Compare(&cascade.cached_projection_matrix, &cascade.projection_matrix, sizeof(Matrix4x4)) != 0)
+		{
+			cascade.cached_view_matrix = cascade.view_matrix;
+			cascade.cached_projection_matrix = cascade.projection_matrix;
+			dirty = true;
+		}
+
+		// casters entered or left cascade, or were enabled or disabled
+		int index = 0;
+		bool same_casters = cascade.cached_static_casters.Size() == static_casters.Size();
+		for (auto i : static_casters)
+		{
+			if (!same_casters || cascade.cached_static_casters[index] != i)
+			{
+				same_casters = false;
+				break;
+			}
+			++index;
+		}
+		if (!same_casters)
+		{
+			cascade.cached_static_casters.Clear();
+			for (auto i : static_casters)
+			{
+				cascade.cached_static_casters.Add(i);
+			}
+			dirty = true;
+		}
+
+		return dirty;
+	}
+
+	void Light::UpdateCascades()
+	{
+		Camera* camera = nullptr;
+		if (this->GetType() == LightType::Directional && m_shadow_cascade_count > 1)
+		{
+			camera = FindShadowCamera();
+		}
+
+		if (camera)
+		{
+			this->FitCascades(camera);
+			return;
+		}
+
+		m_cascade_count = 1;
+
+		auto& cascade = m_cascades[0];
+		cascade.view_matrix = this->GetViewMatrix();
+		cascade.projection_matrix = this->GetProjectionMatrix();
+		cascade.cull_matrix = cascade.projection_matrix;
+		cascade.fit_near = false;
+		cascade.min_caster_size = 0;
+		cascade.tile_x = 0;
+		cascade.tile_y = 0;
+		cascade.tile_size = m_shadow_texture_size;
+	}
+
+	void Light::FitCascades(Camera* camera)
+	{
+		m_cascade_count = m_shadow_cascade_count;
+
+		const Matrix4x4& camera_projection = camera->GetProjectionMatrix();
+		Matrix4x4 camera_to_world = camera->GetViewMatrix().Inverse();
+		float extent_x = 1.0f / camera_projection.m00;
+		float extent_y = 1.0f / camera_projection.m11;
+		float near_clip = Mathf::Max(camera->GetNearClip(), 0.01f);
+		float far_clip = Mathf::Max(Mathf::Min(camera->GetFarClip(), m_shadow_distance), near_clip * 1.001f);
+
+		// rotation only, so snapping in light space is stable when camera moves
+		Matrix4x4 light_view = Matrix4x4::LookTo(Vector3::Zero(), this->GetTransform()->GetForward(), this->GetTransform()->GetUp());
+		int tile_size = m_shadow_texture_size / 2;
+
+		for (int i = 0; i < m_cascade_count; ++i)
+		{
+			float split_near = CascadeSplit(near_clip, far_clip, i, m_cascade_count);
+			float split_far = CascadeSplit(near_clip, far_clip, i + 1, m_cascade_count);
+
+			Vector3 corners[8];
+			Vector3 center = Vector3::Zero();
+			for (int j = 0; j < 8; ++j)
+			{
+				float depth = j < 4 ? split_near : split_far;
+				float scale = camera->IsOrthographic() ? 1.0f : depth;
+				float x = (j & 1) ? extent_x : -extent_x;
+				float y = (j & 2) ? extent_y : -extent_y;
+				corners[j] = camera_to_world.MultiplyPoint3x4(Vector3(x * scale, y * scale, -depth));
+				center += corners[j];
+			}
+			center *= 1.0f / 8;
+
+			// bounding sphere keeps cascade size same when camera rotates
+			float radius = 0;
+			for (int j = 0; j < 8; ++j)
+			{
+				radius = Mathf::Max(radius, (corners[j] - center).Magnitude());
+			}
+			radius = ceil(radius * 16) / 16;
+
+			// move cascade in whole texels
+			float texel_size = radius * 2 / tile_size;
+			Vector3 center_light = light_view.MultiplyPoint3x4(center);
+			center_light.x = floor(center_light.x / texel_size) * texel_size;
+			center_light.y = floor(center_light.y / texel_size) * texel_size;
+
+			auto& cascade = m_cascades[i];
+			cascade.left = center_light.x - radius;
+			cascade.right = center_light.x + radius;
+			cascade.bottom = center_light.y - radius;
+			cascade.top = center_light.y + radius;
+			cascade.near_depth = -center_light.z - radius;
+			cascade.far_depth = -center_light.z + radius;
+			cascade.fit_near = true;
+			cascade.min_caster_size = i > 0 ? texel_size * CASCADE_CASTER_MIN_TEXELS : 0;
+			cascade.tile_x = (i % 2) * tile_size;
+			cascade.tile_y = (i / 2) * tile_size;
+			cascade.tile_size = tile_size;
+
+			cascade.view_matrix = light_view;
+			cascade.projection_matrix = Matrix4x4::Ortho(cascade.left, cascade.right, cascade.bottom, cascade.top, cascade.near_depth, cascade.far_depth);
+			// casters up to far clip of light in front of cascade can cast shadow into it
+			cascade.cull_matrix = Matrix4x4::Ortho(cascade.left, cascade.right, cascade.bottom, cascade.top, cascade.near_depth - m_far_clip, cascade.far_depth);
+		}
+	}
+
+	void Light::CullRenderers(int cascade_index, List<Renderer*>& static_result, List<Renderer*>& dynamic_result)
+	{
+		auto& cascade = m_cascades[cascade_index];
+		Frustum frustum(cascade.cull_matrix * cascade.view_matrix);
+		float near_depth = cascade.near_depth;
+
+		Vector<Renderer*> candidates;
+		Renderer::QueryFrustum(frustum, candidates);
+
+		for (int j = 0; j < candidates.Size(); ++j)
+		{
+			Renderer* i = candidates[j];
+			int layer = i->GetGameObject()->GetLayer();
+			if (i->GetGameObject()->IsActiveInTree() && ((1 << layer) & m_culling_mask) != 0 && i->IsCastShadow())
+			{
+				const Bounds* bounds = i->GetBounds();
+				if (bounds)
+				{
+					if (frustum.ContainsBounds(*bounds) == ContainsResult::Out)
+					{
+						continue;
+					}
+
+					if (bounds->GetExtents().Magnitude() * 2 < cascade.min_caster_size)
+					{
+						continue;
+					}
+
+					if (cascade.fit_near)
+					{
+						Bounds light_bounds = bounds->Transform(cascade.view_matrix);
+						near_depth = Mathf::Min(near_depth, -light_bounds.Max().z);
+					}
+				}
+				else if (cascade.fit_near)
+				{
+					near_depth = Mathf::Min(near_depth, cascade.near_depth - m_far_clip);
+				}
+
+				if (i->GetGameObject()->IsStatic())
+				{
+					static_result.AddLast(i);
+				}
+				else
+				{
+					dynamic_result.AddLast(i);
+				}
+			}
+		}
+		SortByQueue(static_result);
+		SortByQueue(dynamic_result);
+
+		// depth range only spans casters and receivers of cascade
+		if (cascade.fit_near)
+		{
+			// whole steps keep cached static layer when casters move a little
+			float step = (cascade.far_depth - cascade.near_depth) / CASCADE_NEAR_STEPS;
+			near_depth = cascade.near_depth - ceil((cascade.near_depth - near_depth) / step) * step;
+			cascade.projection_matrix = Matrix4x4::Ortho(cascade.left, cascade.right, cascade.bottom, cascade.top, near_depth, cascade.far_depth);
+		}
+
+		// ndc to tile of shadow texture
+		float tile_scale = cascade.tile_size / (float) m_shadow_texture_size;
+		Matrix4x4 to_tile = Matrix4x4::Identity();
+		to_tile.m00 = 0.5f * tile_scale;
+		to_tile.m03 = 0.5f * tile_scale + cascade.tile_x / (float) m_shadow_texture_size;
+		to_tile.m11 = 0.5f * tile_scale;
+		to_tile.m13 = 0.5f * tile_scale + cascade.tile_y / (float) m_shadow_texture_size;
+		to_tile.m22 = 0.5f;
+		to_tile.m23 = 0.5f;
+		cascade.shadow_matrix = to_tile * cascade.projection_matrix * cascade.view_matrix;
+	}
+
+	void Light::UpdateViewUniforms(int cascade_index)
 	{
+		auto& cascade = m_cascades[cascade_index];
+
 		auto& driver = Engine::Instance()->GetDriverApi();
-		if (!m_view_uniform_buffer)
+		if (!cascade.view_uniform_buffer)
 		{
-			m_view_uniform_buffer = driver.createUniformBuffer(sizeof(ViewUniforms), filament::backend::BufferUsage::DYNAMIC);
+			cascade.view_uniform_buffer = driver.createUniformBuffer(sizeof(ViewUniforms), filament::backend::BufferUsage::DYNAMIC);
 		}
 
 		ViewUniforms view_uniforms;
-		view_uniforms.view_matrix = this->GetViewMatrix();
-		view_uniforms.projection_matrix = this->GetProjectionMatrix();
+		view_uniforms.view_matrix = cascade.view_matrix;
+		view_uniforms.projection_matrix = cascade.projection_matrix;
 		view_uniforms.camera_pos = this->GetTransform()->GetPosition();
 
 		void* buffer = driver.allocate(sizeof(ViewUniforms));
 		Memory::Copy(buffer, &view_uniforms, sizeof(ViewUniforms));
-		driver.loadUniformBuffer(m_view_uniform_buffer, filament::backend::BufferDescriptor(buffer, sizeof(ViewUniforms)));
+		driver.loadUniformBuffer(cascade.view_uniform_buffer, filament::backend::BufferDescriptor(buffer, sizeof(ViewUniforms)));
 	}
 
-	void Light::Draw(const List<Renderer*>& renderers)
+	void Light::PrepareShadowPass(int index)
 	{
-		auto& driver = Engine::Instance()->GetDriverApi();
+		auto& pass = m_shadow_passes[index];
+		const auto& cascade = m_cascades[pass.cascade_index];
 
-		int target_width = m_shadow_texture_size;
-		int target_height = m_shadow_texture_size;
+		auto& driver = Engine::Instance()->GetDriverApi();
 
-		filament::backend::RenderTargetHandle target;
-		filament::backend::RenderPassParams params;
-		params.flags.clear = filament::backend::TargetBufferFlags::NONE;
-		params.flags.discardStart = filament::backend::TargetBufferFlags::NONE;
-		params.flags.discardEnd = filament::backend::TargetBufferFlags::NONE;
+		if (pass.update_view)
+		{
+			this->UpdateViewUniforms(pass.cascade_index);
+		}
 
-		if (!m_render_target)
+		filament::backend::RenderTargetHandle& target = pass.static_layer ? m_static_layer_target : m_render_target;
+		if (!target)
 		{
+			const Ref<Texture>& texture = pass.static_layer ? m_static_layer_texture : m_shadow_texture;
+
 			filament::backend::TargetBufferFlags target_flags = filament::backend::TargetBufferFlags::NONE;
 			filament::backend::TargetBufferInfo color = { };
 			filament::backend::TargetBufferInfo depth = { };
 			filament::backend::TargetBufferInfo stencil = { };
 
 			target_flags |= filament::backend::TargetBufferFlags::DEPTH;
-			depth.handle = m_shadow_texture->GetTexture();
+			depth.handle = texture->GetTexture();
 
-			m_render_target = driver.createRenderTarget(
+			target = driver.createRenderTarget(
 				target_flags,
-				target_width,
-				target_height,
+				m_shadow_texture_size,
+				m_shadow_texture_size,
 				1,
 				color,
 				depth,
 				stencil);
 		}
-		target = m_render_target;
-
-		params.flags.clear = filament::backend::TargetBufferFlags::DEPTH;
-		params.flags.discardStart |= filament::backend::TargetBufferFlags::COLOR;
 
-		params.viewport.left = 0;
-		params.viewport.bottom = 0;
-		params.viewport.width = (uint32_t) target_width;
-		params.viewport.height = (uint32_t) target_height;
-
-		driver.beginRenderPass(target, params);
-
-		driver.bindUniformBuffer((size_t) Shader::BindingPoint::PerView, m_view_uniform_buffer);
-
-		for (auto i : renderers)
+		if (pass.copy_static_layer)
 		{
-			this->DrawRenderer(i);
+			m_static_layer_material->Prepare(0);
+			Camera::GetQuadMesh();
 		}
 
-		driver.endRenderPass();
-
-		driver.flush();
+		// parts are culled again as other cascades may cull the same renderer,
+		// their ranges go to this pass before its draws
+		Frustum frustum(cascade.cull_matrix * cascade.view_matrix);
+		pass.draws.Clear();
+		for (auto i : *pass.casters)
+		{
+			i->CullParts(frustum);
+			this->AddShadowDraws(pass.draws, i);
+		}
 	}
 
-	void Light::DrawRenderer(Renderer* renderer)
+	void Light::AddShadowDraws(Vector<ShadowDraw>& draws, Renderer* renderer)
 	{
-		auto& driver = Engine::Instance()->GetDriverApi();
-
-		driver.bindUniformBuffer((size_t) Shader::BindingPoint::PerRenderer, renderer->GetTransformUniformBuffer());
-
 		SkinnedMeshRenderer* skin = dynamic_cast<SkinnedMeshRenderer*>(renderer);
-		if (skin && skin->GetBonesUniformBuffer())
-		{
-			driver.bindUniformBuffer((size_t) Shader::BindingPoint::PerRendererBones, skin->GetBonesUniformBuffer());
-		}
 
 		const auto& materials = renderer->GetMaterials();
-		for (int i = 0; i < materials.Size(); ++i)
+		auto primitives = renderer->GetPrimitives();
+		for (int i = 0; i < materials.Size() && i < primitives.Size(); ++i)
 		{
 			auto& material = materials[i];
-			if (material)
+			const auto& primitive = primitives[i];
+			if (!material || !primitive)
 			{
-				filament::backend::RenderPrimitiveHandle primitive;
-
-				auto primitives = renderer->GetPrimitives();
-				if (i < primitives.Size())
-				{
-					primitive = primitives[i];
-				}
-				else
-				{
-					break;
-				}
+				continue;
+			}
 
-				if (primitive)
+			const auto& shader = material->GetShader();
+			for (int j = 0; j < shader->GetPassCount(); ++j)
+			{
+				if (shader->GetPass(j).queue <= (int) Shader::Queue::AlphaTest &&
+					shader->GetPass(j).pipeline.rasterState.depthWrite)
 				{
-					const auto& shader = material->GetShader();
-
-					material->SetScissor(m_shadow_texture_size, m_shadow_texture_size);
-
-					for (int j = 0; j < shader->GetPassCount(); ++j)
+					Shader* shadow_shader;
+					if (skin && skin->GetBonePaths().Size() > 0)
+					{
+						if (!m_shadow_skin_shader)
+						{
+							m_shadow_skin_shader = Shader::Find("ShadowMap", { "SKIN_ON" });
+						}
+						shadow_shader = m_shadow_skin_shader.get();
+					}
+					else
 					{
-						if (shader->GetPass(j).queue <= (int) Shader::Queue::AlphaTest &&
-							shader->GetPass(j).pipeline.rasterState.depthWrite)
+						if (!m_shadow_shader)
 						{
-							material->Bind(j);
-
-							Ref<Shader> shadow_shader;
-							if (skin && skin->GetBonePaths().Size() > 0)
-							{
-								shadow_shader = Shader::Find("ShadowMap", { "SKIN_ON" });
-							}
-							else
-							{
-								shadow_shader = Shader::Find("ShadowMap");
-							}
-
-							const auto& pipeline = shadow_shader->GetPass(0).pipeline;
-							driver.draw(pipeline, primitive);
+							m_shadow_shader = Shader::Find("ShadowMap");
 						}
+						shadow_shader = m_shadow_shader.get();
 					}
+
+					// prewarmed variant still compiling
+					if (!shadow_shader || shadow_shader->GetPassCount() == 0)
+					{
+						continue;
+					}
+
+					ShadowDraw draw;
+					draw.renderer = renderer;
+					draw.material = material.get();
+					draw.shader = shadow_shader;
+					draw.primitive = primitive;
+					draw.pass = j;
+					draws.Add(draw);
 				}
 			}
 		}
 	}
 
+	void Light::DrawShadowPass(int index)
+	{
+		const auto& pass = m_shadow_passes[index];
+		const auto& cascade = m_cascades[pass.cascade_index];
+
+		auto& driver = Engine::Instance()->GetDriverApi();
+
+		int target_width = m_shadow_texture_size;
+		int target_height = m_shadow_texture_size;
+
+		filament::backend::RenderPassParams params;
+		params.flags.clear = filament::backend::TargetBufferFlags::NONE;
+		params.flags.discardStart = filament::backend::TargetBufferFlags::NONE;
+		params.flags.discardEnd = filament::backend::TargetBufferFlags::NONE;
+
+		// first cascade clears whole texture, others keep drawn tiles,
+		// copied static layer overwrites the whole tile
+		if (pass.cascade_index == 0 && !pass.copy_static_layer)
+		{
+			params.flags.clear = filament::backend::TargetBufferFlags::DEPTH;
+		}
+		params.flags.discardStart |= filament::backend::TargetBufferFlags::COLOR;
+
+		params.viewport.left = cascade.tile_x;
+		params.viewport.bottom = cascade.tile_y;
+		params.viewport.width = (uint32_t) cascade.tile_size;
+		params.viewport.height = (uint32_t) cascade.tile_size;
+
+		driver.beginRenderPass(pass.static_layer ? m_static_layer_target : m_render_target, params);
+
+		if (pass.copy_static_layer)
+		{
+			m_static_layer_material->SetScissor(target_width, target_height);
+			m_static_layer_material->Bind(0);
+
+			const auto& pipeline = m_static_layer_material->GetShader()->GetPass(0).pipeline;
+			driver.draw(pipeline, Camera::GetQuadMesh()->GetPrimitives()[0]);
+		}
+
+		driver.bindUniformBuffer((size_t) Shader::BindingPoint::PerView, cascade.view_uniform_buffer);
+
+		Renderer* bound_renderer = nullptr;
+		for (int i = 0; i < pass.draws.Size(); ++i)
+		{
+			const auto& draw = pass.draws[i];
+			if (draw.renderer != bound_renderer)
+			{
+				bound_renderer = draw.renderer;
+				bound_renderer->BindUniforms();
+			}
+
+			draw.material->SetScissor(target_width, target_height);
+			draw.material->Bind(draw.pass);
+
+			const auto& pipeline = draw.shader->GetPass(0).pipeline;
+			driver.draw(pipeline, draw.primitive);
+		}
+
+		driver.endRenderPass();
+
+		driver.flush();
+	}
+
     Light::Light():
 		m_dirty(true),
         m_type(LightType::Directional),
@@ -239,23 +686,41 @@ namespace Viry3D
 		m_near_clip(0.3f),
 		m_far_clip(1000),
 		m_orthographic_size(1),
+		m_shadow_cascade_count(1),
+		m_shadow_distance(100),
+		m_cascade_count(1),
+		m_shadow_dirty(true),
+		m_static_version(0),
+		m_has_dynamic_casters(false),
+		m_shadow_static_only(false),
+		m_static_layer_valid(false),
 		m_view_matrix_dirty(true),
+		m_transform_subscription(-1),
 		m_projection_matrix_dirty(true),
 		m_culling_mask(0xffffffff)
     {
 		m_lights.AddLast(this);
+		m_cascades.Resize(LightFragmentUniforms::CASCADE_MAX_COUNT);
 
 		this->SetShadowTextureSize(1024);
     }
 
 	Light::~Light()
     {
+		if (m_transform_subscription >= 0)
+		{
+			TransformSystem::Unsubscribe(m_transform_subscription);
+		}
+
 		auto& driver = Engine::Instance()->GetDriverApi();
 
-		if (m_view_uniform_buffer)
+		for (int i = 0; i < m_cascades.Size(); ++i)
 		{
-			driver.destroyUniformBuffer(m_view_uniform_buffer);
-			m_view_uniform_buffer.clear();
+			if (m_cascades[i].view_uniform_buffer)
+			{
+				driver.destroyUniformBuffer(m_cascades[i].view_uniform_buffer);
+				m_cascades[i].view_uniform_buffer.clear();
+			}
 		}
 
 		if (m_light_uniform_buffer)
@@ -276,13 +741,27 @@ namespace Viry3D
 			m_render_target.clear();
 		}
 
+		if (m_static_layer_target)
+		{
+			driver.destroyRenderTarget(m_static_layer_target);
+			m_static_layer_target.clear();
+		}
+
 		m_lights.Remove(this);
     }
 
+	void Light::OnAttach()
+	{
+		m_transform_subscription = this->GetTransform()->Subscribe([this]() {
+			this->OnTransformDirty();
+		});
+	}
+
 	void Light::OnTransformDirty()
 	{
 		m_dirty = true;
 		m_view_matrix_dirty = true;
+		m_shadow_dirty = true;
 	}
 
 	void Light::SetType(LightType type)
@@ -290,6 +769,7 @@ namespace Viry3D
 		m_type = type;
 		m_dirty = true;
 		m_projection_matrix_dirty = true;
+		m_shadow_dirty = true;
 	}
 
 	void Light::SetColor(const Color& color)
@@ -315,11 +795,13 @@ namespace Viry3D
 		m_spot_angle = angle;
 		m_dirty = true;
 		m_projection_matrix_dirty = true;
+		m_shadow_dirty = true;
 	}
 
 	void Light::EnableShadow(bool enable)
 	{
 		m_shadow_enable = enable;
+		m_shadow_dirty = true;
 	}
 
 	void Light::SetShadowTextureSize(int size)
@@ -350,6 +832,15 @@ namespace Viry3D
 				driver.destroyRenderTarget(m_render_target);
 				m_render_target.clear();
 			}
+
+			if (m_static_layer_target)
+			{
+				driver.destroyRenderTarget(m_static_layer_target);
+				m_static_layer_target.clear();
+			}
+			m_static_layer_texture.reset();
+			m_static_layer_material.reset();
+			m_shadow_dirty = true;
 		}
 	}
 
@@ -375,18 +866,33 @@ namespace Viry3D
 	{
 		m_near_clip = clip;
 		m_projection_matrix_dirty = true;
+		m_shadow_dirty = true;
 	}
 
 	void Light::SetFarClip(float clip)
 	{
 		m_far_clip = clip;
 		m_projection_matrix_dirty = true;
+		m_shadow_dirty = true;
 	}
 
 	void Light::SetOrthographicSize(float size)
 	{
 		m_orthographic_size = size;
 		m_projection_matrix_dirty = true;
+		m_shadow_dirty = true;
+	}
+
+	void Light::SetShadowCascadeCount(int count)
+	{
+		m_shadow_cascade_count = Mathf::Clamp(count, 1, (int) LightFragmentUniforms::CASCADE_MAX_COUNT);
+		m_shadow_dirty = true;
+	}
+
+	void Light::SetShadowDistance(float distance)
+	{
+		m_shadow_distance = distance;
+		m_shadow_dirty = true;
 	}
 
 	const Matrix4x4& Light::GetViewMatrix()
@@ -431,6 +937,34 @@ namespace Viry3D
 	void Light::SetCullingMask(uint32_t mask)
 	{
 		m_culling_mask = mask;
+		m_shadow_dirty = true;
+	}
+
+	void Light::GetLightUniforms(Vector4& light_pos, Color& light_color, Vector4& light_atten, Vector4& spot_light_dir)
+	{
+		if (this->GetType() == LightType::Directional)
+		{
+			light_pos = -this->GetTransform()->GetForward();
+			light_pos.w = 0.0f;
+		}
+		else
+		{
+			light_pos = this->GetTransform()->GetPosition();
+			light_pos.w = 1.0f;
+		}
+		light_color = this->GetColor() * this->GetIntensity();
+		light_color.a = (float) this->GetType();
+		light_atten = Vector4(0, 0, 0, 0);
+		if (this->GetType() == LightType::Spot || this->GetType() == LightType::Point)
+		{
+			light_atten.z = 1.0f / (this->GetRange() * this->GetRange());
+		}
+		if (this->GetType() == LightType::Spot)
+		{
+			light_atten.x = cos(this->GetSpotAngle() / 2 * Mathf::Deg2Rad);
+			light_atten.y = 1.0f / (light_atten.x - cos(this->GetSpotAngle() / 4 * Mathf::Deg2Rad));
+			spot_light_dir = -this->GetTransform()->GetForward();
+		}
 	}
 
 	void Light::Prepare()
@@ -449,30 +983,13 @@ namespace Viry3D
 
 		LightFragmentUniforms light_uniforms;
 		light_uniforms.ambient_color = this->GetAmbientColor();
-		if (this->GetType() == LightType::Directional)
-		{
-			light_uniforms.light_pos = -this->GetTransform()->GetForward();
-			light_uniforms.light_pos.w = 0.0f;
-		}
-		else
-		{
-			light_uniforms.light_pos = this->GetTransform()->GetPosition();
-			light_uniforms.light_pos.w = 1.0f;
-		}
-		light_uniforms.light_color = this->GetColor() * this->GetIntensity();
-		light_uniforms.light_color.a = (float) this->GetType();
-		light_uniforms.light_atten = Vector4(0, 0, 0, 0);
-		if (this->GetType() == LightType::Spot || this->GetType() == LightType::Point)
-		{
-			light_uniforms.light_atten.z = 1.0f / (this->GetRange() * this->GetRange());
-		}
-		if (this->GetType() == LightType::Spot)
+		this->GetLightUniforms(light_uniforms.light_pos, light_uniforms.light_color, light_uniforms.light_atten, light_uniforms.spot_light_dir);
+		light_uniforms.shadow_params = Vector4(m_shadow_strength, m_shadow_z_bias, m_shadow_slope_bias, 1.0f / m_shadow_texture_size * 3);
+		light_uniforms.cascade_params = Vector4((float) m_cascade_count, m_cascade_count > 1 ? 0.5f : 1.0f, 0, 0);
+		for (int i = 0; i < m_cascade_count; ++i)
 		{
-			light_uniforms.light_atten.x = cos(this->GetSpotAngle() / 2 * Mathf::Deg2Rad);
-			light_uniforms.light_atten.y = 1.0f / (light_uniforms.light_atten.x - cos(this->GetSpotAngle() / 4 * Mathf::Deg2Rad));
-			light_uniforms.spot_light_dir = -this->GetTransform()->GetForward();
+			light_uniforms.cascade_matrices[i] = m_cascades[i].shadow_matrix;
 		}
-		light_uniforms.shadow_params = Vector4(m_shadow_strength, m_shadow_z_bias, m_shadow_slope_bias, 1.0f / m_shadow_texture_size * 3);
 
 		void* buffer = driver.allocate(sizeof(LightFragmentUniforms));
 		Memory::Copy(buffer, &light_uniforms, sizeof(LightFragmentUniforms));
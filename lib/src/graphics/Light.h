@@ -19,8 +19,10 @@
 
 #include "Component.h"
 #include "container/List.h"
+#include "container/Vector.h"
 #include "Color.h"
 #include "math/Matrix4x4.h"
+#include "CommandPass.h"
 #include "private/backend/DriverApi.h"
 
 namespace Viry3D
@@ -34,14 +36,24 @@ namespace Viry3D
 
 	class Renderer;
 	class Texture;
+	class Camera;
+	class Material;
+	class Shader;
     
     class Light : public Component
     {
     public:
+		static void Done();
 		static const List<Light*>& GetLights() { return m_lights; }
 		static const Color& GetAmbientColor() { return m_ambient_color; }
 		static void SetAmbientColor(const Color& color);
-		static void RenderShadowMaps();
+		// cull shadow casters of all lights and mark casters to draw visible, call before Renderer::PrepareVisible
+		static void CullAll();
+		// passes of all shadow maps, one pass per cascade and texture
+		static void AddShadowPasses(Vector<CommandPass>& passes);
+		// shadow passes rendered and skipped by cache in last frame, a pass draws casters of one cascade into one texture
+		static int GetShadowPassCount() { return m_shadow_pass_count; }
+		static int GetSkippedShadowPassCount() { return m_skipped_shadow_pass_count; }
 		Light();
         virtual ~Light();
 		LightType GetType() const { return m_type; }
@@ -64,23 +76,93 @@ namespace Viry3D
 		void SetNearClip(float clip);
 		void SetFarClip(float clip);
 		void SetOrthographicSize(float size);
+		int GetShadowCascadeCount() const { return m_shadow_cascade_count; }
+		// directional light only, 2 ~ 4 cascades split view of the first camera and pack into shadow texture,
+		// 1 renders one map of orthographic size around light position
+		void SetShadowCascadeCount(int count);
+		float GetShadowDistance() const { return m_shadow_distance; }
+		// cascades cover camera view from near clip to this distance
+		void SetShadowDistance(float distance);
 		uint32_t GetCullingMask() const { return m_culling_mask; }
 		void SetCullingMask(uint32_t mask);
-		const filament::backend::UniformBufferHandle& GetViewUniformBuffer() const { return m_view_uniform_buffer; }
+		const filament::backend::UniformBufferHandle& GetViewUniformBuffer() const { return m_cascades[0].view_uniform_buffer; }
 		const filament::backend::UniformBufferHandle& GetLightUniformBuffer() const { return m_light_uniform_buffer; }
 		const filament::backend::SamplerGroupHandle& GetSamplerGroup() const { return m_sampler_group; }
 
 	protected:
-		virtual void OnTransformDirty();
+		virtual void OnAttach();
+		virtual uint32_t GetUpdatePhases() const { return 0; }
 
 	private:
+		struct ShadowCascade
+		{
+			Matrix4x4 view_matrix;
+			Matrix4x4 projection_matrix;
+			// projection extended toward light to find casters out of cascade
+			Matrix4x4 cull_matrix;
+			// world to uv and depth in shadow texture
+			Matrix4x4 shadow_matrix;
+			// light view space box of cascade, near is moved to the closest caster
+			float left;
+			float right;
+			float bottom;
+			float top;
+			float near_depth;
+			float far_depth;
+			bool fit_near;
+			// casters smaller than this are skipped
+			float min_caster_size;
+			// tile in shadow texture
+			int tile_x;
+			int tile_y;
+			int tile_size;
+			filament::backend::UniformBufferHandle view_uniform_buffer;
+			// state of last rendered static casters
+			Matrix4x4 cached_view_matrix;
+			Matrix4x4 cached_projection_matrix;
+			Vector<Renderer*> cached_static_casters;
+			// culled by CullAll, drawn by shadow passes in same frame
+			List<Renderer*> static_casters;
+			List<Renderer*> dynamic_casters;
+		};
+
+		struct ShadowDraw
+		{
+			Renderer* renderer;
+			Material* material;
+			Shader* shader;
+			filament::backend::RenderPrimitiveHandle primitive;
+			int pass;
+		};
+
+		// casters of one cascade drawn into shadow texture or static layer texture
+		struct ShadowPass
+		{
+			int cascade_index;
+			bool static_layer;
+			bool copy_static_layer;
+			bool update_view;
+			const List<Renderer*>* casters;
+			// found by prepare after parts are culled
+			Vector<ShadowDraw> draws;
+		};
+
 		const Matrix4x4& GetViewMatrix();
 		const Matrix4x4& GetProjectionMatrix();
-		void CullRenderers(const List<Renderer*>& renderers, List<Renderer*>& result);
-		void UpdateViewUniforms();
-		void Draw(const List<Renderer*>& renderers);
-		void DrawRenderer(Renderer* renderer);
+		void CullShadowCasters();
+		void AddShadowMapPasses(Vector<CommandPass>& passes);
+		void AddShadowPass(int cascade, bool static_layer, bool copy_static_layer, const List<Renderer*>& casters, bool update_view);
+		void UpdateCascades();
+		void FitCascades(Camera* camera);
+		void CullRenderers(int cascade, List<Renderer*>& static_result, List<Renderer*>& dynamic_result);
+		bool UpdateStaticCache(int cascade, const List<Renderer*>& static_casters);
+		void UpdateViewUniforms(int cascade);
+		void PrepareShadowPass(int index);
+		void AddShadowDraws(Vector<ShadowDraw>& draws, Renderer* renderer);
+		void DrawShadowPass(int index);
+		void GetLightUniforms(Vector4& light_pos, Color& light_color, Vector4& light_atten, Vector4& spot_light_dir);
 		void Prepare();
+		void OnTransformDirty();
 
 	private:
 		friend class Camera;
@@ -88,6 +170,11 @@ namespace Viry3D
     private:
 		static List<Light*> m_lights;
 		static Color m_ambient_color;
+		static int m_shadow_pass_count;
+		static int m_skipped_shadow_pass_count;
+		// found once, casters pick one without string work
+		static Ref<Shader> m_shadow_shader;
+		static Ref<Shader> m_shadow_skin_shader;
 		bool m_dirty;
         LightType m_type;
 		Color m_color;
@@ -103,12 +190,29 @@ namespace Viry3D
 		float m_near_clip;
 		float m_far_clip;
 		float m_orthographic_size;
+		int m_shadow_cascade_count;
+		float m_shadow_distance;
+		Vector<ShadowCascade> m_cascades;
+		int m_cascade_count;
+		// static casters are rendered again if light changed
+		bool m_shadow_dirty;
+		uint32_t m_static_version;
+		bool m_has_dynamic_casters;
+		// shadow texture has static casters only and is up to date
+		bool m_shadow_static_only;
+		// static casters of all cascades are cached in static layer
+		bool m_static_layer_valid;
+		Ref<Texture> m_static_layer_texture;
+		Ref<Material> m_static_layer_material;
+		filament::backend::RenderTargetHandle m_static_layer_target;
+		// passes of this frame
+		Vector<ShadowPass> m_shadow_passes;
 		Matrix4x4 m_view_matrix;
 		bool m_view_matrix_dirty;
+		int m_transform_subscription;
 		Matrix4x4 m_projection_matrix;
 		bool m_projection_matrix_dirty;
 		uint32_t m_culling_mask;
-		filament::backend::UniformBufferHandle m_view_uniform_buffer;
 		filament::backend::UniformBufferHandle m_light_uniform_buffer;
 		filament::backend::SamplerGroupHandle m_sampler_group;
 		filament::backend::RenderTargetHandle m_render_target;
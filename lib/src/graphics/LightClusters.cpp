@@ -0,0 +1,225 @@
+/*
+* Viry3D
+* Copyright 2014-2019 by Stack - stackos@qq.com
+*
+* Licensed under the Apache License, Version 2.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at
+*
+*     http://www.apache.org/licenses/LICENSE-2.0
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+*/
+
+#include "LightClusters.h"
+#include "thread/JobSystem.h"
+#include "math/Mathf.h"
+
+namespace Viry3D
+{
+	// bounding sphere of light volume, spot cone is bounded tighter than its range
+	static void LightSphere(const LightClusters::Light& light, Vector3& center, float& radius)
+	{
+		if (light.spot_cos <= -1.0f)
+		{
+			center = light.position;
+			radius = light.range;
+		}
+		else if (light.spot_cos < 0.70710678f)
+		{
+			// wide cone, sphere of the cap circle
+			float spot_sin = sqrt(Mathf::Max(1.0f - light.spot_cos * light.spot_cos, 0.0f));
+			center = light.position + light.direction * (light.range * light.spot_cos);
+			radius = light.range * spot_sin;
+		}
+		else
+		{
+			// narrow cone, sphere through apex and cap circle
+			radius = light.range / (2.0f * light.spot_cos);
+			center = light.position + light.direction * radius;
+		}
+	}
+
+	static void TileRange(float min, float max, float extent_near, float extent_far, int count, int& begin, int& end)
+	{
+		float ndc_min = Mathf::Min(min / extent_near, min / extent_far);
+		float ndc_max = Mathf::Max(max / extent_near, max / extent_far);
+
+		begin = Mathf::Max(Mathf::FloorToInt((ndc_min * 0.5f + 0.5f) * count), 0);
+		end = Mathf::Min(Mathf::FloorToInt((ndc_max * 0.5f + 0.5f) * count) + 1, count);
+	}
+
+	LightClusters::LightClusters():
+		m_extent_x(1),
+		m_extent_y(1),
+		m_near_clip(0.3f),
+		m_far_clip(1000),
+		m_orthographic(false),
+		m_slice_scale(0),
+		m_slice_bias(0)
+	{
+		m_clusters.Resize(CLUSTER_COUNT);
+		m_slices.Resize(CLUSTER_Z);
+	}
+
+	void LightClusters::SetView(float extent_x, float extent_y, float near_clip, float far_clip, bool orthographic)
+	{
+		m_extent_x = extent_x;
+		m_extent_y = extent_y;
+		m_near_clip = Mathf::Max(near_clip, 0.001f);
+		m_far_clip = Mathf::Max(far_clip, m_near_clip * 1.001f);
+		m_orthographic = orthographic;
+
+		float log_range = log(m_far_clip / m_near_clip);
+		m_slice_scale = CLUSTER_Z / log_range;
+		m_slice_bias = -CLUSTER_Z * log(m_near_clip) / log_range;
+	}
+
+	float LightClusters::GetSliceDepth(int z) const
+	{
+		if (z <= 0)
+		{
+			return 0;
+		}
+		return m_near_clip * pow(m_far_clip / m_near_clip, z / (float) CLUSTER_Z);
+	}
+
+	void LightClusters::Build(const Vector<Light>& lights, JobSystem* jobs, int max_index_count)
+	{
+		if (jobs && lights.Size() > 0)
+		{
+			// near slices hold more lights, small chunks let idle threads steal them,
+			// each cluster is written by one thread only
+			jobs->ParallelFor(CLUSTER_Z, [&](int begin, int end) {
+				this->BuildSlices(lights, begin, end);
+			});
+		}
+		else
+		{
+			this->BuildSlices(lights, 0, CLUSTER_Z);
+		}
+
+		// merge slice lists into one index list
+		m_indices.Clear();
+		for (int z = 0; z < CLUSTER_Z; ++z)
+		{
+			const auto& slice_indices = m_slices[z].indices;
+			int base = m_indices.Size();
+			int copy_count = Mathf::Min(slice_indices.Size(), max_index_count - base);
+
+			for (int i = z * CLUSTER_X * CLUSTER_Y; i < (z + 1) * CLUSTER_X * CLUSTER_Y; ++i)
+			{
+				auto& cluster = m_clusters[i];
+				cluster.count = Mathf::Max(Mathf::Min(cluster.count, copy_count - cluster.offset), 0);
+				cluster.offset += base;
+			}
+
+			if (copy_count > 0)
+			{
+				m_indices.AddRange(&slice_indices[0], copy_count);
+			}
+		}
+	}
+
+	void LightClusters::BuildSlices(const Vector<Light>& lights, int begin, int end)
+	{
+		for (int z = begin; z < end; ++z)
+		{
+			this->BuildSlice(lights, z);
+		}
+	}
+
+	void LightClusters::BuildSlice(const Vector<Light>& lights, int z)
+	{
+		float depth_near = this->GetSliceDepth(z);
+		float depth_far = this->GetSliceDepth(z + 1);
+		if (z == CLUSTER_Z - 1)
+		{
+			depth_far = m_far_clip;
+		}
+
+		// half size of view at both ends of slice
+		float extent_near_x = m_extent_x;
+		float extent_near_y = m_extent_y;
+		float extent_far_x = m_extent_x;
+		float extent_far_y = m_extent_y;
+		if (!m_orthographic)
+		{
+			extent_near_x *= depth_near;
+			extent_near_y *= depth_near;
+			extent_far_x *= depth_far;
+			extent_far_y *= depth_far;
+		}
+		// avoid divide by zero at eye
+		extent_near_x = Mathf::Max(extent_near_x, Mathf::Epsilon);
+		extent_near_y = Mathf::Max(extent_near_y, Mathf::Epsilon);
+
+		auto& slice = m_slices[z];
+		auto& candidates = slice.candidates;
+		auto& indices = slice.indices;
+		candidates.Clear();
+		indices.Clear();
+
+		for (int i = 0; i < lights.Size(); ++i)
+		{
+			Candidate candidate;
+			candidate.light = i;
+			LightSphere(lights[i], candidate.center, candidate.radius);
+
+			float depth = -candidate.center.z;
+			if (depth + candidate.radius < depth_near || depth - candidate.radius > depth_far)
+			{
+				continue;
+			}
+
+			TileRange(candidate.center.x - candidate.radius, candidate.center.x + candidate.radius, extent_near_x, extent_far_x, CLUSTER_X, candidate.x_begin, candidate.x_end);
+			TileRange(candidate.center.y - candidate.radius, candidate.center.y + candidate.radius, extent_near_y, extent_far_y, CLUSTER_Y, candidate.y_begin, candidate.y_end);
+			if (candidate.x_begin >= candidate.x_end || candidate.y_begin >= candidate.y_end)
+			{
+				continue;
+			}
+
+			candidates.Add(candidate);
+		}
+
+		for (int y = 0; y < CLUSTER_Y; ++y)
+		{
+			float ndc_y_min = 2.0f * y / CLUSTER_Y - 1.0f;
+			float ndc_y_max = 2.0f * (y + 1) / CLUSTER_Y - 1.0f;
+			float min_y = Mathf::Min(ndc_y_min * extent_near_y, ndc_y_min * extent_far_y);
+			float max_y = Mathf::Max(ndc_y_max * extent_near_y, ndc_y_max * extent_far_y);
+
+			for (int x = 0; x < CLUSTER_X; ++x)
+			{
+				float ndc_x_min = 2.0f * x / CLUSTER_X - 1.0f;
+				float ndc_x_max = 2.0f * (x + 1) / CLUSTER_X - 1.0f;
+				Vector3 min(Mathf::Min(ndc_x_min * extent_near_x, ndc_x_min * extent_far_x), min_y, -depth_far);
+				Vector3 max(Mathf::Max(ndc_x_max * extent_near_x, ndc_x_max * extent_far_x), max_y, -depth_near);
+
+				auto& cluster = m_clusters[(z * CLUSTER_Y + y) * CLUSTER_X + x];
+				cluster.offset = indices.Size();
+
+				for (int i = 0; i < candidates.Size(); ++i)
+				{
+					const auto& candidate = candidates[i];
+					if (x < candidate.x_begin || x >= candidate.x_end || y < candidate.y_begin || y >= candidate.y_end)
+					{
+						continue;
+					}
+
+					Vector3 closest = Vector3::Max(min, Vector3::Min(candidate.center, max));
+					if ((closest - candidate.center).SqrMagnitude() <= candidate.radius * candidate.radius)
+					{
+						indices.Add((byte) candidate.light);
+					}
+				}
+
+				cluster.count = indices.Size() - cluster.offset;
+			}
+		}
+	}
+}
@@ -0,0 +1,104 @@
+/*
+* Viry3D
+* Copyright 2014-2019 by Stack - stackos@qq.com
+*
+* Licensed under the Apache License, Version 2.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at
+*
+*     http://www.apache.org/licenses/LICENSE-2.0
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+*/
+
+#pragma once
+
+#include "container/Vector.h"
+#include "math/Vector3.h"
+#include "memory/Memory.h"
+
+namespace Viry3D
+{
+	class JobSystem;
+
+	// bins local lights into a view space froxel grid,
+	// x and y split the view evenly, z slices grow exponentially from near to far clip,
+	// each cluster keeps a range of light indices in one shared index list.
+	class LightClusters
+	{
+	public:
+		static const int CLUSTER_X = 16;
+		static const int CLUSTER_Y = 9;
+		static const int CLUSTER_Z = 24;
+		static const int CLUSTER_COUNT = CLUSTER_X * CLUSTER_Y * CLUSTER_Z;
+		// light index is stored in one byte
+		static const int LIGHT_MAX_COUNT = 255;
+
+		// in view space, view looks at -z
+		struct Light
+		{
+			Vector3 position;
+			float range;
+			// spot only, spot_cos is cos of half spot angle, point light uses -1
+			Vector3 direction;
+			float spot_cos;
+		};
+
+		struct Cluster
+		{
+			int offset;
+			int count;
+		};
+
+		LightClusters();
+		// extent is half size of view at depth 1 for perspective, or half size of view for orthographic,
+		// only symmetric projections are supported
+		void SetView(float extent_x, float extent_y, float near_clip, float far_clip, bool orthographic);
+		// bin lights on job threads if not null, index list is truncated to max_index_count
+		void Build(const Vector<Light>& lights, JobSystem* jobs = nullptr, int max_index_count = 0x7fffffff);
+		// cluster index of (x, y, z) is (z * CLUSTER_Y + y) * CLUSTER_X + x
+		const Vector<Cluster>& GetClusters() const { return m_clusters; }
+		const Vector<byte>& GetIndices() const { return m_indices; }
+		// slice z = log(depth) * scale + bias
+		float GetSliceScale() const { return m_slice_scale; }
+		float GetSliceBias() const { return m_slice_bias; }
+
+	private:
+		struct Candidate
+		{
+			int light;
+			Vector3 center;
+			float radius;
+			int x_begin;
+			int x_end;
+			int y_begin;
+			int y_end;
+		};
+
+		struct Slice
+		{
+			Vector<Candidate> candidates;
+			Vector<byte> indices;
+		};
+
+		void BuildSlices(const Vector<Light>& lights, int begin, int end);
+		void BuildSlice(const Vector<Light>& lights, int z);
+		float GetSliceDepth(int z) const;
+
+	private:
+		float m_extent_x;
+		float m_extent_y;
+		float m_near_clip;
+		float m_far_clip;
+		bool m_orthographic;
+		float m_slice_scale;
+		float m_slice_bias;
+		Vector<Cluster> m_clusters;
+		Vector<byte> m_indices;
+		Vector<Slice> m_slices;
+	};
+}
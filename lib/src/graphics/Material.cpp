@@ -18,69 +18,128 @@
 #include "Material.h"
 #include "Engine.h"
 #include "Camera.h"
+#include "MaterialPropertyBlock.h"
 
 namespace Viry3D
 {
     Material::Material(const Ref<Shader>& shader):
         m_shader(shader),
-        m_scissor_rect(0, 0, 1, 1)
+        m_scissor_rect(0, 0, 1, 1),
+        m_version(0),
+        m_layout_shader(nullptr),
+        m_layout_ready(false),
+        m_layout_pass_count(0)
     {
-        m_unifrom_buffers.Resize(shader->GetPassCount());
-        for (int i = 0; i < m_unifrom_buffers.Size(); ++i)
-        {
-            m_unifrom_buffers[i].Resize((int) Shader::BindingPoint::Count);
-        }
-        
-        m_samplers.Resize(shader->GetPassCount());
+        this->UpdateLayout();
 
         this->SetTexture(MaterialProperty::TEXTURE, Texture::GetSharedWhiteTexture());
 		this->SetVector(MaterialProperty::TEXTURE_SCALE_OFFSET, Vector4(1, 1, 0, 0));
 		this->SetColor(MaterialProperty::COLOR, Color(1, 1, 1, 1));
     }
     
-    Material::~Material()
+    static void DestroyBuffers(Vector<Vector<UniformBuffer>>& unifrom_buffers, Vector<SamplerGroup>& samplers)
     {
         auto& driver = Engine::Instance()->GetDriverApi();
         
-        for (int i = 0; i < m_unifrom_buffers.Size(); ++i)
+        for (int i = 0; i < unifrom_buffers.Size(); ++i)
         {
-            for (int j = 0; j < m_unifrom_buffers[i].Size(); ++j)
+            for (int j = 0; j < unifrom_buffers[i].Size(); ++j)
             {
-                if (m_unifrom_buffers[i][j].uniform_buffer)
+                if (unifrom_buffers[i][j].uniform_buffer)
                 {
-                    driver.destroyUniformBuffer(m_unifrom_buffers[i][j].uniform_buffer);
-					m_unifrom_buffers[i][j].uniform_buffer.clear();
+                    driver.destroyUniformBuffer(unifrom_buffers[i][j].uniform_buffer);
+					unifrom_buffers[i][j].uniform_buffer.clear();
                 }
             }
         }
-        m_unifrom_buffers.Clear();
+        unifrom_buffers.Clear();
         
-        for (int i = 0; i < m_samplers.Size(); ++i)
+        for (int i = 0; i < samplers.Size(); ++i)
         {
-            if (m_samplers[i].sampler_group)
+            if (samplers[i].sampler_group)
             {
-                driver.destroySamplerGroup(m_samplers[i].sampler_group);
-				m_samplers[i].sampler_group.clear();
+                driver.destroySamplerGroup(samplers[i].sampler_group);
+				samplers[i].sampler_group.clear();
             }
         }
-        m_samplers.Clear();
+        samplers.Clear();
     }
     
-	const Ref<Shader>& Material::GetLightAddShader()
+    Material::~Material()
+    {
+        DestroyBuffers(m_unifrom_buffers, m_samplers);
+    }
+
+	void Material::UpdateLayout()
 	{
-		if (!m_light_add_shader)
+		// pending shader gives passes of its fallback or none, buffers are remade when it is published
+		if (m_layout_shader == m_shader.get() &&
+			m_layout_ready == m_shader->IsReady() &&
+			m_layout_pass_count == m_shader->GetPassCount())
 		{
-			auto& keywords = m_shader->GetKeywords();
-			Vector<String> new_keywords;
-			for (auto& i : keywords)
-			{
-				new_keywords.Add(i);
-			}
-			new_keywords.Add("LIGHT_ADD_ON");
-			m_light_add_shader = Shader::Find(m_shader->GetName(), new_keywords, true);
+			return;
 		}
 
-		return m_light_add_shader;
+		m_layout_shader = m_shader.get();
+		m_layout_ready = m_shader->IsReady();
+		m_layout_pass_count = m_shader->GetPassCount();
+
+		DestroyBuffers(m_unifrom_buffers, m_samplers);
+
+		m_unifrom_buffers.Resize(m_layout_pass_count);
+		for (int i = 0; i < m_unifrom_buffers.Size(); ++i)
+		{
+			m_unifrom_buffers[i].Resize((int) Shader::BindingPoint::Count);
+		}
+
+		m_samplers.Resize(m_layout_pass_count);
+
+		// write all properties into new buffers
+		for (auto& i : m_properties)
+		{
+			i.dirty = true;
+		}
+		++m_version;
+	}
+    
+	const Ref<Shader>& Material::GetVariant(Ref<Shader>& variant, Shader::KeywordMask keywords, bool light_add)
+	{
+		if (!variant)
+		{
+			variant = m_shader->GetVariant(m_shader->GetKeywordMask() | keywords, light_add);
+		}
+
+		return variant;
+	}
+
+	const Ref<Shader>& Material::GetLightAddShader()
+	{
+		static const Shader::KeywordMask keywords = Shader::GetKeywordMask("LIGHT_ADD_ON");
+		return this->GetVariant(m_light_add_shader, keywords, true);
+	}
+
+	const Ref<Shader>& Material::GetInstancingShader()
+	{
+		static const Shader::KeywordMask keywords = Shader::GetKeywordMask("INSTANCING_ON");
+		return this->GetVariant(m_instancing_shader, keywords, false);
+	}
+
+	const Ref<Shader>& Material::GetLightAddInstancingShader()
+	{
+		static const Shader::KeywordMask keywords = Shader::GetKeywordMask("LIGHT_ADD_ON") | Shader::GetKeywordMask("INSTANCING_ON");
+		return this->GetVariant(m_light_add_instancing_shader, keywords, true);
+	}
+
+	const Ref<Shader>& Material::GetClusteredShader()
+	{
+		static const Shader::KeywordMask keywords = Shader::GetKeywordMask("LIGHTS_CLUSTERED");
+		return this->GetVariant(m_clustered_shader, keywords, false);
+	}
+
+	const Ref<Shader>& Material::GetClusteredInstancingShader()
+	{
+		static const Shader::KeywordMask keywords = Shader::GetKeywordMask("LIGHTS_CLUSTERED") | Shader::GetKeywordMask("INSTANCING_ON");
+		return this->GetVariant(m_clustered_instancing_shader, keywords, false);
 	}
 
     int Material::GetQueue() const
@@ -98,113 +157,125 @@ namespace Viry3D
         m_queue = RefMake<int>(queue);
     }
     
-    const Matrix4x4* Material::GetMatrix(const String& name) const
+    const Matrix4x4* Material::GetMatrix(int id) const
     {
-        return this->GetProperty<Matrix4x4>(name, MaterialProperty::Type::Matrix);
+        return this->GetProperty<Matrix4x4>(id, MaterialProperty::Type::Matrix);
     }
     
-    void Material::SetMatrix(const String& name, const Matrix4x4& value)
+    void Material::SetMatrix(int id, const Matrix4x4& value)
     {
-        this->SetProperty(name, value, MaterialProperty::Type::Matrix);
+        this->SetProperty(id, value, MaterialProperty::Type::Matrix);
     }
     
-    const Vector4* Material::GetVector(const String& name) const
+    const Vector4* Material::GetVector(int id) const
     {
-        return this->GetProperty<Vector4>(name, MaterialProperty::Type::Vector);
+        return this->GetProperty<Vector4>(id, MaterialProperty::Type::Vector);
     }
     
-    void Material::SetVector(const String& name, const Vector4& value)
+    void Material::SetVector(int id, const Vector4& value)
     {
-        this->SetProperty(name, value, MaterialProperty::Type::Vector);
+        this->SetProperty(id, value, MaterialProperty::Type::Vector);
     }
     
-    void Material::SetColor(const String& name, const Color& value)
+    void Material::SetColor(int id, const Color& value)
     {
-        this->SetProperty(name, value, MaterialProperty::Type::Color);
+        this->SetProperty(id, value, MaterialProperty::Type::Color);
     }
     
-    void Material::SetFloat(const String& name, float value)
+    void Material::SetFloat(int id, float value)
     {
-        this->SetProperty(name, value, MaterialProperty::Type::Float);
+        this->SetProperty(id, value, MaterialProperty::Type::Float);
     }
     
-    void Material::SetInt(const String& name, int value)
+    void Material::SetInt(int id, int value)
     {
-        this->SetProperty(name, value, MaterialProperty::Type::Int);
+        this->SetProperty(id, value, MaterialProperty::Type::Int);
     }
     
-    Ref<Texture> Material::GetTexture(const String& name) const
+    Ref<Texture> Material::GetTexture(int id) const
     {
         Ref<Texture> texture;
-        const MaterialProperty* property_ptr;
-        if (m_properties.TryGet(name, &property_ptr))
+        const MaterialProperty* property_ptr = this->FindProperty(id);
+        if (property_ptr && property_ptr->type == MaterialProperty::Type::Texture)
         {
-            if (property_ptr->type == MaterialProperty::Type::Texture)
-            {
-                texture = property_ptr->texture;
-            }
+            texture = property_ptr->texture;
         }
         return texture;
     }
     
-    void Material::SetTexture(const String& name, const Ref<Texture>& texture)
+    void Material::SetTexture(int id, const Ref<Texture>& texture)
     {
-        MaterialProperty* property_ptr;
-        if (m_properties.TryGet(name, &property_ptr))
-        {
-            property_ptr->type = MaterialProperty::Type::Texture;
-            property_ptr->texture = texture;
-            property_ptr->dirty = true;
-        }
-        else
+        MaterialProperty* property_ptr = MaterialProperty::GetOrAdd(m_properties, id);
+        property_ptr->type = MaterialProperty::Type::Texture;
+        property_ptr->texture = texture;
+        property_ptr->dirty = true;
+    }
+    
+    void Material::SetVectorArray(int id, const Vector<Vector4>& array)
+    {
+        MaterialProperty* property_ptr = MaterialProperty::GetOrAdd(m_properties, id);
+        property_ptr->type = MaterialProperty::Type::VectorArray;
+        property_ptr->vector_array = array;
+        property_ptr->dirty = true;
+    }
+    
+    void Material::SetMatrixArray(int id, const Vector<Matrix4x4>& array)
+    {
+        MaterialProperty* property_ptr = MaterialProperty::GetOrAdd(m_properties, id);
+        property_ptr->type = MaterialProperty::Type::MatrixArray;
+        property_ptr->matrix_array = array;
+        property_ptr->dirty = true;
+    }
+
+    int MaterialProperty::LowerBound(const Vector<MaterialProperty>& properties, int id)
+    {
+        int begin = 0;
+        int end = properties.Size();
+        while (begin < end)
         {
-            MaterialProperty property;
-            property.name = name;
-            property.type = MaterialProperty::Type::Texture;
-            property.texture = texture;
-            property.dirty = true;
-            m_properties.Add(name, property);
+            int mid = (begin + end) / 2;
+            if (properties[mid].id < id)
+            {
+                begin = mid + 1;
+            }
+            else
+            {
+                end = mid;
+            }
         }
+        return begin;
     }
-    
-    void Material::SetVectorArray(const String& name, const Vector<Vector4>& array)
+
+    MaterialProperty* MaterialProperty::GetOrAdd(Vector<MaterialProperty>& properties, int id)
     {
-        MaterialProperty* property_ptr;
-        if (m_properties.TryGet(name, &property_ptr))
+        int index = MaterialProperty::LowerBound(properties, id);
+        if (index < properties.Size() && properties[index].id == id)
         {
-            property_ptr->type = MaterialProperty::Type::VectorArray;
-            property_ptr->vector_array = array;
-            property_ptr->dirty = true;
+            return &properties[index];
         }
-        else
+
+        // properties are set up front, insert shifts a short array
+        properties.Add(MaterialProperty());
+        for (int i = properties.Size() - 1; i > index; --i)
         {
-            MaterialProperty property;
-            property.name = name;
-            property.type = MaterialProperty::Type::VectorArray;
-            property.vector_array = array;
-            property.dirty = true;
-            m_properties.Add(name, property);
+            properties[i] = std::move(properties[i - 1]);
         }
+
+        auto& property = properties[index];
+        property = MaterialProperty();
+        property.id = id;
+        property.dirty = false;
+        return &property;
     }
-    
-    void Material::SetMatrixArray(const String& name, const Vector<Matrix4x4>& array)
+
+    const MaterialProperty* Material::FindProperty(int id) const
     {
-        MaterialProperty* property_ptr;
-        if (m_properties.TryGet(name, &property_ptr))
-        {
-            property_ptr->type = MaterialProperty::Type::MatrixArray;
-            property_ptr->matrix_array = array;
-            property_ptr->dirty = true;
-        }
-        else
+        int index = MaterialProperty::LowerBound(m_properties, id);
+        if (index < m_properties.Size() && m_properties[index].id == id)
         {
-            MaterialProperty property;
-            property.name = name;
-            property.type = MaterialProperty::Type::MatrixArray;
-            property.matrix_array = array;
-            property.dirty = true;
-            m_properties.Add(name, property);
+            return &m_properties[index];
         }
+        return nullptr;
     }
     
     void Material::SetScissorRect(const Rect& rect)
@@ -214,55 +285,67 @@ namespace Viry3D
     
 	void Material::EnableKeyword(const String& keyword)
 	{
-		auto& keywords = m_shader->GetKeywords();
-		if (!keywords.Contains(keyword))
-		{
-			Vector<String> new_keywords;
-			for (auto& i : keywords)
-			{
-				new_keywords.Add(i);
-			}
-			new_keywords.Add(keyword);
-			m_shader = Shader::Find(m_shader->GetName(), new_keywords);
-		}
+		this->EnableKeywords(Shader::GetKeywordMask(keyword));
 	}
 
 	void Material::DisableKeyword(const String& keyword)
 	{
-		auto& keywords = m_shader->GetKeywords();
-		if (keywords.Contains(keyword))
+		this->DisableKeywords(Shader::GetKeywordMask(keyword));
+	}
+
+	void Material::EnableKeywords(Shader::KeywordMask keywords)
+	{
+		this->SetKeywords(m_shader->GetKeywordMask() | keywords);
+	}
+
+	void Material::DisableKeywords(Shader::KeywordMask keywords)
+	{
+		this->SetKeywords(m_shader->GetKeywordMask() & ~keywords);
+	}
+
+	void Material::SetKeywords(Shader::KeywordMask keywords)
+	{
+		if (keywords == m_shader->GetKeywordMask())
 		{
-			Vector<String> new_keywords;
-			for (auto& i : keywords)
-			{
-				new_keywords.Add(i);
-			}
-			new_keywords.Remove(keyword);
-			m_shader = Shader::Find(m_shader->GetName(), new_keywords);
+			return;
 		}
+
+		// pending variant draws by pending mode, buffers follow it in next Prepare
+		m_shader = m_shader->GetVariant(keywords);
+		++m_version;
+
+		// variants follow the new keywords
+		m_light_add_shader.reset();
+		m_instancing_shader.reset();
+		m_light_add_instancing_shader.reset();
+		m_clustered_shader.reset();
+		m_clustered_instancing_shader.reset();
 	}
 
     void Material::Prepare(int pass)
     {
+        this->UpdateLayout();
+
         for (auto& i : m_properties)
         {
-            if (i.second.dirty)
+            if (i.dirty)
             {
-                i.second.dirty = false;
+                i.dirty = false;
+                ++m_version;
                 
-                switch (i.second.type)
+                switch (i.type)
                 {
                     case MaterialProperty::Type::Texture:
-                        this->UpdateUniformTexture(i.first, i.second.texture);
+                        this->UpdateUniformTexture(i.id, i.texture);
                         break;
                     case MaterialProperty::Type::VectorArray:
-                        this->UpdateUniformMember(i.first, i.second.vector_array.Bytes(), i.second.vector_array.SizeInBytes());
+                        this->UpdateUniformMember(i.id, i.vector_array.Bytes(), i.vector_array.SizeInBytes());
                         break;
                     case MaterialProperty::Type::MatrixArray:
-                        this->UpdateUniformMember(i.first, i.second.matrix_array.Bytes(), i.second.matrix_array.SizeInBytes());
+                        this->UpdateUniformMember(i.id, i.matrix_array.Bytes(), i.matrix_array.SizeInBytes());
                         break;
                     default:
-                        this->UpdateUniformMember(i.first, &i.second.data, i.second.size);
+                        this->UpdateUniformMember(i.id, &i.data, i.size);
                         break;
                 }
             }
@@ -318,90 +401,62 @@ namespace Viry3D
         }
     }
     
-    void Material::UpdateUniformMember(const String& name, const void* data, int size)
+    void Material::UpdateUniformMember(int id, const void* data, int size)
     {
         auto& driver = Engine::Instance()->GetDriverApi();
         
         for (int i = 0; i < m_shader->GetPassCount(); ++i)
         {
             const auto& pass = m_shader->GetPass(i);
+            const auto* layout = pass.GetUniformProperty(id);
+            if (layout == nullptr)
+            {
+                continue;
+            }
+            
+            const auto& uniform = pass.uniforms[layout->block];
+            auto& unifrom_buffer = m_unifrom_buffers[i][uniform.binding];
             
-            for (int j = 0; j < pass.uniforms.Size(); ++j)
+            if (!unifrom_buffer.uniform_buffer)
             {
-                const auto& uniform = pass.uniforms[j];
-				bool find = false;
-                
-                for (int k = 0; k < uniform.members.Size(); ++k)
-                {
-                    const auto& member = uniform.members[k];
-                    
-                    if (name == member.name)
-                    {
-                        auto& unifrom_buffer = m_unifrom_buffers[i][uniform.binding];
-                        
-                        if (!unifrom_buffer.uniform_buffer)
-                        {
-                            unifrom_buffer.uniform_buffer = driver.createUniformBuffer(uniform.size, filament::backend::BufferUsage::DYNAMIC);
-                            unifrom_buffer.buffer = ByteBuffer(uniform.size);
-                        }
-                        
-                        assert(size <= member.size);
-                        
-                        Memory::Copy(&unifrom_buffer.buffer[member.offset], data, size);
-                        
-                        unifrom_buffer.dirty = true;
-
-						find = true;
-						break;
-                    }
-                }
-
-				if (find)
-				{
-					break;
-				}
+                unifrom_buffer.uniform_buffer = driver.createUniformBuffer(uniform.size, filament::backend::BufferUsage::DYNAMIC);
+                unifrom_buffer.buffer = ByteBuffer(uniform.size);
             }
+            
+            assert(size <= layout->size);
+            
+            Memory::Copy(&unifrom_buffer.buffer[layout->offset], data, size);
+            
+            unifrom_buffer.dirty = true;
         }
     }
     
-    void Material::UpdateUniformTexture(const String& name, const Ref<Texture>& texture)
+    void Material::UpdateUniformTexture(int id, const Ref<Texture>& texture)
     {
         auto& driver = Engine::Instance()->GetDriverApi();
         
         for (int i = 0; i < m_shader->GetPassCount(); ++i)
         {
             const auto& pass = m_shader->GetPass(i);
+            const auto* layout = pass.GetTextureProperty(id);
+            if (layout == nullptr)
+            {
+                continue;
+            }
             
-            for (int j = 0; j < pass.samplers.Size(); ++j)
+            const auto& group = pass.samplers[layout->block];
+            auto& sampler_group = m_samplers[i];
+            
+            if (!sampler_group.sampler_group)
             {
-                const auto& group = pass.samplers[j];
-                
-				if (group.binding == (int) Shader::BindingPoint::PerMaterialFragment)
-				{
-					for (int k = 0; k < group.samplers.Size(); ++k)
-					{
-						const auto& sampler = group.samplers[k];
-
-						if (name == sampler.name)
-						{
-							auto& sampler_group = m_samplers[i];
-
-							if (!sampler_group.sampler_group)
-							{
-								sampler_group.sampler_group = driver.createSamplerGroup(group.samplers.Size());
-								sampler_group.samplers.Resize(group.samplers.Size());
-							}
-
-							sampler_group.samplers[k].binding = sampler.binding;
-							sampler_group.samplers[k].texture = texture;
-
-							sampler_group.dirty = true;
-						}
-					}
-
-					break;
-				}
+                sampler_group.sampler_group = driver.createSamplerGroup(group.samplers.Size());
+                sampler_group.samplers.Resize(group.samplers.Size());
             }
+            
+            sampler_group.samplers[layout->offset].binding = group.samplers[layout->offset].binding;
+            sampler_group.samplers[layout->offset].texture = texture;
+            
+            sampler_group.dirty = true;
         }
     }
     
@@ -421,6 +476,12 @@ namespace Viry3D
 	{
 		auto& driver = Engine::Instance()->GetDriverApi();
 
+		// shader changed since last Prepare
+		if (pass >= m_unifrom_buffers.Size())
+		{
+			return;
+		}
+
 		const auto& unifrom_buffers = m_unifrom_buffers[pass];
 		const auto& samplers = m_samplers[pass];
 
@@ -439,4 +500,221 @@ namespace Viry3D
 			driver.bindSamplers((size_t) Shader::BindingPoint::PerMaterialFragment, samplers.sampler_group);
 		}
 	}
+
+	static void GetPropertyData(const MaterialProperty& property, const void*& data, int& size)
+	{
+		switch (property.type)
+		{
+			case MaterialProperty::Type::VectorArray:
+				data = property.vector_array.Bytes();
+				size = property.vector_array.SizeInBytes();
+				break;
+			case MaterialProperty::Type::MatrixArray:
+				data = property.matrix_array.Bytes();
+				size = property.matrix_array.SizeInBytes();
+				break;
+			default:
+				data = &property.data;
+				size = property.size;
+				break;
+		}
+	}
+
+	void Material::PrepareOverride(const MaterialPropertyBlock& block, MaterialOverride& override_data)
+	{
+		// override reads material buffers by pass
+		this->UpdateLayout();
+
+		if (override_data.material_id == this->GetId() &&
+			override_data.block_id == block.GetId() &&
+			override_data.material_version == m_version &&
+			override_data.block_version == block.GetVersion())
+		{
+			return;
+		}
+
+		auto& driver = Engine::Instance()->GetDriverApi();
+		int pass_count = m_shader->GetPassCount();
+
+		if (override_data.material_id != this->GetId() || override_data.unifrom_buffers.Size() != pass_count)
+		{
+			Material::ReleaseOverride(override_data);
+			override_data.unifrom_buffers.Resize(pass_count);
+			for (int i = 0; i < pass_count; ++i)
+			{
+				override_data.unifrom_buffers[i].Resize((int) Shader::BindingPoint::Count);
+			}
+			override_data.samplers.Resize(pass_count);
+		}
+
+		override_data.material_id = this->GetId();
+		override_data.block_id = block.GetId();
+		override_data.material_version = m_version;
+		override_data.block_version = block.GetVersion();
+
+		const auto& properties = block.GetProperties();
+
+		for (int i = 0; i < pass_count; ++i)
+		{
+			const auto& pass = m_shader->GetPass(i);
+			auto& unifrom_buffers = override_data.unifrom_buffers[i];
+			auto& sampler_group = override_data.samplers[i];
+
+			for (int j = 0; j < unifrom_buffers.Size(); ++j)
+			{
+				unifrom_buffers[j].dirty = false;
+			}
+			sampler_group.dirty = false;
+
+			for (const auto& property : properties)
+			{
+				if (property.type == MaterialProperty::Type::Texture)
+				{
+					const auto* layout = pass.GetTextureProperty(property.id);
+					if (layout == nullptr || !property.texture)
+					{
+						continue;
+					}
+
+					// start from textures of material
+					if (!sampler_group.dirty)
+					{
+						const auto& group = pass.samplers[layout->block];
+						if (!sampler_group.sampler_group)
+						{
+							sampler_group.sampler_group = driver.createSamplerGroup(group.samplers.Size());
+						}
+						sampler_group.samplers.Resize(group.samplers.Size());
+						for (int k = 0; k < group.samplers.Size(); ++k)
+						{
+							sampler_group.samplers[k].binding = group.samplers[k].binding;
+							sampler_group.samplers[k].texture = k < m_samplers[i].samplers.Size() ? m_samplers[i].samplers[k].texture : Ref<Texture>();
+							if (!sampler_group.samplers[k].texture)
+							{
+								sampler_group.samplers[k].texture = Texture::GetSharedWhiteTexture();
+							}
+						}
+						sampler_group.dirty = true;
+					}
+
+					sampler_group.samplers[layout->offset].texture = property.texture;
+				}
+				else
+				{
+					const auto* layout = pass.GetUniformProperty(property.id);
+					if (layout == nullptr)
+					{
+						continue;
+					}
+
+					const auto& uniform = pass.uniforms[layout->block];
+					auto& unifrom_buffer = unifrom_buffers[uniform.binding];
+
+					// start from values of material
+					if (!unifrom_buffer.dirty)
+					{
+						if (!unifrom_buffer.uniform_buffer)
+						{
+							unifrom_buffer.uniform_buffer = driver.createUniformBuffer(uniform.size, filament::backend::BufferUsage::DYNAMIC);
+						}
+
+						// byte buffer copies share memory, so copy bytes into own buffer
+						if (unifrom_buffer.buffer.Size() != uniform.size)
+						{
+							unifrom_buffer.buffer = ByteBuffer(uniform.size);
+						}
+
+						const auto& source = m_unifrom_buffers[i][uniform.binding];
+						if (source.buffer.Size() == uniform.size)
+						{
+							Memory::Copy(unifrom_buffer.buffer.Bytes(), source.buffer.Bytes(), uniform.size);
+						}
+						else
+						{
+							Memory::Zero(unifrom_buffer.buffer.Bytes(), uniform.size);
+						}
+						unifrom_buffer.dirty = true;
+					}
+
+					const void* data;
+					int size;
+					GetPropertyData(property, data, size);
+					assert(size <= layout->size);
+
+					Memory::Copy(&unifrom_buffer.buffer[layout->offset], data, size);
+				}
+			}
+
+			// upload overridden blocks, drop blocks no longer overridden
+			for (int j = 0; j < unifrom_buffers.Size(); ++j)
+			{
+				auto& unifrom_buffer = unifrom_buffers[j];
+
+				if (unifrom_buffer.dirty)
+				{
+					unifrom_buffer.dirty = false;
+
+					void* buffer = Memory::Alloc<void>(unifrom_buffer.buffer.Size());
+					Memory::Copy(buffer, unifrom_buffer.buffer.Bytes(), unifrom_buffer.buffer.Size());
+					driver.loadUniformBuffer(unifrom_buffer.uniform_buffer, filament::backend::BufferDescriptor(buffer, unifrom_buffer.buffer.Size(), FreeBufferCallback));
+				}
+				else if (unifrom_buffer.uniform_buffer)
+				{
+					driver.destroyUniformBuffer(unifrom_buffer.uniform_buffer);
+					unifrom_buffer.uniform_buffer.clear();
+				}
+			}
+
+			if (sampler_group.dirty)
+			{
+				sampler_group.dirty = false;
+
+				filament::backend::SamplerGroup samplers(sampler_group.samplers.Size());
+				for (int j = 0; j < sampler_group.samplers.Size(); ++j)
+				{
+					const auto& sampler = sampler_group.samplers[j];
+					samplers.setSampler(j, sampler.texture->GetTexture(), sampler.texture->GetSampler());
+				}
+				driver.updateSamplerGroup(sampler_group.sampler_group, std::move(samplers));
+			}
+			else if (sampler_group.sampler_group)
+			{
+				driver.destroySamplerGroup(sampler_group.sampler_group);
+				sampler_group.sampler_group.clear();
+			}
+		}
+	}
+
+	void Material::BindOverride(const MaterialOverride& override_data, int pass)
+	{
+		if (pass >= override_data.unifrom_buffers.Size())
+		{
+			return;
+		}
+
+		auto& driver = Engine::Instance()->GetDriverApi();
+
+		const auto& unifrom_buffers = override_data.unifrom_buffers[pass];
+		const auto& samplers = override_data.samplers[pass];
+
+		for (int i = 0; i < unifrom_buffers.Size(); ++i)
+		{
+			if (unifrom_buffers[i].uniform_buffer)
+			{
+				driver.bindUniformBuffer((size_t) i, unifrom_buffers[i].uniform_buffer);
+			}
+		}
+
+		if (samplers.sampler_group)
+		{
+			driver.bindSamplers((size_t) Shader::BindingPoint::PerMaterialFragment, samplers.sampler_group);
+		}
+	}
+
+	void Material::ReleaseOverride(MaterialOverride& override_data)
+	{
+		DestroyBuffers(override_data.unifrom_buffers, override_data.samplers);
+		override_data.material_id = 0;
+		override_data.block_id = 0;
+	}
 }
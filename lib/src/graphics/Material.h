@@ -32,6 +32,8 @@
 namespace Viry3D
 {
     class Camera;
+    class Material;
+    class MaterialPropertyBlock;
     
 	// per view uniforms, set by camera
 	struct ViewUniforms
@@ -59,6 +61,15 @@ namespace Viry3D
 		Vector4 lightmap_index; // in x
 	};
 
+	// per renderer uniforms of instanced draw, set by camera
+	struct InstancedRendererUniforms
+	{
+		static constexpr const char* MODEL_MATRICES = "u_model_matrices";
+		static constexpr const int INSTANCE_MAX_COUNT = 128;
+
+		Matrix4x4 model_matrices[INSTANCE_MAX_COUNT];
+	};
+
 	// per renderer bones uniforms, set by skinned mesh renderer
 	struct SkinnedMeshRendererUniforms
 	{
@@ -77,6 +88,9 @@ namespace Viry3D
 		static constexpr const char* LIGHT_ATTEN = "u_light_atten";
 		static constexpr const char* SPOT_LIGHT_DIR = "u_spot_light_dir";
 		static constexpr const char* SHADOW_PARAMS = "u_shadow_params";
+		static constexpr const char* CASCADE_PARAMS = "u_cascade_params";
+		static constexpr const char* CASCADE_MATRICES = "u_cascade_matrices";
+		static constexpr const int CASCADE_MAX_COUNT = 4;
 
 		Color ambient_color;
 		Vector4 light_pos;
@@ -84,6 +98,37 @@ namespace Viry3D
 		Vector4 light_atten;
 		Vector4 spot_light_dir;
 		Vector4 shadow_params; // strength, z_bias, slope_bias, filter_radius
+		Vector4 cascade_params; // cascade count, tile scale in shadow texture
+		Matrix4x4 cascade_matrices[CASCADE_MAX_COUNT]; // world to uv and depth in shadow texture
+	};
+
+	// all lights of clustered forward pass, set by camera
+	struct ClusteredLightUniforms
+	{
+		static constexpr const char* AMBIENT_COLOR = "u_ambient_color";
+		static constexpr const char* CLUSTER_SIZE = "u_cluster_size";
+		static constexpr const char* CLUSTER_EXTENT = "u_cluster_extent";
+		static constexpr const char* CLUSTER_PARAMS = "u_cluster_params";
+		static constexpr const char* CLUSTER_VIEW = "u_cluster_view";
+		static constexpr const char* LIGHTS = "u_lights";
+		// fill 16k uniform buffer
+		static constexpr const int LIGHT_MAX_COUNT = 254;
+
+		// same layout as LightFragmentUniforms
+		struct Light
+		{
+			Vector4 light_pos;
+			Color light_color; // light type in a
+			Vector4 light_atten;
+			Vector4 spot_light_dir;
+		};
+
+		Color ambient_color;
+		Vector4 cluster_size; // x, y, z cluster count, directional light count in w
+		Vector4 cluster_extent; // view half size at depth 1 or orthographic half size, 1 for perspective in z
+		Vector4 cluster_params; // slice scale, slice bias, index texture width
+		Vector4 cluster_view[3]; // first 3 rows of view matrix
+		Light lights[LIGHT_MAX_COUNT]; // directional lights first
 	};
 
 	// per material uniforms, set by material
@@ -115,7 +160,7 @@ namespace Viry3D
             int int_value;
         };
         
-        String name;
+        int id;
         Type type;
         Data data;
         Ref<Texture> texture;
@@ -123,6 +168,10 @@ namespace Viry3D
         Vector<Matrix4x4> matrix_array;
         int size = 0;
         bool dirty;
+
+        // in arrays sorted by id, index of first property with id not less than given
+        static int LowerBound(const Vector<MaterialProperty>& properties, int id);
+        static MaterialProperty* GetOrAdd(Vector<MaterialProperty>& properties, int id);
     };
     
     struct UniformBuffer
@@ -145,6 +194,19 @@ namespace Viry3D
         bool dirty = false;
     };
     
+    // per renderer copy of the material uniform blocks and sampler group a property block overrides
+    struct MaterialOverride
+    {
+        // ids not addresses, a new material or block may reuse a freed address
+        int material_id = 0;
+        uint32_t block_id = 0;
+        uint32_t material_version = 0;
+        uint32_t block_version = 0;
+        // per pass, only overridden bindings have buffer
+        Vector<Vector<UniformBuffer>> unifrom_buffers;
+        Vector<SamplerGroup> samplers;
+    };
+    
     class Material : public Object
     {
     public:
@@ -152,73 +214,97 @@ namespace Viry3D
         virtual ~Material();
         const Ref<Shader>& GetShader() const { return m_shader; }
 		const Ref<Shader>& GetLightAddShader();
+		const Ref<Shader>& GetInstancingShader();
+		const Ref<Shader>& GetLightAddInstancingShader();
+		const Ref<Shader>& GetClusteredShader();
+		const Ref<Shader>& GetClusteredInstancingShader();
         int GetQueue() const;
         void SetQueue(int queue);
-        const Matrix4x4* GetMatrix(const String& name) const;
-        void SetMatrix(const String& name, const Matrix4x4& value);
-        const Vector4* GetVector(const String& name) const;
-        void SetVector(const String& name, const Vector4& value);
-        void SetColor(const String& name, const Color& value);
-        void SetFloat(const String& name, float value);
-        void SetInt(const String& name, int value);
-        Ref<Texture> GetTexture(const String& name) const;
-        void SetTexture(const String& name, const Ref<Texture>& texture);
-        void SetVectorArray(const String& name, const Vector<Vector4>& array);
-        void SetMatrixArray(const String& name, const Vector<Matrix4x4>& array);
+        const Matrix4x4* GetMatrix(const String& name) const { return this->GetMatrix(Shader::GetPropertyId(name)); }
+        void SetMatrix(const String& name, const Matrix4x4& value) { this->SetMatrix(Shader::GetPropertyId(name), value); }
+        const Vector4* GetVector(const String& name) const { return this->GetVector(Shader::GetPropertyId(name)); }
+        void SetVector(const String& name, const Vector4& value) { this->SetVector(Shader::GetPropertyId(name), value); }
+        void SetColor(const String& name, const Color& value) { this->SetColor(Shader::GetPropertyId(name), value); }
+        void SetFloat(const String& name, float value) { this->SetFloat(Shader::GetPropertyId(name), value); }
+        void SetInt(const String& name, int value) { this->SetInt(Shader::GetPropertyId(name), value); }
+        Ref<Texture> GetTexture(const String& name) const { return this->GetTexture(Shader::GetPropertyId(name)); }
+        void SetTexture(const String& name, const Ref<Texture>& texture) { this->SetTexture(Shader::GetPropertyId(name), texture); }
+        void SetVectorArray(const String& name, const Vector<Vector4>& array) { this->SetVectorArray(Shader::GetPropertyId(name), array); }
+        void SetMatrixArray(const String& name, const Vector<Matrix4x4>& array) { this->SetMatrixArray(Shader::GetPropertyId(name), array); }
+        // ids from Shader::GetPropertyId, no string work
+        const Matrix4x4* GetMatrix(int id) const;
+        void SetMatrix(int id, const Matrix4x4& value);
+        const Vector4* GetVector(int id) const;
+        void SetVector(int id, const Vector4& value);
+        void SetColor(int id, const Color& value);
+        void SetFloat(int id, float value);
+        void SetInt(int id, int value);
+        Ref<Texture> GetTexture(int id) const;
+        void SetTexture(int id, const Ref<Texture>& texture);
+        void SetVectorArray(int id, const Vector<Vector4>& array);
+        void SetMatrixArray(int id, const Vector<Matrix4x4>& array);
         const Rect& GetScissorRect() const { return m_scissor_rect; }
         void SetScissorRect(const Rect& rect);
 		void EnableKeyword(const String& keyword);
 		void DisableKeyword(const String& keyword);
+		// masks from Shader::GetKeywordMask, cheap enough for every draw, nothing changes if keywords are same
+		void EnableKeywords(Shader::KeywordMask keywords);
+		void DisableKeywords(Shader::KeywordMask keywords);
         void Prepare(int pass = -1);
         void SetScissor(int target_width, int target_height);
 		void Bind(int pass);
+		// copy blocks holding properties of block and apply them, only when material or block changed
+		void PrepareOverride(const MaterialPropertyBlock& block, MaterialOverride& override_data);
+		// bind after Bind of the material to replace its overridden blocks
+		static void BindOverride(const MaterialOverride& override_data, int pass);
+		static void ReleaseOverride(MaterialOverride& override_data);
         
     private:
         template <class T>
-        const T* GetProperty(const String& name, MaterialProperty::Type type) const
+        const T* GetProperty(int id, MaterialProperty::Type type) const
         {
-            const MaterialProperty* property_ptr;
-            if (m_properties.TryGet(name, &property_ptr))
+            const MaterialProperty* property_ptr = this->FindProperty(id);
+            if (property_ptr && property_ptr->type == type)
             {
-                if (property_ptr->type == type)
-                {
-                    return (const T*) &property_ptr->data;
-                }
+                return (const T*) &property_ptr->data;
             }
             
             return nullptr;
         }
         template <class T>
-        void SetProperty(const String& name, const T& v, MaterialProperty::Type type)
+        void SetProperty(int id, const T& v, MaterialProperty::Type type)
         {
-            MaterialProperty* property_ptr;
-            if (m_properties.TryGet(name, &property_ptr))
-            {
-                property_ptr->type = type;
-                Memory::Copy(&property_ptr->data, &v, sizeof(v));
-                property_ptr->dirty = true;
-            }
-            else
-            {
-                MaterialProperty property;
-                property.name = name;
-                property.type = type;
-                Memory::Copy(&property.data, &v, sizeof(v));
-                property.size = sizeof(v);
-                property.dirty = true;
-                m_properties.Add(name, property);
-            }
+            MaterialProperty* property_ptr = MaterialProperty::GetOrAdd(m_properties, id);
+            property_ptr->type = type;
+            Memory::Copy(&property_ptr->data, &v, sizeof(v));
+            property_ptr->size = sizeof(v);
+            property_ptr->dirty = true;
         }
-        void UpdateUniformMember(const String& name, const void* data, int size);
-        void UpdateUniformTexture(const String& name, const Ref<Texture>& texture);
+        const MaterialProperty* FindProperty(int id) const;
+        void UpdateUniformMember(int id, const void* data, int size);
+        void UpdateUniformTexture(int id, const Ref<Texture>& texture);
+		const Ref<Shader>& GetVariant(Ref<Shader>& variant, Shader::KeywordMask keywords, bool light_add);
+		void SetKeywords(Shader::KeywordMask keywords);
+		void UpdateLayout();
         
     private:
         Ref<Shader> m_shader;
 		Ref<Shader> m_light_add_shader;
+		Ref<Shader> m_instancing_shader;
+		Ref<Shader> m_light_add_instancing_shader;
+		Ref<Shader> m_clustered_shader;
+		Ref<Shader> m_clustered_instancing_shader;
         Ref<int> m_queue;
-        Map<String, MaterialProperty> m_properties;
+        // sorted by id
+        Vector<MaterialProperty> m_properties;
         Rect m_scissor_rect;
         Vector<Vector<UniformBuffer>> m_unifrom_buffers;
         Vector<SamplerGroup> m_samplers;
+        // changes when uniform data or shader changes
+        uint32_t m_version;
+        // shader state buffers are laid out for
+        const Shader* m_layout_shader;
+        bool m_layout_ready;
+        int m_layout_pass_count;
     };
 }
@@ -0,0 +1,88 @@
+/*
+* Viry3D
+* Copyright 2014-2019 by Stack - stackos@qq.com
+*
+* Licensed under the Apache License, Version 2.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at
+*
+*     http://www.apache.org/licenses/LICENSE-2.0
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+*/
+
+#include "MaterialPropertyBlock.h"
+#include <atomic>
+
+namespace Viry3D
+{
+	MaterialPropertyBlock::MaterialPropertyBlock()
+	{
+		static std::atomic<uint32_t> s_id(0);
+		m_id = ++s_id;
+	}
+
+	const Matrix4x4* MaterialPropertyBlock::GetMatrix(int id) const
+	{
+		return this->GetProperty<Matrix4x4>(id, MaterialProperty::Type::Matrix);
+	}
+
+	void MaterialPropertyBlock::SetMatrix(int id, const Matrix4x4& value)
+	{
+		this->SetProperty(id, value, MaterialProperty::Type::Matrix);
+	}
+
+	const Vector4* MaterialPropertyBlock::GetVector(int id) const
+	{
+		return this->GetProperty<Vector4>(id, MaterialProperty::Type::Vector);
+	}
+
+	void MaterialPropertyBlock::SetVector(int id, const Vector4& value)
+	{
+		this->SetProperty(id, value, MaterialProperty::Type::Vector);
+	}
+
+	void MaterialPropertyBlock::SetColor(int id, const Color& value)
+	{
+		this->SetProperty(id, value, MaterialProperty::Type::Color);
+	}
+
+	void MaterialPropertyBlock::SetFloat(int id, float value)
+	{
+		this->SetProperty(id, value, MaterialProperty::Type::Float);
+	}
+
+	void MaterialPropertyBlock::SetInt(int id, int value)
+	{
+		this->SetProperty(id, value, MaterialProperty::Type::Int);
+	}
+
+	Ref<Texture> MaterialPropertyBlock::GetTexture(int id) const
+	{
+		Ref<Texture> texture;
+		int index = MaterialProperty::LowerBound(m_properties, id);
+		if (index < m_properties.Size() && m_properties[index].id == id && m_properties[index].type == MaterialProperty::Type::Texture)
+		{
+			texture = m_properties[index].texture;
+		}
+		return texture;
+	}
+
+	void MaterialPropertyBlock::SetTexture(int id, const Ref<Texture>& texture)
+	{
+		MaterialProperty* property_ptr = MaterialProperty::GetOrAdd(m_properties, id);
+		property_ptr->type = MaterialProperty::Type::Texture;
+		property_ptr->texture = texture;
+		++m_version;
+	}
+
+	void MaterialPropertyBlock::Clear()
+	{
+		m_properties.Clear();
+		++m_version;
+	}
+}
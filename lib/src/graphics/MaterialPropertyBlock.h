@@ -0,0 +1,86 @@
+/*
+* Viry3D
+* Copyright 2014-2019 by Stack - stackos@qq.com
+*
+* Licensed under the Apache License, Version 2.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at
+*
+*     http://www.apache.org/licenses/LICENSE-2.0
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+*/
+
+#pragma once
+
+#include "Material.h"
+
+namespace Viry3D
+{
+	// property overrides of one renderer, renderers keep sharing material and pipeline,
+	// overridden values go to per renderer copies of the material uniform blocks and sampler group they live in.
+	// renderers sharing one block can still be merged into instanced draws.
+	class MaterialPropertyBlock
+	{
+	public:
+		MaterialPropertyBlock();
+		// unique in process, never 0, caches key by it since addresses are reused
+		uint32_t GetId() const { return m_id; }
+		const Matrix4x4* GetMatrix(const String& name) const { return this->GetMatrix(Shader::GetPropertyId(name)); }
+		void SetMatrix(const String& name, const Matrix4x4& value) { this->SetMatrix(Shader::GetPropertyId(name), value); }
+		const Vector4* GetVector(const String& name) const { return this->GetVector(Shader::GetPropertyId(name)); }
+		void SetVector(const String& name, const Vector4& value) { this->SetVector(Shader::GetPropertyId(name), value); }
+		void SetColor(const String& name, const Color& value) { this->SetColor(Shader::GetPropertyId(name), value); }
+		void SetFloat(const String& name, float value) { this->SetFloat(Shader::GetPropertyId(name), value); }
+		void SetInt(const String& name, int value) { this->SetInt(Shader::GetPropertyId(name), value); }
+		Ref<Texture> GetTexture(const String& name) const { return this->GetTexture(Shader::GetPropertyId(name)); }
+		void SetTexture(const String& name, const Ref<Texture>& texture) { this->SetTexture(Shader::GetPropertyId(name), texture); }
+		// ids from Shader::GetPropertyId, no string work
+		const Matrix4x4* GetMatrix(int id) const;
+		void SetMatrix(int id, const Matrix4x4& value);
+		const Vector4* GetVector(int id) const;
+		void SetVector(int id, const Vector4& value);
+		void SetColor(int id, const Color& value);
+		void SetFloat(int id, float value);
+		void SetInt(int id, int value);
+		Ref<Texture> GetTexture(int id) const;
+		void SetTexture(int id, const Ref<Texture>& texture);
+		void Clear();
+		bool IsEmpty() const { return m_properties.Empty(); }
+		// sorted by id
+		const Vector<MaterialProperty>& GetProperties() const { return m_properties; }
+		// changes with every set, renderers rebuild their overrides when it changes
+		uint32_t GetVersion() const { return m_version; }
+
+	private:
+		template <class T>
+		const T* GetProperty(int id, MaterialProperty::Type type) const
+		{
+			int index = MaterialProperty::LowerBound(m_properties, id);
+			if (index < m_properties.Size() && m_properties[index].id == id && m_properties[index].type == type)
+			{
+				return (const T*) &m_properties[index].data;
+			}
+
+			return nullptr;
+		}
+		template <class T>
+		void SetProperty(int id, const T& v, MaterialProperty::Type type)
+		{
+			MaterialProperty* property_ptr = MaterialProperty::GetOrAdd(m_properties, id);
+			property_ptr->type = type;
+			Memory::Copy(&property_ptr->data, &v, sizeof(v));
+			property_ptr->size = sizeof(v);
+			++m_version;
+		}
+
+	private:
+		uint32_t m_id;
+		Vector<MaterialProperty> m_properties;
+		uint32_t m_version = 0;
+	};
+}
@@ -215,6 +215,7 @@ namespace Viry3D
         m_buffer_vertex_count(vertices.Size()),
         m_buffer_index_count(indices.Size()),
         m_uint32_index(uint32_index),
+        m_dynamic(dynamic),
 		m_enabled_attributes(0)
     {
         auto& driver = Engine::Instance()->GetDriverApi();
@@ -297,6 +298,48 @@ namespace Viry3D
 		m_primitives.Clear();
     }
 
+    void Mesh::SetBlendShapes(Vector<BlendShape>&& blend_shapes)
+    {
+        m_blend_shapes = std::move(blend_shapes);
+        
+        this->UpdateBounds();
+    }
+    
+    void Mesh::UpdateBounds()
+    {
+        if (m_vertices.Empty())
+        {
+            m_bounds = Bounds();
+            return;
+        }
+        
+        Vector3 min = m_vertices[0].vertex;
+        Vector3 max = m_vertices[0].vertex;
+        for (int i = 1; i < m_vertices.Size(); ++i)
+        {
+            min = Vector3::Min(min, m_vertices[i].vertex);
+            max = Vector3::Max(max, m_vertices[i].vertex);
+        }
+        
+        // include full weight blend shape frames
+        for (int i = 0; i < m_blend_shapes.Size(); ++i)
+        {
+            const auto& frames = m_blend_shapes[i].frames;
+            for (int j = 0; j < frames.Size(); ++j)
+            {
+                const auto& deltas = frames[j].vertices;
+                for (int k = 0; k < deltas.Size() && k < m_vertices.Size(); ++k)
+                {
+                    Vector3 v = m_vertices[k].vertex + deltas[k];
+                    min = Vector3::Min(min, v);
+                    max = Vector3::Max(max, v);
+                }
+            }
+        }
+        
+        m_bounds = Bounds(min, max);
+    }
+
     void Mesh::Update(Vector<Vertex>&& vertices, Vector<unsigned int>&& indices, const Vector<Submesh>& submeshes)
     {
         auto& driver = Engine::Instance()->GetDriverApi();
@@ -313,6 +356,8 @@ namespace Viry3D
             m_submeshes.Add(Submesh({ 0, m_indices.Size() }));
         }
         
+        this->UpdateBounds();
+        
         void* buffer = Memory::Alloc<void>(m_vertices.SizeInBytes());
         Memory::Copy(buffer, m_vertices.Bytes(), m_vertices.SizeInBytes());
         driver.updateVertexBuffer(m_vb, 0, filament::backend::BufferDescriptor(buffer, m_vertices.SizeInBytes(), FreeBufferCallback), 0);
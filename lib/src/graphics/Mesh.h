@@ -22,6 +22,7 @@
 #include "container/Vector.h"
 #include "math/Vector2.h"
 #include "math/Matrix4x4.h"
+#include "math/Bounds.h"
 #include "private/backend/DriverApi.h"
 
 namespace Viry3D
@@ -74,6 +75,8 @@ namespace Viry3D
         const Vector<Submesh>& GetSubmeshes() const { return m_submeshes; }
         const Vector<Matrix4x4>& GetBindposes() const { return m_bindposes; }
         const Vector<BlendShape>& GetBlendShapes() const { return m_blend_shapes; }
+        const Bounds& GetBounds() const { return m_bounds; }
+        bool IsDynamic() const { return m_dynamic; }
 		const filament::backend::AttributeArray& GetAttributes() const { return m_attributes; }
 		uint32_t GetEnabledAttributes() const { return m_enabled_attributes; }
 		const filament::backend::VertexBufferHandle& GetVertexBuffer() const { return m_vb; }
@@ -82,7 +85,8 @@ namespace Viry3D
 
     private:
         void SetBindposes(Vector<Matrix4x4>&& bindposes) { m_bindposes = std::move(bindposes); }
-        void SetBlendShapes(Vector<BlendShape>&& blend_shapes) { m_blend_shapes = std::move(blend_shapes); }
+        void SetBlendShapes(Vector<BlendShape>&& blend_shapes);
+        void UpdateBounds();
         
     private:
 		static Ref<Mesh> m_shared_quad_mesh;
@@ -93,7 +97,9 @@ namespace Viry3D
         Vector<Submesh> m_submeshes;
         Vector<Matrix4x4> m_bindposes;
         Vector<BlendShape> m_blend_shapes;
+        Bounds m_bounds;
         bool m_uint32_index;
+        bool m_dynamic;
 		filament::backend::AttributeArray m_attributes;
 		uint32_t m_enabled_attributes;
         filament::backend::VertexBufferHandle m_vb;
@@ -16,6 +16,7 @@
 */
 
 #include "MeshRenderer.h"
+#include "GameObject.h"
 
 namespace Viry3D
 {
@@ -32,6 +33,12 @@ namespace Viry3D
     void MeshRenderer::SetMesh(const Ref<Mesh>& mesh)
     {
         m_mesh = mesh;
+        
+        if (m_mesh)
+        {
+            m_mesh_bounds = m_mesh->GetBounds();
+        }
+        this->MarkBoundsDirty();
     }
     
     Vector<filament::backend::RenderPrimitiveHandle> MeshRenderer::GetPrimitives()
@@ -45,4 +52,32 @@ namespace Viry3D
         
         return primitives;
     }
+    
+    const Bounds* MeshRenderer::GetBounds()
+    {
+        // dynamic mesh may change its bounds by Mesh::Update
+        if (m_mesh && m_mesh->GetBounds() != m_mesh_bounds)
+        {
+            m_mesh_bounds = m_mesh->GetBounds();
+            this->MarkBoundsDirty();
+        }
+        
+        return Renderer::GetBounds();
+    }
+    
+    bool MeshRenderer::IsBoundsVolatile() const
+    {
+        return m_mesh && m_mesh->IsDynamic();
+    }
+
+    bool MeshRenderer::CalculateBounds(Bounds& bounds)
+    {
+        if (m_mesh)
+        {
+            bounds = m_mesh_bounds.Transform(this->GetTransform()->GetLocalToWorldMatrix());
+            return true;
+        }
+        
+        return false;
+    }
 }
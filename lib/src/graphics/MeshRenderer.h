@@ -32,8 +32,14 @@ namespace Viry3D
         const Ref<Mesh>& GetMesh() const { return m_mesh; }
 		virtual void SetMesh(const Ref<Mesh>& mesh);
         virtual Vector<filament::backend::RenderPrimitiveHandle> GetPrimitives();
+        virtual const Bounds* GetBounds();
         
+	protected:
+		virtual bool CalculateBounds(Bounds& bounds);
+		virtual bool IsBoundsVolatile() const;
+
 	private:
         Ref<Mesh> m_mesh;
+        Bounds m_mesh_bounds;
     };
 }
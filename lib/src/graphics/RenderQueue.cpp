@@ -0,0 +1,101 @@
+/*
+* Viry3D
+* Copyright 2014-2019 by Stack - stackos@qq.com
+*
+* Licensed under the Apache License, Version 2.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at
+*
+*     http://www.apache.org/licenses/LICENSE-2.0
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+*/
+
+#include "RenderQueue.h"
+#include "math/Mathf.h"
+#include "memory/Memory.h"
+
+namespace Viry3D
+{
+	static uint64_t QuantizeDepth(float depth01, int bits)
+	{
+		uint64_t max = (1ull << bits) - 1;
+		return (uint64_t) (Mathf::Clamp01(depth01) * max);
+	}
+
+	uint64_t RenderQueue::MakeKey(int queue, float depth01, uint32_t shader_id, uint32_t material_id, uint32_t primitive_id, uint32_t block_id, int pass)
+	{
+		uint64_t key = ((uint64_t) Mathf::Clamp(queue, 0, 0x1fff)) << 51;
+
+		if (queue > TransparentQueueStart)
+		{
+			uint64_t max = (1ull << 22) - 1;
+			key |= (max - QuantizeDepth(depth01, 22)) << 29;
+		}
+		else
+		{
+			key |= QuantizeDepth(depth01, 10) << 41;
+			key |= ((uint64_t) (shader_id & 0xfff)) << 29;
+			key |= ((uint64_t) (material_id & 0x1fff)) << 16;
+			// block is mixed into primitive bits, so renderers of one block sit together and merge into instanced draws
+			uint32_t primitive_block = primitive_id ^ ((block_id * 2654435761u) >> 20);
+			key |= ((uint64_t) (primitive_block & 0xfff)) << 4;
+			key |= ((uint64_t) (pass & 0xf));
+		}
+
+		return key;
+	}
+
+	// lsd radix sort by 8 bit digits, stable, skip digits all keys share
+	void RenderQueue::Sort()
+	{
+		int count = m_items.Size();
+		if (count <= 1)
+		{
+			return;
+		}
+
+		m_sort_buffer.Resize(count);
+
+		RenderItem* src = &m_items[0];
+		RenderItem* dst = &m_sort_buffer[0];
+
+		for (int shift = 0; shift < 64; shift += 8)
+		{
+			int offsets[256] = { 0 };
+			for (int i = 0; i < count; ++i)
+			{
+				++offsets[(src[i].key >> shift) & 0xff];
+			}
+
+			if (offsets[(src[0].key >> shift) & 0xff] == count)
+			{
+				continue;
+			}
+
+			int sum = 0;
+			for (int i = 0; i < 256; ++i)
+			{
+				int c = offsets[i];
+				offsets[i] = sum;
+				sum += c;
+			}
+
+			for (int i = 0; i < count; ++i)
+			{
+				dst[offsets[(src[i].key >> shift) & 0xff]++] = src[i];
+			}
+
+			Mathf::Swap(src, dst);
+		}
+
+		if (src != &m_items[0])
+		{
+			Memory::Copy(&m_items[0], src, sizeof(RenderItem) * count);
+		}
+	}
+}
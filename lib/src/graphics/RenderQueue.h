@@ -0,0 +1,66 @@
+/*
+* Viry3D
+* Copyright 2014-2019 by Stack - stackos@qq.com
+*
+* Licensed under the Apache License, Version 2.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at
+*
+*     http://www.apache.org/licenses/LICENSE-2.0
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+*/
+
+#pragma once
+
+#include "container/Vector.h"
+#include "private/backend/DriverApi.h"
+
+namespace Viry3D
+{
+	class Renderer;
+	class Material;
+
+	// one draw of a renderer submesh with a shader pass
+	struct RenderItem
+	{
+		uint64_t key;
+		Renderer* renderer;
+		Material* material;
+		filament::backend::RenderPrimitiveHandle primitive;
+		int submesh;
+		int pass;
+		// can be merged with neighbours of same material, primitive and pass into one instanced draw
+		bool instancing;
+	};
+
+	// flat draw list sorted by packed 64 bit keys
+	//
+	// opaque:      | queue 13 | depth bucket 10 | shader 12 | material 13 | primitive 12 | pass 4 |
+	//     front to back by coarse depth, then grouped by state,
+	//     instancing items use depth 0 so runs of same state stay together
+	// transparent: | queue 13 | inverse depth 22 | 0 29 |
+	//     back to front, items of same depth keep the order they are added
+	class RenderQueue
+	{
+	public:
+		// queues greater than this are sorted back to front
+		static const int TransparentQueueStart = 2500;
+
+		// block_id is id of renderer property block, 0 for none
+		static uint64_t MakeKey(int queue, float depth01, uint32_t shader_id, uint32_t material_id, uint32_t primitive_id, uint32_t block_id, int pass);
+		void Clear() { m_items.Clear(); }
+		void Add(const RenderItem& item) { m_items.Add(item); }
+		void Sort();
+		const Vector<RenderItem>& GetItems() const { return m_items; }
+		int Size() const { return m_items.Size(); }
+
+	private:
+		Vector<RenderItem> m_items;
+		Vector<RenderItem> m_sort_buffer;
+	};
+}
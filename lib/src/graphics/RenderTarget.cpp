@@ -160,19 +160,31 @@ namespace Viry3D
 		{
 			if (p->targets.Remove(target))
 			{
-				if (m_temporary_render_targets_idle.TryGet(key.u, &p))
-				{
-					p->targets.Add(target);
-				}
-				else
-				{
-					TemporaryRenderTargets targets;
-					targets.key = key;
-					targets.targets.Add(target);
-
-					m_temporary_render_targets_idle.Add(key.u, targets);
-				}
+				// frames in flight may still draw to it, reuse after they finish
+				Ref<RenderTarget> retired = target;
+				Engine::Instance()->PostFrameRetiredAction([retired]() {
+					RenderTarget::AddIdleRenderTarget(retired);
+				});
 			}
 		}
 	}
+
+	void RenderTarget::AddIdleRenderTarget(const Ref<RenderTarget>& target)
+	{
+		RenderTargetKey key = target->key;
+
+		TemporaryRenderTargets* p;
+		if (m_temporary_render_targets_idle.TryGet(key.u, &p))
+		{
+			p->targets.Add(target);
+		}
+		else
+		{
+			TemporaryRenderTargets targets;
+			targets.key = key;
+			targets.targets.Add(target);
+
+			m_temporary_render_targets_idle.Add(key.u, targets);
+		}
+	}
 }
@@ -73,6 +73,9 @@ namespace Viry3D
 		Ref<Texture> depth;
 		RenderTargetKey key;
 
+	private:
+		static void AddIdleRenderTarget(const Ref<RenderTarget>& target);
+
 	private:
 		static Map<uint64_t, TemporaryRenderTargets> m_temporary_render_targets_using;
 		static Map<uint64_t, TemporaryRenderTargets> m_temporary_render_targets_idle;
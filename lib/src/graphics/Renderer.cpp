@@ -18,16 +18,174 @@
 #include "Renderer.h"
 #include "Engine.h"
 #include "GameObject.h"
+#include "thread/JobSystem.h"
 
 namespace Viry3D
 {
     List<Renderer*> Renderer::m_renderers;
+	AABBTree Renderer::m_tree;
+	Vector<Renderer*> Renderer::m_tree_dirty_renderers;
+	uint32_t Renderer::m_static_version = 0;
+	Vector<Renderer*> Renderer::m_volatile_renderers;
+	Vector<Renderer*> Renderer::m_unbounded_renderers;
+	Vector<Renderer*> Renderer::m_visible_renderers;
+	Ref<UniformArena> Renderer::m_transform_arena;
+	Ref<UniformArena> Renderer::m_bones_arena;
+
+	void Renderer::Init()
+	{
+		m_transform_arena = RefMake<UniformArena>((int) sizeof(RendererUniforms));
+		m_bones_arena = RefMake<UniformArena>((int) sizeof(SkinnedMeshRendererUniforms));
+	}
+
+	void Renderer::Done()
+	{
+		m_transform_arena.reset();
+		m_bones_arena.reset();
+	}
     
-	void Renderer::PrepareAll()
+	// fewer renderers per job cost more in scheduling than they save
+	static const int PREPARE_MIN_RENDERERS_PER_JOB = 64;
+
+	void Renderer::MarkVisible(Renderer* renderer)
+	{
+		if (!renderer->m_visible)
+		{
+			renderer->m_visible = true;
+			m_visible_renderers.Add(renderer);
+		}
+	}
+
+	void Renderer::PrepareAlways()
 	{
+		// ui handles input in prepare, which may create or destroy renderers, so it goes before culling
 		for (auto i : m_renderers)
 		{
-			i->Prepare();
+			if (i->IsAlwaysPrepared())
+			{
+				i->Prepare();
+				MarkVisible(i);
+			}
+		}
+	}
+
+	void Renderer::PrepareVisible()
+	{
+		for (int i = 0; i < m_visible_renderers.Size(); ++i)
+		{
+			Renderer* renderer = m_visible_renderers[i];
+			if (!renderer->IsAlwaysPrepared())
+			{
+				renderer->Prepare();
+			}
+		}
+
+		JobSystem* jobs = Engine::Instance()->GetJobSystem();
+		if (jobs)
+		{
+			jobs->ParallelFor(m_visible_renderers.Size(), PrepareUniformsRange, PREPARE_MIN_RENDERERS_PER_JOB);
+		}
+		else
+		{
+			PrepareUniformsRange(0, m_visible_renderers.Size());
+		}
+
+		for (int i = 0; i < m_visible_renderers.Size(); ++i)
+		{
+			m_visible_renderers[i]->m_visible = false;
+		}
+		m_visible_renderers.Clear();
+
+		m_transform_arena->Upload();
+		m_bones_arena->Upload();
+	}
+
+	void Renderer::PrepareUniformsRange(int begin, int end)
+	{
+		for (int i = begin; i < end; ++i)
+		{
+			m_visible_renderers[i]->PrepareUniforms();
+		}
+	}
+
+	void Renderer::UpdateSpatialTree()
+	{
+		for (int i = 0; i < m_volatile_renderers.Size(); ++i)
+		{
+			m_volatile_renderers[i]->MarkBoundsDirty();
+		}
+
+		for (int i = 0; i < m_tree_dirty_renderers.Size(); ++i)
+		{
+			Renderer* renderer = m_tree_dirty_renderers[i];
+			renderer->UpdateProxy();
+			renderer->m_tree_dirty = false;
+		}
+		m_tree_dirty_renderers.Clear();
+	}
+
+	void Renderer::QueryFrustum(const Frustum& frustum, Vector<Renderer*>& result)
+	{
+		Vector<void*> proxies;
+		m_tree.QueryFrustum(frustum, proxies);
+
+		for (int i = 0; i < proxies.Size(); ++i)
+		{
+			result.Add((Renderer*) proxies[i]);
+		}
+		result.AddRange(m_unbounded_renderers);
+	}
+
+	void Renderer::QueryFrustums(const Frustum* frustums, int count, Vector<Renderer*>* results)
+	{
+		if (count <= 0)
+		{
+			return;
+		}
+
+		Vector<Vector<void*>> proxies(count);
+		m_tree.QueryFrustums(frustums, count, &proxies[0]);
+
+		for (int i = 0; i < count; ++i)
+		{
+			for (int j = 0; j < proxies[i].Size(); ++j)
+			{
+				results[i].Add((Renderer*) proxies[i][j]);
+			}
+			results[i].AddRange(m_unbounded_renderers);
+		}
+	}
+
+	void Renderer::QuerySphere(const Vector3& center, float radius, Vector<Renderer*>& result)
+	{
+		Vector<void*> proxies;
+		m_tree.QuerySphere(center, radius, proxies);
+
+		for (int i = 0; i < proxies.Size(); ++i)
+		{
+			result.Add((Renderer*) proxies[i]);
+		}
+	}
+
+	void Renderer::QueryCone(const Vector3& apex, const Vector3& direction, float angle, float range, Vector<Renderer*>& result)
+	{
+		Vector<void*> proxies;
+		m_tree.QueryCone(apex, direction, angle, range, proxies);
+
+		for (int i = 0; i < proxies.Size(); ++i)
+		{
+			result.Add((Renderer*) proxies[i]);
+		}
+	}
+
+	void Renderer::QueryRay(const Ray& ray, float max_distance, Vector<Renderer*>& result)
+	{
+		Vector<void*> proxies;
+		m_tree.QueryRay(ray, max_distance, proxies);
+
+		for (int i = 0; i < proxies.Size(); ++i)
+		{
+			result.Add((Renderer*) proxies[i]);
 		}
 	}
 
@@ -35,22 +193,62 @@ namespace Viry3D
 		m_cast_shadow(false),
 		m_recieve_shadow(false),
         m_lightmap_scale_offset(1, 1, 0, 0),
-        m_lightmap_index(-1)
+        m_lightmap_index(-1),
+		m_transform_slot(-1),
+		m_transform_dirty(true),
+		m_transform_subscription(-1),
+		m_bounds_valid(false),
+		m_bounds_dirty(true),
+		m_proxy(AABBTree::NullProxy),
+		m_tree_dirty(false),
+		m_bounds_volatile(false),
+		m_unbounded(false),
+		m_visible(false)
     {
         m_renderers.AddLast(this);
+
+		this->MarkBoundsDirty();
     }
     
     Renderer::~Renderer()
     {
-		auto& driver = Engine::Instance()->GetDriverApi();
+		this->ReleaseMaterialOverrides();
 
-		if (m_transform_uniform_buffer)
+		if (m_transform_subscription >= 0)
 		{
-			driver.destroyUniformBuffer(m_transform_uniform_buffer);
-			m_transform_uniform_buffer.clear();
+			TransformSystem::Unsubscribe(m_transform_subscription);
+		}
+
+		if (m_transform_slot >= 0 && m_transform_arena)
+		{
+			m_transform_arena->Free(m_transform_slot);
+			m_transform_slot = -1;
 		}
 
         m_renderers.Remove(this);
+		++m_static_version;
+
+		if (m_proxy != AABBTree::NullProxy)
+		{
+			m_tree.DestroyProxy(m_proxy);
+			m_proxy = AABBTree::NullProxy;
+		}
+		if (m_tree_dirty)
+		{
+			m_tree_dirty_renderers.Remove(this);
+		}
+		if (m_bounds_volatile)
+		{
+			m_volatile_renderers.Remove(this);
+		}
+		if (m_unbounded)
+		{
+			m_unbounded_renderers.Remove(this);
+		}
+		if (m_visible)
+		{
+			m_visible_renderers.Remove(this);
+		}
     }
     
     Ref<Material> Renderer::GetMaterial() const
@@ -73,11 +271,40 @@ namespace Viry3D
     void Renderer::SetMaterials(const Vector<Ref<Material>>& materials)
     {
         m_materials = materials;
+		++m_static_version;
     }
 
+	void Renderer::SetPropertyBlock(const Ref<MaterialPropertyBlock>& block)
+	{
+		m_property_block = block;
+
+		if (!m_property_block)
+		{
+			this->ReleaseMaterialOverrides();
+		}
+	}
+
+	void Renderer::ReleaseMaterialOverrides()
+	{
+		for (int i = 0; i < m_material_overrides.Size(); ++i)
+		{
+			Material::ReleaseOverride(m_material_overrides[i]);
+		}
+		m_material_overrides.Clear();
+	}
+
+	void Renderer::BindMaterialOverride(int material_index, int pass)
+	{
+		if (m_property_block && material_index < m_material_overrides.Size())
+		{
+			Material::BindOverride(m_material_overrides[material_index], pass);
+		}
+	}
+
 	void Renderer::EnableCastShadow(bool enable)
 	{
 		m_cast_shadow = enable;
+		++m_static_version;
 	}
     
 	void Renderer::EnableRecieveShadow(bool enable)
@@ -88,11 +315,13 @@ namespace Viry3D
     void Renderer::SetLightmapIndex(int index)
     {
         m_lightmap_index = index;
+		m_transform_dirty = true;
     }
     
     void Renderer::SetLightmapScaleOffset(const Vector4& vec)
     {
         m_lightmap_scale_offset = vec;
+		m_transform_dirty = true;
     }
     
     Vector<filament::backend::RenderPrimitiveHandle> Renderer::GetPrimitives()
@@ -100,9 +329,104 @@ namespace Viry3D
         return Vector<filament::backend::RenderPrimitiveHandle>();
     }
 
+	const Bounds* Renderer::GetBounds()
+	{
+		if (m_bounds_dirty)
+		{
+			m_bounds_dirty = false;
+			m_bounds_valid = this->CalculateBounds(m_bounds);
+		}
+
+		if (m_bounds_valid)
+		{
+			return &m_bounds;
+		}
+
+		return nullptr;
+	}
+
+	void Renderer::OnAttach()
+	{
+		m_transform_subscription = this->GetTransform()->Subscribe([this]() {
+			this->OnTransformDirty();
+		});
+	}
+
+	void Renderer::OnTransformDirty()
+	{
+		m_transform_dirty = true;
+		this->MarkBoundsDirty();
+	}
+
+	void Renderer::MarkBoundsDirty()
+	{
+		m_bounds_dirty = true;
+
+		// cached shadows of static casters are rendered again
+		auto obj = this->GetGameObject();
+		if (obj && obj->IsStatic())
+		{
+			++m_static_version;
+		}
+
+		if (!m_tree_dirty)
+		{
+			m_tree_dirty = true;
+			m_tree_dirty_renderers.Add(this);
+		}
+	}
+
+	void Renderer::UpdateProxy()
+	{
+		const Bounds* bounds = this->GetBounds();
+		if (bounds)
+		{
+			if (m_proxy == AABBTree::NullProxy)
+			{
+				m_proxy = m_tree.CreateProxy(*bounds, this);
+			}
+			else
+			{
+				m_tree.MoveProxy(m_proxy, *bounds);
+			}
+		}
+		else if (m_proxy != AABBTree::NullProxy)
+		{
+			m_tree.DestroyProxy(m_proxy);
+			m_proxy = AABBTree::NullProxy;
+		}
+
+		bool unbounded = bounds == nullptr;
+		if (m_unbounded != unbounded)
+		{
+			m_unbounded = unbounded;
+			if (m_unbounded)
+			{
+				m_unbounded_renderers.Add(this);
+			}
+			else
+			{
+				m_unbounded_renderers.Remove(this);
+			}
+		}
+
+		bool bounds_volatile = this->IsBoundsVolatile();
+		if (m_bounds_volatile != bounds_volatile)
+		{
+			m_bounds_volatile = bounds_volatile;
+			if (m_bounds_volatile)
+			{
+				m_volatile_renderers.Add(this);
+			}
+			else
+			{
+				m_volatile_renderers.Remove(this);
+			}
+		}
+	}
+
 	void Renderer::Prepare()
 	{
-		auto& driver = Engine::Instance()->GetDriverApi();
 		const auto& materials = this->GetMaterials();
 
 		for (int i = 0; i < materials.Size(); ++i)
@@ -114,18 +438,58 @@ namespace Viry3D
 			}
 		}
 
-		if (!m_transform_uniform_buffer)
+		// after materials, overrides start from their uploaded values
+		if (m_property_block)
+		{
+			for (int i = materials.Size(); i < m_material_overrides.Size(); ++i)
+			{
+				Material::ReleaseOverride(m_material_overrides[i]);
+			}
+			m_material_overrides.Resize(materials.Size());
+
+			for (int i = 0; i < materials.Size(); ++i)
+			{
+				if (materials[i])
+				{
+					materials[i]->PrepareOverride(*m_property_block, m_material_overrides[i]);
+				}
+			}
+		}
+
+		if (m_transform_slot < 0)
+		{
+			m_transform_slot = m_transform_arena->Alloc();
+			m_transform_dirty = true;
+		}
+
+		// lazy world matrix is resolved on main thread, worker threads only read it
+		if (m_transform_dirty)
 		{
-			m_transform_uniform_buffer = driver.createUniformBuffer(sizeof(RendererUniforms), filament::backend::BufferUsage::DYNAMIC);
+			this->GetTransform()->GetLocalToWorldMatrix();
 		}
+	}
+
+	void Renderer::PrepareUniforms()
+	{
+		// unchanged transform keeps uniforms in arena
+		if (m_transform_dirty)
+		{
+			m_transform_dirty = false;
 
-		RendererUniforms renderer_uniforms;
-		renderer_uniforms.model_matrix = this->GetTransform()->GetLocalToWorldMatrix();
-		renderer_uniforms.lightmap_scale_offset = m_lightmap_scale_offset;
-		renderer_uniforms.lightmap_index = Vector4((float) m_lightmap_index);
+			RendererUniforms renderer_uniforms;
+			renderer_uniforms.model_matrix = this->GetTransform()->GetLocalToWorldMatrix();
+			renderer_uniforms.lightmap_scale_offset = m_lightmap_scale_offset;
+			renderer_uniforms.lightmap_index = Vector4((float) m_lightmap_index);
 
-		void* buffer = driver.allocate(sizeof(RendererUniforms));
-		Memory::Copy(buffer, &renderer_uniforms, sizeof(RendererUniforms));
-		driver.loadUniformBuffer(m_transform_uniform_buffer, filament::backend::BufferDescriptor(buffer, sizeof(RendererUniforms)));
+			m_transform_arena->Write(m_transform_slot, &renderer_uniforms, sizeof(RendererUniforms));
+		}
+	}
+
+	void Renderer::BindUniforms()
+	{
+		if (m_transform_slot >= 0)
+		{
+			m_transform_arena->Bind((size_t) Shader::BindingPoint::PerRenderer, m_transform_slot);
+		}
 	}
 }
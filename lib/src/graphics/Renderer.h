@@ -19,9 +19,13 @@
 
 #include "Component.h"
 #include "Material.h"
+#include "MaterialPropertyBlock.h"
 #include "container/List.h"
 #include "container/Vector.h"
 #include "math/Vector4.h"
+#include "math/Bounds.h"
+#include "math/AABBTree.h"
+#include "UniformArena.h"
 #include "private/backend/DriverApi.h"
 
 namespace Viry3D
@@ -29,14 +33,37 @@ namespace Viry3D
     class Renderer : public Component
     {
     public:
+		static void Init();
+		static void Done();
         static const List<Renderer*>& GetRenderers() { return m_renderers; }
-		static void PrepareAll();
+		// prepare renderers needing prepare every frame, such as ui handling input, call before culling
+		static void PrepareAlways();
+		// add renderer drawn this frame by any camera or light, call from culling before PrepareVisible
+		static void MarkVisible(Renderer* renderer);
+		// prepare renderers marked visible this frame on main thread and worker threads,
+		// then upload changed uniforms of all renderers at once
+		static void PrepareVisible();
+		// refit spatial tree for renderers whose bounds changed, call once per frame before queries
+		static void UpdateSpatialTree();
+		// renderers without bounds are always returned by frustum queries, and never by other queries
+		static void QueryFrustum(const Frustum& frustum, Vector<Renderer*>& result);
+		static void QueryFrustums(const Frustum* frustums, int count, Vector<Renderer*>* results);
+		static void QuerySphere(const Vector3& center, float radius, Vector<Renderer*>& result);
+		static void QueryCone(const Vector3& apex, const Vector3& direction, float angle, float range, Vector<Renderer*>& result);
+		static void QueryRay(const Ray& ray, float max_distance, Vector<Renderer*>& result);
+		static const AABBTree& GetSpatialTree() { return m_tree; }
+		// changes when renderers of static game objects move or change, or any renderer is destroyed
+		static uint32_t GetStaticVersion() { return m_static_version; }
         Renderer();
         virtual ~Renderer();
         Ref<Material> GetMaterial() const;
         void SetMaterial(const Ref<Material>& material);
         const Vector<Ref<Material>>& GetMaterials() const { return m_materials; }
         void SetMaterials(const Vector<Ref<Material>>& materials);
+		const Ref<MaterialPropertyBlock>& GetPropertyBlock() const { return m_property_block; }
+		// overrides properties of all materials for this renderer only, null to remove,
+		// changes of the block are picked up when renderer is prepared
+		void SetPropertyBlock(const Ref<MaterialPropertyBlock>& block);
 		bool IsCastShadow() const { return m_cast_shadow; }
 		void EnableCastShadow(bool enable);
 		bool IsRecieveShadow() const { return m_recieve_shadow; }
@@ -45,23 +72,69 @@ namespace Viry3D
         void SetLightmapIndex(int index);
         const Vector4& GetLightmapScaleOffset() const { return m_lightmap_scale_offset; }
         void SetLightmapScaleOffset(const Vector4& vec);
-        const filament::backend::UniformBufferHandle& GetTransformUniformBuffer() const { return m_transform_uniform_buffer; }
+		// bind per renderer uniforms for draw
+		virtual void BindUniforms();
+		// bind property block overrides of a material, after the material is bound
+		void BindMaterialOverride(int material_index, int pass);
         virtual Vector<filament::backend::RenderPrimitiveHandle> GetPrimitives();
+		// world space bounds, nullptr if renderer should never be culled
+		virtual const Bounds* GetBounds();
+		// called for renderer passed culling, renderers made of parts can skip parts out of frustum
+		virtual void CullParts(const Frustum& frustum) { }
 
 	protected:
+		static UniformArena* GetBonesArena() { return m_bones_arena.get(); }
+		// runs on main thread, may call driver and allocate uniform slots
 		virtual void Prepare();
+		// runs on worker threads after Prepare, only writes own data and own uniform slots
+		virtual void PrepareUniforms();
+		// prepared even if no camera or light draws it
+		virtual bool IsAlwaysPrepared() const { return false; }
 		virtual void OnResize(int width, int height) { }
+		virtual void OnAttach();
+		virtual void OnTransformDirty();
+		virtual uint32_t GetUpdatePhases() const { return 0; }
+		virtual bool CalculateBounds(Bounds& bounds) { return false; }
+		// bounds may change without transform change, refit every frame
+		virtual bool IsBoundsVolatile() const { return false; }
+		void MarkBoundsDirty();
+
+	private:
+		void UpdateProxy();
+		void ReleaseMaterialOverrides();
+		static void PrepareUniformsRange(int begin, int end);
 
 	private:
 		friend class Camera;
 
 	private:
         static List<Renderer*> m_renderers;
+		static AABBTree m_tree;
+		static Vector<Renderer*> m_tree_dirty_renderers;
+		static Vector<Renderer*> m_volatile_renderers;
+		static Vector<Renderer*> m_unbounded_renderers;
+		static Vector<Renderer*> m_visible_renderers;
+		static uint32_t m_static_version;
+		static Ref<UniformArena> m_transform_arena;
+		static Ref<UniformArena> m_bones_arena;
         Vector<Ref<Material>> m_materials;
+		Ref<MaterialPropertyBlock> m_property_block;
+		// one per material
+		Vector<MaterialOverride> m_material_overrides;
 		bool m_cast_shadow;
 		bool m_recieve_shadow;
         Vector4 m_lightmap_scale_offset;
         int m_lightmap_index;
-		filament::backend::UniformBufferHandle m_transform_uniform_buffer;
+		int m_transform_slot;
+		bool m_transform_dirty;
+		int m_transform_subscription;
+		Bounds m_bounds;
+		bool m_bounds_valid;
+		bool m_bounds_dirty;
+		int m_proxy;
+		bool m_tree_dirty;
+		bool m_bounds_volatile;
+		bool m_unbounded;
+		bool m_visible;
     };
 }
@@ -16,79 +16,251 @@
 */
 
 #include "Shader.h"
+#include "ShaderVariant.h"
 #include "Debug.h"
 #include "Engine.h"
 #include "io/File.h"
-#include "lua/lua.hpp"
-#include "memory/Memory.h"
+#include "io/Directory.h"
+#include "thread/ThreadPool.h"
+#include "time/FrameScheduler.h"
+#include "private/backend/DriverApi.h"
 
 #if VR_VULKAN || VR_D3D
 #include "vulkan/spirv_shader_compiler.h"
 #endif
 
-#if VR_D3D
-#include "vulkan/spirv_cross/spirv_hlsl.hpp"
-#endif
-
-#if VR_METAL
-#include "GLSLConversion.h"
-#include "SPIRVConversion.h"
-#endif
-
 namespace Viry3D
 {
+	// recorded variants in cache directory, one per line: name|light_add|keywords...
+	static const char* VARIANT_LIST_NAME = "variants.txt";
+	// change uniform or attribute layout bound by camera, always kept in fallback
+	static const char* LAYOUT_KEYWORDS[] = { "INSTANCING_ON", "LIGHTS_CLUSTERED", "SKIN_ON" };
+
+	struct Shader::Pending
+	{
+		Ref<Shader> shader;
+		Ref<ShaderVariant> variant;
+		String src;
+		String cache_dir;
+		// built in frame scheduler without prewarm thread
+		int task_id = -1;
+		// claimed by prewarm thread or by main thread waiting for it, whichever comes first
+		std::atomic<bool> started{ false };
+		std::atomic<bool> built{ false };
+		std::mutex mutex;
+		std::condition_variable condition;
+
+		// false if already claimed
+		bool Build();
+		void WaitBuilt();
+	};
+
+	// open addressing on keyword mask, tables live until Done so shaders keep a plain pointer
+	struct Shader::VariantTable
+	{
+		struct Entry
+		{
+			KeywordMask mask;
+			Ref<Shader> shader;
+		};
+
+		Vector<Entry> entries;
+		int count = 0;
+
+		static int Hash(KeywordMask mask, int capacity)
+		{
+			return (int) ((mask * 0x9E3779B97F4A7C15ull) >> 32) & (capacity - 1);
+		}
+
+		const Ref<Shader>* Get(KeywordMask mask) const
+		{
+			if (entries.Size() > 0)
+			{
+				int index = Hash(mask, entries.Size());
+				while (entries[index].shader)
+				{
+					if (entries[index].mask == mask)
+					{
+						return &entries[index].shader;
+					}
+					index = (index + 1) & (entries.Size() - 1);
+				}
+			}
+			return nullptr;
+		}
+
+		void Add(KeywordMask mask, const Ref<Shader>& shader)
+		{
+			// keep load under 3 / 4
+			if ((count + 1) * 4 > entries.Size() * 3)
+			{
+				Vector<Entry> old = entries;
+				entries = Vector<Entry>(old.Size() > 0 ? old.Size() * 2 : 8);
+				count = 0;
+				for (const auto& i : old)
+				{
+					if (i.shader)
+					{
+						this->Add(i.mask, i.shader);
+					}
+				}
+			}
+
+			int index = Hash(mask, entries.Size());
+			while (entries[index].shader)
+			{
+				index = (index + 1) & (entries.Size() - 1);
+			}
+			entries[index].mask = mask;
+			entries[index].shader = shader;
+			++count;
+		}
+	};
+
 	Map<String, Ref<Shader>> Shader::m_shaders;
+	Map<String, Ref<Shader::Pending>> Shader::m_pending;
+	Ref<Thread> Shader::m_prewarm_thread;
+	Shader::PendingMode Shader::m_pending_mode = Shader::PendingMode::Fallback;
+	Vector<String> Shader::m_fallback_keywords({ "LIGHT_ADD_ON", "SKIN_ON" });
+	String Shader::m_cache_directory;
+	bool Shader::m_cache_directory_set = false;
+	Map<String, int> Shader::m_keyword_ids;
+	Vector<String> Shader::m_keyword_names;
+	Map<String, int> Shader::m_property_ids;
+	Vector<String> Shader::m_property_names;
+	Map<String, Ref<Shader::VariantTable>> Shader::m_variant_tables;
+
+	// read from cache or build and write to cache, touches no engine state so job threads may call it
+	// false if build failed, variant then has no pass and nothing is cached
+	static bool BuildVariant(ShaderVariant& variant, const String& src, const String& cache_dir)
+	{
+		String cache_path;
+		if (!cache_dir.Empty())
+		{
+			cache_path = cache_dir + "/" + variant.GetCacheKey(src) + ".bin";
+		}
+
+		// warm start skips lua and glsl compiler
+		if (cache_path.Empty() || !variant.ReadCache(cache_path))
+		{
+			if (!variant.Build(src))
+			{
+				Log("Shader build failed: %s", variant.GetName().CString());
+				return false;
+			}
+
+			if (!cache_path.Empty())
+			{
+				if (!Directory::Exist(cache_dir))
+				{
+					Directory::Create(cache_dir);
+				}
+				if (!variant.WriteCache(cache_path))
+				{
+					Log("Shader cache write failed: %s", cache_path.CString());
+				}
+			}
+		}
+
+		return true;
+	}
+
+	bool Shader::Pending::Build()
+	{
+		if (started.exchange(true))
+		{
+			return false;
+		}
+
+		BuildVariant(*variant, src, cache_dir);
+
+		std::lock_guard<std::mutex> lock(mutex);
+		built = true;
+		condition.notify_all();
+		return true;
+	}
+
+	void Shader::Pending::WaitBuilt()
+	{
+		std::unique_lock<std::mutex> lock(mutex);
+		condition.wait(lock, [this]() {
+			return built.load();
+		});
+	}
+
+	static void SortById(Vector<Shader::PropertyLayout>& layouts)
+	{
+		for (int i = 1; i < layouts.Size(); ++i)
+		{
+			Shader::PropertyLayout layout = layouts[i];
+			int j = i - 1;
+			while (j >= 0 && layouts[j].id > layout.id)
+			{
+				layouts[j + 1] = layouts[j];
+				--j;
+			}
+			layouts[j + 1] = layout;
+		}
+	}
+
+	static const Shader::PropertyLayout* FindById(const Vector<Shader::PropertyLayout>& layouts, int id)
+	{
+		int begin = 0;
+		int end = layouts.Size();
+		while (begin < end)
+		{
+			int mid = (begin + end) / 2;
+			if (layouts[mid].id < id)
+			{
+				begin = mid + 1;
+			}
+			else
+			{
+				end = mid;
+			}
+		}
+
+		if (begin < layouts.Size() && layouts[begin].id == id)
+		{
+			return &layouts[begin];
+		}
+		return nullptr;
+	}
+
+	const Shader::PropertyLayout* Shader::Pass::GetUniformProperty(int id) const
+	{
+		return FindById(uniform_properties, id);
+	}
+
+	const Shader::PropertyLayout* Shader::Pass::GetTextureProperty(int id) const
+	{
+		return FindById(texture_properties, id);
+	}
+
+	// keyword without id would be missing in variant mask and alias the variant without it
+	static bool HasKeywordIds(const List<String>& keywords)
+	{
+		for (const auto& i : keywords)
+		{
+			if (Shader::GetKeywordId(i) < 0)
+			{
+				return false;
+			}
+		}
+		return true;
+	}
+
+	static List<String> SortKeywords(const Vector<String>& keywords)
+	{
+		List<String> keyword_list;
+		for (int i = 0; i < keywords.Size(); ++i)
+		{
+			keyword_list.AddLast(keywords[i]);
+		}
+		keyword_list.Sort();
+		return keyword_list;
+	}
 
-#if VR_VULKAN || VR_D3D
-    static void GlslToSpirv(const String& glsl, ShaderCompiler::ShaderType shader_type, Vector<unsigned int>& spirv)
-    {
-#if VR_WINDOWS || VR_ANDROID || VR_UWP
-        String error;
-        bool success = GlslToSpv(shader_type, glsl.CString(), spirv, error);
-        if (!success)
-        {
-            Log("shader compile error: %s", error.CString());
-        }
-        assert(success);
-#elif VR_MAC || VR_IOS
-        MVKShaderStage stage;
-        switch (shader_type)
-        {
-		case ShaderCompiler::ShaderType::Vertex:
-            stage = kMVKShaderStageVertex;
-            break;
-        case ShaderCompiler::ShaderType::Fragment:
-            stage = kMVKShaderStageFragment;
-            break;
-        default:
-            stage = kMVKShaderStageAuto;
-            break;
-        }
-        uint32_t* spirv_code = nullptr;
-        size_t size = 0;
-        char* log = nullptr;
-        bool success = mvkConvertGLSLToSPIRV(glsl.CString(),
-                                             stage,
-                                             &spirv_code,
-                                             &size,
-                                             &log,
-                                             true,
-                                             true);
-        if (!success)
-        {
-            Log("shader compile error: %s", log);
-        }
-        assert(success);
-        
-        spirv.Resize((int) size / 4);
-        Memory::Copy(&spirv[0], spirv_code, spirv.SizeInBytes());
-        
-        free(log);
-        free(spirv_code);
-#endif
-    }
-#endif
-    
     void Shader::Init()
     {
 #if VR_VULKAN || VR_D3D
@@ -98,6 +270,30 @@ namespace Viry3D
     
     void Shader::Done()
     {
+		Shader::WaitPending();
+
+		const String& cache_dir = Shader::GetCacheDirectory();
+		if (!cache_dir.Empty() && m_shaders.Size() > 0)
+		{
+			String list;
+			for (const auto& i : Shader::GetVariants())
+			{
+				list += i.name + "|" + (i.light_add ? "1" : "0");
+				for (const auto& j : i.keywords)
+				{
+					list += "|" + j;
+				}
+				list += "\n";
+			}
+
+			if (!Directory::Exist(cache_dir))
+			{
+				Directory::Create(cache_dir);
+			}
+			File::WriteAllText(cache_dir + "/" + VARIANT_LIST_NAME, list);
+		}
+
+		m_variant_tables.Clear();
 		m_shaders.Clear();
 
 #if VR_VULKAN || VR_D3D
@@ -109,23 +305,31 @@ namespace Viry3D
 	{
 		Ref<Shader> shader;
 
-		List<String> keyword_list;
-		for (int i = 0; i < keywords.Size(); ++i)
+		List<String> keyword_list = SortKeywords(keywords);
+		if (!HasKeywordIds(keyword_list))
 		{
-			keyword_list.AddLast(keywords[i]);
+			Log("Shader %s keyword rejected, more than %d keywords", name.CString(), KEYWORD_MAX_COUNT);
+			return shader;
 		}
-		keyword_list.Sort();
 
-		String key = name;
-		for (const auto& i : keyword_list)
-		{
-			key += "|" + i;
-		}
+		String key = Shader::GetKey(name, keyword_list);
 
 		Ref<Shader>* find;
 		if (m_shaders.TryGet(key, &find))
 		{
 			shader = *find;
+
+			if (!shader->m_ready)
+			{
+				if (m_pending_mode == PendingMode::Wait)
+				{
+					Shader::Publish(key, true);
+				}
+				else if (m_pending_mode == PendingMode::Fallback && !shader->m_fallback)
+				{
+					shader->m_fallback = Shader::FindFallback(shader);
+				}
+			}
 		}
 		else
 		{
@@ -134,11 +338,13 @@ namespace Viry3D
 			{
 				String lua_src = File::ReadAllText(path);
 
-				shader = Ref<Shader>(new Shader(name, light_add));
-				shader->Load(lua_src, keyword_list);
-				shader->Compile();
+				ShaderVariant variant(Engine::Instance()->GetDataPath() + "/shader", name, keyword_list, light_add, Engine::Instance()->GetBackend());
+				BuildVariant(variant, lua_src, Shader::GetCacheDirectory());
+
+				shader = Ref<Shader>(new Shader(name, keyword_list, light_add));
+				shader->CreatePrograms(variant);
 
-				m_shaders.Add(key, shader);
+				Shader::AddShader(key, shader);
 			}
 			else
 			{
@@ -148,478 +354,389 @@ namespace Viry3D
 
 		return shader;
 	}
-    
-    Shader::Shader(const String& name, bool light_add):
-		m_light_add(light_add),
-		m_queue(0)
-    {
-        this->SetName(name);
-    }
-    
-    Shader::~Shader()
-    {
-		auto& driver = Engine::Instance()->GetDriverApi();
 
-		for (int i = 0; i < m_passes.Size(); ++i)
+	void Shader::Prewarm(const Vector<VariantDesc>& variants)
+	{
+		auto engine = Engine::Instance();
+		String shader_dir = engine->GetDataPath() + "/shader";
+		const String& cache_dir = Shader::GetCacheDirectory();
+
+#if !VR_WASM
+		// own thread, job system waits on main thread would pick up compiles and hitch the frame
+		if (!m_prewarm_thread && variants.Size() > 0)
 		{
-			auto& pass = m_passes[i];
+			m_prewarm_thread = RefMake<Thread>(nullptr, nullptr);
+		}
+#endif
 
-			if (pass.pipeline.program)
+		for (const auto& desc : variants)
+		{
+			List<String> keyword_list = SortKeywords(desc.keywords);
+			if (!HasKeywordIds(keyword_list))
 			{
-				driver.destroyProgram(pass.pipeline.program);
-				pass.pipeline.program.clear();
+				Log("Shader %s keyword rejected, more than %d keywords", desc.name.CString(), KEYWORD_MAX_COUNT);
+				continue;
+			}
+
+			String key = Shader::GetKey(desc.name, keyword_list);
+			if (m_shaders.Contains(key))
+			{
+				continue;
+			}
+
+			String path = shader_dir + "/" + desc.name + ".lua";
+			if (!File::Exist(path))
+			{
+				Log("Shader %s not exist: %s", desc.name.CString(), path.CString());
+				continue;
+			}
+
+			Ref<Pending> pending = RefMake<Pending>();
+			pending->shader = Ref<Shader>(new Shader(desc.name, keyword_list, desc.light_add));
+			pending->variant = RefMake<ShaderVariant>(shader_dir, desc.name, keyword_list, desc.light_add, engine->GetBackend());
+			pending->src = File::ReadAllText(path);
+			pending->cache_dir = cache_dir;
+
+			// visible to Find at once, not ready until published
+			Shader::AddShader(key, pending->shader);
+			m_pending.Add(key, pending);
+
+			if (m_prewarm_thread)
+			{
+				Thread::Task task;
+				task.job = [=]() {
+					pending->Build();
+					return Ref<Object>();
+				};
+				// driver is only called on main thread
+				task.complete = [=](const Ref<Object>&) {
+					Shader::Publish(key, false);
+				};
+				m_prewarm_thread->AddTask(task);
+			}
+			else
+			{
+				pending->task_id = engine->GetFrameScheduler()->Add("Shader::Prewarm " + key, [=]() {
+					pending->task_id = -1;
+					pending->Build();
+					Shader::Publish(key, false);
+					return true;
+				});
 			}
 		}
-		m_passes.Clear();
-    }
+	}
 
-	static void SetGlobalInt(lua_State* L, const char* key, int value)
+	void Shader::PrewarmRecorded()
 	{
-		lua_pushinteger(L, value);
-		lua_setglobal(L, key);
+		const String& cache_dir = Shader::GetCacheDirectory();
+		if (cache_dir.Empty())
+		{
+			return;
+		}
+
+		String path = cache_dir + "/" + VARIANT_LIST_NAME;
+		if (!File::Exist(path))
+		{
+			return;
+		}
+
+		Vector<VariantDesc> variants;
+		for (const auto& line : File::ReadAllText(path).Split("\n", true))
+		{
+			auto parts = line.Split("|");
+			if (parts.Size() < 2)
+			{
+				continue;
+			}
+
+			VariantDesc desc;
+			desc.name = parts[0];
+			desc.light_add = parts[1] == "1";
+			for (int i = 2; i < parts.Size(); ++i)
+			{
+				desc.keywords.Add(parts[i]);
+			}
+			variants.Add(desc);
+		}
+
+		Shader::Prewarm(variants);
 	}
 
-	static void AddLuaPath(lua_State* L, const String& path)
+	Vector<Shader::VariantDesc> Shader::GetVariants()
 	{
-		lua_getglobal(L, "package");
-		lua_getfield(L, -1, "path"); // get field "path" from table at top of stack (-1)
-		String cur_path = lua_tostring(L, -1); // grab path string from top of stack
-		cur_path += ";" + path; // do your path magic here
-		lua_pop(L, 1); // get rid of the string on the stack we just pushed on line 5
-		lua_pushstring(L, cur_path.CString()); // push the new one
-		lua_setfield(L, -2, "path"); // set the field "path" in table at -2 with value at top of stack
-		lua_pop(L, 1); // get rid of package table from top of stack
+		Vector<VariantDesc> variants;
+		for (const auto& i : m_shaders)
+		{
+			const auto& shader = i.second;
+
+			VariantDesc desc;
+			desc.name = shader->GetName();
+			desc.light_add = shader->m_light_add;
+			for (const auto& j : shader->m_keywords)
+			{
+				desc.keywords.Add(j);
+			}
+			variants.Add(desc);
+		}
+		return variants;
 	}
 
-	static void GetTableString(lua_State* L, const char* key, String& str)
+	Ref<Shader> Shader::GetVariant(KeywordMask keywords, bool light_add)
 	{
-		lua_pushstring(L, key);
-		lua_gettable(L, -2);
-		if (lua_isstring(L, -1))
+		const Ref<Shader>* find = m_variants->Get(keywords);
+		if (find && (*find)->m_ready)
 		{
-			str = lua_tostring(L, -1);
+			return *find;
 		}
-		lua_pop(L, 1);
+
+		// not loaded, or pending mode applies
+		Vector<String> keyword_names;
+		for (int i = 0; i < m_keyword_names.Size(); ++i)
+		{
+			if (keywords & ((KeywordMask) 1 << i))
+			{
+				keyword_names.Add(m_keyword_names[i]);
+			}
+		}
+		return Shader::Find(this->GetName(), keyword_names, light_add);
 	}
 
-	template <class T>
-	static void GetTableInt(lua_State* L, const char* key, T& num)
+	int Shader::GetKeywordId(const String& keyword)
 	{
-		lua_pushstring(L, key);
-		lua_gettable(L, -2);
-		if (lua_isinteger(L, -1))
+		int* find;
+		if (m_keyword_ids.TryGet(keyword, &find))
 		{
-			num = (T) lua_tointeger(L, -1);
+			return *find;
 		}
-		lua_pop(L, 1);
+
+		if (m_keyword_names.Size() >= KEYWORD_MAX_COUNT)
+		{
+			Log("Shader keyword count exceeds %d: %s", KEYWORD_MAX_COUNT, keyword.CString());
+			return -1;
+		}
+
+		int id = m_keyword_names.Size();
+		m_keyword_names.Add(keyword);
+		m_keyword_ids.Add(keyword, id);
+		return id;
 	}
 
-	void Shader::Load(const String& src, const List<String>& keywords)
+	Shader::KeywordMask Shader::GetKeywordMask(const String& keyword)
 	{
-		m_keywords = keywords;
-
-		lua_State* L = luaL_newstate();
-		luaL_openlibs(L);
-
-		SetGlobalInt(L, "Off", 0);
-		SetGlobalInt(L, "On", 1);
-
-		SetGlobalInt(L, "Back", (int) filament::backend::CullingMode::BACK);
-		SetGlobalInt(L, "Front", (int) filament::backend::CullingMode::FRONT);
-		
-		SetGlobalInt(L, "Less", (int) filament::backend::SamplerCompareFunc::L);
-		SetGlobalInt(L, "Greater", (int) filament::backend::SamplerCompareFunc::G);
-		SetGlobalInt(L, "LEqual", (int) filament::backend::SamplerCompareFunc::LE);
-		SetGlobalInt(L, "GEqual", (int) filament::backend::SamplerCompareFunc::GE);
-		SetGlobalInt(L, "Equal", (int) filament::backend::SamplerCompareFunc::E);
-		SetGlobalInt(L, "NotEqual", (int) filament::backend::SamplerCompareFunc::NE);
-		SetGlobalInt(L, "Always", (int) filament::backend::SamplerCompareFunc::A);
-
-		SetGlobalInt(L, "Zero", (int) filament::backend::BlendFunction::ZERO);
-		SetGlobalInt(L, "One", (int) filament::backend::BlendFunction::ONE);
-		SetGlobalInt(L, "SrcColor", (int) filament::backend::BlendFunction::SRC_COLOR);
-		SetGlobalInt(L, "SrcAlpha", (int) filament::backend::BlendFunction::SRC_ALPHA);
-		SetGlobalInt(L, "DstColor", (int) filament::backend::BlendFunction::DST_COLOR);
-		SetGlobalInt(L, "DstAlpha", (int) filament::backend::BlendFunction::DST_ALPHA);
-		SetGlobalInt(L, "OneMinusSrcColor", (int) filament::backend::BlendFunction::ONE_MINUS_SRC_COLOR);
-		SetGlobalInt(L, "OneMinusSrcAlpha", (int) filament::backend::BlendFunction::ONE_MINUS_SRC_ALPHA);
-		SetGlobalInt(L, "OneMinusDstColor", (int) filament::backend::BlendFunction::ONE_MINUS_DST_COLOR);
-		SetGlobalInt(L, "OneMinusDstAlpha", (int) filament::backend::BlendFunction::ONE_MINUS_DST_ALPHA);
-
-		SetGlobalInt(L, "Background", (int) Queue::Background);
-		SetGlobalInt(L, "Geometry", (int) Queue::Geometry);
-		SetGlobalInt(L, "AlphaTest", (int) Queue::AlphaTest);
-		SetGlobalInt(L, "Transparent", (int) Queue::Transparent);
-		SetGlobalInt(L, "Overlay", (int) Queue::Overlay);
-
-		SetGlobalInt(L, "None", (int) LightMode::None);
-		SetGlobalInt(L, "Forward", (int) LightMode::Forward);
-
-		String dir = Engine::Instance()->GetDataPath() + "/shader/" + this->GetName();
-		dir = dir.Substring(0, dir.LastIndexOf("/"));
-		AddLuaPath(L, dir + "/?.lua");
-
-		if (luaL_dostring(L, src.CString()) != 0)
-		{
-			String error = lua_tostring(L, -1);
-			lua_pop(L, 1);
-			Log("do lua error: %s\n", error.CString());
-			assert(false);
-		}
-
-		if (lua_istable(L, -1))
-		{
-			// pass array
-			lua_pushnil(L);
-			while (lua_next(L, -2))
-			{
-				if (lua_istable(L, -1))
-				{
-					// pass
-					Pass pass;
-					GetTableString(L, "vs", pass.vs);
-					GetTableString(L, "fs", pass.fs);
-
-					lua_pushstring(L, "rs");
-					lua_gettable(L, -2);
-					if (lua_istable(L, -1))
-					{
-						// rs
-						filament::backend::CullingMode culling = filament::backend::CullingMode::BACK;
-						GetTableInt(L, "Cull", culling);
-						pass.pipeline.rasterState.culling = culling;
-
-						filament::backend::SamplerCompareFunc depth_func = filament::backend::SamplerCompareFunc::LE;
-						GetTableInt(L, "ZTest", depth_func);
-						pass.pipeline.rasterState.depthFunc = depth_func;
-
-						bool depth_write = true;
-						GetTableInt(L, "ZWrite", depth_write);
-						pass.pipeline.rasterState.depthWrite = depth_write;
-
-						filament::backend::BlendFunction src_color_blend = filament::backend::BlendFunction::ONE;
-						filament::backend::BlendFunction dst_color_blend = filament::backend::BlendFunction::ZERO;
-                        filament::backend::BlendFunction src_alpha_blend = filament::backend::BlendFunction::ONE;
-                        filament::backend::BlendFunction dst_alpha_blend = filament::backend::BlendFunction::ZERO;
-						GetTableInt(L, "SrcBlendMode", src_color_blend);
-						GetTableInt(L, "DstBlendMode", dst_color_blend);
-                        GetTableInt(L, "SrcBlendMode", src_alpha_blend);
-                        GetTableInt(L, "DstBlendMode", dst_alpha_blend);
-                        GetTableInt(L, "SrcColorBlendMode", src_color_blend);
-                        GetTableInt(L, "DstColorBlendMode", dst_color_blend);
-                        GetTableInt(L, "SrcAlphaBlendMode", src_alpha_blend);
-                        GetTableInt(L, "DstAlphaBlendMode", dst_alpha_blend);
-						pass.pipeline.rasterState.blendFunctionSrcRGB = src_color_blend;
-						pass.pipeline.rasterState.blendFunctionSrcAlpha = src_alpha_blend;
-						pass.pipeline.rasterState.blendFunctionDstRGB = dst_color_blend;
-						pass.pipeline.rasterState.blendFunctionDstAlpha = dst_alpha_blend;
-
-						bool color_write = true;
-						GetTableInt(L, "CWrite", color_write);
-						pass.pipeline.rasterState.colorWrite = color_write;
-
-						GetTableInt(L, "Queue", pass.queue);
-
-						if (m_queue < pass.queue)
-						{
-							m_queue = pass.queue;
-						}
-
-						GetTableInt(L, "LightMode", pass.light_mode);
-
-						if (pass.light_mode == LightMode::Forward && m_light_add)
-						{
-							pass.pipeline.rasterState.depthWrite = false;
-							pass.pipeline.rasterState.blendFunctionSrcRGB = src_color_blend;
-							pass.pipeline.rasterState.blendFunctionSrcAlpha = src_alpha_blend;
-							pass.pipeline.rasterState.blendFunctionDstRGB = filament::backend::BlendFunction::ONE;
-							pass.pipeline.rasterState.blendFunctionDstAlpha = filament::backend::BlendFunction::ONE;
-						}
-					}
-					lua_pop(L, 1);
+		int id = Shader::GetKeywordId(keyword);
+		return id >= 0 ? (KeywordMask) 1 << id : 0;
+	}
 
-					lua_pushstring(L, "uniforms");
-					lua_gettable(L, -2);
-					if (lua_istable(L, -1))
-					{
-						lua_pushnil(L);
-						while (lua_next(L, -2))
-						{
-							if (lua_istable(L, -1))
-							{
-								Uniform uniform;
-								GetTableString(L, "name", uniform.name);
-								GetTableInt(L, "binding", uniform.binding);
-
-								int offset = 0;
-
-								lua_pushstring(L, "members");
-								lua_gettable(L, -2);
-								if (lua_istable(L, -1))
-								{
-									lua_pushnil(L);
-									while (lua_next(L, -2))
-									{
-										if (lua_istable(L, -1))
-										{
-											Member member;
-											GetTableString(L, "name", member.name);
-											GetTableInt(L, "size", member.size);
-
-											member.offset = offset;
-											offset += member.size;
-
-											uniform.members.Add(member);
-										}
-										lua_pop(L, 1);
-									}
-								}
-								lua_pop(L, 1);
-
-								uniform.size = offset;
-
-								pass.uniforms.Add(uniform);
-							}
-							lua_pop(L, 1);
-						}
-					}
-					lua_pop(L, 1);
+	int Shader::GetPropertyId(const String& name)
+	{
+		int* find;
+		if (m_property_ids.TryGet(name, &find))
+		{
+			return *find;
+		}
 
-					lua_pushstring(L, "samplers");
-					lua_gettable(L, -2);
-					if (lua_istable(L, -1))
-					{
-						lua_pushnil(L);
-						while (lua_next(L, -2))
-						{
-							if (lua_istable(L, -1))
-							{
-								SamplerGroup group;
-								GetTableString(L, "name", group.name);
-								GetTableInt(L, "binding", group.binding);
-
-								lua_pushstring(L, "samplers");
-								lua_gettable(L, -2);
-								if (lua_istable(L, -1))
-								{
-									lua_pushnil(L);
-									while (lua_next(L, -2))
-									{
-										if (lua_istable(L, -1))
-										{
-											Sampler sampler;
-											GetTableString(L, "name", sampler.name);
-											GetTableInt(L, "binding", sampler.binding);
-
-											group.samplers.Add(sampler);
-										}
-										lua_pop(L, 1);
-									}
-								}
-								lua_pop(L, 1);
-
-								pass.samplers.Add(group);
-							}
-							lua_pop(L, 1);
-						}
-					}
-					lua_pop(L, 1);
+		int id = m_property_names.Size();
+		m_property_names.Add(name);
+		m_property_ids.Add(name, id);
+		return id;
+	}
 
-					m_passes.Add(pass);
+	void Shader::AddShader(const String& key, const Ref<Shader>& shader)
+	{
+		m_shaders.Add(key, shader);
+		shader->m_variants->Add(shader->m_keyword_mask, shader);
+	}
+
+	String Shader::GetKey(const String& name, const List<String>& keywords)
+	{
+		String key = name;
+		for (const auto& i : keywords)
+		{
+			key += "|" + i;
+		}
+		return key;
+	}
+
+	Ref<Shader> Shader::FindFallback(const Ref<Shader>& shader)
+	{
+		Vector<String> keywords;
+		for (const auto& i : shader->m_keywords)
+		{
+			bool layout = false;
+			for (auto j : LAYOUT_KEYWORDS)
+			{
+				if (i == j)
+				{
+					layout = true;
+					break;
 				}
-				lua_pop(L, 1);
 			}
-			lua_pop(L, 1);
+
+			if (layout || m_fallback_keywords.Contains(i))
+			{
+				keywords.Add(i);
+			}
+		}
+
+		// fallback would be the variant itself
+		if (keywords.Size() == shader->m_keywords.Size())
+		{
+			return Ref<Shader>();
 		}
 
-		lua_close(L);
+		return Shader::Find(shader->GetName(), keywords, shader->m_light_add);
 	}
 
-	void Shader::Compile()
+	void Shader::Publish(const String& key, bool wait)
 	{
-		auto& driver = Engine::Instance()->GetDriverApi();
-
-#if VR_WINDOWS || VR_MAC
-		String version = "#version 410\n";
-#else
-		String version = "#version 300 es\n";
-		if (Engine::Instance()->GetBackend() == filament::backend::Backend::VULKAN ||
-            Engine::Instance()->GetBackend() == filament::backend::Backend::METAL ||
-			Engine::Instance()->GetBackend() == filament::backend::Backend::D3D11)
+		Ref<Pending>* find;
+		if (!m_pending.TryGet(key, &find))
 		{
-			version = "#version 310 es\n";
+			return;
 		}
-#endif
-		
-		String define;
-		String vk_convert;
-
-		if (Engine::Instance()->GetBackend() == filament::backend::Backend::VULKAN ||
-            Engine::Instance()->GetBackend() == filament::backend::Backend::METAL ||
-			Engine::Instance()->GetBackend() == filament::backend::Backend::D3D11)
-		{
-			define = "#extension GL_ARB_separate_shader_objects : enable\n"
-				"#extension GL_ARB_shading_language_420pack : enable\n"
-				"#define VK_LAYOUT_LOCATION(i) layout(location = i)\n"
-				"#define VK_UNIFORM_BINDING(i) layout(std140, set = 0, binding = i)\n"
-				"#define VK_SAMPLER_BINDING(i) layout(set = 1, binding = i)\n";
-			if (Engine::Instance()->GetBackend() == filament::backend::Backend::VULKAN ||
-				Engine::Instance()->GetBackend() == filament::backend::Backend::METAL)
-			{
-				vk_convert = "void vk_convert() {\n"
-					"gl_Position.y = -gl_Position.y;\n"
-					"gl_Position.z = (gl_Position.z + gl_Position.w) * 0.5;\n"
-					"}\n";
+		Ref<Pending> pending = *find;
+
+		if (!pending->built)
+		{
+			if (!wait)
+			{
+				return;
 			}
-			else
+
+			if (pending->task_id >= 0)
+			{
+				Engine::Instance()->GetFrameScheduler()->Cancel(pending->task_id);
+				pending->task_id = -1;
+			}
+
+			// build now if prewarm thread has not started it, waits only for this variant
+			if (!pending->Build())
 			{
-				vk_convert = "void vk_convert() { }\n";
+				pending->WaitBuilt();
 			}
 		}
-		else if (Engine::Instance()->GetBackend() == filament::backend::Backend::OPENGL)
+
+		pending->shader->CreatePrograms(*pending->variant);
+		pending->shader->m_fallback.reset();
+		m_pending.Remove(key);
+	}
+
+	void Shader::WaitPending()
+	{
+		for (const auto& i : m_pending)
 		{
-			define = "#define VR_GLES 1\n"
-				"#define VK_LAYOUT_LOCATION(i)\n"
-				"#define VK_UNIFORM_BINDING(i) layout(std140)\n"
-				"#define VK_SAMPLER_BINDING(i)\n";
-			vk_convert = "void vk_convert() { }\n";
+			const auto& pending = i.second;
+
+			if (pending->task_id >= 0)
+			{
+				Engine::Instance()->GetFrameScheduler()->Cancel(pending->task_id);
+				pending->task_id = -1;
+			}
+
+			// claim ones not started so prewarm thread skips them, wait for the one in build
+			if (pending->started.exchange(true))
+			{
+				pending->WaitBuilt();
+			}
 		}
-		else
+		m_pending.Clear();
+		m_prewarm_thread.reset();
+	}
+
+	void Shader::WaitReady()
+	{
+		if (!m_ready)
 		{
-			assert(false);
+			Shader::Publish(Shader::GetKey(this->GetName(), m_keywords), true);
 		}
+	}
+    
+    Shader::Shader(const String& name, const List<String>& keywords, bool light_add):
+		m_keywords(keywords),
+		m_keyword_mask(0),
+		m_variants(nullptr),
+		m_light_add(light_add),
+		m_ready(false),
+		m_queue(0)
+    {
+        this->SetName(name);
 
 		for (const auto& i : m_keywords)
 		{
-			define += "#define " + i + " 1\n";
+			m_keyword_mask |= Shader::GetKeywordMask(i);
 		}
 
+		Ref<VariantTable>* find;
+		if (m_variant_tables.TryGet(name, &find))
+		{
+			m_variants = find->get();
+		}
+		else
+		{
+			auto table = RefMake<VariantTable>();
+			m_variants = table.get();
+			m_variant_tables.Add(name, table);
+		}
+    }
+    
+    Shader::~Shader()
+    {
+		auto& driver = Engine::Instance()->GetDriverApi();
+
 		for (int i = 0; i < m_passes.Size(); ++i)
 		{
 			auto& pass = m_passes[i];
 
-			String vs = version + define + vk_convert + pass.vs;
-			String fs = version + define + pass.fs;
-			
-			Vector<char> vs_data;
-			Vector<char> fs_data;
-
-            if (Engine::Instance()->GetBackend() == filament::backend::Backend::VULKAN)
-            {
-#if VR_VULKAN
-                Vector<unsigned int> vs_spirv;
-                Vector<unsigned int> fs_spirv;
-                GlslToSpirv(vs, ShaderCompiler::ShaderType::Vertex, vs_spirv);
-                GlslToSpirv(fs, ShaderCompiler::ShaderType::Fragment, fs_spirv);
-
-                vs_data.Resize(vs_spirv.Size() * 4);
-                Memory::Copy(&vs_data[0], &vs_spirv[0], vs_data.Size());
-                fs_data.Resize(fs_spirv.Size() * 4);
-                Memory::Copy(&fs_data[0], &fs_spirv[0], fs_data.Size());
-#endif
-            }
-			else if (Engine::Instance()->GetBackend() == filament::backend::Backend::D3D11)
-			{
-#if VR_D3D
-				Vector<unsigned int> vs_spirv;
-				Vector<unsigned int> fs_spirv;
-				GlslToSpirv(vs, ShaderCompiler::ShaderType::Vertex, vs_spirv);
-				GlslToSpirv(fs, ShaderCompiler::ShaderType::Fragment, fs_spirv);
-
-                spirv_cross::CompilerHLSL::Options options;
-                options.shader_model = 40;
-
-                spirv_cross::CompilerHLSL vs_compiler(&vs_spirv[0], vs_spirv.Size());
-                vs_compiler.set_hlsl_options(options);
-                std::string vs_hlsl = vs_compiler.compile();
-
-                spirv_cross::CompilerHLSL fs_compiler(&fs_spirv[0], fs_spirv.Size());
-                fs_compiler.set_hlsl_options(options);
-                std::string fs_hlsl = fs_compiler.compile();
-
-                vs_data.Resize((int) vs_hlsl.size());
-                Memory::Copy(&vs_data[0], &vs_hlsl[0], (int) vs_hlsl.size());
-                fs_data.Resize((int) fs_hlsl.size());
-                Memory::Copy(&fs_data[0], &fs_hlsl[0], (int) fs_hlsl.size());
-#endif
+			if (pass.pipeline.program)
+			{
+				driver.destroyProgram(pass.pipeline.program);
+				pass.pipeline.program.clear();
 			}
-            else if (Engine::Instance()->GetBackend() == filament::backend::Backend::METAL)
-            {
-#if VR_METAL
-                auto glsl_to_spirv = [](const String& glsl, filament::backend::Program::Shader shader_type, Vector<unsigned int>& spirv) {
-                    MVKShaderStage stage;
-                    switch (shader_type)
-                    {
-                        case filament::backend::Program::Shader::VERTEX:
-                            stage = kMVKShaderStageVertex;
-                            break;
-                        case filament::backend::Program::Shader::FRAGMENT:
-                            stage = kMVKShaderStageFragment;
-                            break;
-                        default:
-                            stage = kMVKShaderStageAuto;
-                            break;
-                    }
-                    uint32_t* spirv_code = nullptr;
-                    size_t size = 0;
-                    char* log = nullptr;
-                    bool success = mvkConvertGLSLToSPIRV(glsl.CString(),
-                                                         stage,
-                                                         &spirv_code,
-                                                         &size,
-                                                         &log,
-                                                         true,
-                                                         true);
-                    if (!success)
-                    {
-                        Log("shader compile error: %s", log);
-                    }
-                    assert(success);
-                    
-                    spirv.Resize((int) size / 4);
-                    Memory::Copy(&spirv[0], spirv_code, spirv.SizeInBytes());
-                    
-                    free(log);
-                    free(spirv_code);
-                };
-                auto spirv_to_msl = [](const Vector<unsigned int>& spirv, String& msl) {
-                    char* msl_code = nullptr;
-                    char* log = nullptr;
-                    bool success = mvkConvertSPIRVToMSL((uint32_t*) spirv.Bytes(), spirv.Size(), &msl_code, &log, true, true);
-                    if (!success)
-                    {
-                        Log("shader compile error: %s", log);
-                    }
-                    assert(success);
-                    
-                    msl = msl_code;
-                    
-                    free(log);
-                    free(msl_code);
-                };
-                
-                Vector<unsigned int> vs_spirv;
-                Vector<unsigned int> fs_spirv;
-                glsl_to_spirv(vs, filament::backend::Program::Shader::VERTEX, vs_spirv);
-                glsl_to_spirv(fs, filament::backend::Program::Shader::FRAGMENT, fs_spirv);
-                String vs_msl;
-                String fs_msl;
-                spirv_to_msl(vs_spirv, vs_msl);
-                spirv_to_msl(fs_spirv, fs_msl);
-                
-                vs_data.Resize(vs_msl.Size());
-                Memory::Copy(&vs_data[0], &vs_msl[0], vs_msl.Size());
-                fs_data.Resize(fs_msl.Size());
-                Memory::Copy(&fs_data[0], &fs_msl[0], fs_msl.Size());
-#endif
-            }
-			else
+		}
+		m_passes.Clear();
+    }
+
+	void Shader::SetCacheDirectory(const String& dir)
+	{
+		m_cache_directory = dir;
+		m_cache_directory_set = true;
+	}
+
+	const String& Shader::GetCacheDirectory()
+	{
+		if (!m_cache_directory_set)
+		{
+#if !VR_WASM
+			const String& save_path = Engine::Instance()->GetSavePath();
+			if (!save_path.Empty())
 			{
-				vs_data.Resize(vs.Size());
-				memcpy(&vs_data[0], &vs[0], vs_data.Size());
-				fs_data.Resize(fs.Size());
-				memcpy(&fs_data[0], &fs[0], fs_data.Size());
+				m_cache_directory = save_path + "/shader_cache";
 			}
+#endif
+			m_cache_directory_set = true;
+		}
+
+		return m_cache_directory;
+	}
+
+	void Shader::CreatePrograms(const ShaderVariant& variant)
+	{
+		auto& driver = Engine::Instance()->GetDriverApi();
+
+		m_keywords = variant.GetKeywords();
+		m_passes = variant.GetPasses();
+		m_queue = variant.GetQueue();
+		m_ready = true;
+
+		const auto& binaries = variant.GetBinaries();
+
+		for (int i = 0; i < m_passes.Size(); ++i)
+		{
+			auto& pass = m_passes[i];
+			Shader::BuildPropertyLayouts(pass);
+
+			const auto& vs_data = binaries[i].vs;
+			const auto& fs_data = binaries[i].fs;
 
 			filament::backend::Program pb;
 			pb.diagnostics(utils::CString(this->GetName().CString()))
@@ -649,4 +766,58 @@ namespace Viry3D
 			pass.pipeline.program = driver.createProgram(std::move(pb));
 		}
 	}
+
+	void Shader::BuildPropertyLayouts(Pass& pass)
+	{
+		pass.uniform_properties.Clear();
+		pass.texture_properties.Clear();
+
+		for (int i = 0; i < pass.uniforms.Size(); ++i)
+		{
+			const auto& uniform = pass.uniforms[i];
+
+			for (int j = 0; j < uniform.members.Size(); ++j)
+			{
+				const auto& member = uniform.members[j];
+				int id = Shader::GetPropertyId(member.name);
+
+				// first uniform with the member wins
+				if (FindById(pass.uniform_properties, id))
+				{
+					continue;
+				}
+
+				PropertyLayout layout;
+				layout.id = id;
+				layout.block = i;
+				layout.offset = member.offset;
+				layout.size = member.size;
+				pass.uniform_properties.Add(layout);
+				SortById(pass.uniform_properties);
+			}
+		}
+
+		for (int i = 0; i < pass.samplers.Size(); ++i)
+		{
+			const auto& group = pass.samplers[i];
+
+			// material only binds its own sampler group
+			if (group.binding != (int) Shader::BindingPoint::PerMaterialFragment)
+			{
+				continue;
+			}
+
+			for (int j = 0; j < group.samplers.Size(); ++j)
+			{
+				PropertyLayout layout;
+				layout.id = Shader::GetPropertyId(group.samplers[j].name);
+				layout.block = i;
+				layout.offset = j;
+				layout.size = 0;
+				pass.texture_properties.Add(layout);
+			}
+			SortById(pass.texture_properties);
+			break;
+		}
+	}
 }
@@ -21,10 +21,14 @@
 #include "container/Vector.h"
 #include "container/List.h"
 #include "container/Map.h"
-#include "private/backend/DriverApi.h"
+#include "backend/DriverEnums.h"
+#include "backend/PipelineState.h"
 
 namespace Viry3D
 {
+	class ShaderVariant;
+	class Thread;
+
     class Shader : public Object
     {
     public:
@@ -98,36 +102,130 @@ namespace Viry3D
 			Vector<Sampler> samplers;
 		};
 
+		// where a material property is written in a pass, found by property id
+		struct PropertyLayout
+		{
+			int id;
+			// index in uniforms or samplers of pass
+			int block;
+			// byte offset in uniform, or sampler index in group
+			int offset;
+			int size;
+		};
+
 		struct Pass
 		{
 			String vs;
 			String fs;
 			int queue = (int) Queue::Geometry;
 			LightMode light_mode = LightMode::None;
+			bool instancing = false;
+			bool lights_clustered = false;
 			Vector<Uniform> uniforms;
 			Vector<SamplerGroup> samplers;
 			filament::backend::PipelineState pipeline;
+			// sorted by id, built with programs
+			Vector<PropertyLayout> uniform_properties;
+			Vector<PropertyLayout> texture_properties;
+
+			const PropertyLayout* GetUniformProperty(int id) const;
+			const PropertyLayout* GetTextureProperty(int id) const;
+		};
+
+		struct VariantDesc
+		{
+			String name;
+			Vector<String> keywords;
+			bool light_add = false;
+		};
+
+		// keywords are interned into bits of a mask, at most 64 keywords in total
+		typedef uint64_t KeywordMask;
+		static const int KEYWORD_MAX_COUNT = 64;
+
+		// what Find gives for a variant still compiling in background
+		enum class PendingMode
+		{
+			// block until compiled
+			Wait,
+			// variant has no pass until compiled, draws using it are skipped
+			Skip,
+			// variant uses passes of its fallback until compiled
+			Fallback,
 		};
 
         static void Init();
         static void Done();
 		static Ref<Shader> Find(const String& name, const Vector<String>& keywords = Vector<String>(), bool light_add = false);
+		// compile variants on a prewarm thread, or time sliced on main thread without threads,
+		// Find returns them at once, they are switched to compiled state on main thread at begin of a frame
+		static void Prewarm(const Vector<VariantDesc>& variants);
+		// prewarm variants used in last session, recorded in cache directory by Done
+		static void PrewarmRecorded();
+		// variants found or prewarmed in this session
+		static Vector<VariantDesc> GetVariants();
+		static void SetPendingMode(PendingMode mode) { m_pending_mode = mode; }
+		// fallback of a pending variant is the same shader keeping only these of its keywords,
+		// LIGHT_ADD_ON and SKIN_ON by default, layout keywords INSTANCING_ON, LIGHTS_CLUSTERED
+		// and SKIN_ON are always kept, no fallback if all are kept
+		static void SetFallbackKeywords(const Vector<String>& keywords) { m_fallback_keywords = keywords; }
+		// compiled variants are cached in save path by default, empty dir disables cache
+		static void SetCacheDirectory(const String& dir);
+		static const String& GetCacheDirectory();
+		// interned keyword id, -1 if no more id, Find and Prewarm reject keywords without id
+		static int GetKeywordId(const String& keyword);
+		// mask of one keyword, intern once and keep the mask for hot paths, 0 if keyword has no id
+		static KeywordMask GetKeywordMask(const String& keyword);
+		// interned id of a uniform member or texture name, intern once and keep the id for hot paths
+		static int GetPropertyId(const String& name);
+		static const String& GetPropertyName(int id) { return m_property_names[id]; }
 
         virtual ~Shader();
 		const List<String>& GetKeywords() const { return m_keywords; }
-		int GetPassCount() const { return m_passes.Size(); }
-		const Pass& GetPass(int index) const { return m_passes[index]; }
-        int GetQueue() const { return m_queue; }
+		KeywordMask GetKeywordMask() const { return m_keyword_mask; }
+		// variant of the same shader with these keywords, found by mask without building strings,
+		// light_add is only used when the variant is not loaded yet
+		Ref<Shader> GetVariant(KeywordMask keywords, bool light_add = false);
+		bool IsReady() const { return m_ready; }
+		// main thread only, finish compile of pending variant now
+		void WaitReady();
+		int GetPassCount() const { return m_ready || !m_fallback ? m_passes.Size() : m_fallback->GetPassCount(); }
+		const Pass& GetPass(int index) const { return m_ready || !m_fallback ? m_passes[index] : m_fallback->GetPass(index); }
+        int GetQueue() const { return m_ready || !m_fallback ? m_queue : m_fallback->GetQueue(); }
 
 	private:
-		Shader(const String& name, bool light_add);
-		void Load(const String& src, const List<String>& keywords);
-		void Compile();
+		struct Pending;
+		struct VariantTable;
+
+		Shader(const String& name, const List<String>& keywords, bool light_add);
+		void CreatePrograms(const ShaderVariant& variant);
+		static void BuildPropertyLayouts(Pass& pass);
+		static String GetKey(const String& name, const List<String>& keywords);
+		static Ref<Shader> FindFallback(const Ref<Shader>& shader);
+		static void Publish(const String& key, bool wait);
+		static void WaitPending();
+		static void AddShader(const String& key, const Ref<Shader>& shader);
 
 	private:
 		static Map<String, Ref<Shader>> m_shaders;
+		static Map<String, Ref<Pending>> m_pending;
+		static Ref<Thread> m_prewarm_thread;
+		static PendingMode m_pending_mode;
+		static Vector<String> m_fallback_keywords;
+		static String m_cache_directory;
+		static bool m_cache_directory_set;
+		static Map<String, int> m_keyword_ids;
+		static Vector<String> m_keyword_names;
+		static Map<String, int> m_property_ids;
+		static Vector<String> m_property_names;
+		// variants of each shader name
+		static Map<String, Ref<VariantTable>> m_variant_tables;
 		List<String> m_keywords;
+		KeywordMask m_keyword_mask;
+		VariantTable* m_variants;
 		bool m_light_add;
+		bool m_ready;
+		Ref<Shader> m_fallback;
 		Vector<Pass> m_passes;
 		int m_queue;
     };
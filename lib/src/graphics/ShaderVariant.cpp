@@ -0,0 +1,957 @@
+/*
+* Viry3D
+* Copyright 2014-2019 by Stack - stackos@qq.com
+*
+* Licensed under the Apache License, Version 2.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at
+*
+*     http://www.apache.org/licenses/LICENSE-2.0
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+*/
+
+#include "ShaderVariant.h"
+#include "Material.h"
+#include "Debug.h"
+#include "io/File.h"
+#include "io/MemoryStream.h"
+#include "lua/lua.hpp"
+#include "memory/Memory.h"
+#include <stdio.h>
+
+#if VR_VULKAN || VR_D3D
+#include "vulkan/spirv_shader_compiler.h"
+#endif
+
+#if VR_D3D
+#include "vulkan/spirv_cross/spirv_hlsl.hpp"
+#endif
+
+#if VR_METAL
+#include "GLSLConversion.h"
+#include "SPIRVConversion.h"
+#endif
+
+namespace Viry3D
+{
+	static const uint32_t CACHE_FILE_MAGIC = 0x43535256; // VRSC
+
+#if VR_VULKAN || VR_D3D
+    static bool GlslToSpirv(const String& glsl, ShaderCompiler::ShaderType shader_type, Vector<unsigned int>& spirv)
+    {
+#if VR_WINDOWS || VR_ANDROID || VR_UWP || VR_LINUX
+        String error;
+        bool success = GlslToSpv(shader_type, glsl.CString(), spirv, error);
+        if (!success)
+        {
+            Log("shader compile error: %s", error.CString());
+        }
+        return success;
+#elif VR_MAC || VR_IOS
+        MVKShaderStage stage;
+        switch (shader_type)
+        {
+		case ShaderCompiler::ShaderType::Vertex:
+            stage = kMVKShaderStageVertex;
+            break;
+        case ShaderCompiler::ShaderType::Fragment:
+            stage = kMVKShaderStageFragment;
+            break;
+        default:
+            stage = kMVKShaderStageAuto;
+            break;
+        }
+        uint32_t* spirv_code = nullptr;
+        size_t size = 0;
+        char* log = nullptr;
+        bool success = mvkConvertGLSLToSPIRV(glsl.CString(),
+                                             stage,
+                                             &spirv_code,
+                                             &size,
+                                             &log,
+                                             true,
+                                             true);
+        if (success)
+        {
+            spirv.Resize((int) size / 4);
+            Memory::Copy(&spirv[0], spirv_code, spirv.SizeInBytes());
+        }
+        else
+        {
+            Log("shader compile error: %s", log);
+        }
+        
+        free(log);
+        free(spirv_code);
+        return success;
+#endif
+    }
+#endif
+
+	ShaderVariant::ShaderVariant(const String& shader_dir, const String& name, const List<String>& keywords, bool light_add, filament::backend::Backend backend):
+		m_shader_dir(shader_dir),
+		m_name(name),
+		m_keywords(keywords),
+		m_light_add(light_add),
+		m_backend(backend),
+		m_glsl_version(GetDefaultGlslVersion(backend)),
+		m_queue(0)
+	{
+	}
+
+	String ShaderVariant::GetDefaultGlslVersion(filament::backend::Backend backend)
+	{
+#if VR_WINDOWS || VR_MAC
+		return "#version 410";
+#else
+		if (backend == filament::backend::Backend::VULKAN ||
+			backend == filament::backend::Backend::METAL ||
+			backend == filament::backend::Backend::D3D11)
+		{
+			return "#version 310 es";
+		}
+		return "#version 300 es";
+#endif
+	}
+
+	// fnv-1a, stable across platforms and runs
+	static void HashBytes(uint64_t& hash, const void* bytes, int size)
+	{
+		const byte* p = (const byte*) bytes;
+		for (int i = 0; i < size; ++i)
+		{
+			hash ^= p[i];
+			hash *= 1099511628211ULL;
+		}
+	}
+
+	static void HashString(uint64_t& hash, const String& str)
+	{
+		int size = str.Size();
+		HashBytes(hash, &size, sizeof(size));
+		HashBytes(hash, str.CString(), size);
+	}
+
+	// lua files loaded by require are searched in the shader folder, see Load
+	static void HashRequires(uint64_t& hash, const String& dir, const String& src, Vector<String>& visited)
+	{
+		int start = 0;
+		while (true)
+		{
+			int index = src.IndexOf("require", start);
+			if (index < 0)
+			{
+				break;
+			}
+			start = index + 7;
+
+			// require "name", require 'name' or require("name")
+			int i = start;
+			while (i < src.Size() && (src[i] == ' ' || src[i] == '\t' || src[i] == '('))
+			{
+				++i;
+			}
+			if (i >= src.Size() || (src[i] != '"' && src[i] != '\''))
+			{
+				continue;
+			}
+
+			char quote[2] = { src[i], 0 };
+			int end = src.IndexOf(quote, i + 1);
+			if (end < 0)
+			{
+				break;
+			}
+
+			String module = src.Substring(i + 1, end - i - 1);
+			start = end + 1;
+
+			if (visited.Contains(module))
+			{
+				continue;
+			}
+			visited.Add(module);
+
+			String path = dir + "/" + module + ".lua";
+			if (File::Exist(path))
+			{
+				String require_src = File::ReadAllText(path);
+				HashString(hash, module);
+				HashString(hash, require_src);
+				HashRequires(hash, dir, require_src, visited);
+			}
+		}
+	}
+
+	String ShaderVariant::GetCacheKey(const String& src) const
+	{
+		uint64_t hash = 14695981039346656037ULL;
+
+		uint32_t version = COMPILER_VERSION;
+		int backend = (int) m_backend;
+		int light_add = m_light_add ? 1 : 0;
+		HashBytes(hash, &version, sizeof(version));
+		HashBytes(hash, &backend, sizeof(backend));
+		HashBytes(hash, &light_add, sizeof(light_add));
+		HashString(hash, m_glsl_version);
+		HashString(hash, m_name);
+		for (const auto& i : m_keywords)
+		{
+			HashString(hash, i);
+		}
+		HashString(hash, src);
+
+		String dir = m_shader_dir + "/" + m_name;
+		dir = dir.Substring(0, dir.LastIndexOf("/"));
+		Vector<String> visited;
+		HashRequires(hash, dir, src, visited);
+
+		return String::Format("%016llx", (unsigned long long) hash);
+	}
+
+	bool ShaderVariant::Build(const String& src)
+	{
+		m_passes.Clear();
+		m_binaries.Clear();
+		m_queue = 0;
+
+		if (!this->Load(src) || !this->Compile())
+		{
+			// no half built passes for caller to use or cache
+			m_passes.Clear();
+			m_binaries.Clear();
+			return false;
+		}
+
+		return true;
+	}
+
+	static void WriteBytes(Vector<byte>& buffer, const void* bytes, int size)
+	{
+		int offset = buffer.Size();
+		buffer.Resize(offset + size);
+		if (size > 0)
+		{
+			Memory::Copy(&buffer[offset], bytes, size);
+		}
+	}
+
+	template <class T>
+	static void WriteValue(Vector<byte>& buffer, const T& value)
+	{
+		WriteBytes(buffer, &value, sizeof(T));
+	}
+
+	static void WriteString(Vector<byte>& buffer, const String& str)
+	{
+		WriteValue(buffer, str.Size());
+		WriteBytes(buffer, str.CString(), str.Size());
+	}
+
+	static void WriteData(Vector<byte>& buffer, const Vector<char>& data)
+	{
+		WriteValue(buffer, data.Size());
+		if (data.Size() > 0)
+		{
+			WriteBytes(buffer, data.Bytes(), data.SizeInBytes());
+		}
+	}
+
+	// reads fail softly on truncated or foreign files, caller then builds from source
+	template <class T>
+	static bool ReadValue(MemoryStream& ms, T& value)
+	{
+		return ms.Read(&value, sizeof(T)) == sizeof(T);
+	}
+
+	static bool ReadSize(MemoryStream& ms, int& size, int max_size)
+	{
+		return ReadValue(ms, size) && size >= 0 && size <= max_size;
+	}
+
+	static bool ReadString(MemoryStream& ms, String& str, int file_size)
+	{
+		int size;
+		if (!ReadSize(ms, size, file_size))
+		{
+			return false;
+		}
+		ByteBuffer buffer(size);
+		if (size > 0 && ms.Read(buffer.Bytes(), size) != size)
+		{
+			return false;
+		}
+		str = String((const char*) buffer.Bytes(), size);
+		return true;
+	}
+
+	static bool ReadData(MemoryStream& ms, Vector<char>& data, int file_size)
+	{
+		int size;
+		if (!ReadSize(ms, size, file_size))
+		{
+			return false;
+		}
+		data.Resize(size);
+		return size == 0 || ms.Read(data.Bytes(), size) == size;
+	}
+
+	bool ShaderVariant::ReadCache(const String& path)
+	{
+		if (!File::Exist(path))
+		{
+			return false;
+		}
+
+		ByteBuffer buffer = File::ReadAllBytes(path);
+		int file_size = buffer.Size();
+		MemoryStream ms(buffer);
+
+		uint32_t magic = 0;
+		uint32_t version = 0;
+		if (!ReadValue(ms, magic) || magic != CACHE_FILE_MAGIC ||
+			!ReadValue(ms, version) || version != COMPILER_VERSION)
+		{
+			return false;
+		}
+
+		Vector<Shader::Pass> passes;
+		Vector<Binary> binaries;
+		int queue = 0;
+		int pass_count = 0;
+		if (!ReadValue(ms, queue) || !ReadSize(ms, pass_count, file_size))
+		{
+			return false;
+		}
+
+		passes.Resize(pass_count);
+		binaries.Resize(pass_count);
+
+		for (int i = 0; i < pass_count; ++i)
+		{
+			auto& pass = passes[i];
+			int light_mode = 0;
+			byte instancing = 0;
+			byte lights_clustered = 0;
+			int uniform_count = 0;
+			int group_count = 0;
+
+			if (!ReadString(ms, pass.vs, file_size) ||
+				!ReadString(ms, pass.fs, file_size) ||
+				!ReadValue(ms, pass.queue) ||
+				!ReadValue(ms, light_mode) ||
+				!ReadValue(ms, instancing) ||
+				!ReadValue(ms, lights_clustered) ||
+				!ReadValue(ms, pass.pipeline.rasterState.u) ||
+				!ReadValue(ms, pass.pipeline.polygonOffset) ||
+				!ReadSize(ms, uniform_count, file_size))
+			{
+				return false;
+			}
+			pass.light_mode = (Shader::LightMode) light_mode;
+			pass.instancing = instancing != 0;
+			pass.lights_clustered = lights_clustered != 0;
+
+			pass.uniforms.Resize(uniform_count);
+			for (int j = 0; j < uniform_count; ++j)
+			{
+				auto& uniform = pass.uniforms[j];
+				int member_count = 0;
+				if (!ReadString(ms, uniform.name, file_size) ||
+					!ReadValue(ms, uniform.binding) ||
+					!ReadValue(ms, uniform.size) ||
+					!ReadSize(ms, member_count, file_size))
+				{
+					return false;
+				}
+
+				uniform.members.Resize(member_count);
+				for (int k = 0; k < member_count; ++k)
+				{
+					auto& member = uniform.members[k];
+					if (!ReadString(ms, member.name, file_size) ||
+						!ReadValue(ms, member.offset) ||
+						!ReadValue(ms, member.size))
+					{
+						return false;
+					}
+				}
+			}
+
+			if (!ReadSize(ms, group_count, file_size))
+			{
+				return false;
+			}
+
+			pass.samplers.Resize(group_count);
+			for (int j = 0; j < group_count; ++j)
+			{
+				auto& group = pass.samplers[j];
+				int sampler_count = 0;
+				if (!ReadString(ms, group.name, file_size) ||
+					!ReadValue(ms, group.binding) ||
+					!ReadSize(ms, sampler_count, file_size))
+				{
+					return false;
+				}
+
+				group.samplers.Resize(sampler_count);
+				for (int k = 0; k < sampler_count; ++k)
+				{
+					auto& sampler = group.samplers[k];
+					if (!ReadString(ms, sampler.name, file_size) ||
+						!ReadValue(ms, sampler.binding))
+					{
+						return false;
+					}
+				}
+			}
+
+			if (!ReadData(ms, binaries[i].vs, file_size) ||
+				!ReadData(ms, binaries[i].fs, file_size))
+			{
+				return false;
+			}
+		}
+
+		m_passes = passes;
+		m_binaries = binaries;
+		m_queue = queue;
+
+		return true;
+	}
+
+	bool ShaderVariant::WriteCache(const String& path) const
+	{
+		Vector<byte> buffer;
+
+		uint32_t version = COMPILER_VERSION;
+		WriteValue(buffer, CACHE_FILE_MAGIC);
+		WriteValue(buffer, version);
+		WriteValue(buffer, m_queue);
+		WriteValue(buffer, m_passes.Size());
+
+		for (int i = 0; i < m_passes.Size(); ++i)
+		{
+			const auto& pass = m_passes[i];
+
+			WriteString(buffer, pass.vs);
+			WriteString(buffer, pass.fs);
+			WriteValue(buffer, pass.queue);
+			WriteValue(buffer, (int) pass.light_mode);
+			WriteValue(buffer, (byte) (pass.instancing ? 1 : 0));
+			WriteValue(buffer, (byte) (pass.lights_clustered ? 1 : 0));
+			WriteValue(buffer, pass.pipeline.rasterState.u);
+			WriteValue(buffer, pass.pipeline.polygonOffset);
+
+			WriteValue(buffer, pass.uniforms.Size());
+			for (const auto& uniform : pass.uniforms)
+			{
+				WriteString(buffer, uniform.name);
+				WriteValue(buffer, uniform.binding);
+				WriteValue(buffer, uniform.size);
+				WriteValue(buffer, uniform.members.Size());
+				for (const auto& member : uniform.members)
+				{
+					WriteString(buffer, member.name);
+					WriteValue(buffer, member.offset);
+					WriteValue(buffer, member.size);
+				}
+			}
+
+			WriteValue(buffer, pass.samplers.Size());
+			for (const auto& group : pass.samplers)
+			{
+				WriteString(buffer, group.name);
+				WriteValue(buffer, group.binding);
+				WriteValue(buffer, group.samplers.Size());
+				for (const auto& sampler : group.samplers)
+				{
+					WriteString(buffer, sampler.name);
+					WriteValue(buffer, sampler.binding);
+				}
+			}
+
+			WriteData(buffer, m_binaries[i].vs);
+			WriteData(buffer, m_binaries[i].fs);
+		}
+
+		// write aside then rename, a reader never sees a half written file
+		String temp_path = path + ".tmp";
+		if (!File::WriteAllBytes(temp_path, ByteBuffer(buffer.Bytes(), buffer.Size())))
+		{
+			return false;
+		}
+		remove(path.CString());
+		return rename(temp_path.CString(), path.CString()) == 0;
+	}
+
+	static void SetGlobalInt(lua_State* L, const char* key, int value)
+	{
+		lua_pushinteger(L, value);
+		lua_setglobal(L, key);
+	}
+
+	static void AddLuaPath(lua_State* L, const String& path)
+	{
+		lua_getglobal(L, "package");
+		lua_getfield(L, -1, "path"); // get field "path" from table at top of stack (-1)
+		String cur_path = lua_tostring(L, -1); // grab path string from top of stack
+		cur_path += ";" + path; // do your path magic here
+		lua_pop(L, 1); // get rid of the string on the stack we just pushed on line 5
+		lua_pushstring(L, cur_path.CString()); // push the new one
+		lua_setfield(L, -2, "path"); // set the field "path" in table at -2 with value at top of stack
+		lua_pop(L, 1); // get rid of package table from top of stack
+	}
+
+	static void GetTableString(lua_State* L, const char* key, String& str)
+	{
+		lua_pushstring(L, key);
+		lua_gettable(L, -2);
+		if (lua_isstring(L, -1))
+		{
+			str = lua_tostring(L, -1);
+		}
+		lua_pop(L, 1);
+	}
+
+	template <class T>
+	static void GetTableInt(lua_State* L, const char* key, T& num)
+	{
+		lua_pushstring(L, key);
+		lua_gettable(L, -2);
+		if (lua_isinteger(L, -1))
+		{
+			num = (T) lua_tointeger(L, -1);
+		}
+		lua_pop(L, 1);
+	}
+
+	bool ShaderVariant::Load(const String& src)
+	{
+		lua_State* L = luaL_newstate();
+		luaL_openlibs(L);
+
+		SetGlobalInt(L, "Off", 0);
+		SetGlobalInt(L, "On", 1);
+
+		SetGlobalInt(L, "Back", (int) filament::backend::CullingMode::BACK);
+		SetGlobalInt(L, "Front", (int) filament::backend::CullingMode::FRONT);
+		
+		SetGlobalInt(L, "Less", (int) filament::backend::SamplerCompareFunc::L);
+		SetGlobalInt(L, "Greater", (int) filament::backend::SamplerCompareFunc::G);
+		SetGlobalInt(L, "LEqual", (int) filament::backend::SamplerCompareFunc::LE);
+		SetGlobalInt(L, "GEqual", (int) filament::backend::SamplerCompareFunc::GE);
+		SetGlobalInt(L, "Equal", (int) filament::backend::SamplerCompareFunc::E);
+		SetGlobalInt(L, "NotEqual", (int) filament::backend::SamplerCompareFunc::NE);
+		SetGlobalInt(L, "Always", (int) filament::backend::SamplerCompareFunc::A);
+
+		SetGlobalInt(L, "Zero", (int) filament::backend::BlendFunction::ZERO);
+		SetGlobalInt(L, "One", (int) filament::backend::BlendFunction::ONE);
+		SetGlobalInt(L, "SrcColor", (int) filament::backend::BlendFunction::SRC_COLOR);
+		SetGlobalInt(L, "SrcAlpha", (int) filament::backend::BlendFunction::SRC_ALPHA);
+		SetGlobalInt(L, "DstColor", (int) filament::backend::BlendFunction::DST_COLOR);
+		SetGlobalInt(L, "DstAlpha", (int) filament::backend::BlendFunction::DST_ALPHA);
+		SetGlobalInt(L, "OneMinusSrcColor", (int) filament::backend::BlendFunction::ONE_MINUS_SRC_COLOR);
+		SetGlobalInt(L, "OneMinusSrcAlpha", (int) filament::backend::BlendFunction::ONE_MINUS_SRC_ALPHA);
+		SetGlobalInt(L, "OneMinusDstColor", (int) filament::backend::BlendFunction::ONE_MINUS_DST_COLOR);
+		SetGlobalInt(L, "OneMinusDstAlpha", (int) filament::backend::BlendFunction::ONE_MINUS_DST_ALPHA);
+
+		SetGlobalInt(L, "Background", (int) Shader::Queue::Background);
+		SetGlobalInt(L, "Geometry", (int) Shader::Queue::Geometry);
+		SetGlobalInt(L, "AlphaTest", (int) Shader::Queue::AlphaTest);
+		SetGlobalInt(L, "Transparent", (int) Shader::Queue::Transparent);
+		SetGlobalInt(L, "Overlay", (int) Shader::Queue::Overlay);
+
+		SetGlobalInt(L, "None", (int) Shader::LightMode::None);
+		SetGlobalInt(L, "Forward", (int) Shader::LightMode::Forward);
+
+		String dir = m_shader_dir + "/" + m_name;
+		dir = dir.Substring(0, dir.LastIndexOf("/"));
+		AddLuaPath(L, dir + "/?.lua");
+
+		if (luaL_dostring(L, src.CString()) != 0)
+		{
+			String error = lua_tostring(L, -1);
+			lua_pop(L, 1);
+			Log("do lua error: %s\n", error.CString());
+			lua_close(L);
+			return false;
+		}
+
+		if (lua_istable(L, -1))
+		{
+			// pass array
+			lua_pushnil(L);
+			while (lua_next(L, -2))
+			{
+				if (lua_istable(L, -1))
+				{
+					// pass
+					Shader::Pass pass;
+					GetTableString(L, "vs", pass.vs);
+					GetTableString(L, "fs", pass.fs);
+
+					lua_pushstring(L, "rs");
+					lua_gettable(L, -2);
+					if (lua_istable(L, -1))
+					{
+						// rs
+						filament::backend::CullingMode culling = filament::backend::CullingMode::BACK;
+						GetTableInt(L, "Cull", culling);
+						pass.pipeline.rasterState.culling = culling;
+
+						filament::backend::SamplerCompareFunc depth_func = filament::backend::SamplerCompareFunc::LE;
+						GetTableInt(L, "ZTest", depth_func);
+						pass.pipeline.rasterState.depthFunc = depth_func;
+
+						bool depth_write = true;
+						GetTableInt(L, "ZWrite", depth_write);
+						pass.pipeline.rasterState.depthWrite = depth_write;
+
+						filament::backend::BlendFunction src_color_blend = filament::backend::BlendFunction::ONE;
+						filament::backend::BlendFunction dst_color_blend = filament::backend::BlendFunction::ZERO;
+                        filament::backend::BlendFunction src_alpha_blend = filament::backend::BlendFunction::ONE;
+                        filament::backend::BlendFunction dst_alpha_blend = filament::backend::BlendFunction::ZERO;
+						GetTableInt(L, "SrcBlendMode", src_color_blend);
+						GetTableInt(L, "DstBlendMode", dst_color_blend);
+                        GetTableInt(L, "SrcBlendMode", src_alpha_blend);
+                        GetTableInt(L, "DstBlendMode", dst_alpha_blend);
+                        GetTableInt(L, "SrcColorBlendMode", src_color_blend);
+                        GetTableInt(L, "DstColorBlendMode", dst_color_blend);
+                        GetTableInt(L, "SrcAlphaBlendMode", src_alpha_blend);
+                        GetTableInt(L, "DstAlphaBlendMode", dst_alpha_blend);
+						pass.pipeline.rasterState.blendFunctionSrcRGB = src_color_blend;
+						pass.pipeline.rasterState.blendFunctionSrcAlpha = src_alpha_blend;
+						pass.pipeline.rasterState.blendFunctionDstRGB = dst_color_blend;
+						pass.pipeline.rasterState.blendFunctionDstAlpha = dst_alpha_blend;
+
+						bool color_write = true;
+						GetTableInt(L, "CWrite", color_write);
+						pass.pipeline.rasterState.colorWrite = color_write;
+
+						GetTableInt(L, "Queue", pass.queue);
+
+						if (m_queue < pass.queue)
+						{
+							m_queue = pass.queue;
+						}
+
+						GetTableInt(L, "LightMode", pass.light_mode);
+						GetTableInt(L, "Instancing", pass.instancing);
+						GetTableInt(L, "LightsClustered", pass.lights_clustered);
+
+						if (pass.light_mode == Shader::LightMode::Forward && m_light_add)
+						{
+							pass.pipeline.rasterState.depthWrite = false;
+							pass.pipeline.rasterState.blendFunctionSrcRGB = src_color_blend;
+							pass.pipeline.rasterState.blendFunctionSrcAlpha = src_alpha_blend;
+							pass.pipeline.rasterState.blendFunctionDstRGB = filament::backend::BlendFunction::ONE;
+							pass.pipeline.rasterState.blendFunctionDstAlpha = filament::backend::BlendFunction::ONE;
+						}
+					}
+					lua_pop(L, 1);
+
+					lua_pushstring(L, "uniforms");
+					lua_gettable(L, -2);
+					if (lua_istable(L, -1))
+					{
+						lua_pushnil(L);
+						while (lua_next(L, -2))
+						{
+							if (lua_istable(L, -1))
+							{
+								Shader::Uniform uniform;
+								GetTableString(L, "name", uniform.name);
+								GetTableInt(L, "binding", uniform.binding);
+
+								int offset = 0;
+
+								lua_pushstring(L, "members");
+								lua_gettable(L, -2);
+								if (lua_istable(L, -1))
+								{
+									lua_pushnil(L);
+									while (lua_next(L, -2))
+									{
+										if (lua_istable(L, -1))
+										{
+											Shader::Member member;
+											GetTableString(L, "name", member.name);
+											GetTableInt(L, "size", member.size);
+
+											member.offset = offset;
+											offset += member.size;
+
+											uniform.members.Add(member);
+										}
+										lua_pop(L, 1);
+									}
+								}
+								lua_pop(L, 1);
+
+								uniform.size = offset;
+
+								pass.uniforms.Add(uniform);
+							}
+							lua_pop(L, 1);
+						}
+					}
+					lua_pop(L, 1);
+
+					lua_pushstring(L, "samplers");
+					lua_gettable(L, -2);
+					if (lua_istable(L, -1))
+					{
+						lua_pushnil(L);
+						while (lua_next(L, -2))
+						{
+							if (lua_istable(L, -1))
+							{
+								Shader::SamplerGroup group;
+								GetTableString(L, "name", group.name);
+								GetTableInt(L, "binding", group.binding);
+
+								lua_pushstring(L, "samplers");
+								lua_gettable(L, -2);
+								if (lua_istable(L, -1))
+								{
+									lua_pushnil(L);
+									while (lua_next(L, -2))
+									{
+										if (lua_istable(L, -1))
+										{
+											Shader::Sampler sampler;
+											GetTableString(L, "name", sampler.name);
+											GetTableInt(L, "binding", sampler.binding);
+
+											group.samplers.Add(sampler);
+										}
+										lua_pop(L, 1);
+									}
+								}
+								lua_pop(L, 1);
+
+								pass.samplers.Add(group);
+							}
+							lua_pop(L, 1);
+						}
+					}
+					lua_pop(L, 1);
+
+					m_passes.Add(pass);
+				}
+				lua_pop(L, 1);
+			}
+			lua_pop(L, 1);
+		}
+
+		lua_close(L);
+		return true;
+	}
+
+	bool ShaderVariant::Compile()
+	{
+		String version = m_glsl_version + "\n";
+		
+		String define;
+		String vk_convert;
+
+		if (m_backend == filament::backend::Backend::VULKAN ||
+            m_backend == filament::backend::Backend::METAL ||
+			m_backend == filament::backend::Backend::D3D11)
+		{
+			define = "#extension GL_ARB_separate_shader_objects : enable\n"
+				"#extension GL_ARB_shading_language_420pack : enable\n"
+				"#define VK_LAYOUT_LOCATION(i) layout(location = i)\n"
+				"#define VK_UNIFORM_BINDING(i) layout(std140, set = 0, binding = i)\n"
+				"#define VK_SAMPLER_BINDING(i) layout(set = 1, binding = i)\n"
+				"#define VR_INSTANCE_ID gl_InstanceIndex\n";
+			if (m_backend == filament::backend::Backend::VULKAN ||
+				m_backend == filament::backend::Backend::METAL)
+			{
+				vk_convert = "void vk_convert() {\n"
+					"gl_Position.y = -gl_Position.y;\n"
+					"gl_Position.z = (gl_Position.z + gl_Position.w) * 0.5;\n"
+					"}\n";
+			}
+			else
+			{
+				vk_convert = "void vk_convert() { }\n";
+			}
+		}
+		else if (m_backend == filament::backend::Backend::OPENGL ||
+			m_backend == filament::backend::Backend::NOOP)
+		{
+			define = "#define VR_GLES 1\n"
+				"#define VK_LAYOUT_LOCATION(i)\n"
+				"#define VK_UNIFORM_BINDING(i) layout(std140)\n"
+				"#define VK_SAMPLER_BINDING(i)\n"
+				"#define VR_INSTANCE_ID gl_InstanceID\n";
+			vk_convert = "void vk_convert() { }\n";
+		}
+		else
+		{
+			assert(false);
+			return false;
+		}
+
+		define += String::Format("#define VR_MAX_INSTANCE_COUNT %d\n", InstancedRendererUniforms::INSTANCE_MAX_COUNT);
+		define += String::Format("#define VR_MAX_CLUSTER_LIGHT_COUNT %d\n", ClusteredLightUniforms::LIGHT_MAX_COUNT);
+
+		for (const auto& i : m_keywords)
+		{
+			define += "#define " + i + " 1\n";
+		}
+
+		m_binaries.Resize(m_passes.Size());
+
+		for (int i = 0; i < m_passes.Size(); ++i)
+		{
+			const auto& pass = m_passes[i];
+
+			String vs = version + define + vk_convert + pass.vs;
+			String fs = version + define + pass.fs;
+			
+			auto& vs_data = m_binaries[i].vs;
+			auto& fs_data = m_binaries[i].fs;
+
+            if (m_backend == filament::backend::Backend::VULKAN)
+            {
+#if VR_VULKAN
+                Vector<unsigned int> vs_spirv;
+                Vector<unsigned int> fs_spirv;
+                if (!GlslToSpirv(vs, ShaderCompiler::ShaderType::Vertex, vs_spirv) ||
+                    !GlslToSpirv(fs, ShaderCompiler::ShaderType::Fragment, fs_spirv))
+                {
+                    return false;
+                }
+
+                vs_data.Resize(vs_spirv.Size() * 4);
+                Memory::Copy(&vs_data[0], &vs_spirv[0], vs_data.Size());
+                fs_data.Resize(fs_spirv.Size() * 4);
+                Memory::Copy(&fs_data[0], &fs_spirv[0], fs_data.Size());
+#endif
+            }
+			else if (m_backend == filament::backend::Backend::D3D11)
+			{
+#if VR_D3D
+				Vector<unsigned int> vs_spirv;
+				Vector<unsigned int> fs_spirv;
+				if (!GlslToSpirv(vs, ShaderCompiler::ShaderType::Vertex, vs_spirv) ||
+					!GlslToSpirv(fs, ShaderCompiler::ShaderType::Fragment, fs_spirv))
+				{
+					return false;
+				}
+
+                spirv_cross::CompilerHLSL::Options options;
+                options.shader_model = 40;
+
+                spirv_cross::CompilerHLSL vs_compiler(&vs_spirv[0], vs_spirv.Size());
+                vs_compiler.set_hlsl_options(options);
+                std::string vs_hlsl = vs_compiler.compile();
+
+                spirv_cross::CompilerHLSL fs_compiler(&fs_spirv[0], fs_spirv.Size());
+                fs_compiler.set_hlsl_options(options);
+                std::string fs_hlsl = fs_compiler.compile();
+
+                vs_data.Resize((int) vs_hlsl.size());
+                Memory::Copy(&vs_data[0], &vs_hlsl[0], (int) vs_hlsl.size());
+                fs_data.Resize((int) fs_hlsl.size());
+                Memory::Copy(&fs_data[0], &fs_hlsl[0], (int) fs_hlsl.size());
+#endif
+			}
+            else if (m_backend == filament::backend::Backend::METAL)
+            {
+#if VR_METAL
+                auto glsl_to_spirv = [](const String& glsl, filament::backend::Program::Shader shader_type, Vector<unsigned int>& spirv) {
+                    MVKShaderStage stage;
+                    switch (shader_type)
+                    {
+                        case filament::backend::Program::Shader::VERTEX:
+                            stage = kMVKShaderStageVertex;
+                            break;
+                        case filament::backend::Program::Shader::FRAGMENT:
+                            stage = kMVKShaderStageFragment;
+                            break;
+                        default:
+                            stage = kMVKShaderStageAuto;
+                            break;
+                    }
+                    uint32_t* spirv_code = nullptr;
+                    size_t size = 0;
+                    char* log = nullptr;
+                    bool success = mvkConvertGLSLToSPIRV(glsl.CString(),
+                                                         stage,
+                                                         &spirv_code,
+                                                         &size,
+                                                         &log,
+                                                         true,
+                                                         true);
+                    if (success)
+                    {
+                        spirv.Resize((int) size / 4);
+                        Memory::Copy(&spirv[0], spirv_code, spirv.SizeInBytes());
+                    }
+                    else
+                    {
+                        Log("shader compile error: %s", log);
+                    }
+                    
+                    free(log);
+                    free(spirv_code);
+                    return success;
+                };
+                auto spirv_to_msl = [](const Vector<unsigned int>& spirv, String& msl) {
+                    char* msl_code = nullptr;
+                    char* log = nullptr;
+                    bool success = mvkConvertSPIRVToMSL((uint32_t*) spirv.Bytes(), spirv.Size(), &msl_code, &log, true, true);
+                    if (success)
+                    {
+                        msl = msl_code;
+                    }
+                    else
+                    {
+                        Log("shader compile error: %s", log);
+                    }
+                    
+                    free(log);
+                    free(msl_code);
+                    return success;
+                };
+                
+                Vector<unsigned int> vs_spirv;
+                Vector<unsigned int> fs_spirv;
+                String vs_msl;
+                String fs_msl;
+                if (!glsl_to_spirv(vs, filament::backend::Program::Shader::VERTEX, vs_spirv) ||
+                    !glsl_to_spirv(fs, filament::backend::Program::Shader::FRAGMENT, fs_spirv) ||
+                    !spirv_to_msl(vs_spirv, vs_msl) ||
+                    !spirv_to_msl(fs_spirv, fs_msl))
+                {
+                    return false;
+                }
+                
+                vs_data.Resize(vs_msl.Size());
+                Memory::Copy(&vs_data[0], &vs_msl[0], vs_msl.Size());
+                fs_data.Resize(fs_msl.Size());
+                Memory::Copy(&fs_data[0], &fs_msl[0], fs_msl.Size());
+#endif
+            }
+			else
+			{
+				vs_data.Resize(vs.Size());
+				memcpy(&vs_data[0], &vs[0], vs_data.Size());
+				fs_data.Resize(fs.Size());
+				memcpy(&fs_data[0], &fs[0], fs_data.Size());
+			}
+		}
+
+		return true;
+	}
+}
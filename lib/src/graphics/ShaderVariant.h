@@ -0,0 +1,71 @@
+/*
+* Viry3D
+* Copyright 2014-2019 by Stack - stackos@qq.com
+*
+* Licensed under the Apache License, Version 2.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at
+*
+*     http://www.apache.org/licenses/LICENSE-2.0
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+*/
+
+#pragma once
+
+#include "Shader.h"
+
+namespace Viry3D
+{
+	// one keyword combination of a shader, parsed pass state and final backend program blobs.
+	// built without engine or driver, so offline tools can fill the shader cache too.
+	// cache file name is a hash of every input of the build, changed inputs only miss the cache.
+	class ShaderVariant
+	{
+	public:
+		// bump when build output changes for the same input, old cache files are never read again
+		static const uint32_t COMPILER_VERSION = 1;
+
+		struct Binary
+		{
+			Vector<char> vs;
+			Vector<char> fs;
+		};
+
+		// shader_dir is the root shader folder, name is relative to it without .lua
+		ShaderVariant(const String& shader_dir, const String& name, const List<String>& keywords, bool light_add, filament::backend::Backend backend);
+		// glsl version line put before all sources, platform default is used if not set
+		void SetGlslVersion(const String& version) { m_glsl_version = version; }
+		// hash of source, required lua files, keywords, backend, glsl version and compiler version
+		String GetCacheKey(const String& src) const;
+		// run lua and compile each pass for backend, false and no passes on lua or compile error
+		bool Build(const String& src);
+		bool ReadCache(const String& path);
+		bool WriteCache(const String& path) const;
+		const String& GetName() const { return m_name; }
+		const List<String>& GetKeywords() const { return m_keywords; }
+		const Vector<Shader::Pass>& GetPasses() const { return m_passes; }
+		const Vector<Binary>& GetBinaries() const { return m_binaries; }
+		int GetQueue() const { return m_queue; }
+		static String GetDefaultGlslVersion(filament::backend::Backend backend);
+
+	private:
+		bool Load(const String& src);
+		bool Compile();
+
+	private:
+		String m_shader_dir;
+		String m_name;
+		List<String> m_keywords;
+		bool m_light_add;
+		filament::backend::Backend m_backend;
+		String m_glsl_version;
+		Vector<Shader::Pass> m_passes;
+		Vector<Binary> m_binaries;
+		int m_queue;
+	};
+}
@@ -19,12 +19,15 @@
 #include "GameObject.h"
 #include "Engine.h"
 #include "Debug.h"
+#include "time/Time.h"
 
 namespace Viry3D
 {
     SkinnedMeshRenderer::SkinnedMeshRenderer():
 		m_blend_shape_dirty(false),
-		m_vb_vertex_count(0)
+		m_bones_slot(-1),
+		m_vb_vertex_count(0),
+		m_bones_bounds_frame(-1)
     {
 
     }
@@ -33,10 +36,10 @@ namespace Viry3D
     {
         auto& driver = Engine::Instance()->GetDriverApi();
         
-        if (m_bones_uniform_buffer)
+        if (m_bones_slot >= 0 && GetBonesArena())
         {
-            driver.destroyUniformBuffer(m_bones_uniform_buffer);
-			m_bones_uniform_buffer.clear();
+            GetBonesArena()->Free(m_bones_slot);
+			m_bones_slot = -1;
         }
 
 		if (m_vb)
@@ -142,6 +145,16 @@ namespace Viry3D
         }
     }
 
+	void SkinnedMeshRenderer::BindUniforms()
+	{
+		MeshRenderer::BindUniforms();
+
+		if (m_bones_slot >= 0)
+		{
+			GetBonesArena()->Bind((size_t) Shader::BindingPoint::PerRendererBones, m_bones_slot);
+		}
+	}
+
     void SkinnedMeshRenderer::Prepare()
     {
 		MeshRenderer::Prepare();
@@ -152,10 +165,7 @@ namespace Viry3D
 		// update bones
         if (materials.Size() > 0 && mesh && m_bone_paths.Size() > 0)
         {
-            const auto& bindposes = mesh->GetBindposes();
-            int bone_count = bindposes.Size();
-
-            assert(m_bone_paths.Size() == bone_count);
+            assert(m_bone_paths.Size() == mesh->GetBindposes().Size());
             assert(m_bone_paths.Size() <= SkinnedMeshRendererUniforms::BONES_VECTOR_MAX_COUNT / 3);
 
             if (m_bones.Empty())
@@ -163,26 +173,16 @@ namespace Viry3D
                 this->FindBones();
             }
 
-            Vector<Vector4> bone_vectors(bone_count * 3);
-
-            for (int i = 0; i < bone_count; ++i)
-            {
-                Matrix4x4 mat = m_bones[i].lock()->GetLocalToWorldMatrix() * bindposes[i];
-
-                bone_vectors[i * 3 + 0] = mat.GetRow(0);
-                bone_vectors[i * 3 + 1] = mat.GetRow(1);
-                bone_vectors[i * 3 + 2] = mat.GetRow(2);
-            }
-
-            auto& driver = Engine::Instance()->GetDriverApi();
-            if (!m_bones_uniform_buffer)
+            if (m_bones_slot < 0)
             {
-                m_bones_uniform_buffer = driver.createUniformBuffer(sizeof(SkinnedMeshRendererUniforms), filament::backend::BufferUsage::DYNAMIC);
+                m_bones_slot = GetBonesArena()->Alloc();
             }
 
-			void* buffer = driver.allocate(bone_vectors.SizeInBytes());
-            Memory::Copy(buffer, bone_vectors.Bytes(), bone_vectors.SizeInBytes());
-            driver.loadUniformBuffer(m_bones_uniform_buffer, filament::backend::BufferDescriptor(buffer, bone_vectors.SizeInBytes()));
+			// lazy bone matrices are resolved on main thread, worker threads only read them
+			for (int i = 0; i < m_bones.Size(); ++i)
+			{
+				m_bones[i].lock()->GetLocalToWorldMatrix();
+			}
         }
 
 		// update blend shapes
@@ -261,6 +261,91 @@ namespace Viry3D
 		}
     }
 
+	void SkinnedMeshRenderer::PrepareUniforms()
+	{
+		MeshRenderer::PrepareUniforms();
+
+		const auto& materials = this->GetMaterials();
+		const auto& mesh = this->GetMesh();
+		if (materials.Size() == 0 || !mesh || m_bone_paths.Size() == 0 || m_bones_slot < 0)
+		{
+			return;
+		}
+
+		const auto& bindposes = mesh->GetBindposes();
+		int bone_count = bindposes.Size();
+
+		Vector<Vector4> bone_vectors(bone_count * 3);
+
+		for (int i = 0; i < bone_count; ++i)
+		{
+			Matrix4x4 mat = m_bones[i].lock()->GetLocalToWorldMatrix() * bindposes[i];
+
+			bone_vectors[i * 3 + 0] = mat.GetRow(0);
+			bone_vectors[i * 3 + 1] = mat.GetRow(1);
+			bone_vectors[i * 3 + 2] = mat.GetRow(2);
+		}
+
+		// still bones are not uploaded again
+		GetBonesArena()->Write(m_bones_slot, bone_vectors.Bytes(), bone_vectors.SizeInBytes());
+	}
+
+    bool SkinnedMeshRenderer::IsBoundsVolatile() const
+    {
+        // bones move without notifying this renderer
+        return m_bone_paths.Size() > 0 || MeshRenderer::IsBoundsVolatile();
+    }
+
+    const Bounds* SkinnedMeshRenderer::GetBounds()
+    {
+        const auto& mesh = this->GetMesh();
+        if (!mesh || m_bone_paths.Size() == 0 || !m_bones_root.lock())
+        {
+            return MeshRenderer::GetBounds();
+        }
+
+        // skinned vertices are in world space, bound them by mesh bounds under every bone, once per frame
+        if (m_bones_bounds_frame != Time::GetFrameCount())
+        {
+            if (m_bones.Empty())
+            {
+                this->FindBones();
+            }
+
+            const auto& bindposes = mesh->GetBindposes();
+            const auto& mesh_bounds = mesh->GetBounds();
+            int bone_count = Mathf::Min(bindposes.Size(), m_bones.Size());
+
+            for (int i = 0; i < bone_count; ++i)
+            {
+                auto bone = m_bones[i].lock();
+                if (!bone)
+                {
+                    return nullptr;
+                }
+
+                Bounds bounds = mesh_bounds.Transform(bone->GetLocalToWorldMatrix() * bindposes[i]);
+                if (i == 0)
+                {
+                    m_bones_bounds = bounds;
+                }
+                else
+                {
+                    m_bones_bounds.Encapsulate(bounds);
+                }
+            }
+
+            if (bone_count == 0)
+            {
+                return nullptr;
+            }
+
+            m_bones_bounds_frame = Time::GetFrameCount();
+        }
+
+        return &m_bones_bounds;
+    }
+
     Vector<filament::backend::RenderPrimitiveHandle> SkinnedMeshRenderer::GetPrimitives()
     {
         Vector<filament::backend::RenderPrimitiveHandle> primitives;
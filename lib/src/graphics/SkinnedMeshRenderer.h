@@ -29,16 +29,19 @@ namespace Viry3D
         virtual ~SkinnedMeshRenderer();
 		virtual void SetMesh(const Ref<Mesh>& mesh);
         const Vector<String>& GetBonePaths() const { return m_bone_paths; }
-        void SetBonePaths(const Vector<String>& bones) { m_bone_paths = bones; }
+        void SetBonePaths(const Vector<String>& bones) { m_bone_paths = bones; this->MarkBoundsDirty(); }
         Ref<Transform> GetBonesRoot() const { return m_bones_root.lock(); }
-        void SetBonesRoot(const Ref<Transform>& node) { m_bones_root = node; }
+        void SetBonesRoot(const Ref<Transform>& node) { m_bones_root = node; this->MarkBoundsDirty(); }
         float GetBlendShapeWeight(const String& name);
         void SetBlendShapeWeight(const String& name, float weight);
-        const filament::backend::UniformBufferHandle& GetBonesUniformBuffer() const { return m_bones_uniform_buffer; }
+		virtual void BindUniforms();
         virtual Vector<filament::backend::RenderPrimitiveHandle> GetPrimitives();
+        virtual const Bounds* GetBounds();
         
 	protected:
 		virtual void Prepare();
+		virtual void PrepareUniforms();
+		virtual bool IsBoundsVolatile() const;
 
     private:
         void FindBones();
@@ -56,10 +59,12 @@ namespace Viry3D
         Vector<WeakRef<Transform>> m_bones;
 		Map<String, BlendShapeWeight> m_blend_shape_weights;
 		bool m_blend_shape_dirty;
-        filament::backend::UniformBufferHandle m_bones_uniform_buffer;
+		int m_bones_slot;
 		filament::backend::VertexBufferHandle m_vb;
 		Vector<filament::backend::RenderPrimitiveHandle> m_primitives;
 		int m_vb_vertex_count;
 		Vector<Mesh::Submesh> m_submeshes;
+		Bounds m_bones_bounds;
+		int m_bones_bounds_frame;
     };
 }
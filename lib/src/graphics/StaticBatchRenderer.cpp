@@ -0,0 +1,165 @@
+/*
+* Viry3D
+* Copyright 2014-2019 by Stack - stackos@qq.com
+*
+* Licensed under the Apache License, Version 2.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at
+*
+*     http://www.apache.org/licenses/LICENSE-2.0
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+*/
+
+#include "StaticBatchRenderer.h"
+#include "GameObject.h"
+#include "Engine.h"
+
+namespace Viry3D
+{
+	StaticBatchRenderer::StaticBatchRenderer():
+		m_world_bounds_dirty(true)
+	{
+
+	}
+
+	StaticBatchRenderer::~StaticBatchRenderer()
+	{
+		this->ClearPrimitives();
+	}
+
+	void StaticBatchRenderer::ClearPrimitives()
+	{
+		auto& driver = Engine::Instance()->GetDriverApi();
+
+		for (int i = 0; i < m_ranges.Size(); ++i)
+		{
+			if (m_ranges[i].primitive)
+			{
+				driver.destroyRenderPrimitive(m_ranges[i].primitive);
+				m_ranges[i].primitive.clear();
+			}
+		}
+		m_ranges.Clear();
+	}
+
+	void StaticBatchRenderer::SetParts(const Vector<Part>& parts, const Vector<Group>& groups)
+	{
+		auto& driver = Engine::Instance()->GetDriverApi();
+		const auto& mesh = this->GetMesh();
+
+		this->ClearPrimitives();
+
+		m_parts = parts;
+		m_groups = groups;
+		m_world_bounds.Resize(m_parts.Size());
+		m_world_bounds_dirty = true;
+
+		m_ranges.Resize(m_groups.Size());
+		for (int i = 0; i < m_groups.Size(); ++i)
+		{
+			m_ranges[i].primitive = driver.createRenderPrimitive();
+			m_ranges[i].part_first = -1;
+			m_ranges[i].part_count = 0;
+
+			driver.setRenderPrimitiveBuffer(m_ranges[i].primitive, mesh->GetVertexBuffer(), mesh->GetIndexBuffer(), mesh->GetEnabledAttributes());
+			this->SetGroupRange(i, m_groups[i].part_first, m_groups[i].part_count);
+		}
+	}
+
+	void StaticBatchRenderer::SetGroupRange(int group, int part_first, int part_count)
+	{
+		auto& range = m_ranges[group];
+		if (range.part_first == part_first && range.part_count == part_count)
+		{
+			return;
+		}
+
+		range.part_first = part_first;
+		range.part_count = part_count;
+
+		if (part_count == 0)
+		{
+			return;
+		}
+
+		const auto& mesh = this->GetMesh();
+		const auto& submeshes = mesh->GetSubmeshes();
+		const auto& first = submeshes[m_parts[part_first].submesh];
+		const auto& last = submeshes[m_parts[part_first + part_count - 1].submesh];
+		int index_count = last.index_first + last.index_count - first.index_first;
+
+		auto& driver = Engine::Instance()->GetDriverApi();
+		driver.setRenderPrimitiveRange(range.primitive, filament::backend::PrimitiveType::TRIANGLES, first.index_first, 0, mesh->GetVertices().Size() - 1, index_count);
+	}
+
+	int StaticBatchRenderer::GetVisiblePartCount() const
+	{
+		int count = 0;
+		for (int i = 0; i < m_ranges.Size(); ++i)
+		{
+			count += m_ranges[i].part_count;
+		}
+		return count;
+	}
+
+	Vector<filament::backend::RenderPrimitiveHandle> StaticBatchRenderer::GetPrimitives()
+	{
+		Vector<filament::backend::RenderPrimitiveHandle> primitives(m_ranges.Size());
+
+		for (int i = 0; i < m_ranges.Size(); ++i)
+		{
+			if (m_ranges[i].part_count > 0)
+			{
+				primitives[i] = m_ranges[i].primitive;
+			}
+		}
+
+		return primitives;
+	}
+
+	void StaticBatchRenderer::CullParts(const Frustum& frustum)
+	{
+		if (m_world_bounds_dirty)
+		{
+			m_world_bounds_dirty = false;
+
+			const Matrix4x4& local_to_world = this->GetTransform()->GetLocalToWorldMatrix();
+			for (int i = 0; i < m_parts.Size(); ++i)
+			{
+				m_world_bounds[i] = m_parts[i].bounds.Transform(local_to_world);
+			}
+		}
+
+		// trim invisible parts at both ends of each group,
+		// parts are sorted in space so visible ones tend to be adjacent
+		for (int i = 0; i < m_groups.Size(); ++i)
+		{
+			const auto& group = m_groups[i];
+			int begin = group.part_first;
+			int end = group.part_first + group.part_count;
+
+			while (begin < end && frustum.ContainsBounds(m_world_bounds[begin]) == ContainsResult::Out)
+			{
+				++begin;
+			}
+			while (end > begin && frustum.ContainsBounds(m_world_bounds[end - 1]) == ContainsResult::Out)
+			{
+				--end;
+			}
+
+			this->SetGroupRange(i, begin, end - begin);
+		}
+	}
+
+	void StaticBatchRenderer::OnTransformDirty()
+	{
+		MeshRenderer::OnTransformDirty();
+
+		m_world_bounds_dirty = true;
+	}
+}
@@ -0,0 +1,75 @@
+/*
+* Viry3D
+* Copyright 2014-2019 by Stack - stackos@qq.com
+*
+* Licensed under the Apache License, Version 2.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at
+*
+*     http://www.apache.org/licenses/LICENSE-2.0
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+*/
+
+#pragma once
+
+#include "MeshRenderer.h"
+
+namespace Viry3D
+{
+	// renders a mesh merged by StaticBatcher,
+	// each source renderer submesh is a part with own submesh range,
+	// parts of same material are adjacent and drawn by one primitive
+	// covering the range from first to last visible part.
+	class StaticBatchRenderer : public MeshRenderer
+	{
+	public:
+		struct Part
+		{
+			// in mesh space
+			Bounds bounds;
+			int submesh;
+		};
+
+		// group i is drawn with material i
+		struct Group
+		{
+			int part_first;
+			int part_count;
+		};
+
+		StaticBatchRenderer();
+		virtual ~StaticBatchRenderer();
+		// call after SetMesh
+		void SetParts(const Vector<Part>& parts, const Vector<Group>& groups);
+		int GetPartCount() const { return m_parts.Size(); }
+		int GetVisiblePartCount() const;
+		virtual Vector<filament::backend::RenderPrimitiveHandle> GetPrimitives();
+		virtual void CullParts(const Frustum& frustum);
+
+	protected:
+		virtual void OnTransformDirty();
+
+	private:
+		struct GroupRange
+		{
+			filament::backend::RenderPrimitiveHandle primitive;
+			int part_first;
+			int part_count;
+		};
+
+		void ClearPrimitives();
+		void SetGroupRange(int group, int part_first, int part_count);
+
+	private:
+		Vector<Part> m_parts;
+		Vector<Group> m_groups;
+		Vector<GroupRange> m_ranges;
+		Vector<Bounds> m_world_bounds;
+		bool m_world_bounds_dirty;
+	};
+}
@@ -0,0 +1,352 @@
+/*
+* Viry3D
+* Copyright 2014-2019 by Stack - stackos@qq.com
+*
+* Licensed under the Apache License, Version 2.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at
+*
+*     http://www.apache.org/licenses/LICENSE-2.0
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+*/
+
+#include "StaticBatcher.h"
+#include "StaticBatchRenderer.h"
+#include "SkinnedMeshRenderer.h"
+#include "animation/Animation.h"
+#include "container/List.h"
+#include "math/Mathf.h"
+
+namespace Viry3D
+{
+	struct BatchPiece
+	{
+		int source;
+		int submesh;
+		// in root space
+		Vector3 center;
+	};
+
+	struct BatchGroup
+	{
+		Ref<Material> material;
+		List<BatchPiece> pieces;
+	};
+
+	struct Batch
+	{
+		int layer;
+		int lightmap_index;
+		bool cast_shadow;
+		bool recieve_shadow;
+		Vector<Ref<MeshRenderer>> sources;
+		Vector<BatchGroup> groups;
+	};
+
+	static bool CanBatch(const Ref<MeshRenderer>& renderer)
+	{
+		if (RefCast<SkinnedMeshRenderer>(renderer) || RefCast<StaticBatchRenderer>(renderer))
+		{
+			return false;
+		}
+
+		auto obj = renderer->GetGameObject();
+		if (!obj->IsStatic() || !obj->IsActiveInTree())
+		{
+			return false;
+		}
+
+		// animated objects are not static even if marked
+		Ref<Transform> node = renderer->GetTransform();
+		while (node)
+		{
+			if (node->GetGameObject()->GetComponent<Animation>())
+			{
+				return false;
+			}
+			node = node->GetParent();
+		}
+
+		const auto& mesh = renderer->GetMesh();
+		if (!mesh || mesh->IsDynamic() || mesh->GetBlendShapes().Size() > 0)
+		{
+			return false;
+		}
+
+		return renderer->GetMaterials().Size() > 0;
+	}
+
+	static Batch& FindBatch(Vector<Batch>& batches, const Ref<MeshRenderer>& renderer)
+	{
+		int layer = renderer->GetGameObject()->GetLayer();
+		int lightmap_index = renderer->GetLightmapIndex();
+
+		for (int i = 0; i < batches.Size(); ++i)
+		{
+			auto& batch = batches[i];
+			if (batch.layer == layer &&
+				batch.lightmap_index == lightmap_index &&
+				batch.cast_shadow == renderer->IsCastShadow() &&
+				batch.recieve_shadow == renderer->IsRecieveShadow())
+			{
+				return batch;
+			}
+		}
+
+		Batch batch;
+		batch.layer = layer;
+		batch.lightmap_index = lightmap_index;
+		batch.cast_shadow = renderer->IsCastShadow();
+		batch.recieve_shadow = renderer->IsRecieveShadow();
+		batches.Add(batch);
+
+		return batches[batches.Size() - 1];
+	}
+
+	static BatchGroup& FindGroup(Batch& batch, const Ref<Material>& material)
+	{
+		for (int i = 0; i < batch.groups.Size(); ++i)
+		{
+			if (batch.groups[i].material == material)
+			{
+				return batch.groups[i];
+			}
+		}
+
+		BatchGroup group;
+		group.material = material;
+		batch.groups.Add(group);
+
+		return batch.groups[batch.groups.Size() - 1];
+	}
+
+	// order pieces along the longest axis, so pieces near each other are adjacent in index buffer
+	static void SortPieces(List<BatchPiece>& pieces)
+	{
+		if (pieces.Size() <= 1)
+		{
+			return;
+		}
+
+		Vector3 min = pieces.First().center;
+		Vector3 max = min;
+		for (const auto& i : pieces)
+		{
+			min = Vector3::Min(min, i.center);
+			max = Vector3::Max(max, i.center);
+		}
+
+		Vector3 size = max - min;
+		Vector3 axis;
+		if (size.x >= size.y && size.x >= size.z)
+		{
+			axis = Vector3(1, 0, 0);
+		}
+		else if (size.y >= size.z)
+		{
+			axis = Vector3(0, 1, 0);
+		}
+		else
+		{
+			axis = Vector3(0, 0, 1);
+		}
+
+		pieces.Sort([&](const BatchPiece& a, const BatchPiece& b) {
+			return Vector3::Dot(a.center, axis) < Vector3::Dot(b.center, axis);
+		});
+	}
+
+	static void BuildBatch(const Ref<GameObject>& root, Batch& batch)
+	{
+		const Matrix4x4& world_to_root = root->GetTransform()->GetWorldToLocalMatrix();
+
+		Vector<Mesh::Vertex> vertices;
+		Vector<unsigned int> indices;
+		Vector<Mesh::Submesh> submeshes;
+		Vector<StaticBatchRenderer::Part> parts;
+		Vector<StaticBatchRenderer::Group> groups;
+		Vector<Ref<Material>> materials;
+		Vector<int> base_vertices(batch.sources.Size());
+		Vector<byte> flip_faces(batch.sources.Size());
+
+		for (int i = 0; i < batch.sources.Size(); ++i)
+		{
+			const auto& source = batch.sources[i];
+			Matrix4x4 to_root = world_to_root * source->GetTransform()->GetLocalToWorldMatrix();
+			Matrix4x4 normal_matrix = to_root.Inverse().Transpose();
+
+			// mirrored transform flips triangle winding
+			Vector3 axis_x = to_root.MultiplyDirection(Vector3(1, 0, 0));
+			Vector3 axis_y = to_root.MultiplyDirection(Vector3(0, 1, 0));
+			Vector3 axis_z = to_root.MultiplyDirection(Vector3(0, 0, 1));
+			flip_faces[i] = Vector3::Dot(axis_x * axis_y, axis_z) < 0 ? 1 : 0;
+
+			const Vector4& lightmap_scale_offset = source->GetLightmapScaleOffset();
+			const auto& source_vertices = source->GetMesh()->GetVertices();
+
+			base_vertices[i] = vertices.Size();
+			for (int j = 0; j < source_vertices.Size(); ++j)
+			{
+				Mesh::Vertex v = source_vertices[j];
+				v.vertex = to_root.MultiplyPoint3x4(v.vertex);
+				v.normal = Vector3::Normalize(normal_matrix.MultiplyDirection(v.normal));
+				Vector3 tangent = Vector3::Normalize(to_root.MultiplyDirection(Vector3(v.tangent.x, v.tangent.y, v.tangent.z)));
+				v.tangent = Vector4(tangent, flip_faces[i] ? -v.tangent.w : v.tangent.w);
+				if (batch.lightmap_index >= 0)
+				{
+					v.uv2 = Vector2(
+						v.uv2.x * lightmap_scale_offset.x + lightmap_scale_offset.z,
+						v.uv2.y * lightmap_scale_offset.y + lightmap_scale_offset.w);
+				}
+				vertices.Add(v);
+			}
+		}
+
+		for (int i = 0; i < batch.groups.Size(); ++i)
+		{
+			auto& batch_group = batch.groups[i];
+			SortPieces(batch_group.pieces);
+
+			StaticBatchRenderer::Group group;
+			group.part_first = parts.Size();
+			group.part_count = batch_group.pieces.Size();
+
+			for (const auto& piece : batch_group.pieces)
+			{
+				const auto& source_mesh = batch.sources[piece.source]->GetMesh();
+				const auto& source_submesh = source_mesh->GetSubmeshes()[piece.submesh];
+				const auto& source_indices = source_mesh->GetIndices();
+				int base_vertex = base_vertices[piece.source];
+				bool flip = flip_faces[piece.source] != 0;
+
+				Mesh::Submesh submesh;
+				submesh.index_first = indices.Size();
+
+				Vector3 min = piece.center;
+				Vector3 max = piece.center;
+				for (int j = 0; j + 2 < source_submesh.index_count; j += 3)
+				{
+					unsigned int a = base_vertex + source_indices[source_submesh.index_first + j];
+					unsigned int b = base_vertex + source_indices[source_submesh.index_first + j + 1];
+					unsigned int c = base_vertex + source_indices[source_submesh.index_first + j + 2];
+					if (flip)
+					{
+						Mathf::Swap(b, c);
+					}
+					indices.Add(a);
+					indices.Add(b);
+					indices.Add(c);
+
+					if (j == 0)
+					{
+						min = vertices[a].vertex;
+						max = vertices[a].vertex;
+					}
+					min = Vector3::Min(min, Vector3::Min(vertices[a].vertex, Vector3::Min(vertices[b].vertex, vertices[c].vertex)));
+					max = Vector3::Max(max, Vector3::Max(vertices[a].vertex, Vector3::Max(vertices[b].vertex, vertices[c].vertex)));
+				}
+
+				submesh.index_count = indices.Size() - submesh.index_first;
+
+				StaticBatchRenderer::Part part;
+				part.bounds = Bounds(min, max);
+				part.submesh = submeshes.Size();
+
+				submeshes.Add(submesh);
+				parts.Add(part);
+			}
+
+			groups.Add(group);
+			materials.Add(batch_group.material);
+		}
+
+		bool uint32_index = vertices.Size() > 65535;
+		Ref<Mesh> mesh = RefMake<Mesh>(std::move(vertices), std::move(indices), submeshes, uint32_index);
+		mesh->SetName("StaticBatch");
+
+		Ref<GameObject> obj = GameObject::Create("StaticBatch");
+		obj->SetLayer(batch.layer);
+		obj->SetStatic(true);
+		obj->GetTransform()->SetParent(root->GetTransform());
+		obj->GetTransform()->SetLocalPosition(Vector3::Zero());
+		obj->GetTransform()->SetLocalRotation(Quaternion::Identity());
+		obj->GetTransform()->SetLocalScale(Vector3::One());
+
+		auto renderer = obj->AddComponent<StaticBatchRenderer>();
+		renderer->SetMaterials(materials);
+		renderer->SetMesh(mesh);
+		renderer->SetParts(parts, groups);
+		renderer->EnableCastShadow(batch.cast_shadow);
+		renderer->EnableRecieveShadow(batch.recieve_shadow);
+		if (batch.lightmap_index >= 0)
+		{
+			// lightmap scale offset is baked into uv2
+			renderer->SetLightmapIndex(batch.lightmap_index);
+			renderer->SetLightmapScaleOffset(Vector4(1, 1, 0, 0));
+		}
+
+		for (int i = 0; i < batch.sources.Size(); ++i)
+		{
+			const auto& source = batch.sources[i];
+			source->GetGameObject()->RemoveComponent(source);
+		}
+	}
+
+	int StaticBatcher::Combine(const Ref<GameObject>& root)
+	{
+		const Matrix4x4& world_to_root = root->GetTransform()->GetWorldToLocalMatrix();
+		Vector<Ref<MeshRenderer>> renderers = root->GetComponentsInChildren<MeshRenderer>();
+		Vector<Batch> batches;
+
+		for (int i = 0; i < renderers.Size(); ++i)
+		{
+			const auto& renderer = renderers[i];
+			if (!CanBatch(renderer))
+			{
+				continue;
+			}
+
+			Batch& batch = FindBatch(batches, renderer);
+			int source = batch.sources.Size();
+			batch.sources.Add(renderer);
+
+			BatchPiece piece;
+			piece.source = source;
+			piece.center = world_to_root.MultiplyPoint3x4(renderer->GetBounds()->GetCenter());
+
+			const auto& materials = renderer->GetMaterials();
+			int submesh_count = renderer->GetMesh()->GetSubmeshes().Size();
+			for (int j = 0; j < materials.Size(); ++j)
+			{
+				if (!materials[j])
+				{
+					continue;
+				}
+
+				// same as camera, extra materials draw the first submesh
+				piece.submesh = j < submesh_count ? j : 0;
+				FindGroup(batch, materials[j]).pieces.AddLast(piece);
+			}
+		}
+
+		int count = 0;
+		for (int i = 0; i < batches.Size(); ++i)
+		{
+			// single renderer gains nothing
+			if (batches[i].sources.Size() < 2)
+			{
+				continue;
+			}
+
+			BuildBatch(root, batches[i]);
+			count += batches[i].sources.Size();
+		}
+
+		return count;
+	}
+}
@@ -0,0 +1,33 @@
+/*
+* Viry3D
+* Copyright 2014-2019 by Stack - stackos@qq.com
+*
+* Licensed under the Apache License, Version 2.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at
+*
+*     http://www.apache.org/licenses/LICENSE-2.0
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+*/
+
+#pragma once
+
+#include "GameObject.h"
+
+namespace Viry3D
+{
+	class StaticBatcher
+	{
+	public:
+		// merge mesh renderers of static game objects under root into StaticBatchRenderers,
+		// renderers are merged if layer, lightmap and shadow settings are same,
+		// vertices are baked into root space so root can still be moved as a whole,
+		// merged renderers are removed, return count of merged renderers.
+		static int Combine(const Ref<GameObject>& root);
+	};
+}
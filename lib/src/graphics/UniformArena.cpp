@@ -0,0 +1,121 @@
+/*
+* Viry3D
+* Copyright 2014-2019 by Stack - stackos@qq.com
+*
+* Licensed under the Apache License, Version 2.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at
+*
+*     http://www.apache.org/licenses/LICENSE-2.0
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+*/
+
+#include "UniformArena.h"
+#include "Engine.h"
+#include "math/Mathf.h"
+
+namespace Viry3D
+{
+	static const int ARENA_MIN_SLOT_COUNT = 64;
+
+	UniformArena::UniformArena(int block_size):
+		m_block_size(block_size),
+		m_slot_size((block_size + ALIGNMENT - 1) / ALIGNMENT * ALIGNMENT),
+		m_slot_count(0),
+		m_dirty(false),
+		m_buffer_slot_count(0)
+	{
+	
+	}
+
+	UniformArena::~UniformArena()
+	{
+		if (m_buffer)
+		{
+			auto& driver = Engine::Instance()->GetDriverApi();
+			driver.destroyUniformBuffer(m_buffer);
+			m_buffer.clear();
+		}
+	}
+
+	int UniformArena::Alloc()
+	{
+		if (m_free_slots.Size() > 0)
+		{
+			int slot = m_free_slots[m_free_slots.Size() - 1];
+			m_free_slots.Resize(m_free_slots.Size() - 1);
+			return slot;
+		}
+
+		int slot = m_slot_count++;
+		m_data.Resize(m_slot_count * m_slot_size, 0);
+		return slot;
+	}
+
+	void UniformArena::Free(int slot)
+	{
+		m_free_slots.Add(slot);
+	}
+
+	void UniformArena::Write(int slot, const void* data, int size)
+	{
+		assert(slot >= 0 && slot < m_slot_count);
+		assert(size <= m_block_size);
+
+		byte* block = m_data.Bytes(slot * m_slot_size);
+		if (Memory::Compare(block, data, size) != 0)
+		{
+			Memory::Copy(block, data, size);
+			m_dirty = true;
+		}
+	}
+
+	void UniformArena::Upload()
+	{
+		if (m_slot_count > m_buffer_slot_count)
+		{
+			auto& driver = Engine::Instance()->GetDriverApi();
+			if (m_buffer)
+			{
+				driver.destroyUniformBuffer(m_buffer);
+				m_buffer.clear();
+			}
+
+			// gl orphans stream buffers on upload instead of waiting for gpu,
+			// other backends do not support stream uniform buffers
+			filament::backend::BufferUsage usage = filament::backend::BufferUsage::DYNAMIC;
+			if (Engine::Instance()->GetBackend() == filament::backend::Backend::OPENGL)
+			{
+				usage = filament::backend::BufferUsage::STREAM;
+			}
+
+			m_buffer_slot_count = Mathf::Max(Mathf::Max(m_slot_count, m_buffer_slot_count * 2), ARENA_MIN_SLOT_COUNT);
+			m_buffer = driver.createUniformBuffer(m_buffer_slot_count * m_slot_size, usage);
+			m_dirty = true;
+		}
+
+		if (!m_dirty)
+		{
+			return;
+		}
+		m_dirty = false;
+
+		// whole used range, d3d discards buffer on write
+		auto& driver = Engine::Instance()->GetDriverApi();
+		int size = m_slot_count * m_slot_size;
+		void* buffer = driver.allocate(size);
+		Memory::Copy(buffer, m_data.Bytes(), size);
+		driver.loadUniformBuffer(m_buffer, filament::backend::BufferDescriptor(buffer, size));
+	}
+
+	void UniformArena::Bind(size_t binding, int slot)
+	{
+		auto& driver = Engine::Instance()->GetDriverApi();
+		driver.bindUniformBufferRange(binding, m_buffer, slot * m_slot_size, m_block_size);
+	}
+}
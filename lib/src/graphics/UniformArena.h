@@ -0,0 +1,58 @@
+/*
+* Viry3D
+* Copyright 2014-2019 by Stack - stackos@qq.com
+*
+* Licensed under the Apache License, Version 2.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at
+*
+*     http://www.apache.org/licenses/LICENSE-2.0
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+*/
+
+#pragma once
+
+#include "container/Vector.h"
+#include "memory/Memory.h"
+#include "private/backend/DriverApi.h"
+#include <atomic>
+
+namespace Viry3D
+{
+	// one large uniform buffer shared by many uniform blocks of same size,
+	// each block owns an aligned slot, blocks are written on cpu,
+	// and changed blocks are uploaded with one command per frame, then bound with buffer offset.
+	class UniformArena
+	{
+	public:
+		// max uniform buffer offset alignment of backends
+		static const int ALIGNMENT = 256;
+
+		UniformArena(int block_size);
+		~UniformArena();
+		int Alloc();
+		void Free(int slot);
+		// block is only marked changed if data differs,
+		// different slots may be written from worker threads, alloc and upload stay on main thread
+		void Write(int slot, const void* data, int size);
+		// upload all slots if any block changed since last upload
+		void Upload();
+		void Bind(size_t binding, int slot);
+		int GetSlotCount() const { return m_slot_count - m_free_slots.Size(); }
+
+	private:
+		int m_block_size;
+		int m_slot_size;
+		int m_slot_count;
+		Vector<int> m_free_slots;
+		Vector<byte> m_data;
+		std::atomic<bool> m_dirty;
+		int m_buffer_slot_count;
+		filament::backend::UniformBufferHandle m_buffer;
+	};
+}
@@ -112,14 +112,8 @@ namespace Viry3D
 
 		if (exist != nullptr)
 		{
-			if (dir != nullptr && (readdir(dir)->d_type & DT_DIR) != 0)
-			{
-				*exist = true;
-			}
-			else
-			{
-				*exist = false;
-			}
+			// first entry is not always "." so only opendir tells
+			*exist = dir != nullptr;
 
 			if (dir != nullptr)
 			{
@@ -208,16 +202,20 @@ namespace Viry3D
 	void Directory::Create(const String& path)
 	{
 		auto splits = path.Split("/", true);
-		String folder = splits[0];
+		String folder;
 
 		if (path.StartsWith("/"))
 		{
-			folder = "/" + folder;
+			folder = "/";
 		}
 
-		for (int i = 1; i < splits.Size(); ++i)
+		for (int i = 0; i < splits.Size(); ++i)
 		{
-			folder += "/" + splits[i];
+			if (i > 0)
+			{
+				folder += "/";
+			}
+			folder += splits[i];
 
 #if VR_WINDOWS || VR_UWP
 			CreateDirectoryA(folder.CString(), nullptr);
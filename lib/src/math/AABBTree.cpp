@@ -0,0 +1,760 @@
+/*
+* Viry3D
+* Copyright 2014-2019 by Stack - stackos@qq.com
+*
+* Licensed under the Apache License, Version 2.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at
+*
+*     http://www.apache.org/licenses/LICENSE-2.0
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+*/
+
+#include "AABBTree.h"
+#include "Mathf.h"
+#include <assert.h>
+
+namespace Viry3D
+{
+	// traversal stack, no heap allocation until tree is very deep
+	template<class T>
+	class QueryStack
+	{
+	public:
+		QueryStack(): m_count(0) { }
+		bool Empty() const { return m_count == 0; }
+
+		void Push(const T& v)
+		{
+			if (m_count < FixedSize)
+			{
+				m_fixed[m_count] = v;
+			}
+			else
+			{
+				m_spill.Add(v);
+			}
+			++m_count;
+		}
+
+		T Pop()
+		{
+			--m_count;
+			if (m_count < FixedSize)
+			{
+				return m_fixed[m_count];
+			}
+			else
+			{
+				T v = m_spill[m_spill.Size() - 1];
+				m_spill.Resize(m_spill.Size() - 1);
+				return v;
+			}
+		}
+
+	private:
+		static const int FixedSize = 64;
+		T m_fixed[FixedSize];
+		Vector<T> m_spill;
+		int m_count;
+	};
+
+	static Bounds Union(const Bounds& a, const Bounds& b)
+	{
+		return Bounds(Vector3::Min(a.Min(), b.Min()), Vector3::Max(a.Max(), b.Max()));
+	}
+
+	static float Perimeter(const Bounds& bounds)
+	{
+		Vector3 size = bounds.Max() - bounds.Min();
+		return 2.0f * (size.x * size.y + size.y * size.z + size.z * size.x);
+	}
+
+	static bool BoundsContains(const Bounds& outer, const Bounds& inner)
+	{
+		return outer.Min().x <= inner.Min().x && outer.Min().y <= inner.Min().y && outer.Min().z <= inner.Min().z &&
+			outer.Max().x >= inner.Max().x && outer.Max().y >= inner.Max().y && outer.Max().z >= inner.Max().z;
+	}
+
+	static bool SphereIntersects(const Bounds& bounds, const Vector3& center, float radius)
+	{
+		const Vector3& min = bounds.Min();
+		const Vector3& max = bounds.Max();
+		Vector3 closest(
+			Mathf::Clamp(center.x, min.x, max.x),
+			Mathf::Clamp(center.y, min.y, max.y),
+			Mathf::Clamp(center.z, min.z, max.z));
+
+		return (closest - center).SqrMagnitude() <= radius * radius;
+	}
+
+	// test bounding sphere of box against cone, conservative
+	static bool ConeIntersects(const Bounds& bounds, const Vector3& apex, const Vector3& direction, float sin_angle, float cos_angle, float range)
+	{
+		Vector3 center = bounds.GetCenter();
+		float radius = bounds.GetExtents().Magnitude();
+
+		Vector3 v = center - apex;
+		float v_sqr = v.SqrMagnitude();
+		if (v_sqr <= radius * radius)
+		{
+			return true;
+		}
+
+		float along = v.Dot(direction);
+		if (along > range + radius || along < -radius)
+		{
+			return false;
+		}
+
+		float away = sqrt(Mathf::Max(v_sqr - along * along, 0.0f));
+		return away * cos_angle - along * sin_angle <= radius;
+	}
+
+	static bool RaySlab(float min, float max, float origin, float inv_dir, float& t_min, float& t_max)
+	{
+		float t0 = (min - origin) * inv_dir;
+		float t1 = (max - origin) * inv_dir;
+		if (t0 > t1)
+		{
+			Mathf::Swap(t0, t1);
+		}
+
+		t_min = Mathf::Max(t_min, t0);
+		t_max = Mathf::Min(t_max, t1);
+
+		return t_min <= t_max;
+	}
+
+	static bool RayIntersects(const Bounds& bounds, const Vector3& origin, const Vector3& inv_dir, float max_distance)
+	{
+		float t_min = 0;
+		float t_max = max_distance;
+
+		return RaySlab(bounds.Min().x, bounds.Max().x, origin.x, inv_dir.x, t_min, t_max) &&
+			RaySlab(bounds.Min().y, bounds.Max().y, origin.y, inv_dir.y, t_min, t_max) &&
+			RaySlab(bounds.Min().z, bounds.Max().z, origin.z, inv_dir.z, t_min, t_max);
+	}
+
+	AABBTree::AABBTree(float margin):
+		m_root(NullProxy),
+		m_free_list(NullProxy),
+		m_proxy_count(0),
+		m_margin(margin)
+	{
+	}
+
+	int AABBTree::AllocateNode()
+	{
+		if (m_free_list == NullProxy)
+		{
+			int old_size = m_nodes.Size();
+			int new_size = Mathf::Max(16, old_size * 2);
+			m_nodes.Resize(new_size);
+
+			for (int i = old_size; i < new_size; ++i)
+			{
+				m_nodes[i].parent = i + 1 < new_size ? i + 1 : NullProxy;
+				m_nodes[i].height = -1;
+			}
+			m_free_list = old_size;
+		}
+
+		int node = m_free_list;
+		m_free_list = m_nodes[node].parent;
+
+		Node& n = m_nodes[node];
+		n.user_data = nullptr;
+		n.parent = NullProxy;
+		n.left = NullProxy;
+		n.right = NullProxy;
+		n.height = 0;
+
+		return node;
+	}
+
+	void AABBTree::FreeNode(int node)
+	{
+		m_nodes[node].parent = m_free_list;
+		m_nodes[node].height = -1;
+		m_free_list = node;
+	}
+
+	int AABBTree::CreateProxy(const Bounds& bounds, void* user_data)
+	{
+		int proxy = this->AllocateNode();
+
+		Vector3 margin(m_margin, m_margin, m_margin);
+		m_nodes[proxy].bounds = Bounds(bounds.Min() - margin, bounds.Max() + margin);
+		m_nodes[proxy].user_data = user_data;
+
+		this->InsertLeaf(proxy);
+		++m_proxy_count;
+
+		return proxy;
+	}
+
+	void AABBTree::DestroyProxy(int proxy)
+	{
+		assert(proxy >= 0 && proxy < m_nodes.Size() && m_nodes[proxy].IsLeaf());
+
+		this->RemoveLeaf(proxy);
+		this->FreeNode(proxy);
+		--m_proxy_count;
+	}
+
+	bool AABBTree::MoveProxy(int proxy, const Bounds& bounds)
+	{
+		assert(proxy >= 0 && proxy < m_nodes.Size() && m_nodes[proxy].IsLeaf());
+
+		if (BoundsContains(m_nodes[proxy].bounds, bounds))
+		{
+			return false;
+		}
+
+		this->RemoveLeaf(proxy);
+
+		Vector3 margin(m_margin, m_margin, m_margin);
+		m_nodes[proxy].bounds = Bounds(bounds.Min() - margin, bounds.Max() + margin);
+
+		this->InsertLeaf(proxy);
+
+		return true;
+	}
+
+	int AABBTree::GetHeight() const
+	{
+		if (m_root == NullProxy)
+		{
+			return 0;
+		}
+
+		return m_nodes[m_root].height;
+	}
+
+	void AABBTree::Clear()
+	{
+		m_nodes.Clear();
+		m_root = NullProxy;
+		m_free_list = NullProxy;
+		m_proxy_count = 0;
+	}
+
+	void AABBTree::InsertLeaf(int leaf)
+	{
+		if (m_root == NullProxy)
+		{
+			m_root = leaf;
+			m_nodes[m_root].parent = NullProxy;
+			return;
+		}
+
+		// find best sibling by surface area heuristic
+		Bounds leaf_bounds = m_nodes[leaf].bounds;
+		int index = m_root;
+		while (!m_nodes[index].IsLeaf())
+		{
+			const Node& node = m_nodes[index];
+			int left = node.left;
+			int right = node.right;
+
+			float area = Perimeter(node.bounds);
+			float combined_area = Perimeter(Union(node.bounds, leaf_bounds));
+
+			// cost of creating a new parent for this node and the new leaf
+			float cost = 2.0f * combined_area;
+			// minimum cost of pushing the leaf further down the tree
+			float inheritance_cost = 2.0f * (combined_area - area);
+
+			float cost_left = Perimeter(Union(m_nodes[left].bounds, leaf_bounds)) + inheritance_cost;
+			if (!m_nodes[left].IsLeaf())
+			{
+				cost_left -= Perimeter(m_nodes[left].bounds);
+			}
+
+			float cost_right = Perimeter(Union(m_nodes[right].bounds, leaf_bounds)) + inheritance_cost;
+			if (!m_nodes[right].IsLeaf())
+			{
+				cost_right -= Perimeter(m_nodes[right].bounds);
+			}
+
+			if (cost < cost_left && cost < cost_right)
+			{
+				break;
+			}
+
+			index = cost_left < cost_right ? left : right;
+		}
+
+		int sibling = index;
+
+		int old_parent = m_nodes[sibling].parent;
+		int new_parent = this->AllocateNode();
+		m_nodes[new_parent].parent = old_parent;
+		m_nodes[new_parent].bounds = Union(leaf_bounds, m_nodes[sibling].bounds);
+		m_nodes[new_parent].height = m_nodes[sibling].height + 1;
+		m_nodes[new_parent].left = sibling;
+		m_nodes[new_parent].right = leaf;
+		m_nodes[sibling].parent = new_parent;
+		m_nodes[leaf].parent = new_parent;
+
+		if (old_parent != NullProxy)
+		{
+			if (m_nodes[old_parent].left == sibling)
+			{
+				m_nodes[old_parent].left = new_parent;
+			}
+			else
+			{
+				m_nodes[old_parent].right = new_parent;
+			}
+		}
+		else
+		{
+			m_root = new_parent;
+		}
+
+		// refit ancestors
+		index = m_nodes[leaf].parent;
+		while (index != NullProxy)
+		{
+			index = this->Balance(index);
+
+			Node& node = m_nodes[index];
+			node.height = 1 + Mathf::Max(m_nodes[node.left].height, m_nodes[node.right].height);
+			node.bounds = Union(m_nodes[node.left].bounds, m_nodes[node.right].bounds);
+
+			index = node.parent;
+		}
+	}
+
+	void AABBTree::RemoveLeaf(int leaf)
+	{
+		if (leaf == m_root)
+		{
+			m_root = NullProxy;
+			return;
+		}
+
+		int parent = m_nodes[leaf].parent;
+		int grand_parent = m_nodes[parent].parent;
+		int sibling = m_nodes[parent].left == leaf ? m_nodes[parent].right : m_nodes[parent].left;
+
+		if (grand_parent != NullProxy)
+		{
+			if (m_nodes[grand_parent].left == parent)
+			{
+				m_nodes[grand_parent].left = sibling;
+			}
+			else
+			{
+				m_nodes[grand_parent].right = sibling;
+			}
+			m_nodes[sibling].parent = grand_parent;
+			this->FreeNode(parent);
+
+			int index = grand_parent;
+			while (index != NullProxy)
+			{
+				index = this->Balance(index);
+
+				Node& node = m_nodes[index];
+				node.height = 1 + Mathf::Max(m_nodes[node.left].height, m_nodes[node.right].height);
+				node.bounds = Union(m_nodes[node.left].bounds, m_nodes[node.right].bounds);
+
+				index = node.parent;
+			}
+		}
+		else
+		{
+			m_root = sibling;
+			m_nodes[sibling].parent = NullProxy;
+			this->FreeNode(parent);
+		}
+	}
+
+	// rotate a up if it is imbalanced, return the new root of the subtree
+	int AABBTree::Balance(int a)
+	{
+		Node& node_a = m_nodes[a];
+		if (node_a.IsLeaf() || node_a.height < 2)
+		{
+			return a;
+		}
+
+		int b = node_a.left;
+		int c = node_a.right;
+		Node& node_b = m_nodes[b];
+		Node& node_c = m_nodes[c];
+
+		int balance = node_c.height - node_b.height;
+
+		// rotate c up
+		if (balance > 1)
+		{
+			int f = node_c.left;
+			int g = node_c.right;
+			Node& node_f = m_nodes[f];
+			Node& node_g = m_nodes[g];
+
+			node_c.left = a;
+			node_c.parent = node_a.parent;
+			node_a.parent = c;
+
+			if (node_c.parent != NullProxy)
+			{
+				if (m_nodes[node_c.parent].left == a)
+				{
+					m_nodes[node_c.parent].left = c;
+				}
+				else
+				{
+					m_nodes[node_c.parent].right = c;
+				}
+			}
+			else
+			{
+				m_root = c;
+			}
+
+			if (node_f.height > node_g.height)
+			{
+				node_c.right = f;
+				node_a.right = g;
+				node_g.parent = a;
+				node_a.bounds = Union(node_b.bounds, node_g.bounds);
+				node_c.bounds = Union(node_a.bounds, node_f.bounds);
+				node_a.height = 1 + Mathf::Max(node_b.height, node_g.height);
+				node_c.height = 1 + Mathf::Max(node_a.height, node_f.height);
+			}
+			else
+			{
+				node_c.right = g;
+				node_a.right = f;
+				node_f.parent = a;
+				node_a.bounds = Union(node_b.bounds, node_f.bounds);
+				node_c.bounds = Union(node_a.bounds, node_g.bounds);
+				node_a.height = 1 + Mathf::Max(node_b.height, node_f.height);
+				node_c.height = 1 + Mathf::Max(node_a.height, node_g.height);
+			}
+
+			return c;
+		}
+
+		// rotate b up
+		if (balance < -1)
+		{
+			int d = node_b.left;
+			int e = node_b.right;
+			Node& node_d = m_nodes[d];
+			Node& node_e = m_nodes[e];
+
+			node_b.left = a;
+			node_b.parent = node_a.parent;
+			node_a.parent = b;
+
+			if (node_b.parent != NullProxy)
+			{
+				if (m_nodes[node_b.parent].left == a)
+				{
+					m_nodes[node_b.parent].left = b;
+				}
+				else
+				{
+					m_nodes[node_b.parent].right = b;
+				}
+			}
+			else
+			{
+				m_root = b;
+			}
+
+			if (node_d.height > node_e.height)
+			{
+				node_b.right = d;
+				node_a.left = e;
+				node_e.parent = a;
+				node_a.bounds = Union(node_c.bounds, node_e.bounds);
+				node_b.bounds = Union(node_a.bounds, node_d.bounds);
+				node_a.height = 1 + Mathf::Max(node_c.height, node_e.height);
+				node_b.height = 1 + Mathf::Max(node_a.height, node_d.height);
+			}
+			else
+			{
+				node_b.right = e;
+				node_a.left = d;
+				node_d.parent = a;
+				node_a.bounds = Union(node_c.bounds, node_d.bounds);
+				node_b.bounds = Union(node_a.bounds, node_e.bounds);
+				node_a.height = 1 + Mathf::Max(node_c.height, node_d.height);
+				node_b.height = 1 + Mathf::Max(node_a.height, node_e.height);
+			}
+
+			return b;
+		}
+
+		return a;
+	}
+
+	void AABBTree::CollectLeaves(int node, Vector<void*>& result) const
+	{
+		QueryStack<int> stack;
+		stack.Push(node);
+
+		while (!stack.Empty())
+		{
+			const Node& n = m_nodes[stack.Pop()];
+			if (n.IsLeaf())
+			{
+				result.Add(n.user_data);
+			}
+			else
+			{
+				stack.Push(n.left);
+				stack.Push(n.right);
+			}
+		}
+	}
+
+	void AABBTree::QueryBounds(const Bounds& bounds, Vector<void*>& result) const
+	{
+		if (m_root == NullProxy)
+		{
+			return;
+		}
+
+		QueryStack<int> stack;
+		stack.Push(m_root);
+
+		while (!stack.Empty())
+		{
+			const Node& node = m_nodes[stack.Pop()];
+			if (!node.bounds.Intersects(bounds))
+			{
+				continue;
+			}
+
+			if (node.IsLeaf())
+			{
+				result.Add(node.user_data);
+			}
+			else
+			{
+				stack.Push(node.left);
+				stack.Push(node.right);
+			}
+		}
+	}
+
+	void AABBTree::QueryFrustum(const Frustum& frustum, Vector<void*>& result) const
+	{
+		if (m_root == NullProxy)
+		{
+			return;
+		}
+
+		QueryStack<int> stack;
+		stack.Push(m_root);
+
+		while (!stack.Empty())
+		{
+			int index = stack.Pop();
+			const Node& node = m_nodes[index];
+
+			ContainsResult contains = frustum.ContainsBounds(node.bounds);
+			if (contains == ContainsResult::Out)
+			{
+				continue;
+			}
+
+			if (contains == ContainsResult::In)
+			{
+				// whole subtree visible, skip plane tests below
+				this->CollectLeaves(index, result);
+			}
+			else if (node.IsLeaf())
+			{
+				result.Add(node.user_data);
+			}
+			else
+			{
+				stack.Push(node.left);
+				stack.Push(node.right);
+			}
+		}
+	}
+
+	void AABBTree::QueryFrustums(const Frustum* frustums, int count, Vector<void*>* results) const
+	{
+		assert(count <= MaxBatchFrustums);
+
+		if (m_root == NullProxy || count <= 0)
+		{
+			return;
+		}
+
+		// frustums still crossing the node, and frustums fully containing it
+		struct Entry
+		{
+			int node;
+			uint32_t cross_mask;
+			uint32_t in_mask;
+		};
+
+		QueryStack<Entry> stack;
+		uint32_t all_mask = count == 32 ? 0xffffffff : ((1u << count) - 1);
+		stack.Push({ m_root, all_mask, 0 });
+
+		while (!stack.Empty())
+		{
+			Entry entry = stack.Pop();
+			const Node& node = m_nodes[entry.node];
+
+			for (int i = 0; i < count; ++i)
+			{
+				uint32_t bit = 1u << i;
+				if (entry.cross_mask & bit)
+				{
+					ContainsResult contains = frustums[i].ContainsBounds(node.bounds);
+					if (contains == ContainsResult::Out)
+					{
+						entry.cross_mask &= ~bit;
+					}
+					else if (contains == ContainsResult::In)
+					{
+						entry.cross_mask &= ~bit;
+						entry.in_mask |= bit;
+					}
+				}
+			}
+
+			uint32_t mask = entry.cross_mask | entry.in_mask;
+			if (mask == 0)
+			{
+				continue;
+			}
+
+			if (node.IsLeaf())
+			{
+				for (int i = 0; i < count; ++i)
+				{
+					if (mask & (1u << i))
+					{
+						results[i].Add(node.user_data);
+					}
+				}
+			}
+			else
+			{
+				stack.Push({ node.left, entry.cross_mask, entry.in_mask });
+				stack.Push({ node.right, entry.cross_mask, entry.in_mask });
+			}
+		}
+	}
+
+	void AABBTree::QuerySphere(const Vector3& center, float radius, Vector<void*>& result) const
+	{
+		if (m_root == NullProxy)
+		{
+			return;
+		}
+
+		QueryStack<int> stack;
+		stack.Push(m_root);
+
+		while (!stack.Empty())
+		{
+			const Node& node = m_nodes[stack.Pop()];
+			if (!SphereIntersects(node.bounds, center, radius))
+			{
+				continue;
+			}
+
+			if (node.IsLeaf())
+			{
+				result.Add(node.user_data);
+			}
+			else
+			{
+				stack.Push(node.left);
+				stack.Push(node.right);
+			}
+		}
+	}
+
+	void AABBTree::QueryCone(const Vector3& apex, const Vector3& direction, float angle, float range, Vector<void*>& result) const
+	{
+		if (m_root == NullProxy)
+		{
+			return;
+		}
+
+		Vector3 dir = Vector3::Normalize(direction);
+		float sin_angle = sin(angle * Mathf::Deg2Rad);
+		float cos_angle = cos(angle * Mathf::Deg2Rad);
+
+		QueryStack<int> stack;
+		stack.Push(m_root);
+
+		while (!stack.Empty())
+		{
+			const Node& node = m_nodes[stack.Pop()];
+			if (!ConeIntersects(node.bounds, apex, dir, sin_angle, cos_angle, range))
+			{
+				continue;
+			}
+
+			if (node.IsLeaf())
+			{
+				result.Add(node.user_data);
+			}
+			else
+			{
+				stack.Push(node.left);
+				stack.Push(node.right);
+			}
+		}
+	}
+
+	void AABBTree::QueryRay(const Ray& ray, float max_distance, Vector<void*>& result) const
+	{
+		if (m_root == NullProxy)
+		{
+			return;
+		}
+
+		const Vector3& origin = ray.GetOrigin();
+		const Vector3& dir = ray.GetDirection();
+		Vector3 inv_dir(
+			dir.x != 0 ? 1.0f / dir.x : Mathf::MaxFloatValue,
+			dir.y != 0 ? 1.0f / dir.y : Mathf::MaxFloatValue,
+			dir.z != 0 ? 1.0f / dir.z : Mathf::MaxFloatValue);
+
+		QueryStack<int> stack;
+		stack.Push(m_root);
+
+		while (!stack.Empty())
+		{
+			const Node& node = m_nodes[stack.Pop()];
+			if (!RayIntersects(node.bounds, origin, inv_dir, max_distance))
+			{
+				continue;
+			}
+
+			if (node.IsLeaf())
+			{
+				result.Add(node.user_data);
+			}
+			else
+			{
+				stack.Push(node.left);
+				stack.Push(node.right);
+			}
+		}
+	}
+}
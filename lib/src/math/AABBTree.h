@@ -0,0 +1,84 @@
+/*
+* Viry3D
+* Copyright 2014-2019 by Stack - stackos@qq.com
+*
+* Licensed under the Apache License, Version 2.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at
+*
+*     http://www.apache.org/licenses/LICENSE-2.0
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+*/
+
+#pragma once
+
+#include "Bounds.h"
+#include "Frustum.h"
+#include "Ray.h"
+#include "container/Vector.h"
+
+namespace Viry3D
+{
+	// dynamic bounding volume hierarchy,
+	// leaves store fat bounds so small moves do not touch the tree,
+	// query results are conservative, callers test exact bounds if needed.
+	class AABBTree
+	{
+	public:
+		static const int NullProxy = -1;
+		static const int MaxBatchFrustums = 32;
+
+		AABBTree(float margin = 0.1f);
+		int CreateProxy(const Bounds& bounds, void* user_data);
+		void DestroyProxy(int proxy);
+		// return true if proxy is reinserted
+		bool MoveProxy(int proxy, const Bounds& bounds);
+		void* GetUserData(int proxy) const { return m_nodes[proxy].user_data; }
+		const Bounds& GetFatBounds(int proxy) const { return m_nodes[proxy].bounds; }
+		int GetProxyCount() const { return m_proxy_count; }
+		int GetHeight() const;
+		void Clear();
+		void QueryBounds(const Bounds& bounds, Vector<void*>& result) const;
+		void QueryFrustum(const Frustum& frustum, Vector<void*>& result) const;
+		// one traversal for up to MaxBatchFrustums frustums, results[i] for frustums[i]
+		void QueryFrustums(const Frustum* frustums, int count, Vector<void*>* results) const;
+		void QuerySphere(const Vector3& center, float radius, Vector<void*>& result) const;
+		// angle is the half angle of cone in degrees
+		void QueryCone(const Vector3& apex, const Vector3& direction, float angle, float range, Vector<void*>& result) const;
+		void QueryRay(const Ray& ray, float max_distance, Vector<void*>& result) const;
+
+	private:
+		struct Node
+		{
+			Bounds bounds;
+			void* user_data;
+			// next free node when in free list
+			int parent;
+			int left;
+			int right;
+			// leaf 0, free -1
+			int height;
+
+			bool IsLeaf() const { return left == NullProxy; }
+		};
+
+		int AllocateNode();
+		void FreeNode(int node);
+		void InsertLeaf(int leaf);
+		void RemoveLeaf(int leaf);
+		int Balance(int a);
+		void CollectLeaves(int node, Vector<void*>& result) const;
+
+	private:
+		Vector<Node> m_nodes;
+		int m_root;
+		int m_free_list;
+		int m_proxy_count;
+		float m_margin;
+	};
+}
@@ -21,6 +21,8 @@
 
 namespace Viry3D
 {
+	struct Matrix4x4;
+
 	class Bounds
 	{
 	public:
@@ -28,7 +30,16 @@ namespace Viry3D
 		Bounds(const Vector3& min, const Vector3& max);
 		const Vector3& Min() const { return m_min; }
 		const Vector3& Max() const { return m_max; }
+		Vector3 GetCenter() const { return (m_min + m_max) * 0.5f; }
+		Vector3 GetExtents() const { return (m_max - m_min) * 0.5f; }
 		bool Contains(const Vector3& point) const;
+		bool Intersects(const Bounds& bounds) const;
+		void Encapsulate(const Vector3& point);
+		void Encapsulate(const Bounds& bounds);
+		// aabb of this box transformed by matrix
+		Bounds Transform(const Matrix4x4& matrix) const;
+		bool operator ==(const Bounds& bounds) const;
+		bool operator !=(const Bounds& bounds) const { return !(*this == bounds); }
 
 	private:
 		Vector3 m_min;
@@ -57,6 +57,7 @@ namespace Viry3D
 		ContainsResult ContainsPoint(const Vector3& point) const;
 		ContainsResult ContainsSphere(const Vector3& center, float radius) const;
 		ContainsResult ContainsBounds(const Vector3& min, const Vector3& max) const;
+		ContainsResult ContainsBounds(const Bounds& bounds) const { return this->ContainsBounds(bounds.Min(), bounds.Max()); }
 		ContainsResult ContainsPoints(const Vector<Vector3>& points, const Matrix4x4* matrix) const;
 		float DistanceToPlane(const Vector3& point, int plane_index) const;
 
@@ -34,6 +34,9 @@ namespace Viry3D
         virtual ~SpringBone();
         void Init();
         void UpdateSpring();
+
+    protected:
+        virtual uint32_t GetUpdatePhases() const { return 0; }
         
     private:
         static Ref<SpringManager> GetParentSpringManager(const Ref<Transform>& t);
@@ -25,5 +25,8 @@ namespace Viry3D
 	{
 	public:
         float radius = 0.5f;
+
+	protected:
+		virtual uint32_t GetUpdatePhases() const { return 0; }
 	};
 }
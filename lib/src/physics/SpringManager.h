@@ -49,6 +49,12 @@ namespace Viry3D
             }
         }
         
+        // springs run in late update with other late updates, as before phases
+        virtual uint32_t GetUpdatePhases() const
+        {
+            return 1 << (int) UpdatePhase::LateUpdate;
+        }
+        
         virtual void LateUpdate()
         {
             for (int i = 0; i < spring_bones.Size(); ++i)
@@ -31,6 +31,9 @@ namespace Viry3D
 		virtual ~PostProcessing();
 		virtual void OnRenderImage(const Ref<RenderTarget>& src, const Ref<RenderTarget>& dst);
 
+	protected:
+		virtual uint32_t GetUpdatePhases() const { return 0; }
+
 	protected:
 		friend class Camera;
 		const void SetCameraDepthTexture(const Ref<Texture>& texture) { m_camera_depth_texture = texture; }
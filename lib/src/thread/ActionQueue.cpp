@@ -0,0 +1,123 @@
+/*
+* Viry3D
+* Copyright 2014-2019 by Stack - stackos@qq.com
+*
+* Licensed under the Apache License, Version 2.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at
+*
+*     http://www.apache.org/licenses/LICENSE-2.0
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+*/
+
+#include "ActionQueue.h"
+#include <chrono>
+
+namespace Viry3D
+{
+	ActionQueue::ActionQueue():
+		m_posted(nullptr),
+		m_pending_first(nullptr),
+		m_pending_last(nullptr),
+		m_pending_count(0)
+	{
+	
+	}
+
+	ActionQueue::~ActionQueue()
+	{
+		DeleteNodes(m_posted.exchange(nullptr));
+		DeleteNodes(m_pending_first);
+	}
+
+	void ActionQueue::Post(const Action& action)
+	{
+		Node* node = new Node();
+		node->action = action;
+		node->next = m_posted.load(std::memory_order_relaxed);
+
+		while (!m_posted.compare_exchange_weak(node->next, node, std::memory_order_release, std::memory_order_relaxed))
+		{
+		}
+	}
+
+	void ActionQueue::Drain()
+	{
+		Node* node = m_posted.exchange(nullptr, std::memory_order_acquire);
+		if (node == nullptr)
+		{
+			return;
+		}
+
+		// reverse to post order
+		Node* first = nullptr;
+		Node* last = node;
+		int count = 0;
+		while (node)
+		{
+			Node* next = node->next;
+			node->next = first;
+			first = node;
+			node = next;
+			++count;
+		}
+
+		if (m_pending_last)
+		{
+			m_pending_last->next = first;
+		}
+		else
+		{
+			m_pending_first = first;
+		}
+		m_pending_last = last;
+		m_pending_count += count;
+	}
+
+	void ActionQueue::Process(float budget_ms)
+	{
+		this->Drain();
+
+		auto begin = std::chrono::steady_clock::now();
+		while (m_pending_first)
+		{
+			Node* node = m_pending_first;
+			m_pending_first = node->next;
+			if (m_pending_first == nullptr)
+			{
+				m_pending_last = nullptr;
+			}
+			--m_pending_count;
+
+			if (node->action)
+			{
+				node->action();
+			}
+			delete node;
+
+			if (budget_ms > 0)
+			{
+				auto now = std::chrono::steady_clock::now();
+				if (std::chrono::duration<float, std::milli>(now - begin).count() >= budget_ms)
+				{
+					break;
+				}
+			}
+		}
+	}
+
+	void ActionQueue::DeleteNodes(Node* node)
+	{
+		while (node)
+		{
+			Node* next = node->next;
+			delete node;
+			node = next;
+		}
+	}
+}
@@ -0,0 +1,60 @@
+/*
+* Viry3D
+* Copyright 2014-2019 by Stack - stackos@qq.com
+*
+* Licensed under the Apache License, Version 2.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at
+*
+*     http://www.apache.org/licenses/LICENSE-2.0
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+*/
+
+#pragma once
+
+#include "Action.h"
+#include <atomic>
+
+namespace Viry3D
+{
+	// many producers, one consumer action queue without lock,
+	// producers push nodes on an atomic stack, consumer swaps the whole stack out and reverses it to post order.
+	// actions not run within time budget stay pending for next process.
+	class ActionQueue
+	{
+	public:
+		ActionQueue();
+		// pending actions are dropped without run
+		~ActionQueue();
+		// any thread
+		void Post(const Action& action);
+		// consumer thread only, runs at least one action when any,
+		// budget in ms, 0 runs all, actions posted while running wait for next process
+		void Process(float budget_ms = 0);
+		// consumer thread only, posted but not drained actions are not counted
+		int GetPendingCount() const { return m_pending_count; }
+
+	private:
+		struct Node
+		{
+			Action action;
+			Node* next;
+		};
+
+		void Drain();
+		static void DeleteNodes(Node* node);
+
+	private:
+		// newest first
+		std::atomic<Node*> m_posted;
+		// oldest first, owned by consumer
+		Node* m_pending_first;
+		Node* m_pending_last;
+		int m_pending_count;
+	};
+}
@@ -0,0 +1,302 @@
+/*
+* Viry3D
+* Copyright 2014-2019 by Stack - stackos@qq.com
+*
+* Licensed under the Apache License, Version 2.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at
+*
+*     http://www.apache.org/licenses/LICENSE-2.0
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+*/
+
+#include "JobSystem.h"
+#include "math/Mathf.h"
+
+namespace Viry3D
+{
+	// chunks of parallel for per thread, threads finishing early steal the rest
+	static const int PARALLEL_CHUNKS_PER_THREAD = 4;
+
+	static thread_local JobSystem* g_current_system = nullptr;
+	static thread_local int g_current_index = -1;
+	static thread_local uint32_t g_steal_seed = 0;
+
+	JobSystem::JobSystem(int thread_count):
+		m_owner_thread(std::this_thread::get_id()),
+		m_queued_count(0),
+		m_sleeping_count(0),
+		m_exit(false)
+	{
+		if (thread_count < 0)
+		{
+			thread_count = Mathf::Max((int) std::thread::hardware_concurrency() - 1, 0);
+		}
+
+		m_queues.Resize(thread_count + 1);
+		for (int i = 0; i < m_queues.Size(); ++i)
+		{
+			m_queues[i] = RefMake<Queue>();
+		}
+
+		m_threads.Resize(thread_count);
+		for (int i = 0; i < m_threads.Size(); ++i)
+		{
+			m_threads[i] = RefMake<std::thread>(&JobSystem::Loop, this, i);
+		}
+	}
+
+	JobSystem::~JobSystem()
+	{
+		{
+			std::lock_guard<std::mutex> lock(m_mutex);
+			m_exit = true;
+			m_condition.notify_all();
+		}
+
+		for (int i = 0; i < m_threads.Size(); ++i)
+		{
+			m_threads[i]->join();
+		}
+	}
+
+	JobSystem::Job* JobSystem::CreateJob(Action func, Job* parent)
+	{
+		Job* job = new Job();
+		job->func = func;
+		job->parent = parent;
+		job->unfinished = 1;
+		job->ref_count = 1;
+
+		if (parent)
+		{
+			parent->unfinished.fetch_add(1);
+		}
+
+		return job;
+	}
+
+	void JobSystem::Run(Job* job)
+	{
+		this->Push(job);
+	}
+
+	void JobSystem::RunAndRetain(Job* job)
+	{
+		job->ref_count.fetch_add(1);
+		this->Push(job);
+	}
+
+	void JobSystem::Wait(Job* job)
+	{
+		int index = this->GetCurrentIndex();
+
+		while (job->unfinished.load() > 0)
+		{
+			if (!this->Execute(index))
+			{
+				std::this_thread::yield();
+			}
+		}
+
+		this->Release(job);
+	}
+
+	void JobSystem::RunAndWait(Job* job)
+	{
+		this->RunAndRetain(job);
+		this->Wait(job);
+	}
+
+	void JobSystem::ParallelFor(int count, const RangeFunc& func, int min_chunk)
+	{
+		if (count <= 0)
+		{
+			return;
+		}
+
+		int chunk = Mathf::Max(Mathf::Max(min_chunk, 1), count / ((m_threads.Size() + 1) * PARALLEL_CHUNKS_PER_THREAD));
+		if (m_threads.Size() == 0 || chunk >= count)
+		{
+			func(0, count);
+			return;
+		}
+
+		Job* root = this->CreateJob(nullptr);
+		for (int begin = chunk; begin < count; begin += chunk)
+		{
+			int end = Mathf::Min(begin + chunk, count);
+			this->Run(this->CreateJob([&func, begin, end]() {
+				func(begin, end);
+			}, root));
+		}
+
+		// first chunk on calling thread, then help with the rest
+		func(0, chunk);
+
+		this->RunAndWait(root);
+	}
+
+	void JobSystem::Push(Job* job)
+	{
+		int index = this->GetCurrentIndex();
+		if (index >= 0)
+		{
+			auto& queue = *m_queues[index];
+			if (queue.getCount() >= QUEUE_CAPACITY)
+			{
+				if (job->func)
+				{
+					job->func();
+				}
+				this->Finish(job);
+				return;
+			}
+
+			queue.push(job);
+		}
+		else
+		{
+			std::lock_guard<std::mutex> lock(m_shared_mutex);
+			m_shared_queue.AddLast(job);
+		}
+
+		m_queued_count.fetch_add(1);
+
+		// lock so a worker about to sleep either sees the job or gets the notify
+		if (m_sleeping_count.load() > 0)
+		{
+			std::lock_guard<std::mutex> lock(m_mutex);
+			m_condition.notify_one();
+		}
+	}
+
+	JobSystem::Job* JobSystem::Take(int index)
+	{
+		if (m_queued_count.load() <= 0)
+		{
+			return nullptr;
+		}
+
+		Job* job = nullptr;
+
+		if (index >= 0)
+		{
+			job = m_queues[index]->pop();
+		}
+
+		if (job == nullptr)
+		{
+			// start from a random queue, so thieves do not crowd the same victim
+			g_steal_seed = g_steal_seed * 1664525 + 1013904223;
+			int count = m_queues.Size();
+			int start = (int) ((g_steal_seed >> 16) % count);
+
+			for (int i = 0; i < count && job == nullptr; ++i)
+			{
+				int victim = (start + i) % count;
+				if (victim != index)
+				{
+					job = m_queues[victim]->steal();
+				}
+			}
+		}
+
+		if (job == nullptr)
+		{
+			std::lock_guard<std::mutex> lock(m_shared_mutex);
+			if (!m_shared_queue.Empty())
+			{
+				job = m_shared_queue.First();
+				m_shared_queue.RemoveFirst();
+			}
+		}
+
+		if (job)
+		{
+			m_queued_count.fetch_sub(1);
+		}
+
+		return job;
+	}
+
+	bool JobSystem::Execute(int index)
+	{
+		Job* job = this->Take(index);
+		if (job == nullptr)
+		{
+			return false;
+		}
+
+		if (job->func)
+		{
+			job->func();
+		}
+		this->Finish(job);
+
+		return true;
+	}
+
+	void JobSystem::Finish(Job* job)
+	{
+		if (job->unfinished.fetch_sub(1) == 1)
+		{
+			Job* parent = job->parent;
+			this->Release(job);
+
+			if (parent)
+			{
+				this->Finish(parent);
+			}
+		}
+	}
+
+	void JobSystem::Release(Job* job)
+	{
+		if (job->ref_count.fetch_sub(1) == 1)
+		{
+			delete job;
+		}
+	}
+
+	void JobSystem::Loop(int index)
+	{
+		g_current_system = this;
+		g_current_index = index;
+		g_steal_seed = (uint32_t) index + 1;
+
+		while (!m_exit)
+		{
+			if (!this->Execute(index))
+			{
+				std::unique_lock<std::mutex> lock(m_mutex);
+				m_sleeping_count.fetch_add(1);
+				m_condition.wait(lock, [this]() {
+					return m_exit || m_queued_count.load() > 0;
+				});
+				m_sleeping_count.fetch_sub(1);
+			}
+		}
+
+		g_current_system = nullptr;
+		g_current_index = -1;
+	}
+
+	int JobSystem::GetCurrentIndex() const
+	{
+		if (g_current_system == this)
+		{
+			return g_current_index;
+		}
+		if (std::this_thread::get_id() == m_owner_thread)
+		{
+			return m_queues.Size() - 1;
+		}
+		return -1;
+	}
+}
@@ -0,0 +1,96 @@
+/*
+* Viry3D
+* Copyright 2014-2019 by Stack - stackos@qq.com
+*
+* Licensed under the Apache License, Version 2.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at
+*
+*     http://www.apache.org/licenses/LICENSE-2.0
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+*/
+
+#pragma once
+
+#include "container/Vector.h"
+#include "container/List.h"
+#include "memory/Ref.h"
+#include "Action.h"
+#include <utils/WorkStealingDequeue.h>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <functional>
+
+namespace Viry3D
+{
+	// work stealing scheduler for short jobs,
+	// each worker owns a lock free deque, pushes and pops at its bottom, idle workers steal from top of others,
+	// thread creating the job system is also a worker while it waits, other threads submit through a locked queue.
+	class JobSystem
+	{
+	public:
+		struct Job
+		{
+			Action func;
+			Job* parent;
+			// own function and unfinished children
+			std::atomic<int> unfinished;
+			// released by finish and by Wait of retained job
+			std::atomic<int> ref_count;
+		};
+
+		typedef std::function<void(int begin, int end)> RangeFunc;
+
+		// worker thread count, negative uses hardware concurrency minus the creating thread
+		JobSystem(int thread_count = -1);
+		// all jobs must be finished before destroy
+		~JobSystem();
+		// worker threads, not counting the creating thread
+		int GetThreadCount() const { return m_threads.Size(); }
+		// parent does not finish before children, create children before parent finishes its function
+		Job* CreateJob(Action func, Job* parent = nullptr);
+		// job is released when finished, handle must not be used after
+		void Run(Job* job);
+		// handle stays valid until Wait
+		void RunAndRetain(Job* job);
+		// calling thread runs other jobs until job and its children finish, then releases handle
+		void Wait(Job* job);
+		void RunAndWait(Job* job);
+		// split [0, count) into chunks of at least min_chunk, several chunks per thread for balance
+		void ParallelFor(int count, const RangeFunc& func, int min_chunk = 1);
+
+	private:
+		// jobs beyond capacity run inline on submitting thread
+		static const int QUEUE_CAPACITY = 4096;
+		typedef utils::WorkStealingDequeue<Job*, QUEUE_CAPACITY> Queue;
+
+		void Push(Job* job);
+		Job* Take(int index);
+		bool Execute(int index);
+		void Finish(Job* job);
+		void Release(Job* job);
+		void Loop(int index);
+		int GetCurrentIndex() const;
+
+	private:
+		Vector<Ref<std::thread>> m_threads;
+		// one per worker thread, last one belongs to creating thread
+		Vector<Ref<Queue>> m_queues;
+		std::thread::id m_owner_thread;
+		// jobs from threads not owning a queue
+		List<Job*> m_shared_queue;
+		std::mutex m_shared_mutex;
+		std::atomic<int> m_queued_count;
+		std::atomic<int> m_sleeping_count;
+		std::mutex m_mutex;
+		std::condition_variable m_condition;
+		std::atomic<bool> m_exit;
+	};
+}
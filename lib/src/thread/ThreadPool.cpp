@@ -18,6 +18,7 @@
 #include "ThreadPool.h"
 #include "Object.h"
 #include "Engine.h"
+#include "time/FrameScheduler.h"
 
 namespace Viry3D
 {
@@ -104,8 +105,10 @@ namespace Viry3D
 
                 if (task.complete)
                 {
-                    Engine::Instance()->PostAction([=]() {
+                    // completions are time sliced on main thread within scheduler budget, so a burst of loads does not spike one frame
+                    Engine::Instance()->GetFrameScheduler()->Post("Thread::Complete", [=]() {
                         task.complete(res);
+                        return true;
                     });
                 }
             }
@@ -0,0 +1,328 @@
+/*
+* Viry3D
+* Copyright 2014-2019 by Stack - stackos@qq.com
+*
+* Licensed under the Apache License, Version 2.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at
+*
+*     http://www.apache.org/licenses/LICENSE-2.0
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+*/
+
+#include "FrameScheduler.h"
+#include <algorithm>
+
+namespace Viry3D
+{
+	static const float BUDGET_DEFAULT_MS = 2.0f;
+
+	static float DurationMS(const std::chrono::steady_clock::time_point& from, const std::chrono::steady_clock::time_point& to)
+	{
+		return std::chrono::duration<float, std::milli>(to - from).count();
+	}
+
+	FrameScheduler::FrameScheduler():
+		m_budget_ms(BUDGET_DEFAULT_MS),
+		m_next_id(0),
+		m_frame_count(0)
+	{
+	
+	}
+
+	int FrameScheduler::Add(const String& name, const Step& step, int priority, float deadline_ms)
+	{
+		Task task;
+		task.id = m_next_id++;
+		task.step = step;
+		task.add_time = Clock::now();
+		task.first_step_time = task.add_time;
+		task.deadline = task.add_time;
+		if (deadline_ms > 0)
+		{
+			task.deadline += std::chrono::duration_cast<Clock::duration>(std::chrono::duration<float, std::milli>(deadline_ms));
+		}
+		task.add_frame = m_frame_count;
+		task.overdue = false;
+		task.stats.name = name;
+		task.stats.priority = priority;
+		task.stats.steps = 0;
+		task.stats.run_ms = 0;
+		task.stats.wait_ms = 0;
+		task.stats.latency_ms = 0;
+		task.stats.frames = 0;
+		task.stats.missed_deadline = false;
+		m_tasks.Add(task.id, task);
+		m_added.Add(task.id);
+
+		return task.id;
+	}
+
+	void FrameScheduler::Post(const String& name, const Step& step, int priority)
+	{
+		m_posted.Post([=]() {
+			this->Add(name, step, priority);
+		});
+	}
+
+	void FrameScheduler::Cancel(int id)
+	{
+		m_tasks.Remove(id);
+	}
+
+	bool FrameScheduler::IsPending(int id) const
+	{
+		return m_tasks.Contains(id);
+	}
+
+	bool FrameScheduler::GetStats(int id, TaskStats* stats) const
+	{
+		const Task* task;
+		if (!m_tasks.TryGet(id, &task))
+		{
+			return false;
+		}
+
+		this->FillStats(*task, Clock::now(), stats);
+		return true;
+	}
+
+	void FrameScheduler::Run()
+	{
+		++m_frame_count;
+
+		// posted tasks are added here on main thread, then all added since last run join the heaps
+		m_posted.Process();
+		for (int i = 0; i < m_added.Size(); ++i)
+		{
+			const Task* task;
+			if (m_tasks.TryGet(m_added[i], &task))
+			{
+				this->Schedule(*task);
+			}
+		}
+		m_added.Clear();
+
+		auto begin = Clock::now();
+
+		// at least one step each frame, so a budget smaller than any step still makes progress
+		bool stepped = false;
+		while (true)
+		{
+			auto now = Clock::now();
+			if (stepped && DurationMS(begin, now) >= m_budget_ms)
+			{
+				break;
+			}
+
+			this->PromoteOverdue(now);
+
+			int id = this->PopTask();
+			if (id < 0)
+			{
+				break;
+			}
+
+			stepped = true;
+			if (!this->RunStep(id))
+			{
+				continue;
+			}
+
+			const Task* task;
+			m_tasks.TryGet(id, &task);
+			if (task->overdue)
+			{
+				m_overdue_stepped.Add(id);
+			}
+			else
+			{
+				PushEntry(m_ready, MakeEntry(*task), false);
+			}
+		}
+	}
+
+	FrameScheduler::Entry FrameScheduler::MakeEntry(const Task& task)
+	{
+		Entry entry;
+		entry.id = task.id;
+		entry.priority = task.stats.priority;
+		entry.has_deadline = task.deadline != task.add_time;
+		entry.deadline = task.deadline;
+		return entry;
+	}
+
+	// priority, earlier deadline, then add order
+	bool FrameScheduler::RunsBefore(const Entry& a, const Entry& b)
+	{
+		if (a.priority != b.priority)
+		{
+			return a.priority > b.priority;
+		}
+		if (a.has_deadline != b.has_deadline)
+		{
+			return a.has_deadline;
+		}
+		if (a.has_deadline && a.deadline != b.deadline)
+		{
+			return a.deadline < b.deadline;
+		}
+		return a.id < b.id;
+	}
+
+	void FrameScheduler::PushEntry(Vector<Entry>& heap, const Entry& entry, bool by_deadline)
+	{
+		heap.Add(entry);
+		if (by_deadline)
+		{
+			std::push_heap(heap.begin(), heap.end(), [](const Entry& a, const Entry& b) {
+				return a.deadline > b.deadline;
+			});
+		}
+		else
+		{
+			std::push_heap(heap.begin(), heap.end(), [](const Entry& a, const Entry& b) {
+				return RunsBefore(b, a);
+			});
+		}
+	}
+
+	FrameScheduler::Entry FrameScheduler::PopEntry(Vector<Entry>& heap, bool by_deadline)
+	{
+		if (by_deadline)
+		{
+			std::pop_heap(heap.begin(), heap.end(), [](const Entry& a, const Entry& b) {
+				return a.deadline > b.deadline;
+			});
+		}
+		else
+		{
+			std::pop_heap(heap.begin(), heap.end(), [](const Entry& a, const Entry& b) {
+				return RunsBefore(b, a);
+			});
+		}
+
+		Entry entry = heap[heap.Size() - 1];
+		heap.RemoveRange(heap.Size() - 1, 1);
+		return entry;
+	}
+
+	void FrameScheduler::Schedule(const Task& task)
+	{
+		Entry entry = MakeEntry(task);
+		PushEntry(m_ready, entry, false);
+		if (entry.has_deadline)
+		{
+			PushEntry(m_deadlines, entry, true);
+		}
+	}
+
+	void FrameScheduler::PromoteOverdue(const Clock::time_point& now)
+	{
+		while (!m_deadlines.Empty() && m_deadlines[0].deadline <= now)
+		{
+			Entry entry = PopEntry(m_deadlines, true);
+
+			// entry left in ready heap is skipped from now on
+			Task* task;
+			if (m_tasks.TryGet(entry.id, &task) && !task->overdue)
+			{
+				task->overdue = true;
+				PushEntry(m_overdue, entry, false);
+			}
+		}
+	}
+
+	int FrameScheduler::PopTask()
+	{
+		// each overdue task gets one step in a turn, a new turn starts when all had theirs
+		if (m_overdue.Empty())
+		{
+			for (int i = 0; i < m_overdue_stepped.Size(); ++i)
+			{
+				const Task* task;
+				if (m_tasks.TryGet(m_overdue_stepped[i], &task))
+				{
+					PushEntry(m_overdue, MakeEntry(*task), false);
+				}
+			}
+			m_overdue_stepped.Clear();
+		}
+
+		while (!m_overdue.Empty())
+		{
+			Entry entry = PopEntry(m_overdue, false);
+			if (m_tasks.Contains(entry.id))
+			{
+				return entry.id;
+			}
+		}
+
+		while (!m_ready.Empty())
+		{
+			Entry entry = PopEntry(m_ready, false);
+			const Task* task;
+			if (m_tasks.TryGet(entry.id, &task) && !task->overdue)
+			{
+				return entry.id;
+			}
+		}
+
+		return -1;
+	}
+
+	bool FrameScheduler::RunStep(int id)
+	{
+		Task* task;
+		m_tasks.TryGet(id, &task);
+
+		auto begin = Clock::now();
+		if (task->stats.steps == 0)
+		{
+			task->first_step_time = begin;
+		}
+
+		// step may add or cancel tasks, so it is called from a copy and task is found again after
+		Step step = task->step;
+		bool done = step();
+
+		auto end = Clock::now();
+		if (!m_tasks.TryGet(id, &task))
+		{
+			return false;
+		}
+
+		task->stats.steps += 1;
+		task->stats.run_ms += DurationMS(begin, end);
+
+		if (done)
+		{
+			TaskStats stats;
+			this->FillStats(*task, end, &stats);
+			m_finished_stats.AddLast(stats);
+			if (m_finished_stats.Size() > FINISHED_STATS_MAX_COUNT)
+			{
+				m_finished_stats.RemoveFirst();
+			}
+
+			m_tasks.Remove(id);
+			return false;
+		}
+
+		return true;
+	}
+
+	void FrameScheduler::FillStats(const Task& task, const Clock::time_point& now, TaskStats* stats) const
+	{
+		*stats = task.stats;
+		stats->wait_ms = task.stats.steps > 0 ? DurationMS(task.add_time, task.first_step_time) : DurationMS(task.add_time, now);
+		stats->latency_ms = DurationMS(task.add_time, now);
+		stats->frames = m_frame_count - task.add_frame;
+		stats->missed_deadline = task.deadline != task.add_time && now > task.deadline;
+	}
+}
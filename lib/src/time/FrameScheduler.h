@@ -0,0 +1,127 @@
+/*
+* Viry3D
+* Copyright 2014-2019 by Stack - stackos@qq.com
+*
+* Licensed under the Apache License, Version 2.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at
+*
+*     http://www.apache.org/licenses/LICENSE-2.0
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+*/
+
+#pragma once
+
+#include "container/Vector.h"
+#include "container/List.h"
+#include "container/Map.h"
+#include "string/String.h"
+#include "thread/ActionQueue.h"
+#include <functional>
+#include <chrono>
+
+namespace Viry3D
+{
+	// runs resumable main thread tasks in slices within a time budget per frame,
+	// a task is a step function called once per slice until it returns true.
+	// tasks past their deadline go first, one step each in turn, others go by priority then deadline then add order.
+	// all steps count against the budget, at least one step runs each frame.
+	class FrameScheduler
+	{
+	public:
+		// returns true when task finished
+		typedef std::function<bool()> Step;
+
+		struct TaskStats
+		{
+			String name;
+			int priority;
+			// steps run and ms spent in them
+			int steps;
+			float run_ms;
+			// from add to first step, and to finish or now if pending
+			float wait_ms;
+			float latency_ms;
+			int frames;
+			bool missed_deadline;
+		};
+
+		static const int FINISHED_STATS_MAX_COUNT = 64;
+
+		FrameScheduler();
+		// main thread, higher priority runs first, deadline in ms from now, 0 for none, returns task id
+		int Add(const String& name, const Step& step, int priority = 0, float deadline_ms = 0);
+		// any thread, task without deadline is added at begin of next run, it can not be canceled
+		void Post(const String& name, const Step& step, int priority = 0);
+		void Cancel(int id);
+		bool IsPending(int id) const;
+		int GetPendingCount() const { return m_tasks.Size(); }
+		float GetBudget() const { return m_budget_ms; }
+		void SetBudget(float ms) { m_budget_ms = ms; }
+		// called by engine each frame, steps may add tasks, they run from next frame
+		void Run();
+		// stats of pending task, false if task finished or canceled
+		bool GetStats(int id, TaskStats* stats) const;
+		// stats of recently finished tasks, oldest first
+		const List<TaskStats>& GetFinishedStats() const { return m_finished_stats; }
+
+	private:
+		typedef std::chrono::steady_clock Clock;
+
+		struct Task
+		{
+			int id;
+			Step step;
+			Clock::time_point add_time;
+			Clock::time_point first_step_time;
+			// no deadline if equals add time
+			Clock::time_point deadline;
+			int add_frame;
+			bool overdue;
+			TaskStats stats;
+		};
+
+		// heap entries keep order fields, entries of finished, canceled or moved tasks are skipped when popped
+		struct Entry
+		{
+			int id;
+			int priority;
+			bool has_deadline;
+			Clock::time_point deadline;
+		};
+
+		static Entry MakeEntry(const Task& task);
+		static bool RunsBefore(const Entry& a, const Entry& b);
+		static void PushEntry(Vector<Entry>& heap, const Entry& entry, bool by_deadline);
+		static Entry PopEntry(Vector<Entry>& heap, bool by_deadline);
+		void Schedule(const Task& task);
+		void PromoteOverdue(const Clock::time_point& now);
+		int PopTask();
+		// false if task finished or canceled in step
+		bool RunStep(int id);
+		void FillStats(const Task& task, const Clock::time_point& now, TaskStats* stats) const;
+
+	private:
+		float m_budget_ms;
+		int m_next_id;
+		int m_frame_count;
+		Map<int, Task> m_tasks;
+		// added since last run, scheduled at begin of next run
+		Vector<int> m_added;
+		ActionQueue m_posted;
+		// tasks not overdue, by priority
+		Vector<Entry> m_ready;
+		// tasks with deadline not overdue yet, by deadline
+		Vector<Entry> m_deadlines;
+		// overdue tasks not stepped in this turn, by priority
+		Vector<Entry> m_overdue;
+		// overdue tasks stepped in this turn, back to overdue heap when the turn ends
+		Vector<int> m_overdue_stepped;
+		List<TaskStats> m_finished_stats;
+	};
+}
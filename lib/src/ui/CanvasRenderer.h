@@ -50,9 +50,13 @@ namespace Viry3D
 		void MarkCanvasDirty();
 		Ref<Camera> GetCamera() const { return m_camera.lock(); }
 		void SetCamera(const Ref<Camera>& camera) { m_camera = camera; }
+		// canvas mesh is built in canvas camera space, never culled
+		virtual const Bounds* GetBounds() { return nullptr; }
 
 	protected:
 		virtual void Prepare();
+		// layout and touch events are handled even if canvas is not drawn
+		virtual bool IsAlwaysPrepared() const { return true; }
 		virtual void OnResize(int width, int height);
 
 	private:
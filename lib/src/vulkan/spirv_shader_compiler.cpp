@@ -56,19 +56,19 @@ namespace Viry3D
 	{
 		void InitShaderCompiler()
 		{
-#if VR_WINDOWS || VR_UWP
+#if VR_WINDOWS || VR_UWP || VR_LINUX
 			glslang::InitializeProcess();
 #endif
 		}
 
 		void DeinitShaderCompiler()
 		{
-#if VR_WINDOWS || VR_UWP
+#if VR_WINDOWS || VR_UWP || VR_LINUX
 			glslang::FinalizeProcess();
 #endif
 		}
 
-#if VR_WINDOWS || VR_UWP
+#if VR_WINDOWS || VR_UWP || VR_LINUX
 		static void InitResources(TBuiltInResource& resources)
 		{
 			resources.maxLights = 32;
@@ -183,7 +183,7 @@ namespace Viry3D
 
 		bool GlslToSpv(ShaderType shader_type, const char* src, Vector<unsigned int>& spirv, String& error)
 		{
-#if VR_WINDOWS || VR_UWP
+#if VR_WINDOWS || VR_UWP || VR_LINUX
 			EShLanguage type = FindShaderType(shader_type);
 			glslang::TShader shader(type);
 			const char *shader_strings[1];